@@ -0,0 +1,367 @@
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <unistd.h>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+constexpr char checkpoint::magic[8];
+constexpr uint32_t checkpoint::page_size;
+
+/**
+ * @brief Registers a run of bytes.
+ * 
+ * @param name The field's name, a dotted path like "hart0.x".
+ * @param p The bytes.
+ * @param len The number of bytes.
+*/
+void checkpoint::add(const std::string &name, void *p, size_t len)
+{
+    uint8_t *b = static_cast<uint8_t *>(p);
+    fields.push_back({ name,
+        [b, len] { return std::string(reinterpret_cast<const char *>(b), len); },
+        [b, len] (const std::string &s)
+        {
+            if (s.size() != len)
+            {
+                return false;
+            }
+            memcpy(b, s.data(), len);
+            return true;
+        } });
+}
+
+/**
+ * @brief Registers a string, which may have any length.
+ * 
+ * @param name The field's name.
+ * @param s The string.
+*/
+void checkpoint::add(const std::string &name, std::string *s)
+{
+    fields.push_back({ name,
+        [s] { return *s; },
+        [s] (const std::string &v) { *s = v; return true; } });
+}
+
+/**
+ * @brief Registers state that is not held as plain bytes, such as a
+ * queue.
+ *
+ * @param name The field's name.
+ * @param get Returns the state as bytes.
+ * @param set Sets the state from bytes, and returns false if they are
+ *  not the state.
+*/
+void checkpoint::add(const std::string &name, std::function<std::string()> get, std::function<bool(const std::string &)> set)
+{
+    fields.push_back({ name, std::move(get), std::move(set) });
+}
+
+/**
+ * @brief Captures every registered field and all of RAM to memory.
+ *
+ * @param img Set to the state.
+ * @param mem The memory whose RAM is captured.
+ * @param prev The image captured before, whose unchanged pages are
+ *  shared, or nullptr.
+*/
+void checkpoint::capture(image &img, memory &mem, const image *prev) const
+{
+    img.values.clear();
+    for (const field &f : fields)
+    {
+        img.values.push_back(f.get());
+    }
+
+    uint32_t pages = (mem.get_size() + page_size - 1) / page_size;
+    const uint8_t *ram = mem.get_ptr(0, mem.get_size());
+    img.pages.resize(pages);
+    for (uint32_t i = 0; i < pages; ++i)
+    {
+        const uint8_t *p = ram + i * page_size;
+        uint32_t len = std::min(page_size, mem.get_size() - i * page_size);
+        if (prev && prev->pages.size() == pages && memcmp(prev->pages[i]->data(), p, len) == 0)
+        {
+            img.pages[i] = prev->pages[i];
+        }
+        else
+        {
+            img.pages[i] = std::make_shared<const std::string>(reinterpret_cast<const char *>(p), len);
+        }
+    }
+}
+
+/**
+ * @brief Puts the machine back in the state of an image captured from
+ * it, copying only the pages that differ.
+ *
+ * @param img The state.
+ * @param mem The memory it was captured from.
+*/
+void checkpoint::apply(const image &img, memory &mem)
+{
+    for (size_t i = 0; i < fields.size(); ++i)
+    {
+        fields[i].set(img.values[i]);
+    }
+
+    uint8_t *ram = mem.get_ptr(0, mem.get_size());
+    for (size_t i = 0; i < img.pages.size(); ++i)
+    {
+        const std::string &page = *img.pages[i];
+        if (memcmp(ram + i * page_size, page.data(), page.size()) != 0)
+        {
+            memcpy(ram + i * page_size, page.data(), page.size());
+        }
+    }
+
+    for (auto &fn : restored)
+    {
+        fn();
+    }
+}
+
+/**
+ * @brief Writes every registered field and all of RAM to a file.
+ * 
+ * @param fname The file.
+ * @param mem The memory whose RAM is saved.
+ * @param m What the machine was built with.
+ * 
+ * @return False, after printing why on std::cerr, if the file could not
+ *  be written.
+*/
+bool checkpoint::save(const std::string &fname, memory &mem, const machine &m) const
+{
+    std::ofstream os(fname, std::ios::binary | std::ios::trunc);
+    if (!os)
+    {
+        cerr << "Can't create checkpoint " << fname << endl;
+        return false;
+    }
+
+    file_header h = { };
+    memcpy(h.magic, magic, sizeof(h.magic));
+    h.xlen = m.xlen;
+    h.vlen = m.vlen;
+    h.harts = m.harts;
+    h.mem_size = m.mem_size;
+    h.page_size = page_size;
+    h.num_fields = fields.size();
+    os.write(reinterpret_cast<const char *>(&h), sizeof(h));
+
+    for (const field &f : fields)
+    {
+        std::string v = f.get();
+        uint16_t name_len = f.name.size();
+        uint32_t len = v.size();
+        os.write(reinterpret_cast<const char *>(&name_len), sizeof(name_len));
+        os.write(f.name.data(), name_len);
+        os.write(reinterpret_cast<const char *>(&len), sizeof(len));
+        os.write(v.data(), len);
+    }
+
+    // Map every page, noting the ones that hold a single byte value.
+    uint32_t pages = (mem.get_size() + page_size - 1) / page_size;
+    const uint8_t *ram = mem.get_ptr(0, mem.get_size());
+    std::vector<uint16_t> map(pages);
+    for (uint32_t i = 0; i < pages; ++i)
+    {
+        const uint8_t *p = ram + i * page_size;
+        uint32_t len = std::min(page_size, mem.get_size() - i * page_size);
+        bool fill = len == page_size && memcmp(p, p + 1, len - 1) == 0;
+        map[i] = fill ? (page_fill | p[0]) : page_data;
+    }
+    h.map_offset = os.tellp();
+    os.write(reinterpret_cast<const char *>(map.data()), map.size() * sizeof(uint16_t));
+
+    // The pages with data start on a page boundary of the file.
+    uint64_t map_end = os.tellp();
+    h.data_offset = (map_end + page_size - 1) / page_size * page_size;
+    os.write(std::string(h.data_offset - map_end, '\0').data(), h.data_offset - map_end);
+    for (uint32_t i = 0; i < pages; ++i)
+    {
+        if (map[i] == page_data)
+        {
+            // A short last page is padded to a whole one.
+            uint32_t len = std::min(page_size, mem.get_size() - i * page_size);
+            os.write(reinterpret_cast<const char *>(ram + i * page_size), len);
+            os.write(std::string(page_size - len, '\0').data(), page_size - len);
+        }
+    }
+
+    os.seekp(0);
+    os.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    os.close();
+    if (!os)
+    {
+        cerr << "Can't write checkpoint " << fname << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the header of a checkpoint and checks it is one.
+ * 
+ * @param is The file.
+ * @param h Set to the header.
+ * 
+ * @return False if the file is not a checkpoint.
+*/
+bool checkpoint::read_header(std::istream &is, file_header &h)
+{
+    is.read(reinterpret_cast<char *>(&h), sizeof(h));
+    return is && memcmp(h.magic, magic, sizeof(h.magic)) == 0 && h.page_size == page_size;
+}
+
+/**
+ * @brief Reads what the machine that saved a checkpoint was built with.
+ * 
+ * @param fname The file.
+ * @param m Set to the machine.
+ * 
+ * @return False if the file is not a checkpoint.
+*/
+bool checkpoint::read_machine(const std::string &fname, machine &m)
+{
+    std::ifstream is(fname, std::ios::binary);
+    file_header h;
+    if (!read_header(is, h))
+    {
+        return false;
+    }
+    m.xlen = h.xlen;
+    m.vlen = h.vlen;
+    m.harts = h.harts;
+    m.mem_size = h.mem_size;
+    return true;
+}
+
+/**
+ * @brief Restores every registered field and all of RAM from a file.
+ * 
+ * @param fname The file.
+ * @param mem The memory whose RAM is restored. It has to be the size
+ *  the checkpoint was saved with.
+ * 
+ * @return False, after printing why on std::cerr, if the file does not
+ *  fit the machine. The machine is left half restored then.
+*/
+bool checkpoint::restore(const std::string &fname, memory &mem)
+{
+    std::ifstream is(fname, std::ios::binary);
+    file_header h;
+    if (!read_header(is, h))
+    {
+        cerr << "Not a checkpoint: " << fname << endl;
+        return false;
+    }
+    if (h.mem_size != mem.get_size())
+    {
+        cerr << "Checkpoint " << fname << " is of a different memory size" << endl;
+        return false;
+    }
+
+    std::map<std::string, std::string> saved;
+    for (uint32_t i = 0; i < h.num_fields && is; ++i)
+    {
+        uint16_t name_len = 0;
+        uint32_t len = 0;
+        is.read(reinterpret_cast<char *>(&name_len), sizeof(name_len));
+        std::string name(name_len, '\0');
+        is.read(&name[0], name_len);
+        is.read(reinterpret_cast<char *>(&len), sizeof(len));
+        std::string v(len, '\0');
+        is.read(&v[0], len);
+        saved[name] = v;
+    }
+
+    uint32_t pages = (mem.get_size() + page_size - 1) / page_size;
+    std::vector<uint16_t> map(pages);
+    is.seekg(h.map_offset);
+    is.read(reinterpret_cast<char *>(map.data()), map.size() * sizeof(uint16_t));
+    if (!is)
+    {
+        cerr << "Checkpoint " << fname << " is cut short" << endl;
+        return false;
+    }
+
+    for (const field &f : fields)
+    {
+        auto it = saved.find(f.name);
+        if (it == saved.end() || !f.set(it->second))
+        {
+            cerr << "Checkpoint " << fname << " has no " << f.name << " of the right size" << endl;
+            return false;
+        }
+        saved.erase(it);
+    }
+    if (!saved.empty())
+    {
+        cerr << "Checkpoint " << fname << " has " << saved.begin()->first << ", which this machine lacks" << endl;
+        return false;
+    }
+
+    // RAM starts out zero, each run of pages in the file is mapped over
+    // it, and the pages of some other single value are filled.
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        cerr << "Can't open checkpoint " << fname << endl;
+        return false;
+    }
+    mem.clear_ram();
+    uint8_t *ram = mem.get_ptr(0, mem.get_size());
+    bool ok = true;
+    uint64_t offset = h.data_offset;
+    for (uint32_t i = 0; i < pages && ok; )
+    {
+        if (map[i] != page_data)
+        {
+            if (map[i] & 0xff)
+            {
+                memset(ram + i * page_size, map[i] & 0xff, std::min(page_size, mem.get_size() - i * page_size));
+            }
+            ++i;
+            continue;
+        }
+
+        uint32_t run = 1;
+        while (i + run < pages && map[i + run] == page_data)
+        {
+            ++run;
+        }
+
+        // A host with bigger pages, or a short last page, gets a read.
+        uint32_t len = std::min(run * page_size, mem.get_size() - i * page_size);
+        if (!mem.map_pages(i * page_size, run * page_size, fd, offset))
+        {
+            ok = pread(fd, ram + i * page_size, len, offset) == (ssize_t) len;
+        }
+        offset += (uint64_t) run * page_size;
+        i += run;
+    }
+    close(fd);
+    if (!ok)
+    {
+        cerr << "Checkpoint " << fname << " is cut short" << endl;
+        return false;
+    }
+
+    for (auto &fn : restored)
+    {
+        fn();
+    }
+    return true;
+}
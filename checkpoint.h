@@ -0,0 +1,153 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "memory.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A registry of the machine's state, which saves all of it to a
+ * file and restores it from one.
+ * 
+ * As with the statistics, the hart, the register files and each device
+ * register their state once by name, and save and restore walk the
+ * list. A field is a run of bytes copied in place, or an atomic or a
+ * string copied through its value. A restore matches the fields by
+ * name, and every field registered has to be in the file at the same
+ * size and every field in the file has to be registered, so a
+ * checkpoint only goes back into a machine built like the one that
+ * saved it. State that follows from the fields, such as the TLBs, is
+ * rebuilt by the callbacks added with on_restore.
+ * 
+ * The file is a header, the fields, a map of RAM with two bytes per
+ * 4 KiB page, and then the pages. A page that holds one byte value
+ * throughout, as untouched or cleared RAM does, is only in the map.
+ * The rest follow in address order from a page boundary, so a restore
+ * maps them straight into RAM copy-on-write rather than reading them.
+ * The same state can be captured to an image in memory instead, to go
+ * back to it within the run.
+*/
+class checkpoint
+{
+public:
+    /**
+     * @brief What the machine has to be built with to take the state.
+    */
+    struct machine
+    {
+        uint32_t xlen = { 32 };
+        uint32_t vlen = { 128 };
+        uint32_t harts = { 1 };
+        uint32_t mem_size = { 0 };
+    };
+
+    void add(const std::string &name, void *p, size_t len);
+    void add(const std::string &name, std::string *s);
+    void add(const std::string &name, std::function<std::string()> get, std::function<bool(const std::string &)> set);
+    /**
+     * @brief Registers a plain value or array.
+     * 
+     * @param name The field's name, a dotted path like "hart0.pc".
+     * @param p The value. It is copied as bytes.
+    */
+    template <typename T> void add(const std::string &name, T *p) { add(name, static_cast<void *>(p), sizeof(T)); }
+    template <typename T> void add(const std::string &name, std::atomic<T> *p);
+    /**
+     * @brief Adds a callback run after every field has been restored.
+     * 
+     * @param fn The callback.
+    */
+    void on_restore(std::function<void()> fn) { restored.push_back(std::move(fn)); }
+
+    /**
+     * @brief The state held in memory rather than in a file. Each page is
+     * shared with the image captured before it if it has not changed
+     * since, so an image costs the pages written in between.
+    */
+    struct image
+    {
+        std::vector<std::string> values;    ///< By field, in the order they were added.
+        std::vector<std::shared_ptr<const std::string>> pages;
+    };
+
+    void capture(image &img, memory &mem, const image *prev) const;
+    void apply(const image &img, memory &mem);
+
+    bool save(const std::string &fname, memory &mem, const machine &m) const;
+    bool restore(const std::string &fname, memory &mem);
+    static bool read_machine(const std::string &fname, machine &m);
+
+    static constexpr uint32_t page_size = 0x1000;
+
+private:
+    /**
+     * @brief One registered field.
+    */
+    struct field
+    {
+        std::string name;
+        std::function<std::string()> get;
+        std::function<bool(const std::string &)> set;   ///< False if the size is wrong.
+    };
+
+    /**
+     * @brief The start of the file.
+    */
+    struct file_header
+    {
+        char magic[8];
+        uint32_t xlen;
+        uint32_t vlen;
+        uint32_t harts;
+        uint32_t mem_size;
+        uint32_t page_size;
+        uint32_t num_fields;
+        uint64_t map_offset;
+        uint64_t data_offset;
+    };
+
+    static constexpr char magic[8] = { 'R', 'V', 'C', 'K', 'P', 'T', '0', '1' };
+    static constexpr uint16_t page_data = 0;            ///< A map entry for a page in the file.
+    static constexpr uint16_t page_fill = 0x100;        ///< Or'ed with the byte a page is full of.
+
+    static bool read_header(std::istream &is, file_header &h);
+
+    std::vector<field> fields;
+    std::vector<std::function<void()>> restored;
+};
+
+/**
+ * @brief Registers an atomic value.
+ * 
+ * @param name The field's name.
+ * @param p The atomic. It is read and written through its value.
+*/
+template <typename T> void checkpoint::add(const std::string &name, std::atomic<T> *p)
+{
+    fields.push_back({ name,
+        [p] { T v = p->load(); return std::string(reinterpret_cast<const char *>(&v), sizeof(v)); },
+        [p] (const std::string &s)
+        {
+            T v;
+            if (s.size() != sizeof(v))
+            {
+                return false;
+            }
+            memcpy(&v, s.data(), sizeof(v));
+            p->store(v);
+            return true;
+        } });
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include "clint.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+thread_local uint32_t clint::current_hart = 0;
+
+/**
+ * @brief Constructor for the CLINT.
+ * 
+ * @param harts The number of harts. Every msip starts clear and every
+ *  mtimecmp at its largest value, so no interrupt is pending.
+*/
+clint::clint(uint32_t harts) : num_harts(harts), ports(new hart_port[harts])
+{
+}
+
+/**
+ * @brief Connects a hart to its msip and mtimecmp.
+ * 
+ * @param hart The hart ID.
+ * @param counter The hart's instruction count, which mtime follows.
+ * @param wake Set to 0 when a write may have raised an interrupt of
+ *  the hart.
+*/
+void clint::attach_hart(uint32_t hart, const uint64_t *counter, std::atomic<uint64_t> *wake)
+{
+    ports[hart].counter = counter;
+    ports[hart].wake = wake;
+}
+
+/**
+ * @brief Sets the hart whose mtime the calling host thread reads.
+ * 
+ * @param hart The hart ID of the hart running on this thread.
+*/
+void clint::bind_thread(uint32_t hart)
+{
+    current_hart = hart;
+}
+
+/**
+ * @brief Reads a byte of a CLINT register.
+ * 
+ * @param offset The offset from the CLINT's base.
+ * 
+ * @return The byte, or 0 for an offset with no register.
+*/
+uint8_t clint::read8(uint32_t offset)
+{
+    if (offset - msip_offset < 4 * num_harts)
+    {
+        uint32_t hart = (offset - msip_offset) / 4;
+        return (offset % 4 == 0) ? ports[hart].msip.load() : 0;
+    }
+    if (offset - mtimecmp_offset < 8 * num_harts)
+    {
+        uint32_t hart = (offset - mtimecmp_offset) / 8;
+        return ports[hart].mtimecmp.load() >> (8 * (offset % 8));
+    }
+    if (offset - mtime_offset < 8)
+    {
+        return get_mtime(current_hart) >> (8 * (offset % 8));
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a byte of a CLINT register, and wakes the harts whose
+ * interrupts it may change.
+ * 
+ * @param offset The offset from the CLINT's base.
+ * @param val The byte.
+*/
+void clint::write8(uint32_t offset, uint8_t val)
+{
+    if (offset - msip_offset < 4 * num_harts)
+    {
+        uint32_t hart = (offset - msip_offset) / 4;
+        if (offset % 4 == 0)
+        {
+            ports[hart].msip = val & 1;
+            wake(hart);
+        }
+        return;
+    }
+
+    uint32_t shift = 8 * (offset % 8);
+    uint64_t mask = ~((uint64_t) 0xff << shift);
+
+    if (offset - mtimecmp_offset < 8 * num_harts)
+    {
+        uint32_t hart = (offset - mtimecmp_offset) / 8;
+        ports[hart].mtimecmp = (ports[hart].mtimecmp.load() & mask) | ((uint64_t) val << shift);
+        wake(hart);
+        return;
+    }
+    if (offset - mtime_offset < 8)
+    {
+        // Move every hart's time by the same amount.
+        uint64_t now = get_mtime(current_hart);
+        uint64_t counter = ports[current_hart].counter ? *ports[current_hart].counter : 0;
+        time_offset = ((now & mask) | ((uint64_t) val << shift)) - counter;
+        for (uint32_t i = 0; i < num_harts; ++i)
+        {
+            wake(i);
+        }
+    }
+}
+
+/**
+ * @brief Getter for a hart's msip
+ * 
+ * @param hart The hart ID.
+ * 
+ * @return True if the hart's software interrupt is pending.
+*/
+bool clint::get_msip(uint32_t hart) const
+{
+    return ports[hart].msip.load(std::memory_order_relaxed) != 0;
+}
+
+/**
+ * @brief Checks a hart's timer.
+ * 
+ * @param hart The hart ID.
+ * 
+ * @return True if the hart's timer interrupt is pending.
+*/
+bool clint::get_mtip(uint32_t hart) const
+{
+    return get_mtime(hart) >= ports[hart].mtimecmp.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Gets when a hart's timer interrupt will be raised.
+ * 
+ * @param hart The hart ID.
+ * 
+ * @return The hart's instruction count at which mtime reaches mtimecmp.
+*/
+uint64_t clint::get_deadline(uint32_t hart) const
+{
+    uint64_t cmp = ports[hart].mtimecmp.load(std::memory_order_relaxed);
+    uint64_t offset = time_offset.load(std::memory_order_relaxed);
+    return cmp > offset ? cmp - offset : 0;
+}
+
+/**
+ * @brief Registers msip and mtimecmp of every hart, and the offset
+ * mtime has from the instruction count, for checkpoints.
+ * 
+ * @param c The checkpoint registry.
+ * @param prefix The name the fields are grouped under.
+*/
+void clint::register_state(checkpoint &c, const std::string &prefix)
+{
+    for (uint32_t i = 0; i < num_harts; ++i)
+    {
+        c.add(prefix + ".msip" + std::to_string(i), &ports[i].msip);
+        c.add(prefix + ".mtimecmp" + std::to_string(i), &ports[i].mtimecmp);
+    }
+    c.add(prefix + ".time_offset", &time_offset);
+}
+
+/**
+ * @brief Gets mtime as a hart sees it.
+ * 
+ * @param hart The hart ID.
+ * 
+ * @return The hart's instruction count plus the offset of the last
+ *  write to mtime.
+*/
+uint64_t clint::get_mtime(uint32_t hart) const
+{
+    uint64_t counter = ports[hart].counter ? *ports[hart].counter : 0;
+    return counter + time_offset.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Makes a hart look at its interrupts at its next block boundary.
+ * 
+ * @param hart The hart ID.
+*/
+void clint::wake(uint32_t hart)
+{
+    if (ports[hart].wake)
+    {
+        ports[hart].wake->store(0, std::memory_order_relaxed);
+    }
+}
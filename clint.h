@@ -0,0 +1,75 @@
+#ifndef CLINT_H
+#define CLINT_H
+
+#include "checkpoint.h"
+#include <atomic>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief The core-local interruptor: msip, mtimecmp and mtime.
+ * 
+ * The registers sit at the SiFive offsets, msip at 0x0 and mtimecmp at
+ * 0x4000 for each hart in turn, and mtime at 0xbff8. mtime ticks once
+ * per instruction. Each hart runs on its own host thread without
+ * keeping step with the others, so each one sees mtime as its own
+ * instruction count plus an offset that writes to mtime share.
+ * 
+ * The harts never poll the CLINT. Each one keeps the instruction count
+ * at which it next has to look at its interrupts, and a write that may
+ * raise one sets that to 0 so the hart looks at its next block boundary.
+*/
+class clint : public mmio_device
+{
+public:
+    clint(uint32_t harts);
+
+    uint8_t read8(uint32_t offset) override;
+    void write8(uint32_t offset, uint8_t val) override;
+
+    void attach_hart(uint32_t hart, const uint64_t *counter, std::atomic<uint64_t> *wake);
+    void bind_thread(uint32_t hart);
+
+    bool get_msip(uint32_t hart) const;
+    bool get_mtip(uint32_t hart) const;
+    uint64_t get_deadline(uint32_t hart) const;
+
+    void register_state(checkpoint &c, const std::string &prefix);
+
+    static constexpr uint32_t base          = 0x02000000;
+    static constexpr uint32_t size          = 0x10000;
+    static constexpr uint32_t msip_offset   = 0x0000;
+    static constexpr uint32_t mtimecmp_offset = 0x4000;
+    static constexpr uint32_t mtime_offset  = 0xbff8;
+
+private:
+    /**
+     * @brief The registers of one hart and how to reach the hart.
+    */
+    struct hart_port
+    {
+        std::atomic<uint32_t> msip = { 0 };
+        std::atomic<uint64_t> mtimecmp = { UINT64_MAX };
+        const uint64_t *counter = { nullptr };  ///< The hart's instruction count.
+        std::atomic<uint64_t> *wake = { nullptr };  ///< When the hart next checks.
+    };
+
+    uint64_t get_mtime(uint32_t hart) const;
+    void wake(uint32_t hart);
+
+    uint32_t num_harts;
+    std::unique_ptr<hart_port[]> ports;
+    std::atomic<uint64_t> time_offset = { 0 };
+
+    static thread_local uint32_t current_hart;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "cpu_multi_hart.h"
+#include <thread>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor for the cpu.
+ * 
+ * @param m The simulated memory the harts share.
+ * @param n The number of harts.
+*/
+template <uint32_t XLEN>
+cpu_multi_hart<XLEN>::cpu_multi_hart(memory &m, uint32_t n) : mem(m)
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        harts.push_back(std::unique_ptr<cpu_single_hart<XLEN>>(new cpu_single_hart<XLEN>(mem)));
+
+        // Label every line a hart prints once there is more than one.
+        if (n > 1)
+        {
+            harts[i]->set_header("[" + std::to_string(i) + "] ");
+        }
+    }
+
+    // A single hart keeps time for the device events.
+    if (n == 1)
+    {
+        harts[0]->set_events(&events);
+    }
+}
+
+/**
+ * @brief Resets every hart and gives each its hart ID.
+*/
+template <uint32_t XLEN>
+void cpu_multi_hart<XLEN>::reset()
+{
+    for (uint32_t i = 0; i < harts.size(); ++i)
+    {
+        harts[i]->reset();
+        harts[i]->set_mhartid(i);
+    }
+}
+
+/**
+ * @brief Runs every hart until it halts or hits the limit, then prints
+ * the results of each.
+ * 
+ * @param exec_limit The maximum number of instructions each hart may
+ * execute.
+*/
+template <uint32_t XLEN>
+void cpu_multi_hart<XLEN>::run(uint64_t exec_limit)
+{
+    if (harts.size() == 1)
+    {
+        harts[0]->run(exec_limit);
+        return;
+    }
+
+    // Start a host thread per hart and wait for all of them.
+    std::vector<std::thread> threads;
+    for (auto &h : harts)
+    {
+        cpu_single_hart<XLEN> *hart = h.get();
+        threads.push_back(std::thread([hart, exec_limit] { hart->execute(exec_limit); }));
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    uint64_t insns = 0;
+    for (auto &h : harts)
+    {
+        h->finish();
+        insns += h->get_insn_counter();
+    }
+
+    // Dump the final statistics of all the harts.
+    if (st)
+    {
+        st->dump(cout, insns);
+    }
+}
+
+/**
+ * @brief Sets the statistics registry and registers the harts and memory.
+ * 
+ * @param s The statistics registry.
+ * @param interval Dump the statistics every interval instructions, or
+ * only at the end of the run if 0. Periodic dumps are only made with a
+ * single hart, since the harts do not run in step.
+*/
+template <uint32_t XLEN>
+void cpu_multi_hart<XLEN>::set_stats(stats *s, uint64_t interval)
+{
+    if (harts.size() == 1)
+    {
+        harts[0]->set_stats(s, interval);
+        return;
+    }
+
+    st = s;
+    for (uint32_t i = 0; i < harts.size(); ++i)
+    {
+        harts[i]->register_stats(*st, "hart" + std::to_string(i));
+    }
+    mem.register_stats(*st, "mem");
+}
+
+/**
+ * @brief Dumps the registers of every hart.
+*/
+template <uint32_t XLEN>
+void cpu_multi_hart<XLEN>::dump()
+{
+    for (auto &h : harts)
+    {
+        h->dump(harts.size() > 1 ? "[" + std::to_string(h->get_mhartid()) + "] " : "");
+    }
+}
+
+template class cpu_multi_hart<32>;
+template class cpu_multi_hart<64>;
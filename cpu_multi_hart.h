@@ -0,0 +1,66 @@
+#ifndef CPU_MULTI_HART_H
+#define CPU_MULTI_HART_H
+
+#include "cpu_single_hart.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A cpu with several harts sharing one memory.
+ * 
+ * Every hart runs on its own host thread. The harts only meet in
+ * memory, where the A extension's atomics are host atomics, so no
+ * simulator-wide lock is needed. With a single hart the cpu runs on
+ * the calling thread and behaves exactly like a cpu_single_hart.
+ * 
+ * @tparam XLEN 32 for RV32, 64 for RV64.
+*/
+template <uint32_t XLEN>
+class cpu_multi_hart
+{
+public:
+    cpu_multi_hart(memory &m, uint32_t n);
+
+    /**
+     * @brief Getter for the number of harts.
+     * 
+     * @return The number of harts.
+    */
+    uint32_t get_num_harts() const { return harts.size(); }
+    /**
+     * @brief Getter for a hart.
+     * 
+     * @param i The hart ID.
+     * 
+     * @return The hart.
+    */
+    cpu_single_hart<XLEN> &get_hart(uint32_t i) { return *harts[i]; }
+    /**
+     * @brief Gets the queue devices schedule their events on.
+     * 
+     * @return The queue, or nullptr with more than one hart, since the
+     *  harts do not run in step and none of them keeps time for all.
+    */
+    event_queue *get_events() { return harts.size() == 1 ? &events : nullptr; }
+
+    void reset();
+    void run(uint64_t exec_limit);
+    void set_stats(stats *s, uint64_t interval);
+    void dump();
+
+private:
+    memory &mem;
+    std::vector<std::unique_ptr<cpu_single_hart<XLEN>>> harts;
+    stats *st = { nullptr };
+    event_queue events;
+};
+
+#endif
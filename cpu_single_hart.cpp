@@ -11,39 +11,359 @@
 //***************************************************************************
 
 /**
- * @brief Runs the cpu.
+ * @brief Runs the cpu and prints the results.
  * 
  * @param exec_limit The maximum number of instructions to be executed
 */
-void cpu_single_hart::run(uint64_t exec_limit)
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::run(uint64_t exec_limit)
 {
-    // Set the 2nd register to the size of memory.
-    regs.set(2, mem.get_size());
+    execute(exec_limit);
+    finish();
+}
 
-    // If there is not a limit...
-    if (exec_limit == 0)
+/**
+ * @brief Runs the cpu until it halts or hits the limit.
+ * 
+ * @param exec_limit The maximum number of instructions to be executed
+ * 
+ * @note Each hart gets its own stack_size bytes of stack, counting
+ * down from the end of memory by hart ID. Hart 0's stack pointer is
+ * the size of memory, as it always was, or points at argc under
+ * system call emulation.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::execute(uint64_t exec_limit)
+{
+    // Set the 2nd register to the top of this hart's stack. Under system
+    // call emulation the stacks start below argv and envp. A hart
+    // restored from a checkpoint already has its stack.
+    if (this->get_insn_counter() == 0)
     {
-        // tick() until the program is halted.
-        while (!is_halted())
-        {
-            tick();
-        }
+        uint32_t top = this->sys ? this->sys->get_stack_top() : this->mem.get_size();
+        this->regs.set(2, top - this->get_mhartid() * stack_size);
+    }
+
+    // mtime reads on this thread are this hart's time.
+    if (this->timer)
+    {
+        this->timer->bind_thread(this->get_mhartid());
     }
-    else    // There is a limit.
+
+    // A breakpoint where the run starts has already been stopped at.
+    uint64_t start = this->get_insn_counter();
+    paused = false;
+
+    // Dump the statistics every stats_interval instructions, if asked.
+    uint64_t next_dump = (st && stats_interval) ? (this->get_insn_counter() / stats_interval + 1) * stats_interval : UINT64_MAX;
+
+    // tick() until the program is halted or we hit the limit, if
+    // there is one. Run in slices that end at each statistics dump
+    // and at the checkpoint.
+    while (!this->is_halted() && !paused && (exec_limit == 0 || this->get_insn_counter() < exec_limit))
     {
-        // tick() until the program is halted or we hit the limit.
-        while (!is_halted() && get_insn_counter() < exec_limit)
+        uint64_t slice_end = std::min(next_dump, snap_at);
+        if (exec_limit != 0 && exec_limit < slice_end)
+        {
+            slice_end = exec_limit;
+        }
+
+        // Run up to the next device event without looking at the
+        // queue. An event scheduled sooner moves the due time forward.
+        // A snapshot the guest asked for ends the slice once no event
+        // is pending.
+        uint64_t due;
+        while (!this->is_halted() && this->get_insn_counter() < slice_end &&
+               this->get_insn_counter() < (due = events ? events->get_due() : UINT64_MAX) &&
+               !(snap_pending && due == UINT64_MAX))
+        {
+            if (breaks && this->get_insn_counter() != start && breaks->count(this->get_pc()))
+            {
+                paused = true;
+                break;
+            }
+
+            // A wait in wfi that the last slice cut short goes on
+            // without an instruction.
+            if (!this->is_idle())
+            {
+                this->tick(header);
+            }
+
+            // A hart in wfi or an idle loop skips ahead to where the wait
+            // ends. A hart that keeps the event time is the only one, so
+            // if nothing it can see will end the wait, nothing will.
+            if (this->is_idle() && !this->fast_forward(std::min(slice_end, due)) && events)
+            {
+                this->stop("Idle with nothing to wake the hart");
+            }
+
+            // Another hart may have ended the program with exit_group.
+            if (this->sys && this->sys->has_exited())
+            {
+                this->stop("exit_group with status " + std::to_string(this->sys->get_exit_status()));
+            }
+        }
+
+        if (events)
+        {
+            events->run_until(this->get_insn_counter());
+        }
+
+        // The snapshot is taken at the first point from snap_at on
+        // where no device has I/O in flight, since an event can be
+        // neither saved nor forked.
+        if (this->get_insn_counter() >= snap_at)
+        {
+            snap_pending = true;
+            snap_at = UINT64_MAX;
+        }
+        if (snap_pending && (!events || events->get_due() == UINT64_MAX))
+        {
+            take_snapshot();
+        }
+
+        if (this->get_insn_counter() == next_dump)
         {
-            tick();
+            st->dump(cout, this->get_insn_counter());
+            next_dump += stats_interval;
         }
     }
 
+    // Guest output a device still holds goes out before the results.
+    this->mem.flush();
+}
+
+/**
+ * @brief Prints the results of the run.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::finish()
+{
     // If the cpu was halted, execution was terminated. Provide the reason.
-    if (is_halted())
+    if (this->is_halted())
     {
-        cout << "Execution terminated. Reason: " << get_halt_reason() << endl;
+        cout << header << "Execution terminated. Reason: " << this->get_halt_reason() << endl;
     }
 
     // Print the number of instructions executed.
-    cout << get_insn_counter() << " instructions executed" << endl;
-}
\ No newline at end of file
+    cout << header << this->get_insn_counter() << " instructions executed" << endl;
+
+    // A variant's result goes back to the parent that forked it.
+    if (fan)
+    {
+        fan->report(this->is_halted() ? this->get_halt_reason() : "Instruction limit reached",
+                    this->get_insn_counter(), this->regs.get(10), XLEN);
+    }
+
+    // Drain the instruction stream and print what each sink found.
+    this->flush_trace();
+    this->report_sinks(cout);
+
+    // Dump the final statistics.
+    if (st)
+    {
+        st->dump(cout, this->get_insn_counter());
+    }
+}
+
+/**
+ * @brief Sets the statistics registry and registers the hart and memory.
+ * 
+ * @param s The statistics registry.
+ * @param interval Dump the statistics every interval instructions, or
+ * only at the end of the run if 0.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::set_stats(stats *s, uint64_t interval)
+{
+    st = s;
+    stats_interval = interval;
+
+    this->register_stats(*st, "hart0");
+    this->mem.register_stats(*st, "mem");
+    if (events)
+    {
+        events->register_stats(*st, "events");
+    }
+}
+
+/**
+ * @brief Sets the event queue this hart's run loop drives.
+ * 
+ * @param q The queue. Its time becomes this hart's instruction count.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::set_events(event_queue *q)
+{
+    events = q;
+    events->set_clock(this->get_clock());
+}
+
+/**
+ * @brief Sets the checkpoint to save.
+ * 
+ * @param c The registry of the machine's state.
+ * @param fname The file to save it to.
+ * @param at The instruction count to save it at, or UINT64_MAX to save
+ * it only when the guest writes the checkpoint command to the marker
+ * CSR.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::set_checkpoint(checkpoint *c, const std::string &fname, uint64_t at)
+{
+    ckpt = c;
+    ckpt_file = fname;
+    snap_at = at;
+}
+
+/**
+ * @brief Sets the variants to fork at the snapshot.
+ * 
+ * @param f The variants.
+ * @param at The instruction count to fork them at, or UINT64_MAX to fork
+ * them only when the guest writes the checkpoint command to the marker
+ * CSR.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::set_fanout(fanout *f, uint64_t at)
+{
+    fan = f;
+    snap_at = at;
+}
+
+/**
+ * @brief Saves the checkpoint and forks the variants, whichever are set.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::take_snapshot()
+{
+    snap_pending = false;
+    if (ckpt)
+    {
+        save_checkpoint();
+    }
+
+    // A child runs its variant to the end rather than forking again.
+    if (fan && !fan->is_child())
+    {
+        fan_out();
+    }
+}
+
+/**
+ * @brief Saves the checkpoint, and says where it was taken.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::save_checkpoint()
+{
+    // What the guest has printed goes out first, as the UART's buffer
+    // is not saved.
+    this->mem.flush();
+
+    checkpoint::machine m;
+    m.xlen = XLEN;
+    m.vlen = this->vregs.get_vlenb() * 8;
+    m.harts = 1;
+    m.mem_size = this->mem.get_size();
+    if (ckpt->save(ckpt_file, this->mem, m))
+    {
+        cout << header << "Checkpoint saved to " << ckpt_file << " at " << this->get_insn_counter() << " instructions" << endl;
+    }
+}
+
+/**
+ * @brief Forks a child per variant. The parent stops once they are all
+ * done, and each child injects its variant and runs on.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::fan_out()
+{
+    // What the guest has printed so far goes out once, from the parent.
+    this->mem.flush();
+
+    int i = fan->split(this->get_insn_counter());
+    if (i < 0)
+    {
+        this->stop("Fanned out to " + std::to_string(fan->get_num_variants()) + " variants");
+        return;
+    }
+
+    const fanout::variant &v = fan->get_variant(i);
+    for (const auto &r : v.regs)
+    {
+        this->regs.set(r.first, r.second);
+    }
+    if (v.set_pc)
+    {
+        this->set_pc(v.pc);
+    }
+    for (const fanout::patch &p : v.patches)
+    {
+        this->mem.set_block(p.addr, reinterpret_cast<const uint8_t *>(p.bytes.data()), p.bytes.size());
+    }
+}
+
+/**
+ * @brief Sets roi_only
+ * 
+ * @param b True to run the detailed models only inside the region of
+ * interest marked by the guest. Until the guest marks the start of
+ * the region the cpu runs in fast functional mode.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::set_roi_only(bool b)
+{
+    roi_only = b;
+    this->set_detailed(!roi_only);
+}
+
+/**
+ * @brief Acts on a command the guest wrote to the marker CSR.
+ * 
+ * @param cmd The command.
+*/
+template <uint32_t XLEN>
+void cpu_single_hart<XLEN>::on_marker(uint32_t cmd)
+{
+    switch (cmd)
+    {
+        case rv_hart<XLEN>::marker_roi_begin:
+            if (roi_only)
+            {
+                this->set_detailed(true);
+            }
+            break;
+        case rv_hart<XLEN>::marker_roi_end:
+            if (roi_only)
+            {
+                this->set_detailed(false);
+            }
+            break;
+        case rv_hart<XLEN>::marker_dump_stats:
+            if (st)
+            {
+                st->dump(cout, this->get_insn_counter());
+            }
+            break;
+        case rv_hart<XLEN>::marker_reset_stats:
+            if (st)
+            {
+                st->reset();
+            }
+            break;
+        case rv_hart<XLEN>::marker_checkpoint:
+            // Taken after this instruction, once the run loop gets to it.
+            if (ckpt || fan)
+            {
+                snap_pending = true;
+            }
+            break;
+        default:
+            // Unknown commands are ignored so newer guests still run.
+            break;
+    }
+}
+
+template class cpu_single_hart<32>;
+template class cpu_single_hart<64>;
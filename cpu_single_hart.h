@@ -1,4 +1,10 @@
+#ifndef CPU_SINGLE_HART_H
+#define CPU_SINGLE_HART_H
+
 #include "rv32i_hart.h"
+#include "event_queue.h"
+#include "fanout.h"
+#include <set>
 
 //***************************************************************************
 //
@@ -10,7 +16,13 @@
 //
 //***************************************************************************
 
-class cpu_single_hart : public rv32i_hart
+/**
+ * @brief A cpu with one hart.
+ * 
+ * @tparam XLEN 32 for RV32, 64 for RV64.
+*/
+template <uint32_t XLEN>
+class cpu_single_hart : public rv_hart<XLEN>
 {
 public:
     /**
@@ -18,7 +30,58 @@ public:
      * 
      * @param mem The simulated memory the CPU will access.
     */
-    cpu_single_hart(memory &mem) : rv32i_hart(mem) {}
+    cpu_single_hart(memory &mem) : rv_hart<XLEN>(mem) {}
 
     void run(uint64_t exec_limit);
-};
\ No newline at end of file
+    void execute(uint64_t exec_limit);
+    void finish();
+
+    void set_stats(stats *s, uint64_t interval);
+    void set_roi_only(bool b);
+    void set_events(event_queue *q);
+    void set_checkpoint(checkpoint *c, const std::string &fname, uint64_t at);
+    void set_fanout(fanout *f, uint64_t at);
+    /**
+     * @brief Sets the breakpoints execute stops at.
+     * 
+     * @param b The addresses, or nullptr for none.
+    */
+    void set_breakpoints(const std::set<uint64_t> *b) { breaks = b; }
+    /**
+     * @brief Checks if execute stopped at a breakpoint.
+     * 
+     * @return True until execute is called again.
+    */
+    bool is_paused() const { return paused; }
+    /**
+     * @brief Setter for header
+     * 
+     * @param h The header printed on each line this hart prints.
+    */
+    void set_header(const std::string &h) { header = h; }
+
+    static constexpr uint32_t stack_size = 0x1000;
+
+protected:
+    void on_marker(uint32_t cmd) override;
+
+private:
+    void take_snapshot();
+    void save_checkpoint();
+    void fan_out();
+
+    bool roi_only = { false };
+    stats *st = { nullptr };
+    uint64_t stats_interval = { 0 };
+    event_queue *events = { nullptr };  ///< Run on this hart's time, if set.
+    checkpoint *ckpt = { nullptr };     ///< Saved at the snapshot, if set.
+    std::string ckpt_file;
+    fanout *fan = { nullptr };          ///< Forked at the snapshot, if set.
+    uint64_t snap_at = { UINT64_MAX };  ///< The snapshot is due here or on the guest's marker.
+    bool snap_pending = { false };      ///< Taken once no device event is pending.
+    const std::set<uint64_t> *breaks = { nullptr };
+    bool paused = { false };
+    std::string header;
+};
+
+#endif
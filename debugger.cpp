@@ -0,0 +1,309 @@
+#include "debugger.h"
+#include <sstream>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor for the debugger. Captures the machine as it is, so
+ * the run can always go back to where it started.
+ * 
+ * @param h The hart.
+ * @param m The memory.
+ * @param c The checkpoint registry, with the machine's state in it.
+ * @param l The replay log the host inputs go through.
+ * @param exec_limit The last instruction count, or 0 for none.
+*/
+template <uint32_t XLEN>
+debugger<XLEN>::debugger(cpu_single_hart<XLEN> &h, memory &m, checkpoint &c, replay_log &l, uint64_t exec_limit) :
+    hart(h), mem(m), ck(c), log(l), limit(exec_limit)
+{
+    frontier = hart.get_insn_counter();
+    log.set_frontier(frontier);
+    take_snapshot();
+}
+
+/**
+ * @brief Reads and runs the commands of a script, printing each one and
+ * where the run is after it.
+ * 
+ * @param is The script, in the format the class describes.
+*/
+template <uint32_t XLEN>
+void debugger<XLEN>::run(std::istream &is)
+{
+    std::string line;
+    while (std::getline(is, line))
+    {
+        std::istringstream ls(line);
+        std::string cmd;
+        if (!(ls >> cmd) || cmd[0] == '#')
+        {
+            continue;
+        }
+        cout << "> " << line << endl;
+
+        uint64_t now = hart.get_insn_counter();
+        uint64_t n;
+        if (cmd == "step")
+        {
+            forward(now + (ls >> n ? n : 1), true);
+            show();
+        }
+        else if (cmd == "continue")
+        {
+            forward(UINT64_MAX, true);
+            show();
+        }
+        else if (cmd == "rstep")
+        {
+            n = ls >> n ? n : 1;
+            go_to(now > n ? now - n : 0);
+            show();
+        }
+        else if (cmd == "rcontinue")
+        {
+            if (!reverse_continue())
+            {
+                cout << "No breakpoint hit before " << now << " instructions" << endl;
+            }
+            show();
+        }
+        else if (cmd == "goto" && ls >> n)
+        {
+            go_to(n);
+            show();
+        }
+        else if (cmd == "break" && ls >> std::hex >> n)
+        {
+            breaks.insert(n);
+        }
+        else if (cmd == "delete" && ls >> std::hex >> n)
+        {
+            breaks.erase(n);
+        }
+        else if (cmd == "regs")
+        {
+            hart.dump();
+        }
+        else if (cmd == "mem" && ls >> std::hex >> n)
+        {
+            uint64_t len;
+            show_mem(n, ls >> len ? len : 0x10);
+        }
+        else if (cmd == "where")
+        {
+            show();
+        }
+        else if (cmd == "quit")
+        {
+            break;
+        }
+        else
+        {
+            cerr << "Unknown debugger command: " << line << endl;
+        }
+    }
+}
+
+/**
+ * @brief Runs forward, capturing a snapshot every snapshot_interval
+ * instructions past the last one. Sets stopped if it stopped at a
+ * breakpoint.
+ * 
+ * @param until The instruction count to stop at.
+ * @param stop_at_breaks True to stop at a breakpoint on the way.
+*/
+template <uint32_t XLEN>
+void debugger<XLEN>::forward(uint64_t until, bool stop_at_breaks)
+{
+    if (limit && until > limit)
+    {
+        until = limit;
+    }
+
+    stopped = false;
+    hart.set_breakpoints(stop_at_breaks ? &breaks : nullptr);
+    for (bool first = true; !hart.is_halted() && hart.get_insn_counter() < until; first = false)
+    {
+        // execute passes over a breakpoint where it starts, which is
+        // only right where the command started.
+        if (!first && stop_at_breaks && breaks.count(hart.get_pc()))
+        {
+            stopped = true;
+            break;
+        }
+
+        // Over ground already covered this passes the snapshots taken
+        // then, and the next one is due past the last of them.
+        uint64_t next = snaps.back().when + snapshot_interval;
+        hart.execute(std::min(until, next));
+        if (hart.get_insn_counter() >= next && !hart.is_halted())
+        {
+            take_snapshot();
+        }
+        if (hart.is_paused())
+        {
+            stopped = true;
+            break;
+        }
+    }
+    hart.set_breakpoints(nullptr);
+
+    if (hart.get_insn_counter() > frontier)
+    {
+        frontier = hart.get_insn_counter();
+        log.set_frontier(frontier);
+    }
+}
+
+/**
+ * @brief Goes to an instruction count, forward by running on, or back by
+ * restoring the latest snapshot at or before it and running on from
+ * there. Breakpoints are passed over either way.
+ * 
+ * @param when The instruction count. Before the first snapshot, the run
+ *  goes to that.
+*/
+template <uint32_t XLEN>
+void debugger<XLEN>::go_to(uint64_t when)
+{
+    if (when < hart.get_insn_counter())
+    {
+        size_t k = snaps.size() - 1;
+        while (k > 0 && snaps[k].when > when)
+        {
+            --k;
+        }
+        restore(snaps[k]);
+    }
+    forward(when, false);
+}
+
+/**
+ * @brief Goes back to the last breakpoint hit before the current
+ * instruction count. Each interval between snapshots is run again from
+ * its start, latest first, noting the breakpoints it hits.
+ * 
+ * @return False, at the first snapshot, if no breakpoint was hit.
+*/
+template <uint32_t XLEN>
+bool debugger<XLEN>::reverse_continue()
+{
+    uint64_t end = hart.get_insn_counter();
+    stopped = false;
+    size_t k = snaps.size();
+    while (k > 0 && snaps[k - 1].when >= end)
+    {
+        --k;
+    }
+
+    while (k > 0)
+    {
+        const snapshot &s = snaps[--k];
+        restore(s);
+
+        // execute passes over a breakpoint where it starts, so the one
+        // at the snapshot is checked here.
+        uint64_t found = breaks.count(hart.get_pc()) ? s.when : UINT64_MAX;
+        hart.set_breakpoints(&breaks);
+        while (!hart.is_halted() && hart.get_insn_counter() < end)
+        {
+            hart.execute(end);
+            if (!hart.is_paused())
+            {
+                break;
+            }
+            found = hart.get_insn_counter();
+        }
+        hart.set_breakpoints(nullptr);
+
+        if (found != UINT64_MAX)
+        {
+            go_to(found);
+            stopped = true;
+            return true;
+        }
+        end = s.when;
+    }
+
+    restore(snaps[0]);
+    return false;
+}
+
+/**
+ * @brief Puts the machine and the replay log back as they were at a
+ * snapshot.
+ * 
+ * @param s The snapshot.
+*/
+template <uint32_t XLEN>
+void debugger<XLEN>::restore(const snapshot &s)
+{
+    mem.flush();
+    ck.apply(s.img, mem);
+    log.seek(s.cursor);
+}
+
+/**
+ * @brief Captures the machine at the current instruction count, sharing
+ * the pages that have not changed since the last snapshot.
+*/
+template <uint32_t XLEN>
+void debugger<XLEN>::take_snapshot()
+{
+    mem.flush();
+    snapshot s = { hart.get_insn_counter(), log.get_cursor(), { } };
+    ck.capture(s.img, mem, snaps.empty() ? nullptr : &snaps.back().img);
+    snaps.push_back(std::move(s));
+}
+
+/**
+ * @brief Prints the instruction count and pc, and why the run stopped if
+ * it was not where it was going.
+*/
+template <uint32_t XLEN>
+void debugger<XLEN>::show() const
+{
+    cout << "At " << hart.get_insn_counter() << " instructions, pc "
+         << (XLEN == 64 ? hex::to_hex0x64(hart.get_pc()) : hex::to_hex0x32(hart.get_pc()));
+    if (stopped)
+    {
+        cout << ", at a breakpoint";
+    }
+    if (hart.is_halted())
+    {
+        cout << ", halted: " << hart.get_halt_reason();
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Dumps memory, 16 bytes a line.
+ * 
+ * @param addr The first address.
+ * @param len The number of bytes.
+*/
+template <uint32_t XLEN>
+void debugger<XLEN>::show_mem(uint64_t addr, uint64_t len) const
+{
+    for (uint64_t i = 0; i < len; ++i)
+    {
+        if (i % 16 == 0)
+        {
+            cout << (i ? "\n" : "") << hex::to_hex32(addr + i) << ":";
+        }
+        cout << " " << hex::to_hex8(mem.get8(addr + i));
+    }
+    cout << endl;
+}
+
+template class debugger<32>;
+template class debugger<64>;
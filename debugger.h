@@ -0,0 +1,106 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include "cpu_single_hart.h"
+#include "replay.h"
+#include <set>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Runs a single-hart guest forwards and backwards under a script
+ * of commands.
+ * 
+ * Going forwards, the debugger captures the machine every
+ * snapshot_interval instructions, with the cursor of the replay log at
+ * that point. Each capture shares the pages that have not changed since
+ * the one before, so it costs what the guest wrote in between. Going
+ * back to an instruction count restores the latest snapshot at or
+ * before it, seeks the log to the snapshot's cursor and runs forward the
+ * rest of the way. Every input the run takes from the host comes from
+ * the log on the way, so the run goes exactly as it did, and the guest's
+ * output up to the furthest point reached is not printed again.
+ * 
+ * The script holds one command per line:
+ *     step [n]         runs n instructions (default 1)
+ *     continue         runs to a breakpoint or the end
+ *     rstep [n]        goes back n instructions (default 1)
+ *     rcontinue        goes back to the last breakpoint hit, or the start
+ *     goto n           goes to instruction count n
+ *     break addr       sets a breakpoint at a hex address
+ *     delete addr      clears it
+ *     regs             dumps the registers
+ *     mem addr [len]   dumps len bytes (default 0x10) from addr, both in hex
+ *     where            prints the instruction count and pc
+ *     quit             stops reading the script
+ * Blank lines and lines starting with # are skipped.
+ * 
+ * @tparam XLEN 32 for RV32, 64 for RV64.
+*/
+template <uint32_t XLEN>
+class debugger
+{
+public:
+    debugger(cpu_single_hart<XLEN> &h, memory &m, checkpoint &c, replay_log &l, uint64_t exec_limit);
+
+    void run(std::istream &is);
+
+    static constexpr uint64_t snapshot_interval = 1000000;
+
+private:
+    /**
+     * @brief The machine at an instruction count.
+    */
+    struct snapshot
+    {
+        uint64_t when;
+        size_t cursor;                      ///< Where the replay log was.
+        checkpoint::image img;
+    };
+
+    void forward(uint64_t until, bool stop_at_breaks);
+    void go_to(uint64_t when);
+    bool reverse_continue();
+    void restore(const snapshot &s);
+    void take_snapshot();
+    void show() const;
+    void show_mem(uint64_t addr, uint64_t len) const;
+
+    cpu_single_hart<XLEN> &hart;
+    memory &mem;
+    checkpoint &ck;
+    replay_log &log;
+    uint64_t limit;                         ///< The last instruction count, or 0 for none.
+    std::vector<snapshot> snaps;
+    std::set<uint64_t> breaks;
+    bool stopped = { false };               ///< True if the run is at a breakpoint it stopped at.
+    uint64_t frontier = { 0 };              ///< The furthest the run has been.
+};
+
+/**
+ * @brief Runs a script of debugger commands on a hart, deducing the
+ * register width from it.
+ * 
+ * @param h The hart.
+ * @param m The memory.
+ * @param c The checkpoint registry, with the machine's state in it.
+ * @param l The replay log the host inputs go through.
+ * @param exec_limit The last instruction count, or 0 for none.
+ * @param is The script.
+*/
+template <uint32_t XLEN>
+void debug(cpu_single_hart<XLEN> &h, memory &m, checkpoint &c, replay_log &l, uint64_t exec_limit, std::istream &is)
+{
+    debugger<XLEN> d(h, m, c, l, exec_limit);
+    d.run(is);
+}
+
+#endif
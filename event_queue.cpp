@@ -0,0 +1,287 @@
+#include "event_queue.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor for the queue. Every slot starts empty.
+*/
+event_queue::event_queue()
+{
+    for (uint32_t i = 0; i < levels * slots; ++i)
+    {
+        heads[i] = none;
+    }
+}
+
+/**
+ * @brief Schedules a callback.
+ * 
+ * @param when The time to run it at. A time already past runs as soon
+ *  as the run loop next looks.
+ * @param fn The callback. It runs on the run loop's thread, with the
+ *  queue unlocked, so it may schedule more events.
+ * 
+ * @return The event's ID, for cancel.
+*/
+uint64_t event_queue::schedule(uint64_t when, callback fn)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    ++scheduled;
+
+    uint32_t i = alloc(std::max(when, wheel_time), std::move(fn));
+    file(i);
+    if (nodes[i].when < due.load(std::memory_order_relaxed))
+    {
+        due.store(nodes[i].when, std::memory_order_relaxed);
+    }
+    return ((uint64_t) nodes[i].gen << 32) | i;
+}
+
+/**
+ * @brief Cancels an event that has not run yet.
+ * 
+ * @param id The ID schedule returned.
+ * 
+ * @return False if the event has already run or been cancelled.
+*/
+bool event_queue::cancel(uint64_t id)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    uint32_t i = id;
+    if (i >= nodes.size() || nodes[i].gen != (id >> 32) || nodes[i].slot == none)
+    {
+        return false;
+    }
+    ++cancelled;
+    unlink(i);
+    release(i);
+    update_due();
+    return true;
+}
+
+/**
+ * @brief Runs every event due at or before a time, in time order.
+ * 
+ * @param now The current time.
+ * 
+ * @note Events due at the same time run in no particular order.
+*/
+void event_queue::run_until(uint64_t now)
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    uint32_t level;
+    uint32_t slot;
+    while (first(level, slot))
+    {
+        uint32_t s = level * slots + slot;
+        if (level == 0)
+        {
+            // A level 0 slot holds events for exactly one time.
+            uint64_t when = (wheel_time & ~(uint64_t) (slots - 1)) | slot;
+            if (when > now)
+            {
+                break;
+            }
+            wheel_time = when;
+
+            std::vector<callback> ready;
+            while (heads[s] != none)
+            {
+                uint32_t i = heads[s];
+                unlink(i);
+                ready.push_back(std::move(nodes[i].fn));
+                release(i);
+            }
+            fired += ready.size();
+
+            guard.unlock();
+            for (callback &fn : ready)
+            {
+                fn();
+            }
+            guard.lock();
+            continue;
+        }
+
+        // Move the wheel up to the earliest event in the slot, and file
+        // the slot's events again below it.
+        uint64_t earliest = UINT64_MAX;
+        for (uint32_t i = heads[s]; i != none; i = nodes[i].next)
+        {
+            earliest = std::min(earliest, nodes[i].when);
+        }
+        if (earliest > now)
+        {
+            break;
+        }
+        wheel_time = earliest;
+
+        uint32_t i = heads[s];
+        while (i != none)
+        {
+            uint32_t next = nodes[i].next;
+            unlink(i);
+            file(i);
+            ++refiled;
+            i = next;
+        }
+    }
+    update_due();
+}
+
+/**
+ * @brief Takes a node from the free list, or adds one.
+ * 
+ * @param when The event's time.
+ * @param fn The callback.
+ * 
+ * @return The node's index.
+*/
+uint32_t event_queue::alloc(uint64_t when, callback fn)
+{
+    uint32_t i;
+    if (!free_nodes.empty())
+    {
+        i = free_nodes.back();
+        free_nodes.pop_back();
+    }
+    else
+    {
+        i = nodes.size();
+        nodes.emplace_back();
+    }
+    nodes[i].when = when;
+    nodes[i].fn = std::move(fn);
+    return i;
+}
+
+/**
+ * @brief Puts an unlinked node back on the free list.
+ * 
+ * @param i The node.
+*/
+void event_queue::release(uint32_t i)
+{
+    nodes[i].fn = nullptr;
+    nodes[i].slot = none;
+    ++nodes[i].gen;
+    free_nodes.push_back(i);
+}
+
+/**
+ * @brief Links a node into the slot its time picks.
+ * 
+ * @param i The node. Its time is no earlier than wheel_time.
+*/
+void event_queue::file(uint32_t i)
+{
+    node &n = nodes[i];
+    uint64_t diff = n.when ^ wheel_time;
+    uint32_t level = diff ? (63 - __builtin_clzll(diff)) / 8 : 0;
+    uint32_t slot = (n.when >> (8 * level)) & (slots - 1);
+
+    n.slot = level * slots + slot;
+    n.prev = none;
+    n.next = heads[n.slot];
+    if (n.next != none)
+    {
+        nodes[n.next].prev = i;
+    }
+    heads[n.slot] = i;
+    occupied[level][slot / 64] |= (uint64_t) 1 << (slot % 64);
+}
+
+/**
+ * @brief Takes a node out of its slot.
+ * 
+ * @param i The node.
+*/
+void event_queue::unlink(uint32_t i)
+{
+    node &n = nodes[i];
+    if (n.prev != none)
+        nodes[n.prev].next = n.next;
+    else
+        heads[n.slot] = n.next;
+    if (n.next != none)
+        nodes[n.next].prev = n.prev;
+
+    if (heads[n.slot] == none)
+    {
+        uint32_t level = n.slot / slots;
+        uint32_t slot = n.slot % slots;
+        occupied[level][slot / 64] &= ~((uint64_t) 1 << (slot % 64));
+    }
+    n.prev = none;
+    n.next = none;
+}
+
+/**
+ * @brief Finds the slot holding the earliest events.
+ * 
+ * @param level Set to the level of the slot.
+ * @param slot Set to the slot.
+ * 
+ * @return False if the queue is empty.
+ * 
+ * @note Slots at a level are in time order, and every level is due
+ * before the one above it, so this is the lowest set bit of the lowest
+ * level that has one.
+*/
+bool event_queue::first(uint32_t &level, uint32_t &slot) const
+{
+    for (level = 0; level < levels; ++level)
+    {
+        for (uint32_t w = 0; w < slots / 64; ++w)
+        {
+            if (occupied[level][w])
+            {
+                slot = w * 64 + __builtin_ctzll(occupied[level][w]);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Works out when the next event is due, after events have gone.
+*/
+void event_queue::update_due()
+{
+    uint32_t level;
+    uint32_t slot;
+    uint64_t when = UINT64_MAX;
+    if (first(level, slot))
+    {
+        for (uint32_t i = heads[level * slots + slot]; i != none; i = nodes[i].next)
+        {
+            when = std::min(when, nodes[i].when);
+        }
+    }
+    due.store(when, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Registers the statistics of the queue.
+ * 
+ * @param s The statistics registry.
+ * @param prefix The name the statistics are grouped under.
+*/
+void event_queue::register_stats(stats &s, const std::string &prefix) const
+{
+    s.add_scalar(prefix + ".scheduled", &scheduled, "Events scheduled");
+    s.add_scalar(prefix + ".fired", &fired, "Events run");
+    s.add_scalar(prefix + ".cancelled", &cancelled, "Events cancelled before they ran");
+    s.add_scalar(prefix + ".refiled", &refiled, "Events moved down the wheel as it turned");
+}
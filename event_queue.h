@@ -0,0 +1,119 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include "stats.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Callbacks that devices schedule for a future simulated time,
+ * kept in a hierarchical timer wheel.
+ * 
+ * Time is the instruction count of the hart whose run loop owns the
+ * queue. The wheel has eight levels of 256 slots, one per byte of the
+ * 64-bit time. An event is filed at the level of the highest byte in
+ * which its time differs from the wheel's time, in the slot that byte
+ * picks, so scheduling and cancelling are constant time and every event
+ * at one level is due before any at the level above. When the wheel
+ * reaches a slot above level 0, its events are filed again, lower down.
+ * 
+ * The run loop reads when the next event is due, runs that many
+ * instructions without looking at the queue, and then runs what is
+ * due. A device may schedule from any host thread, and an event due
+ * sooner than the run loop expected brings the due time forward for it
+ * to see.
+*/
+class event_queue
+{
+public:
+    typedef std::function<void()> callback;
+
+    event_queue();
+
+    /**
+     * @brief Setter for clock
+     * 
+     * @param c The instruction count the queue's time follows.
+    */
+    void set_clock(const uint64_t *c) { clock = c; }
+    /**
+     * @brief Gets the current simulated time.
+     * 
+     * @return The instruction count of the hart that runs the queue.
+    */
+    uint64_t get_time() const { return clock ? *clock : 0; }
+    /**
+     * @brief Gets when the next event is due.
+     * 
+     * @return The time of the earliest event, or UINT64_MAX if there
+     *  is none.
+    */
+    uint64_t get_due() const { return due.load(std::memory_order_relaxed); }
+
+    uint64_t schedule(uint64_t when, callback fn);
+    /**
+     * @brief Schedules a callback some time from now.
+     * 
+     * @param delay The number of instructions from now.
+     * @param fn The callback.
+     * 
+     * @return The event's ID, for cancel.
+    */
+    uint64_t schedule_in(uint64_t delay, callback fn) { return schedule(get_time() + delay, std::move(fn)); }
+    bool cancel(uint64_t id);
+    void run_until(uint64_t now);
+
+    void register_stats(stats &s, const std::string &prefix) const;
+
+private:
+    static constexpr uint32_t levels        = 8;
+    static constexpr uint32_t slots         = 256;
+    static constexpr uint32_t none          = UINT32_MAX;
+
+    /**
+     * @brief A scheduled event, linked into its slot.
+    */
+    struct node
+    {
+        uint64_t when = { 0 };
+        callback fn;
+        uint32_t slot = { none };       ///< level * slots + slot, none if free.
+        uint32_t prev = { none };
+        uint32_t next = { none };
+        uint32_t gen = { 0 };           ///< Bumped on free, so old IDs miss.
+    };
+
+    uint32_t alloc(uint64_t when, callback fn);
+    void release(uint32_t i);
+    void file(uint32_t i);
+    void unlink(uint32_t i);
+    bool first(uint32_t &level, uint32_t &slot) const;
+    void update_due();
+
+    std::vector<node> nodes;
+    std::vector<uint32_t> free_nodes;
+    uint32_t heads[levels * slots];
+    uint64_t occupied[levels][slots / 64] = { };    ///< A bit per non-empty slot.
+    uint64_t wheel_time = { 0 };        ///< No event is due before this.
+    const uint64_t *clock = { nullptr };
+    std::atomic<uint64_t> due = { UINT64_MAX };
+    std::mutex lock;
+
+    uint64_t scheduled = { 0 };
+    uint64_t fired = { 0 };
+    uint64_t cancelled = { 0 };
+    uint64_t refiled = { 0 };
+};
+
+#endif
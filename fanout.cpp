@@ -0,0 +1,408 @@
+#include "fanout.h"
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <poll.h>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Parses a hex number, with or without 0x.
+ * 
+ * @param s The text.
+ * @param v Set to the number.
+ * 
+ * @return False if the text is not all one hex number.
+*/
+static bool parse_hex(const std::string &s, uint64_t &v)
+{
+    std::istringstream iss(s);
+    iss >> std::hex >> v;
+    return !s.empty() && !iss.fail() && iss.eof();
+}
+
+/**
+ * @brief Reads the variants from a file.
+ * 
+ * @param fname The file, in the format the class describes.
+ * 
+ * @return False, after printing why on std::cerr, if the file can't be
+ *  read or a line is not a variant.
+*/
+bool fanout::load(const std::string &fname)
+{
+    std::ifstream is(fname);
+    if (!is)
+    {
+        cerr << "Can't open variants file " << fname << endl;
+        return false;
+    }
+
+    std::string line;
+    for (uint32_t n = 1; std::getline(is, line); ++n)
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+        variant v;
+        if (!parse(line, v))
+        {
+            cerr << "Bad variant on line " << n << " of " << fname << endl;
+            return false;
+        }
+        variants.push_back(v);
+    }
+
+    if (variants.empty())
+    {
+        cerr << "No variants in " << fname << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses one line of the variants file.
+ * 
+ * @param line The line.
+ * @param v Set to the variant.
+ * 
+ * @return False if some item on the line is not understood.
+*/
+bool fanout::parse(const std::string &line, variant &v)
+{
+    std::istringstream is(line);
+    std::string item;
+    while (is >> item)
+    {
+        size_t eq = item.find('=');
+        uint64_t val;
+        if (item[0] == 'x' && eq != std::string::npos)
+        {
+            // xN=value, with N in decimal as in the disassembly.
+            std::istringstream rs(item.substr(1, eq - 1));
+            uint32_t r = 32;
+            rs >> r;
+            if (rs.fail() || !rs.eof() || r >= 32 || !parse_hex(item.substr(eq + 1), val))
+            {
+                return false;
+            }
+            v.regs.push_back({ r, val });
+        }
+        else if (item.compare(0, 3, "pc=") == 0)
+        {
+            if (!parse_hex(item.substr(3), v.pc))
+            {
+                return false;
+            }
+            v.set_pc = true;
+        }
+        else if (item[0] == '@')
+        {
+            // @addr=bytes or @addr<file.
+            size_t sep = item.find_first_of("=<");
+            uint64_t addr;
+            if (sep == std::string::npos || !parse_hex(item.substr(1, sep - 1), addr) || addr > UINT32_MAX)
+            {
+                return false;
+            }
+            patch p = { static_cast<uint32_t>(addr), "" };
+            std::string rest = item.substr(sep + 1);
+            if (item[sep] == '=')
+            {
+                if (rest.empty() || rest.size() % 2)
+                {
+                    return false;
+                }
+                for (size_t i = 0; i < rest.size(); i += 2)
+                {
+                    if (!parse_hex(rest.substr(i, 2), val))
+                    {
+                        return false;
+                    }
+                    p.bytes.push_back(static_cast<char>(val));
+                }
+            }
+            else
+            {
+                std::ifstream f(rest, std::ios::binary);
+                if (!f)
+                {
+                    cerr << "Can't open " << rest << endl;
+                    return false;
+                }
+                p.bytes.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+            }
+            v.patches.push_back(p);
+        }
+        else if (item[0] == '<' && item.size() > 1)
+        {
+            v.input = item.substr(1);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Forks a child per variant from the state the simulator is in,
+ * and in the parent waits for them all and prints what they sent back.
+ * 
+ * @param at The instruction count of the snapshot, for the report.
+ * 
+ * @return In a child, the number of the variant it runs, with stdout
+ *  going to the parent. In the parent, -1 once every child is done.
+*/
+int fanout::split(uint64_t at)
+{
+    // Anything still buffered would otherwise be written by every child.
+    cout.flush();
+    cerr.flush();
+
+    std::vector<outcome> done(variants.size());
+    uint32_t jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    uint32_t next = 0;
+    uint32_t running = 0;
+    while (next < variants.size() || running)
+    {
+        while (next < variants.size() && running < jobs)
+        {
+            start(next, done);
+            if (is_child())
+            {
+                return child;
+            }
+            running += done[next].pid > 0;
+            ++next;
+        }
+        if (!running)
+        {
+            continue;
+        }
+
+        // Read whatever the running children have written, so none of
+        // them blocks on a full pipe.
+        std::vector<pollfd> fds;
+        std::vector<uint32_t> who;
+        for (uint32_t i = 0; i < next; ++i)
+        {
+            if (done[i].out >= 0)
+            {
+                fds.push_back({ done[i].out, POLLIN, 0 });
+                who.push_back(i);
+            }
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            continue;
+        }
+        for (size_t k = 0; k < fds.size(); ++k)
+        {
+            if (!fds[k].revents)
+            {
+                continue;
+            }
+            char buf[4096];
+            ssize_t n = read(fds[k].fd, buf, sizeof(buf));
+            if (n > 0)
+            {
+                done[who[k]].output.append(buf, n);
+            }
+            else
+            {
+                collect(done[who[k]]);
+                --running;
+            }
+        }
+    }
+
+    print(at, done);
+    return -1;
+}
+
+/**
+ * @brief Forks the child of a variant, with pipes for its stdout and its
+ * result. In the child, sets child and result_fd and redirects stdin.
+ * 
+ * @param i The variant.
+ * @param done The children so far, whose pipes a child closes.
+*/
+void fanout::start(uint32_t i, std::vector<outcome> &done)
+{
+    int out[2];
+    int res[2];
+    if (pipe(out) < 0)
+    {
+        done[i].reason = "Can't make a pipe";
+        return;
+    }
+    if (pipe(res) < 0)
+    {
+        close(out[0]);
+        close(out[1]);
+        done[i].reason = "Can't make a pipe";
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(out[0]);
+        close(out[1]);
+        close(res[0]);
+        close(res[1]);
+        done[i].reason = "Can't fork";
+        return;
+    }
+
+    if (pid == 0)
+    {
+        // The child keeps only the write ends of its own pipes.
+        for (outcome &o : done)
+        {
+            if (o.out >= 0)
+            {
+                close(o.out);
+            }
+            if (o.res >= 0)
+            {
+                close(o.res);
+            }
+        }
+        close(out[0]);
+        close(res[0]);
+        dup2(out[1], 1);
+        close(out[1]);
+        result_fd = res[1];
+        child = i;
+
+        if (!variants[i].input.empty())
+        {
+            int fd = open(variants[i].input.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                cerr << "Can't open " << variants[i].input << endl;
+                _exit(1);
+            }
+            dup2(fd, 0);
+            close(fd);
+        }
+        return;
+    }
+
+    close(out[1]);
+    close(res[1]);
+    done[i].pid = pid;
+    done[i].out = out[0];
+    done[i].res = res[0];
+}
+
+/**
+ * @brief Waits for a child whose stdout has closed and reads its result.
+ * 
+ * @param o The child.
+*/
+void fanout::collect(outcome &o)
+{
+    close(o.out);
+    o.out = -1;
+    waitpid(o.pid, &o.status, 0);
+
+    // The child has exited, so the whole result is in the pipe.
+    if (read(o.res, &o.r, sizeof(o.r)) == sizeof(o.r))
+    {
+        std::string reason(o.r.reason_len, '\0');
+        if (read(o.res, &reason[0], reason.size()) == (ssize_t) reason.size())
+        {
+            o.reason = reason;
+        }
+    }
+    else if (WIFSIGNALED(o.status))
+    {
+        o.reason = "Killed by signal " + std::to_string(WTERMSIG(o.status));
+    }
+    close(o.res);
+    o.res = -1;
+}
+
+/**
+ * @brief Prints each child's stdout, each line headed with its variant,
+ * and then a line per variant on how it ended.
+ * 
+ * @param at The instruction count of the snapshot.
+ * @param done The children.
+*/
+void fanout::print(uint64_t at, const std::vector<outcome> &done) const
+{
+    for (size_t i = 0; i < done.size(); ++i)
+    {
+        std::istringstream is(done[i].output);
+        std::string line;
+        while (std::getline(is, line))
+        {
+            cout << "[v" << i << "] " << line << endl;
+        }
+    }
+
+    cout << "Fanned out " << done.size() << " variants at " << at << " instructions" << endl;
+    for (size_t i = 0; i < done.size(); ++i)
+    {
+        const outcome &o = done[i];
+        cout << "  variant " << i << ": " << o.reason;
+        if (o.r.xlen)
+        {
+            cout << ", " << o.r.insns << " instructions, a0 = "
+                 << (o.r.xlen == 64 ? hex::to_hex0x64(o.r.a0) : hex::to_hex0x32(o.r.a0));
+        }
+        if (o.pid > 0 && WIFEXITED(o.status))
+        {
+            cout << ", exit status " << WEXITSTATUS(o.status);
+        }
+        cout << endl;
+    }
+}
+
+/**
+ * @brief Sends a child's result back to the parent. Does nothing in the
+ * parent.
+ * 
+ * @param reason Why the hart stopped.
+ * @param insns The hart's instruction count.
+ * @param a0 The value of a0, which holds the result under the calling
+ *  convention.
+ * @param xlen The register width.
+*/
+void fanout::report(const std::string &reason, uint64_t insns, uint64_t a0, uint32_t xlen)
+{
+    if (!is_child() || result_fd < 0)
+    {
+        return;
+    }
+
+    result r = { insns, a0, xlen, static_cast<uint32_t>(reason.size()) };
+    std::string msg(reinterpret_cast<const char *>(&r), sizeof(r));
+    msg += reason;
+    if (write(result_fd, msg.data(), msg.size()) != (ssize_t) msg.size())
+    {
+        cerr << "Can't send the result of variant " << child << endl;
+    }
+    close(result_fd);
+    result_fd = -1;
+}
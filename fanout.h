@@ -0,0 +1,125 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include "hex.h"
+#include <vector>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Runs many variants of the guest on from one warm snapshot, each
+ * in a host process forked from the simulator.
+ * 
+ * The guest runs once up to the snapshot point. Then the simulator forks
+ * one child per variant, so each child starts with the shared memory and
+ * hart state copy-on-write, and nothing is copied or run again. A child
+ * injects its variant's registers, memory patches and stdin, and runs on
+ * to the end. Its stdout and its result come back to the parent over
+ * pipes. At most one child per host core runs at a time.
+ * 
+ * The variants come from a file with one variant per line. Each line
+ * holds any of these, separated by spaces, with values and addresses in
+ * hex:
+ *     xN=value       sets register xN
+ *     pc=value       sets the pc
+ *     @addr=bytes    writes bytes, two hex digits each, at addr
+ *     @addr<file     writes the contents of a host file at addr
+ *     <file          makes a host file the child's stdin
+ * Blank lines and lines starting with # are skipped.
+*/
+class fanout
+{
+public:
+    /**
+     * @brief Bytes to write to memory.
+    */
+    struct patch
+    {
+        uint32_t addr;
+        std::string bytes;
+    };
+
+    /**
+     * @brief What one child injects.
+    */
+    struct variant
+    {
+        std::vector<std::pair<uint32_t, uint64_t>> regs;    ///< Register number and value.
+        bool set_pc = { false };
+        uint64_t pc = { 0 };
+        std::vector<patch> patches;
+        std::string input;                  ///< The file for stdin, if not empty.
+    };
+
+    bool load(const std::string &fname);
+
+    /**
+     * @brief Getter for the number of variants
+     * 
+     * @return The number of children split forks.
+    */
+    uint32_t get_num_variants() const { return variants.size(); }
+    /**
+     * @brief Getter for a variant
+     * 
+     * @param i The variant's number.
+     * 
+     * @return The variant.
+    */
+    const variant &get_variant(uint32_t i) const { return variants[i]; }
+    /**
+     * @brief Checks if this process is one of the children.
+     * 
+     * @return True in a child, after split.
+    */
+    bool is_child() const { return child >= 0; }
+
+    int split(uint64_t at);
+    void report(const std::string &reason, uint64_t insns, uint64_t a0, uint32_t xlen);
+
+private:
+    /**
+     * @brief What a child sends back over its result pipe, followed by
+     * the reason it stopped.
+    */
+    struct result
+    {
+        uint64_t insns;
+        uint64_t a0;
+        uint32_t xlen;
+        uint32_t reason_len;
+    };
+
+    /**
+     * @brief A child and what has come back from it.
+    */
+    struct outcome
+    {
+        int pid = { -1 };
+        int out = { -1 };                   ///< The read end of its stdout.
+        int res = { -1 };                   ///< The read end of its result.
+        std::string output;
+        std::string reason = { "No result" };
+        result r = { };
+        int status = { 0 };
+    };
+
+    bool parse(const std::string &line, variant &v);
+    void start(uint32_t i, std::vector<outcome> &done);
+    void collect(outcome &o);
+    void print(uint64_t at, const std::vector<outcome> &done) const;
+
+    std::vector<variant> variants;
+    int child = { -1 };                     ///< The variant of this process, if a child.
+    int result_fd = { -1 };                 ///< The write end of a child's result.
+};
+
+#endif
@@ -52,4 +52,16 @@ std::string hex::to_hex0x32(uint32_t i) ///< Print 32 bytes as hex, led with 0x.
     return std::string("0x")+to_hex32(i);
 }
 
+std::string hex::to_hex64(uint64_t i)   ///< Print 64 bytes as hex.
+{
+    std::ostringstream os;
+    os << std::hex << std::setfill('0') << std::setw(16) << i;
+    return os.str();
+}
+
+std::string hex::to_hex0x64(uint64_t i) ///< Print 64 bytes as hex, led with 0x.
+{
+    return std::string("0x")+to_hex64(i);
+}
+
 /**@}*/
\ No newline at end of file
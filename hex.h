@@ -1,3 +1,6 @@
+#ifndef HEX_H
+#define HEX_H
+
 #include <string>
 #include <cstdint>
 #include <iomanip>
@@ -7,6 +10,10 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <functional>
 
 using std::cout;
 using std::endl;
@@ -30,4 +37,8 @@ class hex
         static std :: string to_hex0x12( uint32_t i );
         static std :: string to_hex0x20( uint32_t i );
         static std :: string to_hex0x32 ( uint32_t i );
+        static std :: string to_hex64 ( uint64_t i );
+        static std :: string to_hex0x64 ( uint64_t i );
 };
+
+#endif
@@ -0,0 +1,190 @@
+#include "ilp_study.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Parses a list of window sizes of the form 32,128,512.
+ * 
+ * @param spec The list of window sizes, in decimal.
+ * @param windows The vector to append the sizes to.
+ * 
+ * @return True if every size was a positive number, False otherwise.
+*/
+bool ilp_study::parse_windows(const std::string &spec, std::vector<uint32_t> &windows)
+{
+    std::istringstream iss(spec);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        std::istringstream vs(item);
+        uint32_t val = 0;
+        if (!(vs >> val) || val == 0)
+            return false;
+        windows.push_back(val);
+    }
+    return true;
+}
+
+/**
+ * @brief Constructor for the limit study.
+ * 
+ * @param windows The window sizes to model. An unlimited window is
+ *  always modelled as well.
+*/
+ilp_study::ilp_study(const std::vector<uint32_t> &windows)
+{
+    models.resize(windows.size() + 1);
+    for (size_t i = 0; i < models.size(); ++i)
+    {
+        window &w = models[i];
+        w.size = (i == 0) ? 0 : windows[i - 1];
+        for (int r = 0; r < insn_record::num_regs; ++r)
+            w.reg_time[r] = 0;
+        w.mem_tags.resize(1 << mem_table_bits, 0);
+        w.mem_time.resize(1 << mem_table_bits, 0);
+        w.retired.resize(w.size, 0);
+        w.last_retire = 0;
+        w.critical = 0;
+        w.chunk_start = 0;
+        for (int b = 0; b < num_buckets; ++b)
+            w.hist[b] = 0;
+    }
+}
+
+/**
+ * @brief Consume a batch of retired instructions.
+ * 
+ * @param recs The records, in program order.
+ * @param n The number of records.
+*/
+void ilp_study::consume(const insn_record *recs, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (window &w : models)
+            model(w, recs[i]);
+
+        ++insns;
+        if (insns % chunk_len == 0)
+        {
+            for (window &w : models)
+                end_chunk(w);
+        }
+    }
+}
+
+/**
+ * @brief Schedules one instruction in one window model.
+ * 
+ * @param w The window model.
+ * @param r The retired instruction.
+*/
+void ilp_study::model(window &w, const insn_record &r)
+{
+    uint64_t start = std::max(w.reg_time[r.rs1], w.reg_time[r.rs2]);
+    start = std::max(start, w.reg_time[r.rs3]);
+
+    // Find the word in the hashed memory-time table.
+    uint32_t word = r.addr >> 2;
+    uint32_t h = word * 0x9e3779b1;
+    uint32_t slot = h >> (32 - mem_table_bits);
+
+    if (r.kind == insn_record::kind_load && w.mem_tags[slot] == word + 1)
+        start = std::max(start, w.mem_time[slot]);
+
+    // Wait for the instruction a window older to leave the window.
+    uint64_t *ring = nullptr;
+    if (w.size)
+    {
+        ring = &w.retired[insns % w.size];
+        start = std::max(start, *ring);
+    }
+
+    uint64_t done = start + 1;
+
+    if (r.rd != 0)
+        w.reg_time[r.rd] = done;
+
+    if (r.kind == insn_record::kind_store)
+    {
+        w.mem_tags[slot] = word + 1;
+        w.mem_time[slot] = done;
+    }
+
+    w.critical = std::max(w.critical, done);
+
+    // Retire in order.
+    w.last_retire = std::max(w.last_retire, done);
+    if (ring)
+        *ring = w.last_retire;
+}
+
+/**
+ * @brief Folds the ILP of the last chunk into the histogram.
+ * 
+ * @param w The window model.
+*/
+void ilp_study::end_chunk(window &w)
+{
+    uint64_t len = w.critical - w.chunk_start;
+    uint64_t ilp = chunk_len / (len ? len : 1);
+
+    // Bucket b holds the chunks with ILP in [2^b, 2^(b+1)).
+    int b = ilp ? 63 - __builtin_clzll(ilp) : 0;
+    ++w.hist[std::min(b, num_buckets - 1)];
+
+    w.chunk_start = w.critical;
+}
+
+/**
+ * @brief Prints the critical path, ILP and chunk ILP distribution.
+ * 
+ * @param os The stream to print to.
+*/
+void ilp_study::report(std::ostream &os) const
+{
+    os << "ILP limit study (" << insns << " instructions, ILP distribution over "
+       << chunk_len << "-instruction chunks)" << endl;
+
+    os << "  " << std::setw(10) << std::left << "window" << std::right
+       << std::setw(14) << "critical" << std::setw(10) << "ILP" << "  ";
+    for (int b = 0; b < num_buckets; ++b)
+    {
+        std::ostringstream label;
+        label << (1u << b) << (b == num_buckets - 1 ? "+" : "");
+        os << std::setw(6) << label.str();
+    }
+    os << endl;
+
+    for (const window &w : models)
+    {
+        uint64_t chunks = 0;
+        for (int b = 0; b < num_buckets; ++b)
+            chunks += w.hist[b];
+
+        std::ostringstream name;
+        if (w.size)
+            name << w.size;
+        else
+            name << "unlimited";
+
+        os << "  " << std::setw(10) << std::left << name.str() << std::right
+           << std::setw(14) << w.critical << std::setw(10) << std::fixed << std::setprecision(2)
+           << (w.critical ? (double)insns / w.critical : 0.0) << "  " << std::setprecision(0);
+        for (int b = 0; b < num_buckets; ++b)
+        {
+            std::ostringstream pct;
+            pct << std::fixed << std::setprecision(0) << (chunks ? 100.0 * w.hist[b] / chunks : 0.0) << "%";
+            os << std::setw(6) << pct.str();
+        }
+        os << std::defaultfloat << std::setprecision(6) << endl;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef ILP_STUDY_H
+#define ILP_STUDY_H
+
+#include "insn_trace.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief An instruction-level parallelism limit study.
+ * 
+ * Every instruction runs one time unit after the last of its inputs is
+ * available, with unlimited functional units and perfect prediction.
+ * Register inputs come from rs1/rs2/rs3, and a load also waits for the
+ * last store to its word. The length of the longest dependence chain
+ * is the critical path, and instructions over critical path is the
+ * ideal ILP.
+ * 
+ * Each window size is modelled separately: an instruction may not
+ * start until the one window-size instructions older has retired.
+ * Memory times live in a fixed-size hashed table, so a word that was
+ * evicted reads as available from the start. That only ever shortens
+ * the critical path, and it keeps memory bounded for any run length.
+*/
+class ilp_study : public insn_sink
+{
+public:
+    ilp_study(const std::vector<uint32_t> &windows);
+
+    void consume(const insn_record *recs, size_t n) override;
+    void report(std::ostream &os) const override;
+
+    static bool parse_windows(const std::string &spec, std::vector<uint32_t> &windows);
+
+private:
+    static constexpr uint32_t mem_table_bits = 18;
+    static constexpr uint64_t chunk_len = 10000;
+    static constexpr int num_buckets = 12;
+
+    /**
+     * @brief The dataflow state for one window size.
+    */
+    struct window
+    {
+        uint32_t size;                  ///< Window size, 0 for unlimited.
+        uint64_t reg_time[insn_record::num_regs];  ///< When each register is ready.
+        std::vector<uint32_t> mem_tags; ///< Word address + 1 in each slot.
+        std::vector<uint64_t> mem_time; ///< When each word is ready.
+        std::vector<uint64_t> retired;  ///< Ring of retire times.
+        uint64_t last_retire;           ///< Retire time of the youngest insn.
+        uint64_t critical;              ///< Longest chain so far.
+        uint64_t chunk_start;           ///< critical at the start of the chunk.
+        uint64_t hist[num_buckets];     ///< log2 histogram of chunk ILP.
+    };
+
+    void model(window &w, const insn_record &r);
+    void end_chunk(window &w);
+
+    uint64_t insns = { 0 };
+    std::vector<window> models;
+};
+
+#endif
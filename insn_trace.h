@@ -0,0 +1,89 @@
+#ifndef INSN_TRACE_H
+#define INSN_TRACE_H
+
+#include "hex.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A record of one retired instruction.
+ * 
+ * The hart fills one of these for every instruction it executes while
+ * a sink is attached. The records are copies, so a sink can never
+ * change the architectural state of the hart.
+*/
+struct insn_record
+{
+    static constexpr uint8_t kind_alu       = 0;
+    static constexpr uint8_t kind_mul       = 1;
+    static constexpr uint8_t kind_div       = 2;
+    static constexpr uint8_t kind_load      = 3;
+    static constexpr uint8_t kind_store     = 4;
+    static constexpr uint8_t kind_branch    = 5;
+    static constexpr uint8_t kind_jump      = 6;
+    static constexpr uint8_t kind_system    = 7;
+    static constexpr uint8_t kind_fp        = 8;
+    static constexpr uint8_t num_kinds      = 9;
+
+    // Registers are numbered x0-x31, then f0-f31 and then v0-v31, so
+    // the models can track every file in one table. A vector register
+    // stands for its whole group.
+    static constexpr uint8_t fp_reg_base    = 32;
+    static constexpr uint8_t vec_reg_base   = 64;
+    static constexpr uint8_t num_regs       = 96;
+
+    uint32_t pc;        ///< The address of the instruction.
+    uint32_t next_pc;   ///< The address of the next instruction executed.
+    uint32_t insn;      ///< The instruction.
+    uint32_t addr;      ///< The effective address of a load or store.
+    uint8_t rd;         ///< The destination register, 0 if none.
+    uint8_t rs1;        ///< The first source register, 0 if none.
+    uint8_t rs2;        ///< The second source register, 0 if none.
+    uint8_t rs3;        ///< The third source register, 0 if none.
+    uint8_t kind;       ///< One of the kind_X values.
+    uint8_t len;        ///< The length of the instruction in bytes, 2 or 4.
+
+    /**
+     * @brief Gets the address of the next instruction in program order.
+     * 
+     * @return The address next_pc holds unless a transfer was taken.
+    */
+    uint32_t fall_through() const { return pc + len; }
+};
+
+/**
+ * @brief A consumer of the retired instruction stream.
+ * 
+ * The hart buffers records and hands them over in batches, so the
+ * functional execution always runs ahead of the models that consume it.
+*/
+class insn_sink
+{
+public:
+    virtual ~insn_sink() {}
+
+    /**
+     * @brief Consume a batch of retired instructions.
+     * 
+     * @param recs The records, in program order.
+     * @param n The number of records.
+    */
+    virtual void consume(const insn_record *recs, size_t n) = 0;
+
+    /**
+     * @brief Print the results gathered so far.
+     * 
+     * @param os The stream to print to.
+    */
+    virtual void report(std::ostream &os) const = 0;
+};
+
+#endif
@@ -1,4 +1,13 @@
-#include "cpu_single_hart.h"
+#include "cpu_multi_hart.h"
+#include "ooo_timing.h"
+#include "memtrace.h"
+#include "ilp_study.h"
+#include "uart.h"
+#include "virtio_blk.h"
+#include "debugger.h"
+#include <fstream>
+
+extern char **environ;
 
 //***************************************************************************
 //
@@ -12,15 +21,26 @@
 
 /**
  * @brief Dissassembles the simulated memory.
- * Goes through the memory one byte at a time and decodes it.
+ * Goes through the memory one instruction at a time and decodes it.
+ * Compressed instructions are 2 bytes long, the rest 4.
  * 
  * @param mem The simulated memory.
+ * @param xlen The register width to decode for, 32 or 64.
 */
-static void disassemble(const memory &mem)
+static void disassemble(const memory &mem, uint32_t xlen)
 {
-	for (uint32_t i = 0; i < mem.get_size(); i += 4)
+	for (uint32_t i = 0; i < mem.get_size(); )
 	{
-		cout << hex::to_hex32(i) << ": "<< hex::to_hex32(mem.get32(i)) << "  " << rv32i_decode::decode(i, mem.get32(i)) << endl;
+		if (rv32i_decode::is_compressed(mem.get16(i)))
+		{
+			cout << hex::to_hex32(i) << ": "<< "    " << hex::to_hex32(mem.get16(i)).substr(4) << "  " << rv32i_decode::decode(i, mem.get16(i), xlen) << endl;
+			i += 2;
+		}
+		else
+		{
+			cout << hex::to_hex32(i) << ": "<< hex::to_hex32(mem.get32(i)) << "  " << rv32i_decode::decode(i, mem.get32(i), xlen) << endl;
+			i += 4;
+		}
 	}
 }
 
@@ -29,12 +49,51 @@ static void disassemble(const memory &mem)
 */
 static void usage()
 {
-	cerr << "Usage: rv32i [-d] [-i] [-l execution-limit] [-m hex-mem-size] [-r] [-z] infile" << endl;
+	cerr << "Usage: rv32i [-b disk-image] [-c checkpoint] [-C hex-count] [-d] [-e] [-F variants] [-g script] [-h harts] [-i] [-I windows] [-l execution-limit] [-j] [-m hex-mem-size] [-r] [-R] [-s] [-S hex-interval] [-t timing-params] [-u checkpoint] [-V vlen] [-w hex-interval] [-x xlen] [-y log] [-Y log] [-z] infile [args...]" << endl;
+	cerr << "    -b attach a virtio-blk disk backed by the image file" << endl;
+	cerr << "    -c save a checkpoint of the machine to the file when the guest" << endl;
+	cerr << "       writes 5 to CSR 0x8c0, or at the count given with -C" << endl;
+	cerr << "    -C save the checkpoint or fork the variants after hex-count" << endl;
+	cerr << "       instructions, once no disk I/O is in flight" << endl;
 	cerr << "    -d show disassembly before program execution" << endl;
+	cerr << "    -e emulate Linux system calls on ecall, with args as the guest's" << endl;
+	cerr << "       argv and the host environment as its envp (put -- before" << endl;
+	cerr << "       args that start with -), and exit with the guest's status" << endl;
+	cerr << "    -F fork a host process per line of the variants file when the" << endl;
+	cerr << "       guest writes 5 to CSR 0x8c0, or at the count given with -C," << endl;
+	cerr << "       each setting xN=hex, pc=hex, @hex-addr=hex-bytes," << endl;
+	cerr << "       @hex-addr<file or <stdin-file, and report what each did" << endl;
+	cerr << "    -g run the debugger commands in the script file (step, continue," << endl;
+	cerr << "       rstep, rcontinue, goto, break, delete, regs, mem, where and" << endl;
+	cerr << "       quit), going back by running again from periodic snapshots" << endl;
+	cerr << "    -h number of harts, each on its own host thread (default = 1)" << endl;
+	cerr << "       the sinks and -R apply to hart 0" << endl;
 	cerr << "    -i show instruction printing during execution" << endl;
+	cerr << "    -I run the ILP limit study, windows is a list of window" << endl;
+	cerr << "       sizes like 32,128,512 (unlimited is always included)" << endl;
+	cerr << "    -j dump statistics as JSON, one object per line" << endl;
 	cerr << "    -l maximum number of instructions to exec" << endl;
 	cerr << "    -m specify memory size (default = 0x100)" << endl;
 	cerr << "    -r show register printing during exectuion" << endl;
+	cerr << "    -R run tracing and the detailed models only inside the region" << endl;
+	cerr << "       of interest the guest marks by writing 1 (begin) and 2 (end)" << endl;
+	cerr << "       to CSR 0x8c0 (3 dumps and 4 resets the statistics)" << endl;
+	cerr << "    -s dump statistics at the end of the run" << endl;
+	cerr << "    -S also dump statistics every hex-interval instructions" << endl;
+	cerr << "    -t run the out-of-order timing model, params are 'default' or a" << endl;
+	cerr << "       list like fetch=4,issue=4,rob=128,lsq=32,alu=1,mul=3,div=20," << endl;
+	cerr << "       load=3,store=1,branch=1,fp=4,mispredict=8" << endl;
+	cerr << "    -u restore a checkpoint and run on from it instead of loading" << endl;
+	cerr << "       infile (-x, -V and -m come from the checkpoint, -b has to" << endl;
+	cerr << "       name the same disk image, and -l counts from the start)" << endl;
+	cerr << "    -V vector register width in bits, 128 or 256 (default = 128)" << endl;
+	cerr << "    -w trace memory accesses, reporting working set and reuse" << endl;
+	cerr << "       distance every hex-interval instructions" << endl;
+	cerr << "    -x register width, 32 for RV32 or 64 for RV64 (default = 32)" << endl;
+	cerr << "    -y replay the host inputs recorded in the log file instead of" << endl;
+	cerr << "       taking them from the host, halting where the run leaves it" << endl;
+	cerr << "    -Y record the host inputs (system call results, stdin, the" << endl;
+	cerr << "       environment) to the log file, by instruction count" << endl;
 	cerr << "    -z show a dump of the regs & memory after simulation" << endl;
 	exit(1);
 }
@@ -44,7 +103,8 @@ static void usage()
  * @param argc The number of arguments.
  * @param argv Pointer array of the arguments.
  * 
- * @return Returns 0 if the program succeeds.
+ * @return Returns 0 if the program succeeds, or the guest's exit status
+ *  under system call emulation.
 */
 int main(int argc, char **argv)
 {
@@ -52,24 +112,97 @@ int main(int argc, char **argv)
 	bool show_instructions = false;
 	bool show_regs = false;
 	bool show_dump = false;
+	bool emulate_syscalls = false;
 	uint32_t memory_limit = 0x100; // default memory size = 256 bytes
 	uint32_t exec_limit = 0x000;
+	uint32_t num_harts = 1;
+	uint32_t xlen = 32;
+	uint32_t vlen = 128;
+	bool roi_only = false;
+	bool show_stats = false;
+	bool stats_json = false;
+	uint64_t stats_interval = 0;
+	std::unique_ptr<ooo_timing> timing;
+	std::unique_ptr<memtrace> mtrace;
+	std::unique_ptr<ilp_study> ilp;
+	std::string disk_image;
+	std::string save_file;
+	std::string restore_file;
+	uint64_t save_at = UINT64_MAX;
+	std::unique_ptr<fanout> fan;
+	std::string record_file;
+	std::string replay_file;
+	std::string debug_script;
 
 	int opt;
-	while ((opt = getopt(argc, argv, "dirzl:m:")) != -1)
+	while ((opt = getopt(argc, argv, "b:c:C:deF:g:h:iI:jrRsS:zl:m:t:u:V:w:x:y:Y:")) != -1)
 	{
 		switch (opt)
 		{
+		case 'b':
+			{
+				disk_image = optarg;
+			}
+			break;
+		case 'c':
+			{
+				save_file = optarg;
+			}
+			break;
+		case 'C':
+			{
+				std::istringstream iss(optarg);
+				iss >> std::hex >> save_at;
+			}
+			break;
 		case 'd':
 			{
 				show_disassembly = true;
 			}
 			break;
+		case 'e':
+			{
+				emulate_syscalls = true;
+			}
+			break;
+		case 'F':
+			{
+				fan.reset(new fanout);
+				if (!fan->load(optarg))
+					usage();
+			}
+			break;
+		case 'g':
+			{
+				debug_script = optarg;
+			}
+			break;
+		case 'h':
+			{
+				std::istringstream iss(optarg);
+				iss >> num_harts;
+				if (num_harts == 0)
+					usage();
+			}
+			break;
 		case 'i':
 			{
 				show_instructions = true;
 			}
 			break;
+		case 'I':
+			{
+				std::vector<uint32_t> windows;
+				if (!ilp_study::parse_windows(optarg, windows))
+					usage();
+				ilp.reset(new ilp_study(windows));
+			}
+			break;
+		case 'j':
+			{
+				stats_json = true;
+			}
+			break;
 		case 'l':
 			{
 				std::istringstream iss(optarg);
@@ -87,6 +220,72 @@ int main(int argc, char **argv)
 				show_regs = true;
 			}
 			break;
+		case 'R':
+			{
+				roi_only = true;
+			}
+			break;
+		case 's':
+			{
+				show_stats = true;
+			}
+			break;
+		case 'S':
+			{
+				std::istringstream iss(optarg);
+				iss >> std::hex >> stats_interval;
+				show_stats = true;
+			}
+			break;
+		case 't':
+			{
+				ooo_params params;
+				if (!params.parse(optarg))
+					usage();
+				timing.reset(new ooo_timing(params));
+			}
+			break;
+		case 'u':
+			{
+				restore_file = optarg;
+			}
+			break;
+		case 'V':
+			{
+				std::istringstream iss(optarg);
+				iss >> vlen;
+				if (vlen != 128 && vlen != 256)
+					usage();
+			}
+			break;
+		case 'w':
+			{
+				uint64_t interval = 0;
+				std::istringstream iss(optarg);
+				iss >> std::hex >> interval;
+				if (interval == 0)
+					usage();
+				mtrace.reset(new memtrace(interval, cout));
+			}
+			break;
+		case 'x':
+			{
+				std::istringstream iss(optarg);
+				iss >> xlen;
+				if (xlen != 32 && xlen != 64)
+					usage();
+			}
+			break;
+		case 'y':
+			{
+				replay_file = optarg;
+			}
+			break;
+		case 'Y':
+			{
+				record_file = optarg;
+			}
+			break;
 		case 'z':
 			{
 				show_dump = true;
@@ -97,39 +296,283 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (optind >= argc)
+	// A checkpoint holds one hart of the plain machine, without the
+	// host's files behind system call emulation.
+	if ((!save_file.empty() || !restore_file.empty()) && (num_harts != 1 || emulate_syscalls))
+		usage();
+	// Forked children have none of the disk's host threads.
+	if (fan && (num_harts != 1 || !disk_image.empty()))
+		usage();
+	if (save_at != UINT64_MAX && save_file.empty() && !fan)
+		usage();
+	// The log keys the host's inputs on one hart's instruction count,
+	// and going back can't take back what was written to the disk.
+	bool logging = !record_file.empty() || !replay_file.empty() || !debug_script.empty();
+	if (logging && (num_harts != 1 || fan))
+		usage();
+	if (!debug_script.empty() && (!disk_image.empty() || !save_file.empty()))
+		usage();
+
+	// A restored machine is built like the one that saved it.
+	if (!restore_file.empty())
+	{
+		checkpoint::machine m;
+		if (!checkpoint::read_machine(restore_file, m) || m.harts != 1)
+		{
+			cerr << "Not a checkpoint: " << restore_file << endl;
+			usage();
+		}
+		xlen = m.xlen;
+		vlen = m.vlen;
+		memory_limit = m.mem_size;
+	}
+	else if (optind >= argc)
 		usage(); // missing filename
 
 	memory mem(memory_limit);
 
-	if (!mem.load_file(argv[optind]))
+	if (restore_file.empty() && !mem.load_file(argv[optind]))
 		usage();
 
-	if (show_disassembly)
+	replay_log log;
+	if (!replay_file.empty() && !log.load(replay_file))
+		usage();
+
+	// The guest's argv is the file name and whatever follows it. Its
+	// envp is the host's, or the one in the log under replay.
+	std::unique_ptr<syscall_emu> sys;
+	if (emulate_syscalls)
 	{
-		disassemble(mem);
-	}
+		std::vector<std::string> args(argv + optind, argv + argc);
+		std::vector<std::string> env;
+		const replay_log::entry *logged = logging ? log.take(replay_log::kind_env) : nullptr;
+		if (logged)
+		{
+			for (size_t i = 0, j; i < logged->data.size(); i = j + 1)
+			{
+				j = logged->data.find('\0', i);
+				env.push_back(logged->data.substr(i, j - i));
+			}
+		}
+		else
+		{
+			std::string data;
+			for (char **e = environ; *e; ++e)
+			{
+				env.push_back(*e);
+				data += *e;
+				data += '\0';
+			}
+			if (logging && !log.is_replaying())
+			{
+				log.add(replay_log::kind_env, env.size(), data);
+			}
+			else if (logging)
+			{
+				log.diverge("the log has no environment");
+			}
+		}
 
-	cpu_single_hart cpu(mem);
-	cpu.reset();
+		sys.reset(new syscall_emu(mem, xlen));
+		if (!sys->setup_stack(args, env))
+		{
+			cerr << "Arguments and environment too big for memory." << endl;
+			usage();
+		}
+	}
 
-	if (show_instructions)
+	if (show_disassembly)
 	{
-		cpu.set_show_instructions(true);
+		disassemble(mem, xlen);
 	}
 
-	if (show_regs)
+	// Everything past here is the same for RV32 and RV64, so it is
+	// written once for whichever cpu the register width picks.
+	auto run = [&](auto &cpu)
 	{
-		cpu.set_show_registers(true);
-	}
+		cpu.reset();
+
+		stats st;
+		st.set_json(stats_json);
+		if (show_stats)
+		{
+			cpu.set_stats(&st, stats_interval);
+		}
+
+		// The heap may grow up to the lowest hart's stack.
+		if (sys)
+		{
+			sys->set_brk_limit(sys->get_stack_top() - cpu.get_num_harts() * cpu.get_hart(0).stack_size);
+		}
+
+		// The CLINT raises the timer and software interrupts.
+		clint timer(cpu.get_num_harts());
+		if (!mem.attach(clint::base, clint::size, &timer))
+		{
+			cerr << "WARNING: The CLINT overlaps RAM and is not mapped." << endl;
+		}
+
+		// The console UART.
+		uart console;
+		if (!mem.attach(uart::base, uart::size, &console))
+		{
+			cerr << "WARNING: The UART overlaps RAM and is not mapped." << endl;
+		}
+		if (show_stats)
+		{
+			console.register_stats(st, "uart");
+		}
+
+		// The PLIC raises the external interrupts of the disk.
+		plic irqc(cpu.get_num_harts());
+		if (!mem.attach(plic::base, plic::size, &irqc))
+		{
+			cerr << "WARNING: The PLIC overlaps RAM and is not mapped." << endl;
+		}
+
+		std::unique_ptr<virtio_blk> disk;
+		if (!disk_image.empty())
+		{
+			disk.reset(new virtio_blk(mem, irqc, virtio_blk::irq, 4));
+			if (!disk->open_image(disk_image))
+			{
+				usage();
+			}
+			if (cpu.get_events())
+			{
+				disk->set_events(cpu.get_events());
+			}
+			if (!mem.attach(virtio_blk::base, virtio_blk::size, disk.get()))
+			{
+				cerr << "WARNING: The disk overlaps RAM and is not mapped." << endl;
+			}
+			if (show_stats)
+			{
+				disk->register_stats(st, "disk");
+			}
+		}
+
+		for (uint32_t i = 0; i < cpu.get_num_harts(); i++)
+		{
+			cpu.get_hart(i).set_vlen(vlen);
+			cpu.get_hart(i).set_syscalls(sys.get());
+			cpu.get_hart(i).set_clint(&timer);
+			cpu.get_hart(i).set_plic(&irqc);
+
+			if (show_instructions)
+			{
+				cpu.get_hart(i).set_show_instructions(true);
+			}
+
+			if (show_regs)
+			{
+				cpu.get_hart(i).set_show_registers(true);
+			}
+		}
 
-	cpu.run(exec_limit);
+		auto &hart0 = cpu.get_hart(0);
 
-	if (show_dump)
+		if (roi_only)
+		{
+			hart0.set_roi_only(true);
+		}
+
+		if (timing)
+		{
+			hart0.add_sink(timing.get());
+		}
+
+		if (mtrace)
+		{
+			hart0.add_sink(mtrace.get());
+		}
+
+		if (ilp)
+		{
+			hart0.add_sink(ilp.get());
+		}
+
+		// Every input from the host goes through the log.
+		if (logging)
+		{
+			log.set_clock(hart0.get_clock());
+			hart0.set_replay(&log);
+			console.set_replay(&log);
+			if (sys)
+			{
+				sys->set_replay(&log);
+			}
+		}
+
+		// The hart and the devices register their state once, whether
+		// it is saved, restored or captured by the debugger.
+		checkpoint ck;
+		if (!save_file.empty() || !restore_file.empty() || !debug_script.empty())
+		{
+			hart0.register_state(ck, "hart0");
+			timer.register_state(ck, "clint");
+			console.register_state(ck, "uart");
+			irqc.register_state(ck, "plic");
+			if (disk)
+			{
+				disk->register_state(ck, "disk");
+			}
+			if (sys)
+			{
+				sys->register_state(ck, "sys");
+			}
+		}
+		if (!restore_file.empty() && !ck.restore(restore_file, mem))
+		{
+			usage();
+		}
+		if (!save_file.empty())
+		{
+			hart0.set_checkpoint(&ck, save_file, save_at);
+		}
+		if (fan)
+		{
+			hart0.set_fanout(fan.get(), save_at);
+		}
+
+		if (!debug_script.empty())
+		{
+			std::ifstream script(debug_script);
+			if (!script)
+			{
+				cerr << "Can't open debugger script " << debug_script << endl;
+				usage();
+			}
+			debug(hart0, mem, ck, log, exec_limit, script);
+			hart0.finish();
+		}
+		else
+		{
+			cpu.run(exec_limit);
+		}
+
+		if (!record_file.empty())
+		{
+			log.save(record_file);
+		}
+
+		if (show_dump)
+		{
+			cpu.dump();
+			mem.dump();
+		}
+	};
+
+	if (xlen == 64)
+	{
+		cpu_multi_hart<64> cpu(mem, num_harts);
+		run(cpu);
+	}
+	else
 	{
-		cpu.dump();
-		mem.dump();
+		cpu_multi_hart<32> cpu(mem, num_harts);
+		run(cpu);
 	}
 
-	return 0;
+	return sys ? sys->get_exit_status() : 0;
 }
\ No newline at end of file
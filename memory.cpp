@@ -1,4 +1,7 @@
 #include "memory.h"
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
 
 //***************************************************************************
 //
@@ -20,8 +23,20 @@ memory::memory(uint32_t s)
 {
     s = (s+15) & 0xfffffff0;  // Round the length up, mod-16
 
-    // Resize the mem vector.
-    mem.resize(s, 0xa5);
+    // Map whole host pages for RAM and fill it.
+    size_t page = sysconf(_SC_PAGESIZE);
+    ram_size = s;
+    ram_mapped = (s + page - 1) / page * page;
+    void *p = mmap(nullptr, ram_mapped ? ram_mapped : page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+    ram = static_cast<uint8_t *>(p);
+    memset(ram, 0xa5, ram_size);
+
+    // RAM is the first region of the bus.
+    regions.push_back({ 0, s, ram, true, nullptr });
 }
 
 /**
@@ -29,8 +44,8 @@ memory::memory(uint32_t s)
 */
 memory::~memory()
 {
-    // Clear the mem vector.
-    mem.clear();
+    // Unmap RAM, and any file mapped over it.
+    munmap(ram, ram_mapped ? ram_mapped : sysconf(_SC_PAGESIZE));
 }
 
 /**
@@ -46,7 +61,9 @@ bool memory::check_illegal(uint32_t i) const
     // If the address is greater than the size of the simulated memory.
     if ( i >= get_size() )
     {
-        // The address is out of range. Print so on std::cerr
+        // Count it, then print that the address is out of range
+        // on std::cerr
+        ++illegal_accesses;
         cerr << "WARNING: Address out of range: " + hex::to_hex0x32(i) << endl;
         
         // Return true.
@@ -68,134 +85,487 @@ bool memory::check_illegal(uint32_t i) const
 uint32_t memory::get_size() const
 {
     // Return the size of the mem vector.
-    return mem.size();
+    return ram_size;
 }
 
 /**
- * @defgroup getX Get little-endian
- * Read and return a little-endian value from memory.
+ * @defgroup block Block copies
+ * Copy a run of bytes between the simulated memory and a host buffer,
+ * as the vector loads and stores do. A run that lies wholly inside the
+ * simulated memory is one host copy, anything else goes byte by byte so
+ * every out of range byte is reported as get8 and set8 would.
  * 
- * @param addr The address of the byte to read in the simulated memory.
- * @return The little-endian value from the simulated memory starting at
- *  address addr.
- * @note If an address is not within range of the simulated memory, a
- *  warning message will be printed to std::cerr.
+ * @param addr The address of the first byte in the simulated memory.
+ * @param len The number of bytes to copy.
  * @{
 */
 
-uint8_t memory::get8(uint32_t addr) const       ///< Get an 8-bit value from the simulated memory.
+void memory::get_block(uint32_t addr, uint8_t *dst, uint32_t len) const    ///< Copy len bytes out to dst.
 {
-    // Check if the address is legal.
-    if(!check_illegal(addr))
+    if ((uint64_t) addr + len <= get_size())
     {
-        // Return the byte at the address.
-        return mem[addr];
+        memcpy(dst, ram + addr, len);
+        return;
     }
-    else
+
+    for (uint32_t i = 0; i < len; ++i)
+        dst[i] = get8(addr + i);
+}
+
+void memory::set_block(uint32_t addr, const uint8_t *src, uint32_t len)    ///< Copy len bytes in from src.
+{
+    if ((uint64_t) addr + len <= get_size())
     {
-        return 0;
+        memcpy(ram + addr, src, len);
+        return;
     }
+
+    for (uint32_t i = 0; i < len; ++i)
+        set8(addr + i, src[i]);
 }
+/**@}*/
 
-uint16_t memory::get16(uint32_t addr) const     ///< Get a 16-bit little-endian value from the simulated memory.
+/**
+ * @brief Maps a device into the address space.
+ * 
+ * @param base The address of the device's first byte.
+ * @param size The number of bytes the device answers to.
+ * @param dev The device. It must outlive the memory.
+ * 
+ * @return True if the device was mapped, False if it would overlap RAM,
+ *  ROM or another device.
+*/
+bool memory::attach(uint32_t base, uint32_t size, mmio_device *dev)
 {
-    return get8(addr) | (get8(addr+1) << 8);
+    return add_region({ base, size, nullptr, true, dev });
 }
 
-uint32_t memory::get32(uint32_t addr) const     ///< Get a 32-bit little-endian value from the simulated memory.
+/**
+ * @brief Maps a read-only copy of some bytes into the address space.
+ * Writes to it are reported like accesses out of range and dropped.
+ * 
+ * @param base The address of the first byte.
+ * @param data The contents of the ROM.
+ * 
+ * @return True if the ROM was mapped, False if it would overlap RAM,
+ *  ROM or a device.
+*/
+bool memory::map_rom(uint32_t base, const std::vector<uint8_t> &data)
 {
-    return get16(addr) | (get16(addr+2) << 16);
+    std::unique_ptr<uint8_t[]> bytes(new uint8_t[data.size()]);
+    std::copy(data.begin(), data.end(), bytes.get());
+    if (!add_region({ base, (uint32_t) data.size(), bytes.get(), false, nullptr }))
+    {
+        return false;
+    }
+    roms.push_back(std::move(bytes));
+    return true;
 }
-/**@}*/
 
 /**
- * @defgroup getX_sx Get signed-extended little-endian
- * Read and return a signed-extended little-endian value from memory.
+ * @brief Has every device send what it has buffered to the host.
+*/
+void memory::flush() const
+{
+    for (const region &r : regions)
+    {
+        if (r.dev)
+        {
+            r.dev->flush();
+        }
+    }
+}
+
+/**
+ * @brief Asks every device whether input has come in that the guest
+ * has not seen.
  * 
- * @param addr The address of the byte to read in the simulated memory.
- * @return The signed-extended little-endian value from the simulated memory
- *  starting at address addr.
- * @note If an address is not within range of the simulated memory, a
- *  warning message will be printed to std::cerr.
- * @{
+ * @return True if any device has some.
 */
-int32_t memory::get8_sx(uint32_t addr) const    ///< Get a signed-extended 8-bit value from the simulated memory.
+bool memory::has_input() const
 {
-    // Set val to get8() at the current address.
-    int32_t val = get8(addr);
+    bool any = false;
+    for (const region &r : regions)
+    {
+        if (r.dev && r.dev->has_input())
+        {
+            any = true;
+        }
+    }
+    return any;
+}
 
-    return val | (val & 0x00000080 ? 0xffffff00 : 0);
+/**
+ * @brief Adds a region to the map, keeping it sorted by address.
+ * 
+ * @param r The region.
+ * 
+ * @return True if the region was added, False if it is empty, wraps
+ *  past the top of the address space or overlaps another region.
+*/
+bool memory::add_region(const region &r)
+{
+    if (r.size == 0 || (uint64_t) r.base + r.size > 0x100000000ull)
+    {
+        return false;
+    }
+
+    auto pos = std::lower_bound(regions.begin(), regions.end(), r.base,
+        [](const region &x, uint32_t base) { return x.base < base; });
+
+    // It must end before the next region starts, and start after the
+    // one before it ends.
+    if (pos != regions.end() && r.base + (uint64_t) r.size > pos->base)
+    {
+        return false;
+    }
+    if (pos != regions.begin() && (uint64_t) (pos - 1)->base + (pos - 1)->size > r.base)
+    {
+        return false;
+    }
+
+    regions.insert(pos, r);
+    last_region = 0;
+    return true;
 }
 
-int32_t memory::get16_sx(uint32_t addr) const   ///< Get a signed-extended 16-bit little-endian value from the simulated memory.
+/**
+ * @brief Finds the region an address belongs to. The region the last
+ * lookup found is tried first, so a run of accesses to one device
+ * costs a compare each.
+ * 
+ * @param addr The address.
+ * 
+ * @return The region, or nullptr if nothing is mapped at addr.
+*/
+const memory::region *memory::find_region(uint32_t addr) const
 {
-    // Set val to get16() at the current address.
-    int32_t val = get16(addr);
+    // Harts on other threads may move the cache too, but any index
+    // they leave is a valid region, so a relaxed load is enough.
+    const region *r = &regions[last_region.load(std::memory_order_relaxed)];
+    if (addr - r->base < r->size)
+    {
+        return r;
+    }
+
+    ++region_lookups;
+    auto pos = std::upper_bound(regions.begin(), regions.end(), addr,
+        [](uint32_t a, const region &x) { return a < x.base; });
+    if (pos == regions.begin())
+    {
+        return nullptr;
+    }
+
+    --pos;
+    if (addr - pos->base >= pos->size)
+    {
+        return nullptr;
+    }
 
-    return val | (val & 0x00008000 ? 0xffff0000 : 0);
+    last_region.store(pos - regions.begin(), std::memory_order_relaxed);
+    return &*pos;
 }
 
-int32_t memory::get32_sx(uint32_t addr) const   ///< Get a signed-extended 32-bit little-endian value from the simulated memory.
+/**
+ * @brief Reads a value that is not wholly in RAM.
+ * 
+ * @param addr The address of the value's first byte.
+ * @param len The number of bytes, 1, 2, 4 or 8.
+ * 
+ * @return The little-endian value. Bytes that nothing is mapped at
+ *  read as 0.
+ * @note Every byte that nothing is mapped at prints a warning to
+ *  std::cerr, as check_illegal does.
+*/
+uint64_t memory::bus_read(uint32_t addr, uint32_t len) const
 {
-    return get32(addr);
+    const region *r = find_region(addr);
+    if (r && addr + (uint64_t) len <= (uint64_t) r->base + r->size)
+    {
+        uint32_t offset = addr - r->base;
+        if (r->dev)
+        {
+            ++mmio_accesses;
+            return r->dev->read(offset, len);
+        }
+        uint64_t val = 0;
+        memcpy(&val, r->host + offset, len);
+        return val;
+    }
+
+    // The access starts outside every region or runs off the end of
+    // one, so take it a byte at a time.
+    if (len > 1)
+    {
+        uint64_t val = 0;
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            val |= bus_read(addr + i, 1) << (8 * i);
+        }
+        return val;
+    }
+
+    ++illegal_accesses;
+    cerr << "WARNING: Address out of range: " + hex::to_hex0x32(addr) << endl;
+    return 0;
 }
-/**@}*/
 
 /**
- * @defgroup setX Set little-endian
- * Set a little-endian value into memory.
+ * @brief Writes a value that is not wholly in RAM.
  * 
- * @param addr The address of the byte to set in the simulated memory.
- * @param val The value to set at the given address.
- * @note If an address is not within range of the simulated memory, a
- *  warning message will be printed to std::cerr.
- * @{
+ * @param addr The address of the value's first byte.
+ * @param len The number of bytes, 1, 2, 4 or 8.
+ * @param val The little-endian value.
+ * @note Every byte that nothing is mapped at, or that is ROM, prints a
+ *  warning to std::cerr and is dropped.
 */
+void memory::bus_write(uint32_t addr, uint32_t len, uint64_t val)
+{
+    const region *r = find_region(addr);
+    if (r && addr + (uint64_t) len <= (uint64_t) r->base + r->size)
+    {
+        uint32_t offset = addr - r->base;
+        if (r->dev)
+        {
+            ++mmio_accesses;
+            r->dev->write(offset, len, val);
+            return;
+        }
+        if (r->writable)
+        {
+            memcpy(r->host + offset, &val, len);
+            return;
+        }
+    }
+
+    if (len > 1)
+    {
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            bus_write(addr + i, 1, val >> (8 * i));
+        }
+        return;
+    }
 
-void memory::set8(uint32_t addr, uint8_t val)
+    ++illegal_accesses;
+    cerr << "WARNING: " << (r ? "Write to ROM: " : "Address out of range: ") << hex::to_hex0x32(addr) << endl;
+}
+
+/**
+ * @brief Reads from a device a byte at a time.
+ * 
+ * @param offset The offset of the first byte from the device's base.
+ * @param len The number of bytes.
+ * 
+ * @return The little-endian value.
+*/
+uint64_t mmio_device::read(uint32_t offset, uint32_t len)
 {
-    // Check if the the address is legal.
-    if(!check_illegal(addr))
+    uint64_t val = 0;
+    for (uint32_t i = 0; i < len; ++i)
     {
-        // Set the byte at the address.
-        mem[addr] = val;
+        val |= (uint64_t) read8(offset + i) << (8 * i);
     }
+    return val;
 }
 
-void memory::set16(uint32_t addr, uint16_t val)
+/**
+ * @brief Writes to a device a byte at a time.
+ * 
+ * @param offset The offset of the first byte from the device's base.
+ * @param len The number of bytes.
+ * @param val The little-endian value.
+*/
+void mmio_device::write(uint32_t offset, uint32_t len, uint64_t val)
 {
-    // Set the first 8 bytes of val.
-    set8(addr, (uint8_t) val);
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        write8(offset + i, val >> (8 * i));
+    }
+}
 
-    // Bitshift val to the right 8.
-    val >>= 8;
+/**
+ * @brief Gets a host pointer to a run of bytes in the simulated memory.
+ * The system call emulation hands guest buffers straight to the host
+ * this way, so nothing is copied.
+ * 
+ * @param addr The address of the first byte.
+ * @param len The number of bytes the caller will touch.
+ * 
+ * @return The host address of addr, or nullptr if any of the bytes
+ *  are out of range.
+*/
+uint8_t *memory::get_ptr(uint32_t addr, uint32_t len)
+{
+    if ((uint64_t) addr + len > get_size())
+    {
+        return nullptr;
+    }
+    return ram + addr;
+}
 
-    // Set the last 8 bytes of val.
-    set8(addr+1, (uint8_t) val);
+/**
+ * @brief Sets all of RAM to zero by giving it fresh host pages, which
+ * cost nothing until they are touched.
+*/
+void memory::clear_ram()
+{
+    if (ram_mapped)
+    {
+        mmap(ram, ram_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    }
 }
 
-void memory::set32(uint32_t addr, uint32_t val)
+/**
+ * @brief Maps part of a file over RAM, copy-on-write, so its pages are
+ * only read from the file when they are touched and guest writes never
+ * reach it.
+ * 
+ * @param addr The RAM address, a multiple of the host page size.
+ * @param len The number of bytes, a multiple of the host page size.
+ * @param fd The file.
+ * @param offset The file offset, a multiple of the host page size.
+ * 
+ * @return False if the pages could not be mapped.
+*/
+bool memory::map_pages(uint32_t addr, uint32_t len, int fd, uint64_t offset)
 {
-    // Set the first 16 bytes of val.
-    set16(addr, (uint16_t) val);
+    size_t page = sysconf(_SC_PAGESIZE);
+    if ((uint64_t) addr + len > ram_mapped || addr % page || len % page || offset % page)
+    {
+        return false;
+    }
+    return mmap(ram + addr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset) != MAP_FAILED;
+}
 
-    // Bitshift val to the right 16.
-    val >>= 16;
+/**
+ * @defgroup atomic Atomic memory operations
+ * The atomic operations used by the A extension. Each one is a single
+ * host atomic instruction on the word, so harts on different host
+ * threads see each other's atomics without a simulator lock.
+ * 
+ * @param addr The address of the word. It must be 4-byte aligned.
+ * @note If an address is not within range of the simulated memory, a
+ *  warning message will be printed to std::cerr.
+ * @{
+*/
 
-    // Set the last 16 bytes of val.
-    set16(addr+2, (uint16_t) val);
+/**
+ * @brief Atomically loads a word.
+ * 
+ * @return The word, or 0 if the address is out of range.
+*/
+uint32_t memory::atomic_get32(uint32_t addr) const
+{
+    if (check_illegal(addr))
+    {
+        return 0;
+    }
+    return __atomic_load_n(word(addr), __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Atomically replaces a word if it still holds an expected value.
+ * 
+ * @param expected The value the word must hold.
+ * @param desired The value to store.
+ * 
+ * @return True if the word held expected and desired was stored.
+*/
+bool memory::atomic_cas32(uint32_t addr, uint32_t expected, uint32_t desired)
+{
+    if (check_illegal(addr))
+    {
+        return false;
+    }
+    return __atomic_compare_exchange_n(word(addr), &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
 }
 
+/**
+ * @brief Atomically reads, modifies and writes a word.
+ * 
+ * @param op The operation, one of the amo_X values.
+ * @param val The operand.
+ * 
+ * @return The old value of the word, or 0 if the address is out of range.
+*/
+uint32_t memory::atomic_rmw32(uint32_t addr, int op, uint32_t val)
+{
+    if (check_illegal(addr))
+    {
+        return 0;
+    }
+
+    uint32_t *p = word(addr);
+    switch (op)
+    {
+        case amo_swap:
+            return __atomic_exchange_n(p, val, __ATOMIC_SEQ_CST);
+        case amo_add:
+            return __atomic_fetch_add(p, val, __ATOMIC_SEQ_CST);
+        case amo_xor:
+            return __atomic_fetch_xor(p, val, __ATOMIC_SEQ_CST);
+        case amo_and:
+            return __atomic_fetch_and(p, val, __ATOMIC_SEQ_CST);
+        case amo_or:
+            return __atomic_fetch_or(p, val, __ATOMIC_SEQ_CST);
+        default:
+            break;
+    }
+
+    // The host has no min/max instruction, so retry a compare and swap
+    // until no other hart changed the word in between.
+    uint32_t old = __atomic_load_n(p, __ATOMIC_SEQ_CST);
+    uint32_t v;
+    do
+    {
+        switch (op)
+        {
+            case amo_min:
+                v = ((int32_t) old < (int32_t) val) ? old : val;
+                break;
+            case amo_max:
+                v = ((int32_t) old > (int32_t) val) ? old : val;
+                break;
+            case amo_minu:
+                v = std::min(old, val);
+                break;
+            case amo_maxu:
+                v = std::max(old, val);
+                break;
+            default:
+                assert(0 && "unrecognized amo op"); // We should not get here
+                v = old;
+                break;
+        }
+    } while (!__atomic_compare_exchange_n(p, &old, v, true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    return old;
+}
 /**@}*/
 
+/**
+ * @brief Gets the host address of a word of the simulated memory.
+ * 
+ * @param addr The address of the word.
+ * 
+ * @return A pointer to the word. The host is little-endian, so the
+ *  bytes are already in the order the guest expects.
+*/
+uint32_t *memory::word(uint32_t addr) const
+{
+    return reinterpret_cast<uint32_t *>(ram + addr);
+}
+
 /**
  * @brief Dump the contents of the simulated memory.
 */
 
 void memory::dump() const
 {
-    // Loop through the mem vector.
-    for (uint32_t i = 0; i < mem.size(); i++)
+    // Loop through RAM.
+    for (uint32_t i = 0; i < ram_size; i++)
     {
         // If i mod 16 == 0, print the current address.
         if ((i % 16) == 0)
@@ -205,7 +575,7 @@ void memory::dump() const
         }
 
         // Print the current byte at i.
-        cout << hex::to_hex8(mem.at(i)) << " ";
+        cout << hex::to_hex8(ram[i]) << " ";
 
         // For every 8th item, print an extra space.
         if (((i+1) % 8) == 0 && ((i+1) % 16) != 0)
@@ -284,6 +654,7 @@ bool memory::load_file(const std::string &fname)
                  // that address.
             {
                 set8(addr, i);
+                image_size = addr + 1;
             }
         }
 
@@ -292,4 +663,28 @@ bool memory::load_file(const std::string &fname)
 
         return true;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Getter for image_size
+ * 
+ * @return The number of bytes load_file loaded, the end of the program
+ *  image.
+*/
+uint32_t memory::get_image_size() const
+{
+    return image_size;
+}
+
+/**
+ * @brief Registers the statistics of the simulated memory.
+ * 
+ * @param s The statistics registry.
+ * @param prefix The name the statistics are grouped under.
+*/
+void memory::register_stats(stats &s, const std::string &prefix) const
+{
+    s.add_scalar(prefix + ".illegal_accesses", &illegal_accesses, "Accesses outside the simulated memory");
+    s.add_scalar(prefix + ".mmio_accesses", &mmio_accesses, "Accesses that reached a device");
+    s.add_scalar(prefix + ".region_lookups", &region_lookups, "Accesses outside RAM that missed the last-region cache");
+}
@@ -1,4 +1,9 @@
-#include "hex.h"
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "stats.h"
+#include <atomic>
+#include <cstring>
 
 //***************************************************************************
 //
@@ -10,30 +15,190 @@
 //
 //***************************************************************************
 
+/**
+ * @brief A device mapped into the address space.
+ * 
+ * A device only has to answer byte accesses. The bus hands it a whole
+ * access through read and write, which by default split it into bytes,
+ * lowest address first, so a device whose registers are wider can
+ * override them and see a word access as one call. A device that holds
+ * output back from the host sends it when flush is called.
+*/
+class mmio_device
+{
+    public :
+        virtual ~mmio_device () {}
+
+        virtual uint8_t read8 ( uint32_t offset ) = 0;
+        virtual void write8 ( uint32_t offset , uint8_t val ) = 0;
+
+        virtual uint64_t read ( uint32_t offset , uint32_t len );
+        virtual void write ( uint32_t offset , uint32_t len , uint64_t val );
+
+        /**
+         * @brief Sends anything the device has buffered to the host.
+        */
+        virtual void flush () {}
+        /**
+         * @brief Looks for input the device only checks for when read.
+         * A hart calls this before it skips ahead in a loop polling
+         * the device.
+         * 
+         * @return True if the guest would now read something new.
+        */
+        virtual bool has_input () { return false; }
+};
+
+/**
+ * @brief The simulated memory and the bus the harts reach it through.
+ * 
+ * RAM starts at address 0. ROM and devices can be mapped anywhere past
+ * it, and every region, RAM included, sits in a map sorted by address.
+ * An access that lies wholly inside RAM never looks at the map: the
+ * accessors are inlined and test that first, so RAM traffic costs what
+ * it did before there were devices. Anything else is found in the map,
+ * starting with the region the last such access hit.
+*/
 class memory : public hex
 {
     public :
         memory ( uint32_t s );
         ~memory ();
+        memory ( const memory & ) = delete ;
+        memory & operator = ( const memory & ) = delete ;
 
         bool check_illegal ( uint32_t addr ) const ;
         uint32_t get_size () const ;
-        uint8_t get8 ( uint32_t addr ) const ;
-        uint16_t get16 ( uint32_t addr ) const ;
-        uint32_t get32 ( uint32_t addr ) const ;
+        template < typename T > T get ( uint32_t addr ) const ;
+        template < typename T > void set ( uint32_t addr , T val );
+
+        /**
+         * @defgroup access Little-endian access
+         * Read or write a little-endian value. A value wholly in RAM is
+         * handled here, anything else goes out on the bus.
+         * @note An address that nothing is mapped at prints a warning to
+         *  std::cerr.
+         * @{
+        */
+        uint8_t get8 ( uint32_t addr ) const { return get < uint8_t > ( addr ); }
+        uint16_t get16 ( uint32_t addr ) const { return get < uint16_t > ( addr ); }
+        uint32_t get32 ( uint32_t addr ) const { return get < uint32_t > ( addr ); }
+        uint64_t get64 ( uint32_t addr ) const { return get < uint64_t > ( addr ); }
+
+        int32_t get8_sx ( uint32_t addr ) const { return ( int8_t ) get8 ( addr ); }
+        int32_t get16_sx ( uint32_t addr ) const { return ( int16_t ) get16 ( addr ); }
+        int32_t get32_sx ( uint32_t addr ) const { return ( int32_t ) get32 ( addr ); }
+
+        void set8 ( uint32_t addr , uint8_t val ) { set < uint8_t > ( addr , val ); }
+        void set16 ( uint32_t addr , uint16_t val ) { set < uint16_t > ( addr , val ); }
+        void set32 ( uint32_t addr , uint32_t val ) { set < uint32_t > ( addr , val ); }
+        void set64 ( uint32_t addr , uint64_t val ) { set < uint64_t > ( addr , val ); }
+        /**@}*/
 
-        int32_t get8_sx ( uint32_t addr ) const ;
-        int32_t get16_sx ( uint32_t addr ) const ;
-        int32_t get32_sx ( uint32_t addr ) const ;
+        void get_block ( uint32_t addr , uint8_t * dst , uint32_t len ) const ;
+        void set_block ( uint32_t addr , const uint8_t * src , uint32_t len );
+        uint8_t * get_ptr ( uint32_t addr , uint32_t len );
+        void clear_ram ();
+        bool map_pages ( uint32_t addr , uint32_t len , int fd , uint64_t offset );
 
-        void set8 ( uint32_t addr , uint8_t val );
-        void set16 ( uint32_t addr , uint16_t val );
-        void set32 ( uint32_t addr , uint32_t val );
+        static constexpr int amo_swap = 0;
+        static constexpr int amo_add = 1;
+        static constexpr int amo_xor = 2;
+        static constexpr int amo_and = 3;
+        static constexpr int amo_or = 4;
+        static constexpr int amo_min = 5;
+        static constexpr int amo_max = 6;
+        static constexpr int amo_minu = 7;
+        static constexpr int amo_maxu = 8;
+
+        uint32_t atomic_get32 ( uint32_t addr ) const ;
+        bool atomic_cas32 ( uint32_t addr , uint32_t expected , uint32_t desired );
+        uint32_t atomic_rmw32 ( uint32_t addr , int op , uint32_t val );
 
         void dump () const ;
 
+        bool attach ( uint32_t base , uint32_t size , mmio_device * dev );
+        bool map_rom ( uint32_t base , const std :: vector < uint8_t > & data );
+        void flush () const ;
+        bool has_input () const ;
+        /**
+         * @brief Getter for mmio_accesses
+         * 
+         * @return The number of accesses that reached a device.
+        */
+        uint64_t get_mmio_accesses () const { return mmio_accesses ; }
+
         bool load_file ( const std :: string & fname );
+        uint32_t get_image_size () const ;
+
+        void register_stats ( stats & s , const std :: string & prefix ) const ;
 
     private :
-        std :: vector < uint8_t > mem ;
+        /**
+         * @brief A run of addresses and what answers to them. RAM and ROM
+         * are host bytes, a device is reached through its callbacks.
+        */
+        struct region
+        {
+            uint32_t base ;
+            uint32_t size ;
+            uint8_t * host ;            ///< The bytes of RAM or ROM, else nullptr.
+            bool writable ;             ///< False for ROM.
+            mmio_device * dev ;         ///< The device, else nullptr.
+        };
+
+        uint64_t bus_read ( uint32_t addr , uint32_t len ) const ;
+        void bus_write ( uint32_t addr , uint32_t len , uint64_t val );
+        const region * find_region ( uint32_t addr ) const ;
+        bool add_region ( const region & r );
+
+        uint32_t * word ( uint32_t addr ) const ;
+
+        uint8_t * ram = { nullptr };        ///< Host pages of their own, so a file can be mapped over them.
+        uint32_t ram_size = { 0 };
+        size_t ram_mapped = { 0 };          ///< ram_size rounded up to host pages.
+        uint32_t image_size = { 0 };
+        std :: vector < region > regions ;                      ///< Sorted by base.
+        std :: vector < std :: unique_ptr < uint8_t [] > > roms ;
+        mutable std :: atomic < uint32_t > last_region = { 0 }; ///< Index of the region last found.
+        mutable uint64_t illegal_accesses = { 0 };
+        mutable uint64_t mmio_accesses = { 0 };
+        mutable uint64_t region_lookups = { 0 };
 };
+
+/**
+ * @brief Reads a little-endian value.
+ * 
+ * @param addr The address of the value's first byte.
+ * 
+ * @return The value. The host is little-endian, so a value wholly in
+ *  RAM is one host load.
+*/
+template < typename T > inline T memory :: get ( uint32_t addr ) const
+{
+    if ( ( uint64_t ) addr + sizeof ( T ) <= ram_size )
+    {
+        T val ;
+        memcpy ( & val , ram + addr , sizeof ( T ) );
+        return val ;
+    }
+    return ( T ) bus_read ( addr , sizeof ( T ) );
+}
+
+/**
+ * @brief Writes a little-endian value.
+ * 
+ * @param addr The address of the value's first byte.
+ * @param val The value.
+*/
+template < typename T > inline void memory :: set ( uint32_t addr , T val )
+{
+    if ( ( uint64_t ) addr + sizeof ( T ) <= ram_size )
+    {
+        memcpy ( ram + addr , & val , sizeof ( T ) );
+        return ;
+    }
+    bus_write ( addr , sizeof ( T ) , val );
+}
+
+#endif
@@ -0,0 +1,376 @@
+#include "memtrace.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+constexpr uint32_t reuse_tracker::empty_key;
+constexpr size_t memtrace::top_pcs;
+
+/**
+ * @brief Constructor for the reuse tracker.
+*/
+reuse_tracker::reuse_tracker()
+{
+    keys.resize(1 << 12, empty_key);
+    times.resize(1 << 12, empty_key);
+    stamps.resize(1 << 12, 0);
+    tree.resize((1 << 20) + 1, 0);
+}
+
+/**
+ * @brief Gets the histogram bucket of a reuse distance.
+ * 
+ * @param dist The reuse distance.
+ * 
+ * @return 0 for a distance of 0, otherwise 1 + log2(dist), capped
+ *  at the last bucket.
+*/
+int reuse_tracker::bucket(uint64_t dist)
+{
+    if (dist == 0)
+        return 0;
+
+    int b = 64 - __builtin_clzll(dist);
+    return b < num_buckets ? b : num_buckets - 1;
+}
+
+/**
+ * @brief Finds the slot of a block, inserting it if it is new.
+ * 
+ * @param block The block number.
+ * 
+ * @return The slot index. A new block has a time of empty_key.
+*/
+uint32_t reuse_tracker::find(uint32_t block)
+{
+    uint32_t mask = keys.size() - 1;
+    uint32_t h = block * 0x9e3779b1;
+    uint32_t i = (h ^ (h >> 16)) & mask;
+
+    // Linear probe until the block or an empty slot turns up.
+    while (keys[i] != block && keys[i] != empty_key)
+        i = (i + 1) & mask;
+
+    if (keys[i] == empty_key)
+    {
+        keys[i] = block;
+        times[i] = empty_key;
+        stamps[i] = 0;
+        ++used;
+    }
+    return i;
+}
+
+/**
+ * @brief Doubles the size of the block table.
+*/
+void reuse_tracker::grow_table()
+{
+    std::vector<uint32_t> old_keys;
+    std::vector<uint32_t> old_times;
+    std::vector<uint32_t> old_stamps;
+    old_keys.swap(keys);
+    old_times.swap(times);
+    old_stamps.swap(stamps);
+
+    keys.assign(old_keys.size() * 2, empty_key);
+    times.assign(old_keys.size() * 2, empty_key);
+    stamps.assign(old_keys.size() * 2, 0);
+    used = 0;
+
+    for (size_t i = 0; i < old_keys.size(); ++i)
+    {
+        if (old_keys[i] != empty_key)
+        {
+            uint32_t slot = find(old_keys[i]);
+            times[slot] = old_times[i];
+            stamps[slot] = old_stamps[i];
+        }
+    }
+}
+
+/**
+ * @brief Renumbers the last-access times as 0..n-1.
+ * 
+ * Only the order of the times matters to the distances, so squeezing
+ * out the holes left by older accesses changes no result. The tree
+ * doubles when the live blocks would fill more than half of it.
+*/
+void reuse_tracker::compact()
+{
+    std::vector<std::pair<uint32_t, uint32_t>> live;
+    live.reserve(used);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (keys[i] != empty_key && times[i] != empty_key)
+            live.push_back(std::make_pair(times[i], (uint32_t)i));
+    }
+    std::sort(live.begin(), live.end());
+
+    size_t cap = tree.size() - 1;
+    if (live.size() * 2 > cap)
+        cap *= 2;
+    tree.assign(cap + 1, 0);
+
+    now = 0;
+    for (const auto &l : live)
+    {
+        times[l.second] = now;
+        tree_add(now + 1, 1);
+        ++now;
+    }
+}
+
+/**
+ * @defgroup tree Fenwick tree
+ * Point update and prefix sum over positions 1..n.
+ * @{
+*/
+void reuse_tracker::tree_add(uint32_t pos, int32_t val)   ///< Add val at pos.
+{
+    for (; pos < tree.size(); pos += pos & -pos)
+        tree[pos] += val;
+}
+
+int32_t reuse_tracker::tree_sum(uint32_t pos) const     ///< Sum of positions 1..pos.
+{
+    int32_t sum = 0;
+    for (; pos > 0; pos -= pos & -pos)
+        sum += tree[pos];
+    return sum;
+}
+/**@}*/
+
+/**
+ * @brief Records an access to a block.
+ * 
+ * @param block The block number.
+*/
+void reuse_tracker::access(uint32_t block)
+{
+    if (used * 2 >= keys.size())
+        grow_table();
+
+    uint32_t slot = find(block);
+
+    ++accesses;
+    ++interval_accesses;
+
+    // Count the block once per interval toward the working set.
+    if (stamps[slot] != interval)
+    {
+        stamps[slot] = interval;
+        ++interval_blocks;
+    }
+
+    if (now == tree.size() - 1)
+        compact();
+
+    uint32_t t = now++;
+    uint32_t prev = times[slot];
+    if (prev == empty_key)
+    {
+        ++cold;
+    }
+    else
+    {
+        // Count the marks strictly between the two accesses.
+        uint64_t dist = tree_sum(t) - tree_sum(prev + 1);
+        int b = bucket(dist);
+        ++hist[b];
+        ++interval_hist[b];
+        tree_add(prev + 1, -1);
+    }
+    tree_add(t + 1, 1);
+    times[slot] = t;
+}
+
+/**
+ * @brief Clears the per-interval counts.
+*/
+void reuse_tracker::start_interval()
+{
+    ++interval;
+    interval_accesses = 0;
+    interval_blocks = 0;
+    for (int i = 0; i < num_buckets; ++i)
+        interval_hist[i] = 0;
+}
+
+/**
+ * @brief Constructor for the memory trace analysis.
+ * 
+ * @param interval The number of instructions in a report interval.
+ * @param os The stream the interval reports are printed to.
+*/
+memtrace::memtrace(uint64_t interval, std::ostream &os) : interval_len(interval), out(os)
+{
+    next_report = interval_len;
+}
+
+/**
+ * @brief Consume a batch of retired instructions.
+ * 
+ * @param recs The records, in program order.
+ * @param n The number of records.
+*/
+void memtrace::consume(const insn_record *recs, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const insn_record &r = recs[i];
+        ++insns;
+
+        // Straight-line code fetches the same block over and over. Those
+        // repeats cannot change any other distance, so count them as a
+        // distance of 0 without touching the tracker's tables.
+        uint32_t fb = r.pc >> block_shift;
+        if (fb != last_fetch_block)
+        {
+            fetches.access(fb);
+            last_fetch_block = fb;
+        }
+        else
+        {
+            ++fetches.accesses;
+            ++fetches.interval_accesses;
+            ++fetches.hist[0];
+            ++fetches.interval_hist[0];
+        }
+
+        if (r.kind == insn_record::kind_load || r.kind == insn_record::kind_store)
+        {
+            data.access(r.addr >> block_shift);
+
+            // Track how regularly this instruction walks memory.
+            stride_entry &e = strides[r.pc];
+            if (e.accesses != 0)
+            {
+                int32_t s = r.addr - e.last_addr;
+                if (s == e.stride)
+                {
+                    ++e.strided;
+                    ++interval_strided;
+                }
+                e.stride = s;
+            }
+            e.last_addr = r.addr;
+            ++e.accesses;
+        }
+
+        if (insns == next_report)
+            end_interval();
+    }
+}
+
+/**
+ * @brief Prints the line for the current interval and starts a new one.
+*/
+void memtrace::end_interval()
+{
+    // Print the interval line.
+    uint64_t under[3] = { 0, 0, 0 };
+    for (int b = 0; b < reuse_tracker::num_buckets; ++b)
+    {
+        if (b <= 4)
+            under[0] += data.interval_hist[b];
+        if (b <= 8)
+            under[1] += data.interval_hist[b];
+        if (b <= 12)
+            under[2] += data.interval_hist[b];
+    }
+
+    double acc = data.interval_accesses ? (double)data.interval_accesses : 1.0;
+    out << "interval " << intervals << " @" << insns
+        << ": ws insn " << fetches.interval_blocks
+        << " data " << data.interval_blocks << " blk ("
+        << ((data.interval_blocks << block_shift) >> 10) << " KiB)"
+        << std::fixed << std::setprecision(1)
+        << ", reuse<16 " << 100.0 * under[0] / acc << "%"
+        << " <256 " << 100.0 * under[1] / acc << "%"
+        << " <4K " << 100.0 * under[2] / acc << "%"
+        << ", strided " << 100.0 * interval_strided / acc << "%"
+        << std::defaultfloat << std::setprecision(6) << endl;
+
+    ++intervals;
+    next_report += interval_len;
+    interval_strided = 0;
+    last_fetch_block = 0xffffffff;
+    fetches.start_interval();
+    data.start_interval();
+}
+
+/**
+ * @brief Prints a reuse distance histogram.
+ * 
+ * @param os The stream to print to.
+ * @param name The name of the stream the histogram belongs to.
+ * @param t The tracker holding the histogram.
+*/
+void memtrace::print_hist(std::ostream &os, const char *name, const reuse_tracker &t) const
+{
+    os << "  " << name << " accesses " << t.accesses << ", cold " << t.cold << endl;
+
+    double acc = t.accesses ? (double)t.accesses : 1.0;
+    for (int b = 0; b < reuse_tracker::num_buckets; ++b)
+    {
+        if (t.hist[b] == 0)
+            continue;
+
+        // Bucket b holds the distances in [2^(b-1), 2^b).
+        std::ostringstream range;
+        if (b == 0)
+            range << "0";
+        else if (b == reuse_tracker::num_buckets - 1)
+            range << ">=" << (1ull << (b - 1));
+        else
+            range << (1ull << (b - 1)) << "-" << ((1ull << b) - 1);
+
+        os << "    " << std::setw(20) << std::left << range.str() << std::right
+           << std::setw(14) << t.hist[b] << "  " << std::fixed << std::setprecision(1)
+           << std::setw(5) << 100.0 * t.hist[b] / acc << "%" << std::defaultfloat
+           << std::setprecision(6) << endl;
+    }
+}
+
+/**
+ * @brief Prints the run summary.
+ * 
+ * @param os The stream to print to.
+*/
+void memtrace::report(std::ostream &os) const
+{
+    os << "Memory trace (" << (1 << block_shift) << "-byte blocks, " << insns
+       << " instructions, " << intervals << " full intervals)" << endl;
+    os << "  reuse distance in distinct blocks:" << endl;
+    print_hist(os, "insn", fetches);
+    print_hist(os, "data", data);
+
+    // Rank the loads and stores by how often they executed.
+    std::vector<std::pair<uint64_t, uint32_t>> busiest;
+    busiest.reserve(strides.size());
+    for (const auto &s : strides)
+        busiest.push_back(std::make_pair(s.second.accesses, s.first));
+
+    size_t n = std::min(top_pcs, busiest.size());
+    std::partial_sort(busiest.begin(), busiest.begin() + n, busiest.end(),
+                      std::greater<std::pair<uint64_t, uint32_t>>());
+
+    os << "  busiest load/store pcs:" << endl;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const stride_entry &e = strides.at(busiest[i].second);
+        double pct = e.accesses > 1 ? 100.0 * e.strided / (e.accesses - 1) : 0.0;
+        os << "    " << hex::to_hex0x32(busiest[i].second) << std::setw(14) << e.accesses
+           << "  last stride " << std::setw(6) << e.stride << "  strided "
+           << std::fixed << std::setprecision(1) << pct << "%" << std::defaultfloat
+           << std::setprecision(6) << endl;
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+#include "insn_trace.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Tracks the reuse distance of a stream of cache blocks.
+ * 
+ * The reuse distance of an access is the number of distinct blocks
+ * touched since the last access to the same block. Every block keeps
+ * one mark in a Fenwick tree at the time of its last access, so the
+ * distance is a range count over the tree. The time axis is compacted
+ * whenever the tree fills, so memory stays proportional to the number
+ * of distinct blocks rather than the length of the run.
+*/
+class reuse_tracker
+{
+public:
+    static constexpr int num_buckets = 26;
+
+    reuse_tracker();
+
+    void access(uint32_t block);
+    void start_interval();
+
+    uint64_t accesses = { 0 };          ///< Accesses in the whole run.
+    uint64_t cold = { 0 };              ///< First-ever accesses to a block.
+    uint64_t hist[num_buckets] = { };   ///< Whole-run log2 distance histogram.
+
+    uint64_t interval_accesses = { 0 }; ///< Accesses in this interval.
+    uint64_t interval_blocks = { 0 };   ///< Distinct blocks in this interval.
+    uint64_t interval_hist[num_buckets] = { };
+
+    static int bucket(uint64_t dist);
+
+private:
+    static constexpr uint32_t empty_key = 0xffffffff;
+
+    uint32_t find(uint32_t block);
+    void grow_table();
+    void compact();
+
+    void tree_add(uint32_t pos, int32_t val);
+    int32_t tree_sum(uint32_t pos) const;
+
+    // Open-addressed table of block -> time of last access.
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> times;
+    std::vector<uint32_t> stamps;
+    uint32_t used = { 0 };
+
+    // Fenwick tree over the time axis, indexed from 1.
+    std::vector<int32_t> tree;
+    uint32_t now = { 0 };
+
+    uint32_t interval = { 1 };
+};
+
+/**
+ * @brief An analysis of the memory behaviour of a run.
+ * 
+ * Every instruction fetch and every load and store is folded into
+ * 64-byte blocks. Every interval a one line report gives the working
+ * set and the reuse distance profile of the interval. The final report
+ * adds whole-run histograms and the most frequent access strides of
+ * the busiest load and store instructions.
+*/
+class memtrace : public insn_sink
+{
+public:
+    static constexpr uint32_t block_shift = 6;
+
+    memtrace(uint64_t interval, std::ostream &os);
+
+    void consume(const insn_record *recs, size_t n) override;
+    void report(std::ostream &os) const override;
+
+private:
+    static constexpr size_t top_pcs = 10;
+
+    /**
+     * @brief The stride history of one load or store instruction.
+    */
+    struct stride_entry
+    {
+        uint32_t last_addr;
+        int32_t stride;
+        uint64_t accesses;
+        uint64_t strided;
+    };
+
+    void end_interval();
+    void print_hist(std::ostream &os, const char *name, const reuse_tracker &t) const;
+
+    uint64_t interval_len;
+    std::ostream &out;
+
+    uint64_t insns = { 0 };
+    uint64_t intervals = { 0 };
+    uint64_t next_report;
+
+    reuse_tracker fetches;
+    reuse_tracker data;
+    uint32_t last_fetch_block = { 0xffffffff };
+
+    uint64_t interval_strided = { 0 };
+    std::unordered_map<uint32_t, stride_entry> strides;
+};
+
+#endif
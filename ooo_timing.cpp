@@ -0,0 +1,338 @@
+#include "ooo_timing.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Parses a parameter list of the form key=value,key=value.
+ * 
+ * @param spec The parameter list, or "default" to keep the defaults.
+ * 
+ * @return True if every key was recognized and every value was a
+ *  positive number, False otherwise.
+*/
+bool ooo_params::parse(const std::string &spec)
+{
+    if (spec == "default")
+        return true;
+
+    std::istringstream iss(spec);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        // Split the item into its key and value.
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            return false;
+
+        std::string key = item.substr(0, eq);
+        std::istringstream vs(item.substr(eq + 1));
+        uint32_t val = 0;
+        if (!(vs >> val) || val == 0)
+            return false;
+
+        if (key == "fetch")
+            fetch_width = val;
+        else if (key == "issue")
+            issue_width = val;
+        else if (key == "rob")
+            rob_size = val;
+        else if (key == "lsq")
+            lsq_size = val;
+        else if (key == "alu")
+            lat_alu = val;
+        else if (key == "mul")
+            lat_mul = val;
+        else if (key == "div")
+            lat_div = val;
+        else if (key == "load")
+            lat_load = val;
+        else if (key == "store")
+            lat_store = val;
+        else if (key == "branch")
+            lat_branch = val;
+        else if (key == "fp")
+            lat_fp = val;
+        else if (key == "mispredict")
+            mispredict_penalty = val;
+        else
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Constructor for the timing model.
+ * 
+ * @param p The machine parameters.
+*/
+ooo_timing::ooo_timing(const ooo_params &p) : params(p)
+{
+    rob.resize(params.rob_size, 0);
+    lsq.resize(params.lsq_size, 0);
+    issue_ring.resize(issue_ring_size, issue_slot { 0, 0 });
+    store_ready.resize(store_table_size, 0);
+
+    // Start every branch out as weakly not-taken.
+    bht.resize(predictor_size, 1);
+    btb.resize(predictor_size, 0);
+}
+
+/**
+ * @brief Consume a batch of retired instructions.
+ * 
+ * @param recs The records, in program order.
+ * @param n The number of records.
+*/
+void ooo_timing::consume(const insn_record *recs, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        model(recs[i]);
+    }
+}
+
+/**
+ * @brief Gets the execution latency of an instruction.
+ * 
+ * @param kind The kind of the instruction.
+ * 
+ * @return The number of cycles from issue to complete.
+*/
+uint32_t ooo_timing::latency(uint8_t kind) const
+{
+    switch (kind)
+    {
+        case insn_record::kind_mul:
+            return params.lat_mul;
+        case insn_record::kind_div:
+            return params.lat_div;
+        case insn_record::kind_load:
+            return params.lat_load;
+        case insn_record::kind_store:
+            return params.lat_store;
+        case insn_record::kind_branch:
+        case insn_record::kind_jump:
+            return params.lat_branch;
+        case insn_record::kind_fp:
+            return params.lat_fp;
+        default:
+            return params.lat_alu;
+    }
+}
+
+/**
+ * @brief Predicts a control transfer and trains the predictor.
+ * 
+ * Conditional branches use a table of 2-bit counters. Indirect jumps
+ * use a table of last-seen targets. Direct jumps are always right.
+ * 
+ * @param r The retired control transfer.
+ * 
+ * @return True if the prediction was correct.
+*/
+bool ooo_timing::predict(const insn_record &r)
+{
+    uint32_t idx = (r.pc >> 2) % predictor_size;
+
+    if (r.kind == insn_record::kind_branch)
+    {
+        bool taken = (r.next_pc != r.fall_through());
+        uint8_t &ctr = bht[idx];
+        bool correct = ((ctr >= 2) == taken);
+
+        // Saturate the counter toward the actual direction.
+        if (taken && ctr < 3)
+            ++ctr;
+        else if (!taken && ctr > 0)
+            --ctr;
+
+        return correct;
+    }
+
+    // Only the register-indirect jalr has an unknown target.
+    if ((r.insn & 0x7f) == 0b1100111)
+    {
+        bool correct = (btb[idx] == r.next_pc);
+        btb[idx] = r.next_pc;
+        return correct;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Schedules one instruction through the machine.
+ * 
+ * @param r The retired instruction.
+*/
+void ooo_timing::model(const insn_record &r)
+{
+    ++insns;
+
+    bool is_mem = (r.kind == insn_record::kind_load || r.kind == insn_record::kind_store);
+
+    // In-order front end: fetch_width instructions per cycle.
+    if (fetch_slots >= params.fetch_width)
+    {
+        ++front_cycle;
+        fetch_slots = 0;
+    }
+
+    uint64_t dispatch = front_cycle;
+    int reason = stall_frontend;
+
+    // A mispredicted transfer stops the front end until it resolves.
+    if (redirect_cycle > dispatch)
+    {
+        dispatch = redirect_cycle;
+        reason = stall_mispredict;
+    }
+
+    // Wait for the oldest reorder buffer entry to retire.
+    uint64_t &rob_entry = rob[insns % params.rob_size];
+    if (rob_entry + 1 > dispatch)
+    {
+        dispatch = rob_entry + 1;
+        reason = stall_rob;
+    }
+
+    // Loads and stores also need a load/store queue entry.
+    uint64_t *lsq_entry = nullptr;
+    if (is_mem)
+    {
+        lsq_entry = &lsq[mem_ops++ % params.lsq_size];
+        if (*lsq_entry + 1 > dispatch)
+        {
+            dispatch = *lsq_entry + 1;
+            reason = stall_lsq;
+        }
+    }
+
+    // A stalled dispatch holds up everything fetched behind it.
+    if (dispatch != front_cycle)
+    {
+        front_cycle = dispatch;
+        fetch_slots = 0;
+    }
+    ++fetch_slots;
+
+    // A taken transfer ends the fetch group.
+    if (r.next_pc != r.fall_through())
+        fetch_slots = params.fetch_width;
+
+    // Issue once the operands are ready.
+    uint64_t ready = std::max(reg_ready[r.rs1], reg_ready[r.rs2]);
+    ready = std::max(ready, reg_ready[r.rs3]);
+    uint32_t store_idx = (r.addr >> 2) % store_table_size;
+    if (r.kind == insn_record::kind_load)
+        ready = std::max(ready, store_ready[store_idx]);
+
+    uint64_t issue = dispatch + 1;
+    if (ready > issue)
+    {
+        issue = ready;
+        reason = stall_dependency;
+    }
+
+    // Find a cycle with a free issue slot.
+    for (;;)
+    {
+        issue_slot &slot = issue_ring[issue % issue_ring_size];
+        if (slot.cycle != issue)
+        {
+            slot.cycle = issue;
+            slot.used = 0;
+        }
+        if (slot.used < params.issue_width)
+        {
+            ++slot.used;
+            break;
+        }
+        ++issue;
+        reason = stall_issue;
+    }
+
+    uint32_t lat = latency(r.kind);
+    uint64_t complete = issue + lat;
+
+    if (r.rd != 0)
+        reg_ready[r.rd] = complete;
+    if (r.kind == insn_record::kind_store)
+        store_ready[store_idx] = complete;
+
+    // Resolve control transfers.
+    if (r.kind == insn_record::kind_branch || r.kind == insn_record::kind_jump)
+    {
+        if (!predict(r))
+        {
+            ++mispredicts;
+            redirect_cycle = complete + params.mispredict_penalty;
+        }
+    }
+
+    // Retire in order, issue_width per cycle.
+    uint64_t retire = std::max(complete, last_retire);
+    if (retire == last_retire && retired_in_cycle >= params.issue_width)
+        ++retire;
+    if (retire != last_retire)
+        retired_in_cycle = 0;
+    ++retired_in_cycle;
+
+    // Charge the cycles in which nothing retired. The part covered by
+    // the execution latency goes to latency, the rest to whatever held
+    // the instruction up before it issued.
+    if (retire > last_retire + 1)
+    {
+        uint64_t empty = retire - last_retire - 1;
+        uint64_t exec = std::min<uint64_t>(empty, lat - 1);
+        stalls[stall_latency] += exec;
+        stalls[reason] += empty - exec;
+    }
+
+    last_retire = retire;
+    rob_entry = retire;
+    if (lsq_entry)
+        *lsq_entry = retire;
+}
+
+/**
+ * @brief Prints the IPC and the stall breakdown.
+ * 
+ * @param os The stream to print to.
+*/
+void ooo_timing::report(std::ostream &os) const
+{
+    static const char *stall_names[num_stalls] =
+        { "frontend", "mispredict", "rob full", "lsq full", "dependency", "issue width", "latency" };
+
+    uint64_t total = 0;
+    for (int i = 0; i < num_stalls; ++i)
+        total += stalls[i];
+
+    os << "OoO timing model (fetch " << params.fetch_width << ", issue " << params.issue_width
+       << ", rob " << params.rob_size << ", lsq " << params.lsq_size << ")" << endl;
+    os << "  instructions   " << insns << endl;
+    os << "  cycles         " << last_retire << endl;
+    os << "  IPC            " << std::fixed << std::setprecision(3)
+       << (last_retire ? (double)insns / last_retire : 0.0) << endl;
+    os << "  mispredicts    " << mispredicts << endl;
+    os << "  stall cycles   " << total << endl;
+
+    for (int i = 0; i < num_stalls; ++i)
+    {
+        os << "    " << std::setw(12) << std::left << stall_names[i] << std::right
+           << std::setw(12) << stalls[i] << "  " << std::setw(5) << std::setprecision(1)
+           << (last_retire ? 100.0 * stalls[i] / last_retire : 0.0) << "%" << endl;
+    }
+
+    // Put the stream back the way we found it.
+    os << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,114 @@
+#ifndef OOO_TIMING_H
+#define OOO_TIMING_H
+
+#include "insn_trace.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief The parameters of the out-of-order timing model.
+*/
+struct ooo_params
+{
+    uint32_t fetch_width = 4;           ///< Instructions fetched per cycle.
+    uint32_t issue_width = 4;           ///< Instructions issued and retired per cycle.
+    uint32_t rob_size = 128;            ///< Reorder buffer entries.
+    uint32_t lsq_size = 32;             ///< Load/store queue entries.
+    uint32_t lat_alu = 1;               ///< Integer ALU latency.
+    uint32_t lat_mul = 3;               ///< Multiply latency.
+    uint32_t lat_div = 20;              ///< Divide latency.
+    uint32_t lat_load = 3;              ///< Load-to-use latency.
+    uint32_t lat_store = 1;             ///< Store address/data latency.
+    uint32_t lat_branch = 1;            ///< Branch resolution latency.
+    uint32_t lat_fp = 4;                ///< Floating-point latency.
+    uint32_t mispredict_penalty = 8;    ///< Front end refill after a mispredict.
+
+    bool parse(const std::string &spec);
+};
+
+/**
+ * @brief A superscalar out-of-order timing model.
+ * 
+ * The model is fed the retired instruction stream of a hart and
+ * schedules each instruction through an in-order front end, a reorder
+ * buffer, a load/store queue, out-of-order issue and in-order
+ * retirement. Cycles in which nothing retires are charged to the
+ * reason that held up the instruction at the head of the machine.
+*/
+class ooo_timing : public insn_sink
+{
+public:
+    ooo_timing(const ooo_params &p);
+
+    void consume(const insn_record *recs, size_t n) override;
+    void report(std::ostream &os) const override;
+
+    /**
+     * @brief Getter for the number of simulated cycles.
+     * 
+     * @return The cycle in which the last instruction retired.
+    */
+    uint64_t get_cycles() const { return last_retire; }
+
+private:
+    static constexpr int stall_frontend     = 0;
+    static constexpr int stall_mispredict   = 1;
+    static constexpr int stall_rob          = 2;
+    static constexpr int stall_lsq          = 3;
+    static constexpr int stall_dependency   = 4;
+    static constexpr int stall_issue        = 5;
+    static constexpr int stall_latency      = 6;
+    static constexpr int num_stalls         = 7;
+
+    static constexpr uint32_t issue_ring_size   = 4096;
+    static constexpr uint32_t store_table_size  = 1024;
+    static constexpr uint32_t predictor_size    = 4096;
+
+    void model(const insn_record &r);
+    uint32_t latency(uint8_t kind) const;
+    bool predict(const insn_record &r);
+
+    /**
+     * @brief How many instructions issued in a cycle.
+     * The ring is tagged with the cycle so it never needs clearing.
+    */
+    struct issue_slot
+    {
+        uint64_t cycle;
+        uint32_t used;
+    };
+
+    ooo_params params;
+
+    uint64_t insns = { 0 };
+    uint64_t mispredicts = { 0 };
+    uint64_t stalls[num_stalls] = { };
+
+    uint64_t front_cycle = { 1 };
+    uint32_t fetch_slots = { 0 };
+    uint64_t redirect_cycle = { 0 };
+
+    uint64_t reg_ready[insn_record::num_regs] = { };
+
+    std::vector<uint64_t> rob;
+    std::vector<uint64_t> lsq;
+    uint64_t mem_ops = { 0 };
+
+    std::vector<issue_slot> issue_ring;
+    std::vector<uint64_t> store_ready;
+    std::vector<uint8_t> bht;
+    std::vector<uint32_t> btb;
+
+    uint64_t last_retire = { 0 };
+    uint32_t retired_in_cycle = { 0 };
+};
+
+#endif
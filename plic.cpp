@@ -0,0 +1,308 @@
+#include "plic.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor for the PLIC.
+ * 
+ * @param harts The number of harts. Every source starts at priority 0,
+ *  which never interrupts, and disabled.
+*/
+plic::plic(uint32_t harts) : num_harts(harts), contexts(new context[harts])
+{
+    for (auto &p : priority)
+    {
+        p = 0;
+    }
+}
+
+/**
+ * @brief Connects a hart to its context.
+ * 
+ * @param hart The hart ID.
+ * @param wake Set to 0 when a change may have raised an interrupt of
+ *  the hart.
+*/
+void plic::attach_hart(uint32_t hart, std::atomic<uint64_t> *wake)
+{
+    contexts[hart].wake = wake;
+}
+
+/**
+ * @brief Byte reads do not reach the registers.
+ * 
+ * @return 0.
+*/
+uint8_t plic::read8(uint32_t)
+{
+    return 0;
+}
+
+/**
+ * @brief Byte writes do not reach the registers.
+*/
+void plic::write8(uint32_t, uint8_t)
+{
+}
+
+/**
+ * @brief Reads a PLIC register. Reading claim/complete claims the
+ * source it returns.
+ * 
+ * @param offset The offset from the PLIC's base.
+ * @param len The number of bytes, which must be 4.
+ * 
+ * @return The register, or 0 for an offset with no register.
+*/
+uint64_t plic::read(uint32_t offset, uint32_t len)
+{
+    if (len != 4 || offset % 4)
+    {
+        return mmio_device::read(offset, len);
+    }
+
+    if (offset < pending_offset)
+    {
+        return offset / 4 < num_sources ? priority[offset / 4].load() : 0;
+    }
+    if (offset == pending_offset)
+    {
+        return pending.load();
+    }
+    if (offset >= enable_offset && offset < context_offset)
+    {
+        uint32_t hart = (offset - enable_offset) / enable_stride;
+        return (hart < num_harts && offset % enable_stride == 0) ? contexts[hart].enable.load() : 0;
+    }
+    if (offset >= context_offset)
+    {
+        uint32_t hart = (offset - context_offset) / context_stride;
+        if (hart >= num_harts)
+        {
+            return 0;
+        }
+        switch (offset % context_stride)
+        {
+            case 0:
+                return contexts[hart].threshold.load();
+            case 4:
+                return claim(hart);
+            default:
+                return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a PLIC register. Writing a source to claim/complete
+ * completes it.
+ * 
+ * @param offset The offset from the PLIC's base.
+ * @param len The number of bytes, which must be 4.
+ * @param val The value.
+*/
+void plic::write(uint32_t offset, uint32_t len, uint64_t val)
+{
+    if (len != 4 || offset % 4)
+    {
+        mmio_device::write(offset, len, val);
+        return;
+    }
+
+    if (offset < pending_offset)
+    {
+        // Source 0 does not exist, so its priority stays 0.
+        if (offset / 4 < num_sources && offset != 0)
+        {
+            priority[offset / 4] = val & 7;
+        }
+    }
+    else if (offset >= enable_offset && offset < context_offset)
+    {
+        uint32_t hart = (offset - enable_offset) / enable_stride;
+        if (hart < num_harts && offset % enable_stride == 0)
+        {
+            contexts[hart].enable = val & ~1u;
+        }
+    }
+    else if (offset >= context_offset)
+    {
+        uint32_t hart = (offset - context_offset) / context_stride;
+        if (hart >= num_harts)
+        {
+            return;
+        }
+        switch (offset % context_stride)
+        {
+            case 0:
+                contexts[hart].threshold = val & 7;
+                break;
+            case 4:
+                complete(val);
+                break;
+            default:
+                return;
+        }
+    }
+    else
+    {
+        return;
+    }
+    wake_all();
+}
+
+/**
+ * @brief Sets the level a device drives on a source.
+ * 
+ * @param source The source, from 1 to num_sources - 1.
+ * @param high True while the device wants an interrupt.
+*/
+void plic::set_level(uint32_t source, bool high)
+{
+    uint32_t bit = 1u << source;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (high)
+        {
+            level |= bit;
+            if (!(claimed & bit))
+            {
+                pending |= bit;
+            }
+        }
+        else
+        {
+            level &= ~bit;
+            pending &= ~bit;
+        }
+    }
+    wake_all();
+}
+
+/**
+ * @brief Checks a hart's external interrupt.
+ * 
+ * @param hart The hart ID.
+ * 
+ * @return True if a source the hart enabled is pending above its
+ *  threshold.
+*/
+bool plic::get_meip(uint32_t hart) const
+{
+    return best(hart) != 0;
+}
+
+/**
+ * @brief Registers the priorities, the pending, claimed and level bits
+ * and every hart's enables and threshold, for checkpoints.
+ * 
+ * @param c The checkpoint registry.
+ * @param prefix The name the fields are grouped under.
+*/
+void plic::register_state(checkpoint &c, const std::string &prefix)
+{
+    for (uint32_t i = 0; i < num_sources; ++i)
+    {
+        c.add(prefix + ".priority" + std::to_string(i), &priority[i]);
+    }
+    c.add(prefix + ".level", &level);
+    c.add(prefix + ".pending", &pending);
+    c.add(prefix + ".claimed", &claimed);
+    for (uint32_t i = 0; i < num_harts; ++i)
+    {
+        c.add(prefix + ".enable" + std::to_string(i), &contexts[i].enable);
+        c.add(prefix + ".threshold" + std::to_string(i), &contexts[i].threshold);
+    }
+}
+
+/**
+ * @brief Finds the source a hart would claim.
+ * 
+ * @param hart The hart ID.
+ * 
+ * @return The pending, enabled source of highest priority above the
+ *  threshold, the lowest numbered of a tie, or 0 if there is none.
+*/
+uint32_t plic::best(uint32_t hart) const
+{
+    uint32_t cand = pending.load() & contexts[hart].enable.load();
+    uint32_t top = contexts[hart].threshold.load();
+    uint32_t found = 0;
+    for (; cand; cand &= cand - 1)
+    {
+        uint32_t s = __builtin_ctz(cand);
+        uint32_t p = priority[s].load();
+        if (p > top)
+        {
+            top = p;
+            found = s;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Claims the best source of a hart.
+ * 
+ * @param hart The hart ID.
+ * 
+ * @return The source, which stays out of pending until it is
+ *  completed, or 0 if there is none.
+*/
+uint32_t plic::claim(uint32_t hart)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    uint32_t s = best(hart);
+    if (s)
+    {
+        pending &= ~(1u << s);
+        claimed |= 1u << s;
+    }
+    return s;
+}
+
+/**
+ * @brief Completes a claimed source, which is pending again at once if
+ * its device still holds it high.
+ * 
+ * @param source The source.
+*/
+void plic::complete(uint32_t source)
+{
+    if (source == 0 || source >= num_sources)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    uint32_t bit = 1u << source;
+    claimed &= ~bit;
+    if (level & bit)
+    {
+        pending |= bit;
+    }
+}
+
+/**
+ * @brief Makes every hart look at its interrupts at its next block
+ * boundary.
+*/
+void plic::wake_all()
+{
+    for (uint32_t i = 0; i < num_harts; ++i)
+    {
+        if (contexts[i].wake)
+        {
+            contexts[i].wake->store(0, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef PLIC_H
+#define PLIC_H
+
+#include "checkpoint.h"
+#include <atomic>
+#include <mutex>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief The platform-level interrupt controller, which raises the
+ * machine external interrupt of each hart.
+ * 
+ * Devices drive a level on one of 31 sources. The registers sit at the
+ * SiFive offsets: a priority for each source at 0x0, the pending bits
+ * at 0x1000, and for each hart's M-mode context an enable word at
+ * 0x2000 + 0x80 * hart and a threshold and claim/complete register at
+ * 0x200000 + 0x1000 * hart. The registers are 32 bits and only word
+ * accesses reach them.
+ * 
+ * A source that is claimed is not pending again until the hart writes
+ * it back to claim/complete, and it is pending again then if its level
+ * is still high. Every change wakes the harts the same way a CLINT
+ * write does, so none of them polls the PLIC.
+*/
+class plic : public mmio_device
+{
+public:
+    plic(uint32_t harts);
+
+    uint8_t read8(uint32_t offset) override;
+    void write8(uint32_t offset, uint8_t val) override;
+    uint64_t read(uint32_t offset, uint32_t len) override;
+    void write(uint32_t offset, uint32_t len, uint64_t val) override;
+
+    void attach_hart(uint32_t hart, std::atomic<uint64_t> *wake);
+    void set_level(uint32_t source, bool high);
+    bool get_meip(uint32_t hart) const;
+
+    void register_state(checkpoint &c, const std::string &prefix);
+
+    static constexpr uint32_t base              = 0x0c000000;
+    static constexpr uint32_t size              = 0x4000000;
+    static constexpr uint32_t num_sources       = 32;   ///< Including source 0, which is never raised.
+
+private:
+    static constexpr uint32_t pending_offset    = 0x1000;
+    static constexpr uint32_t enable_offset     = 0x2000;
+    static constexpr uint32_t enable_stride     = 0x80;
+    static constexpr uint32_t context_offset    = 0x200000;
+    static constexpr uint32_t context_stride    = 0x1000;
+
+    /**
+     * @brief The M-mode context of one hart.
+    */
+    struct context
+    {
+        std::atomic<uint32_t> enable = { 0 };
+        std::atomic<uint32_t> threshold = { 0 };
+        std::atomic<uint64_t> *wake = { nullptr };  ///< When the hart next checks.
+    };
+
+    uint32_t best(uint32_t hart) const;
+    uint32_t claim(uint32_t hart);
+    void complete(uint32_t source);
+    void wake_all();
+
+    uint32_t num_harts;
+    std::unique_ptr<context[]> contexts;
+    std::atomic<uint32_t> priority[num_sources];
+    std::atomic<uint32_t> level = { 0 };
+    std::atomic<uint32_t> pending = { 0 };
+    std::atomic<uint32_t> claimed = { 0 };
+    std::mutex lock;
+};
+
+#endif
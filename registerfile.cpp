@@ -13,7 +13,8 @@
 /**
  * @brief Constructor for registerfile
 */
-registerfile::registerfile()
+template <typename T>
+registerfile<T>::registerfile()
 {
     // Resize the register vector to the number of registers
     // in a rv32i machine
@@ -26,7 +27,8 @@ registerfile::registerfile()
 /**
  * @brief Destructor for registerfile
 */
-registerfile::~registerfile()
+template <typename T>
+registerfile<T>::~registerfile()
 {
     // Clear the registers
     reg.clear();
@@ -40,7 +42,8 @@ registerfile::~registerfile()
  * @return The value at register r.
  * @note If the target register is 0, return 0.
 */
-int32_t registerfile::get(uint32_t r) const
+template <typename T>
+T registerfile<T>::get(uint32_t r) const
 {
     if (r != 0)
     {
@@ -60,7 +63,8 @@ int32_t registerfile::get(uint32_t r) const
  * 
  * @note If the target register is 0, do nothing.
 */
-void registerfile::set(uint32_t r, int32_t val)
+template <typename T>
+void registerfile<T>::set(uint32_t r, T val)
 {
     // Set the register at r to val
     if (r != 0)
@@ -72,46 +76,279 @@ void registerfile::set(uint32_t r, int32_t val)
 /**
  * @brief Resets the registers
 */
-void registerfile::reset()
+template <typename T>
+void registerfile<T>::reset()
 {
     // Set register 0 to 0x0
     set(0, 0x0);
 
-    // Set the other registers to 0xf0f0f0f0
+    // Set the other registers to 0xf0f0f0f0, in every byte of an
+    // RV64 register.
     for (uint32_t i = 1; i < num_regs; i++)
     {
-        set(i, 0xf0f0f0f0);
+        set(i, (T) 0xf0f0f0f0f0f0f0f0ull);
     }
 }
 
 /**
  * @brief Dump the contents of the registers.
 */
-void registerfile::dump(const std::string &hdr) const
+template <typename T>
+void registerfile<T>::dump(const std::string &hdr) const
 {
+    // 8 RV32 registers fit on a line, but only 4 RV64 ones.
+    uint32_t per_line = (sizeof(T) == 4) ? 8 : 4;
+
     // Cycle through the registers
     for (uint32_t i = 0; i < num_regs; i++)
     {
-        // If i%8 = 0, print the register number.
-        if ((i % 8) == 0)
+        // If i%per_line = 0, print the register number.
+        if ((i % per_line) == 0)
         {
             cout << std::setfill(' ');
             cout << hdr << std::setw(3) << std::right << "x" + std::to_string(i);
         }
 
         // Print the register value at i.
-        cout << " " << hex::to_hex32(reg.at(i));
+        if (sizeof(T) == 4)
+        {
+            cout << " " << hex::to_hex32(reg.at(i));
+        }
+        else
+        {
+            cout << " " << hex::to_hex64(reg.at(i));
+        }
 
         // If 4 registers have been printed, print an extra space.
-        if (((i+1) % 4) == 0 && ((i+1) % 8) != 0)
+        if (((i+1) % 4) == 0 && ((i+1) % per_line) != 0)
         {
             cout << " ";
         }
 
-        // If 8 registers have been printed, print a newline.
-        if (((i+1) % 8) == 0)
+        // If a line of registers has been printed, print a newline.
+        if (((i+1) % per_line) == 0)
         {
             cout << endl;
         }
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Registers the registers as one checkpoint field.
+ * 
+ * @param c The checkpoint registry.
+ * @param name The field's name.
+*/
+template <typename T>
+void registerfile<T>::register_state(checkpoint &c, const std::string &name)
+{
+    c.add(name, reg.data(), reg.size() * sizeof(T));
+}
+
+template class registerfile<int32_t>;
+template class registerfile<int64_t>;
+constexpr uint32_t fpregisterfile::canonical_nan_s;
+
+/**
+ * @brief Constructor for fpregisterfile
+*/
+fpregisterfile::fpregisterfile()
+{
+    // Resize the register vector to the number of registers
+    // in the F and D extensions
+    reg.resize(num_regs);
+
+    // Reset the registers
+    reset();
+}
+
+/**
+ * @brief Gets the single-precision value of a register
+ * 
+ * @param r The target register.
+ * 
+ * @return The low 32 bits of register r.
+ * @note If the value in r is not NaN-boxed, return the canonical NaN.
+*/
+uint32_t fpregisterfile::get_s(uint32_t r) const
+{
+    uint64_t val = reg.at(r);
+    if ((val >> 32) != 0xffffffff)
+    {
+        return canonical_nan_s;
+    }
+    return (uint32_t) val;
+}
+
+/**
+ * @brief Gets the double-precision value of a register
+ * 
+ * @param r The target register.
+ * 
+ * @return All 64 bits of register r.
+*/
+uint64_t fpregisterfile::get_d(uint32_t r) const
+{
+    return reg.at(r);
+}
+
+/**
+ * @brief Sets a register to a single-precision value
+ * 
+ * @param r The target register.
+ * @param val The value, which is NaN-boxed.
+*/
+void fpregisterfile::set_s(uint32_t r, uint32_t val)
+{
+    reg[r] = 0xffffffff00000000ull | val;
+}
+
+/**
+ * @brief Sets a register to a double-precision value
+ * 
+ * @param r The target register.
+ * @param val The value.
+*/
+void fpregisterfile::set_d(uint32_t r, uint64_t val)
+{
+    reg[r] = val;
+}
+
+/**
+ * @brief Resets the registers
+*/
+void fpregisterfile::reset()
+{
+    // Set the registers to 0xf0f0f0f0f0f0f0f0
+    for (uint32_t i = 0; i < num_regs; i++)
+    {
+        set_d(i, 0xf0f0f0f0f0f0f0f0ull);
+    }
+}
+
+/**
+ * @brief Registers the registers as one checkpoint field.
+ * 
+ * @param c The checkpoint registry.
+ * @param name The field's name.
+*/
+void fpregisterfile::register_state(checkpoint &c, const std::string &name)
+{
+    c.add(name, reg.data(), reg.size() * sizeof(uint64_t));
+}
+
+/**
+ * @brief Dump the contents of the registers.
+*/
+void fpregisterfile::dump(const std::string &hdr) const
+{
+    // Cycle through the registers
+    for (uint32_t i = 0; i < num_regs; i++)
+    {
+        // If i%4 = 0, print the register number.
+        if ((i % 4) == 0)
+        {
+            cout << std::setfill(' ');
+            cout << hdr << std::setw(3) << std::right << "f" + std::to_string(i);
+        }
+
+        // Print the register value at i, high word first.
+        cout << " " << hex::to_hex32(reg.at(i) >> 32) << hex::to_hex32(reg.at(i));
+
+        // If 4 registers have been printed, print a newline.
+        if (((i+1) % 4) == 0)
+        {
+            cout << endl;
+        }
+    }
+}
+
+/**
+ * @brief Constructor for the vector registers, with a VLEN of 128.
+*/
+vregisterfile::vregisterfile()
+{
+    set_vlen(128);
+}
+
+/**
+ * @brief Sets the width of the registers and resets them.
+ * 
+ * @param vlen The register width in bits, a power of two of at
+ *  least 64.
+*/
+void vregisterfile::set_vlen(uint32_t vlen)
+{
+    vlenb = vlen / 8;
+    reg.resize(num_regs * vlenb);
+    reset();
+}
+
+/**
+ * @brief Getter for the register width in bytes.
+ * 
+ * @return VLEN / 8.
+*/
+uint32_t vregisterfile::get_vlenb() const
+{
+    return vlenb;
+}
+
+/**
+ * @brief Gets the bytes of a register
+ * 
+ * @param r The target register.
+ * 
+ * @return The first byte of register r. The registers after it follow
+ *  on, so this is also the start of the register group at r.
+*/
+uint8_t *vregisterfile::get(uint32_t r)
+{
+    return &reg.at(r * vlenb);
+}
+
+const uint8_t *vregisterfile::get(uint32_t r) const
+{
+    return &reg.at(r * vlenb);
+}
+
+/**
+ * @brief Resets the registers
+*/
+void vregisterfile::reset()
+{
+    // Set every byte to 0xf0
+    std::fill(reg.begin(), reg.end(), 0xf0);
+}
+
+/**
+ * @brief Registers the registers as one checkpoint field, whose size
+ * follows VLEN.
+ * 
+ * @note set_vlen moves the registers, so it has to come first.
+ * 
+ * @param c The checkpoint registry.
+ * @param name The field's name.
+*/
+void vregisterfile::register_state(checkpoint &c, const std::string &name)
+{
+    c.add(name, reg.data(), reg.size());
+}
+
+/**
+ * @brief Dump the contents of the registers.
+*/
+void vregisterfile::dump(const std::string &hdr) const
+{
+    // Print one register per line, highest byte first.
+    for (uint32_t i = 0; i < num_regs; i++)
+    {
+        cout << std::setfill(' ');
+        cout << hdr << std::setw(3) << std::right << "v" + std::to_string(i) << " ";
+        for (uint32_t b = vlenb; b > 0; b--)
+        {
+            cout << hex::to_hex8(reg.at(i * vlenb + b - 1));
+        }
+        cout << endl;
+    }
+}
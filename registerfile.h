@@ -1,4 +1,8 @@
+#ifndef REGISTERFILE_H
+#define REGISTERFILE_H
+
 #include "rv32i_decode.h"
+#include "checkpoint.h"
 
 //***************************************************************************
 //
@@ -10,22 +14,94 @@
 //
 //***************************************************************************
 
+/**
+ * @brief The 32 integer registers.
+ * 
+ * @tparam T The signed register type, int32_t for RV32 and int64_t
+ *  for RV64.
+*/
+template <typename T>
 class registerfile : public hex
 {
     public:
         registerfile();
         ~registerfile();
 
-        int32_t get(uint32_t r) const;
+        T get(uint32_t r) const;
 
-        void set(uint32_t r, int32_t val);
+        void set(uint32_t r, T val);
 
         void reset();
         void dump(const std::string &hdr) const;
+        void register_state(checkpoint &c, const std::string &name);
+
+    protected:
+        static constexpr int num_regs = 32;
+
+    private:
+        std::vector <T> reg;
+};
+
+/**
+ * @brief The 32 floating-point registers of the F and D extensions.
+ * 
+ * Every register is 64 bits wide. A single-precision value is kept
+ * NaN-boxed, with the upper 32 bits all ones, and a register that does
+ * not hold a boxed value reads as the canonical NaN when it is used as
+ * a single-precision operand.
+*/
+class fpregisterfile : public hex
+{
+    public:
+        fpregisterfile();
+
+        uint32_t get_s(uint32_t r) const;
+        uint64_t get_d(uint32_t r) const;
+
+        void set_s(uint32_t r, uint32_t val);
+        void set_d(uint32_t r, uint64_t val);
+
+        void reset();
+        void dump(const std::string &hdr) const;
+        void register_state(checkpoint &c, const std::string &name);
+
+        static constexpr uint32_t canonical_nan_s = 0x7fc00000;
 
     protected:
         static constexpr int num_regs = 32;
 
     private:
-        std::vector <int32_t> reg;
-};
\ No newline at end of file
+        std::vector <uint64_t> reg;
+};
+
+/**
+ * @brief The 32 vector registers of the V extension.
+ * 
+ * The registers are VLEN bits wide and stored back to back, so a
+ * register group of LMUL registers is one run of bytes starting at
+ * its first register. The elements are kept in little-endian order.
+*/
+class vregisterfile : public hex
+{
+    public:
+        vregisterfile();
+
+        void set_vlen(uint32_t vlen);
+        uint32_t get_vlenb() const;
+
+        uint8_t *get(uint32_t r);
+        const uint8_t *get(uint32_t r) const;
+
+        void reset();
+        void dump(const std::string &hdr) const;
+        void register_state(checkpoint &c, const std::string &name);
+
+    protected:
+        static constexpr int num_regs = 32;
+
+    private:
+        uint32_t vlenb = { 16 };
+        std::vector <uint8_t> reg;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "replay.h"
+#include <cstring>
+#include <fstream>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+constexpr char replay_log::magic[8];
+
+/**
+ * @brief Takes the next entry, if it is the input a source wants now.
+ * 
+ * @param kind The kind of input.
+ * 
+ * @return The entry, or nullptr if the next one is of another kind or
+ *  time, or the log has run out.
+*/
+const replay_log::entry *replay_log::take(uint32_t kind)
+{
+    if (!is_replaying() || entries[cursor].kind != kind || entries[cursor].when != get_time())
+    {
+        return nullptr;
+    }
+    return &entries[cursor++];
+}
+
+/**
+ * @brief Appends an input taken from the host. Any entries past the
+ * cursor are of a run that went another way, and are dropped.
+ * 
+ * @param kind The kind of input.
+ * @param value The result.
+ * @param data What was read into the guest.
+*/
+void replay_log::add(uint32_t kind, uint64_t value, const std::string &data)
+{
+    entries.resize(cursor);
+    entries.push_back({ get_time(), kind, value, data });
+    cursor = entries.size();
+}
+
+/**
+ * @brief Notes that the run asked for an input the log does not have
+ * next, so it can no longer be replayed.
+ * 
+ * @param why What the run asked for.
+*/
+void replay_log::diverge(const std::string &why)
+{
+    if (divergence.empty())
+    {
+        divergence = "Replay diverged at " + std::to_string(get_time()) + " instructions: " + why;
+    }
+}
+
+/**
+ * @brief Writes the log to a file.
+ * 
+ * @param fname The file.
+ * 
+ * @return False, after printing why on std::cerr, if it can't be
+ *  written.
+*/
+bool replay_log::save(const std::string &fname) const
+{
+    std::ofstream os(fname, std::ios::binary | std::ios::trunc);
+    os.write(magic, sizeof(magic));
+    uint64_t n = entries.size();
+    os.write(reinterpret_cast<const char *>(&n), sizeof(n));
+    for (const entry &e : entries)
+    {
+        uint64_t len = e.data.size();
+        os.write(reinterpret_cast<const char *>(&e.when), sizeof(e.when));
+        os.write(reinterpret_cast<const char *>(&e.kind), sizeof(e.kind));
+        os.write(reinterpret_cast<const char *>(&e.value), sizeof(e.value));
+        os.write(reinterpret_cast<const char *>(&len), sizeof(len));
+        os.write(e.data.data(), len);
+    }
+    os.close();
+    if (!os)
+    {
+        cerr << "Can't write replay log " << fname << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a log from a file, with the cursor at its start.
+ * 
+ * @param fname The file.
+ * 
+ * @return False, after printing why on std::cerr, if it is not a log.
+*/
+bool replay_log::load(const std::string &fname)
+{
+    std::ifstream is(fname, std::ios::binary);
+    char m[sizeof(magic)];
+    uint64_t n = 0;
+    is.read(m, sizeof(m));
+    is.read(reinterpret_cast<char *>(&n), sizeof(n));
+    if (!is || memcmp(m, magic, sizeof(m)) != 0)
+    {
+        cerr << "Not a replay log: " << fname << endl;
+        return false;
+    }
+
+    entries.clear();
+    for (uint64_t i = 0; i < n && is; ++i)
+    {
+        entry e;
+        uint64_t len = 0;
+        is.read(reinterpret_cast<char *>(&e.when), sizeof(e.when));
+        is.read(reinterpret_cast<char *>(&e.kind), sizeof(e.kind));
+        is.read(reinterpret_cast<char *>(&e.value), sizeof(e.value));
+        is.read(reinterpret_cast<char *>(&len), sizeof(len));
+        if (!is || len > UINT32_MAX)
+        {
+            break;
+        }
+        e.data.resize(len);
+        is.read(&e.data[0], len);
+        entries.push_back(e);
+    }
+    if (!is)
+    {
+        cerr << "Replay log " << fname << " is cut short" << endl;
+        return false;
+    }
+    cursor = 0;
+    return true;
+}
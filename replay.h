@@ -0,0 +1,131 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "hex.h"
+#include <vector>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A log of everything a single-hart run takes from the host, so
+ * the run can be played again exactly.
+ * 
+ * With one hart, everything but the host is a function of the
+ * instruction count: mtime follows it and device events are keyed on
+ * it. What is left is the results of system calls, with the guest
+ * memory they fill in, the bytes the UART reads from stdin, and the
+ * environment the guest starts with. Each entry holds the instruction
+ * count it was taken at. Interrupts are logged too, though they follow
+ * from the rest, so a replay that goes a different way is caught where
+ * it first does.
+ * 
+ * The log has a cursor. Behind the end of the log, the sources take
+ * their input from it rather than from the host, and when the cursor
+ * reaches the end they go back to the host and append what they get.
+ * Recording is a log that starts out empty. Replaying is a log loaded
+ * from a file. Going back in time is seeking the cursor to where it was
+ * at a snapshot, so the run forward from there gets the same input.
+*/
+class replay_log
+{
+public:
+    /**
+     * @brief One input taken from the host.
+    */
+    struct entry
+    {
+        uint64_t when;                      ///< The instruction count.
+        uint32_t kind;
+        uint64_t value;                     ///< The result, or the cause of an interrupt.
+        std::string data;                   ///< What was read into the guest.
+    };
+
+    /**
+     * @brief Sets the time the entries are keyed on.
+     * 
+     * @param c The hart's instruction count, or nullptr for 0.
+    */
+    void set_clock(const uint64_t *c) { clock = c; }
+    /**
+     * @brief Checks if the sources take their input from the log.
+     * 
+     * @return True while the cursor is behind the end of the log.
+    */
+    bool is_replaying() const { return cursor < entries.size(); }
+    /**
+     * @brief Checks if the run is going over time it has already shown,
+     * so the guest's output is not printed again.
+     * 
+     * @return True before the frontier.
+    */
+    bool is_quiet() const { return get_time() < frontier; }
+
+    const entry *take(uint32_t kind);
+    void add(uint32_t kind, uint64_t value, const std::string &data);
+    void diverge(const std::string &why);
+
+    /**
+     * @brief Checks if the run has left the log.
+     * 
+     * @return True once an input did not match the log.
+    */
+    bool has_diverged() const { return !divergence.empty(); }
+    /**
+     * @brief Getter for divergence
+     * 
+     * @return Where and how the run left the log.
+    */
+    const std::string &get_divergence() const { return divergence; }
+    /**
+     * @brief Getter for cursor
+     * 
+     * @return The number of entries taken or added so far.
+    */
+    size_t get_cursor() const { return cursor; }
+    /**
+     * @brief Moves the cursor, to where it was at a snapshot.
+     * 
+     * @param c The cursor.
+    */
+    void seek(size_t c) { cursor = c; divergence.clear(); }
+    /**
+     * @brief Setter for frontier
+     * 
+     * @param f The latest instruction count the run has shown.
+    */
+    void set_frontier(uint64_t f) { frontier = f; }
+
+    bool save(const std::string &fname) const;
+    bool load(const std::string &fname);
+
+    static constexpr uint32_t kind_syscall  = 0;    ///< value is a0, data the call number and memory filled in.
+    static constexpr uint32_t kind_input    = 1;    ///< data is bytes from stdin, empty at end of file.
+    static constexpr uint32_t kind_irq      = 2;    ///< value is mcause or scause.
+    static constexpr uint32_t kind_env      = 3;    ///< data is the environment, each string ending in a 0.
+
+private:
+    /**
+     * @brief The current time.
+     * 
+     * @return The instruction count, or 0 before there is a hart.
+    */
+    uint64_t get_time() const { return clock ? *clock : 0; }
+
+    static constexpr char magic[8] = { 'R', 'V', 'R', 'E', 'P', 'L', '0', '1' };
+
+    std::vector<entry> entries;
+    size_t cursor = { 0 };
+    uint64_t frontier = { 0 };
+    const uint64_t *clock = { nullptr };
+    std::string divergence;
+};
+
+#endif
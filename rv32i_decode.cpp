@@ -15,13 +15,22 @@
  * 
  * @param addr The current address in the simulated memory.
  * @param insn The instruction at point addr.
+ * @param xlen 32 to decode RV32 instructions, 64 for RV64 ones.
  * 
  * @return A rendered instruction string.
  * @note If the instruction given is unrecognized, a message declaring
  * the instruction was unrecognized is printed.
+ * @note If the low two bits of insn are not 11, only its low half is
+ * used, as a compressed instruction.
 */
-std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
+std::string rv32i_decode::decode(uint32_t addr, uint32_t insn, uint32_t xlen)
 {
+    // A compressed instruction is shown as the instruction it stands for.
+    if (is_compressed(insn))
+    {
+        insn = expand_compressed(insn & 0xffff, xlen);
+    }
+
     // Switch defined by the opcode. This determines the type of instruction.
     switch (get_opcode(insn))
     {
@@ -85,6 +94,14 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
                     case funct3_lhu:
                         return render_itype_load(insn, "lhu");
                         break;
+                    case funct3_ld:
+                        if (xlen == 64)
+                            return render_itype_load(insn, "ld");
+                        return render_illegal_insn(insn);
+                    case funct3_lwu:
+                        if (xlen == 64)
+                            return render_itype_load(insn, "lwu");
+                        return render_illegal_insn(insn);
                     default:
                         // If none of the others, render the illegal_insn()
                         return render_illegal_insn(insn);
@@ -104,12 +121,25 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
                     case funct3_sw:
                         return render_stype(insn, "sw");
                         break;
+                    case funct3_sd:
+                        if (xlen == 64)
+                            return render_stype(insn, "sd");
+                        return render_illegal_insn(insn);
                     default:
                         // If none of the others, render the illegal_insn()
                         return render_illegal_insn(insn);
                 }
                 assert(0 && "unrecognized funct3"); // We should not get here
         case opcode_alu_imm:
+            {
+                // The bit-manipulation extensions share the opcode. They
+                // are only implemented for RV32.
+                int bm = (xlen == 32) ? get_bitmanip(insn) : bm_none;
+                if (bm != bm_none)
+                {
+                    return render_bitmanip(insn, bm);
+                }
+            }
             // A switch defined by funct3. This determines which alu
             // instruction the insn is.
             switch(get_funct3(insn))
@@ -133,18 +163,19 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
                         return render_itype_alu(insn, "andi", get_imm_i(insn));
                         break;
                     case funct3_sll:
-                        return render_itype_alu(insn, "slli", get_rs2(insn));
+                        return render_itype_alu(insn, "slli", get_imm_i(insn) & (xlen - 1));
                         break;
                     case funct3_srx:
                         // An inner switch defiend by funct7. This determines which
-                        // srx instruction the insn is.
-                        switch(get_funct7(insn))
+                        // srx instruction the insn is. On RV64 the low bit of
+                        // funct7 is the top bit of the 6-bit shift amount.
+                        switch(get_funct7(insn) & ~(xlen == 64 ? 1u : 0u))
                         {
                             case funct7_srl:
-                                return render_itype_alu(insn, "srli", get_rs2(insn));
+                                return render_itype_alu(insn, "srli", get_imm_i(insn) & (xlen - 1));
                                 break;
                             case funct7_sra:
-                                return render_itype_alu(insn, "srai", get_rs2(insn));
+                                return render_itype_alu(insn, "srai", get_imm_i(insn) & (xlen - 1));
                                 break;
                             default:
                                 return render_illegal_insn(insn);
@@ -156,6 +187,40 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
                 }
                 assert(0 && "unrecognized funct3"); // We should not get here
         case opcode_rtype:
+            {
+                // The bit-manipulation extensions share the opcode.
+                int bm = (xlen == 32) ? get_bitmanip(insn) : bm_none;
+                if (bm != bm_none)
+                {
+                    return render_bitmanip(insn, bm);
+                }
+            }
+            // The M extension shares the opcode, told apart by funct7.
+            if (get_funct7(insn) == funct7_muldiv)
+            {
+                // A switch defined by funct3. This determines which
+                // multiply or divide instruction the insn is.
+                switch(get_funct3(insn))
+                {
+                    case funct3_mul:
+                        return render_rtype(insn, "mul");
+                    case funct3_mulh:
+                        return render_rtype(insn, "mulh");
+                    case funct3_mulhsu:
+                        return render_rtype(insn, "mulhsu");
+                    case funct3_mulhu:
+                        return render_rtype(insn, "mulhu");
+                    case funct3_div:
+                        return render_rtype(insn, "div");
+                    case funct3_divu:
+                        return render_rtype(insn, "divu");
+                    case funct3_rem:
+                        return render_rtype(insn, "rem");
+                    case funct3_remu:
+                        return render_rtype(insn, "remu");
+                }
+                assert(0 && "unrecognized funct3"); // We should not get here
+            }
             // A switch defined by funct3. This determines which r-type
             // instruction the insn is.
             switch(get_funct3(insn))
@@ -214,6 +279,181 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
                         return render_illegal_insn(insn);
                 }
                 assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_alu_imm_32:
+            // The W instructions work on the low 32 bits of an RV64
+            // register and sign-extend the result.
+            if (xlen != 64)
+            {
+                return render_illegal_insn(insn);
+            }
+            switch(get_funct3(insn))
+            {
+                case funct3_add:
+                    return render_itype_alu(insn, "addiw", get_imm_i(insn));
+                case funct3_sll:
+                    if (get_funct7(insn) != 0)
+                    {
+                        return render_illegal_insn(insn);
+                    }
+                    return render_itype_alu(insn, "slliw", get_rs2(insn));
+                case funct3_srx:
+                    switch(get_funct7(insn))
+                    {
+                        case funct7_srl:
+                            return render_itype_alu(insn, "srliw", get_rs2(insn));
+                        case funct7_sra:
+                            return render_itype_alu(insn, "sraiw", get_rs2(insn));
+                        default:
+                            return render_illegal_insn(insn);
+                    }
+                    assert(0 && "unrecognized funct7"); // We should not get here
+                default:
+                    // If none of the others, render the illegal_insn()
+                    return render_illegal_insn(insn);
+            }
+            assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_rtype_32:
+            if (xlen != 64)
+            {
+                return render_illegal_insn(insn);
+            }
+            // A switch defined by funct7 and funct3. This determines
+            // which W instruction the insn is.
+            switch((get_funct7(insn) << 3) | get_funct3(insn))
+            {
+                case (funct7_add << 3) | funct3_add:
+                    return render_rtype(insn, "addw");
+                case (funct7_sub << 3) | funct3_add:
+                    return render_rtype(insn, "subw");
+                case (funct7_add << 3) | funct3_sll:
+                    return render_rtype(insn, "sllw");
+                case (funct7_srl << 3) | funct3_srx:
+                    return render_rtype(insn, "srlw");
+                case (funct7_sra << 3) | funct3_srx:
+                    return render_rtype(insn, "sraw");
+                case (funct7_muldiv << 3) | funct3_mul:
+                    return render_rtype(insn, "mulw");
+                case (funct7_muldiv << 3) | funct3_div:
+                    return render_rtype(insn, "divw");
+                case (funct7_muldiv << 3) | funct3_divu:
+                    return render_rtype(insn, "divuw");
+                case (funct7_muldiv << 3) | funct3_rem:
+                    return render_rtype(insn, "remw");
+                case (funct7_muldiv << 3) | funct3_remu:
+                    return render_rtype(insn, "remuw");
+                default:
+                    // If none of the others, render the illegal_insn()
+                    return render_illegal_insn(insn);
+            }
+            assert(0 && "unrecognized funct7"); // We should not get here
+        case opcode_amo:
+            // Only the word-sized atomics are implemented.
+            if (get_funct3(insn) != funct3_amo_w)
+            {
+                return render_illegal_insn(insn);
+            }
+            // A switch defined by funct5. This determines which atomic
+            // instruction the insn is.
+            switch(get_funct5(insn))
+            {
+                case funct5_lr:
+                    // lr.w has no rs2, and it must be x0.
+                    if (get_rs2(insn) != 0)
+                    {
+                        return render_illegal_insn(insn);
+                    }
+                    return render_amo(insn, "lr.w");
+                case funct5_sc:
+                    return render_amo(insn, "sc.w");
+                case funct5_amoswap:
+                    return render_amo(insn, "amoswap.w");
+                case funct5_amoadd:
+                    return render_amo(insn, "amoadd.w");
+                case funct5_amoxor:
+                    return render_amo(insn, "amoxor.w");
+                case funct5_amoand:
+                    return render_amo(insn, "amoand.w");
+                case funct5_amoor:
+                    return render_amo(insn, "amoor.w");
+                case funct5_amomin:
+                    return render_amo(insn, "amomin.w");
+                case funct5_amomax:
+                    return render_amo(insn, "amomax.w");
+                case funct5_amominu:
+                    return render_amo(insn, "amominu.w");
+                case funct5_amomaxu:
+                    return render_amo(insn, "amomaxu.w");
+                default:
+                    // If none of the others, render the illegal_insn()
+                    return render_illegal_insn(insn);
+            }
+            assert(0 && "unrecognized funct5"); // We should not get here
+        case opcode_load_fp:
+            // The vector loads have widths of their own.
+            if (get_vec_eew(insn))
+            {
+                return render_vec_mem(insn, false);
+            }
+
+            // A switch defined by funct3. This determines the precision
+            // of the load.
+            switch(get_funct3(insn))
+            {
+                case funct3_flw:
+                    return render_fp_load(insn, "flw");
+                case funct3_fld:
+                    return render_fp_load(insn, "fld");
+                default:
+                    // If none of the others, render the illegal_insn()
+                    return render_illegal_insn(insn);
+            }
+            assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_store_fp:
+            // The vector stores have widths of their own.
+            if (get_vec_eew(insn))
+            {
+                return render_vec_mem(insn, true);
+            }
+
+            // A switch defined by funct3. This determines the precision
+            // of the store.
+            switch(get_funct3(insn))
+            {
+                case funct3_fsw:
+                    return render_fp_store(insn, "fsw");
+                case funct3_fsd:
+                    return render_fp_store(insn, "fsd");
+                default:
+                    // If none of the others, render the illegal_insn()
+                    return render_illegal_insn(insn);
+            }
+            assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_op_fp:
+        case opcode_fmadd:
+        case opcode_fmsub:
+        case opcode_fnmsub:
+        case opcode_fnmadd:
+        {
+            int fp = get_fp_op(insn);
+            if (fp == fp_none)
+            {
+                return render_illegal_insn(insn);
+            }
+            return render_fp(insn, fp);
+        }
+        case opcode_op_v:
+        {
+            if (get_funct3(insn) == funct3_opcfg)
+            {
+                return render_vsetvl(insn);
+            }
+            int vec = get_vec_op(insn);
+            if (vec == vec_none)
+            {
+                return render_illegal_insn(insn);
+            }
+            return render_vec(insn, vec);
+        }
         case opcode_system:
             // A switch defined by funct3. This determines which system
             // instruction the insn is.
@@ -230,7 +470,19 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
                             case insn_ebreak:
                                 return render_ebreak(insn);
                                 break;
+                            case insn_mret:
+                                return render_mret(insn);
+                                break;
+                            case insn_sret:
+                                return render_sret(insn);
+                                break;
+                            case insn_wfi:
+                                return render_wfi(insn);
+                                break;
                             default:
+                                // sfence.vma names two registers.
+                                if ((insn & sfence_vma_mask) == insn_sfence_vma)
+                                    return render_sfence_vma(insn);
                                 // If none of the others, render the illegal_insn()
                                 return render_illegal_insn(insn);
                         }
@@ -530,189 +782,1520 @@ std::string rv32i_decode::render_ebreak(uint32_t insn)
 }
 
 /**
- * @brief Renders the csrrx instructions.
+ * @brief Renders the mret instruction.
  * 
  * @param insn The instruction.
- * @param mnemonic The mnemonic of the instruction.
  * 
- * @return A rendered csrrx instruction string.
+ * @return A rendered mret instruction string.
 */
-std::string rv32i_decode::render_csrrx(uint32_t insn, const char *mnemonic)
+
+std::string rv32i_decode::render_mret(uint32_t insn)
 {
-    // Get the needed parts.
-    uint32_t rd = get_rd(insn);
-    uint32_t csr = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
+    // Cast the insn as a void so that it does not need to get used.
+    (void) insn;
 
     // Build the ostringstream.
     std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << to_hex0x12(csr) << "," << render_reg(rs1);
+    os << "mret";
 
     // Return osstringstream as a string.
     return os.str();
 }
 
 /**
- * @brief Renders the csrrxi instructions.
+ * @brief Renders the sret instruction.
  * 
  * @param insn The instruction.
- * @param mnemonic The mnemonic of the instruction.
  * 
- * @return A rendered csrrxi instruction string.
+ * @return A rendered sret instruction string.
 */
-std::string rv32i_decode::render_csrrxi(uint32_t insn, const char *mnemonic)
+
+std::string rv32i_decode::render_sret(uint32_t insn)
 {
-    // Get the needed parts.
-    uint32_t rd = get_rd(insn);
-    int32_t csr = get_imm_i(insn);
-    uint32_t zimm = get_rs1(insn);
+    // Cast the insn as a void so that it does not need to get used.
+    (void) insn;
 
     // Build the ostringstream.
     std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << to_hex0x12(csr) << "," << zimm;
+    os << "sret";
 
     // Return osstringstream as a string.
     return os.str();
 }
 
 /**
- * @defgroup get_X Get instruction parts.
- * Return various parts of a given insn.
+ * @brief Renders the wfi instruction.
  * 
- * @param insn The instruction we are taking from.
- * @return The desired part of the insn.
- * @{
+ * @param insn The instruction.
+ * 
+ * @return A rendered wfi instruction string.
 */
 
-uint32_t rv32i_decode::get_opcode(uint32_t insn)    ///< Get the opcode from the insn.
+std::string rv32i_decode::render_wfi(uint32_t insn)
 {
-    return (insn & 0x0000007f);
-}
+    // Cast the insn as a void so that it does not need to get used.
+    (void) insn;
 
-uint32_t rv32i_decode::get_rd(uint32_t insn)        ///< Get the rd of the insn.
-{
-    return ((insn & 0x00000f80) >> 7);
-}
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << "wfi";
 
-uint32_t rv32i_decode::get_rs1(uint32_t insn)       ///< Get the rs1 of the insn.
-{
-    return ((insn & 0x000f8000) >> 15);
+    // Return osstringstream as a string.
+    return os.str();
 }
 
-uint32_t rv32i_decode::get_rs2(uint32_t insn)       ///< Get the rs2 of the insn.
-{
-    return ((insn & 0x01f00000) >> 20);
-}
+/**
+ * @brief Renders the sfence.vma instruction.
+ * 
+ * @param insn The instruction.
+ * 
+ * @return A rendered sfence.vma instruction string.
+*/
 
-uint32_t rv32i_decode::get_funct3(uint32_t insn)    ///< Get the funct3 of the insn.
+std::string rv32i_decode::render_sfence_vma(uint32_t insn)
 {
-    return ((insn & 0x00007000) >> 12);
+    // Get the needed parts.
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic("sfence.vma") << render_reg(rs1) << "," << render_reg(rs2);
+
+    // Return osstringstream as a string.
+    return os.str();
 }
 
-uint32_t rv32i_decode::get_funct7(uint32_t insn)    ///< Get the funct7 of the insn.
+/**
+ * @brief Gets the mnemonic and format of a bit-manipulation instruction.
+ * 
+ * @param op The bm_X value of the instruction.
+ * 
+ * @return The table entry for op.
+*/
+const rv32i_decode::bitmanip_info &rv32i_decode::get_bitmanip_info(int op)
 {
-    return ((insn & 0xfe000000) >> 25);
+    // In the order of the bm_X values.
+    static const bitmanip_info table[bm_count] =
+    {
+        { "sh1add", bm_fmt_r },     { "sh2add", bm_fmt_r },     { "sh3add", bm_fmt_r },
+        { "andn", bm_fmt_r },       { "orn", bm_fmt_r },        { "xnor", bm_fmt_r },
+        { "min", bm_fmt_r },        { "minu", bm_fmt_r },       { "max", bm_fmt_r },
+        { "maxu", bm_fmt_r },       { "rol", bm_fmt_r },        { "ror", bm_fmt_r },
+        { "bclr", bm_fmt_r },       { "bext", bm_fmt_r },       { "binv", bm_fmt_r },
+        { "bset", bm_fmt_r },       { "zext.h", bm_fmt_unary }, { "clz", bm_fmt_unary },
+        { "ctz", bm_fmt_unary },    { "cpop", bm_fmt_unary },   { "sext.b", bm_fmt_unary },
+        { "sext.h", bm_fmt_unary }, { "orc.b", bm_fmt_unary },  { "rev8", bm_fmt_unary },
+        { "rori", bm_fmt_imm },     { "bclri", bm_fmt_imm },    { "bexti", bm_fmt_imm },
+        { "binvi", bm_fmt_imm },    { "bseti", bm_fmt_imm },
+    };
+
+    return table[op];
 }
 
-/**@}*/
-
 /**
- * @defgroup get_imm_x Get imm
- * Get the imm of the current instruction type.
+ * @brief Finds which Zba/Zbb/Zbs instruction an insn is.
+ * 
+ * The bit-manipulation instructions share the r-type and i-type alu
+ * opcodes with the base instructions, told apart by funct7 and, for
+ * the unary ones, the rs2 field or the whole immediate.
  * 
  * @param insn The instruction.
- * @return The imm value.
- * @{
+ * 
+ * @return The bm_X value of the instruction, or bm_none if it is not
+ *  a bit-manipulation instruction.
 */
-
-int32_t rv32i_decode::get_imm_i(uint32_t insn)      ///< Get the imm of an i instruction.
+int rv32i_decode::get_bitmanip(uint32_t insn)
 {
-    return ((int32_t)(insn & 0xfff00000) >> 20);
-}
+    // Get the needed parts.
+    uint32_t funct3 = get_funct3(insn);
+    uint32_t funct7 = get_funct7(insn);
+    uint32_t rs2 = get_rs2(insn);
 
-int32_t rv32i_decode::get_imm_u(uint32_t insn)      ///< Get the imm of an u instruction.
-{
-    return ((insn & 0xfffff000));
-}
+    if (get_opcode(insn) == opcode_rtype)
+    {
+        switch (funct7)
+        {
+            case funct7_zba:
+                if (funct3 == funct3_sh1add)
+                    return bm_sh1add;
+                if (funct3 == funct3_sh2add)
+                    return bm_sh2add;
+                if (funct3 == funct3_sh3add)
+                    return bm_sh3add;
+                break;
+            case funct7_sub:
+                if (funct3 == funct3_and)
+                    return bm_andn;
+                if (funct3 == funct3_or)
+                    return bm_orn;
+                if (funct3 == funct3_xor)
+                    return bm_xnor;
+                break;
+            case funct7_minmax:
+                if (funct3 == funct3_min)
+                    return bm_min;
+                if (funct3 == funct3_minu)
+                    return bm_minu;
+                if (funct3 == funct3_max)
+                    return bm_max;
+                if (funct3 == funct3_maxu)
+                    return bm_maxu;
+                break;
+            case funct7_zexth:
+                if (funct3 == funct3_xor && rs2 == 0)
+                    return bm_zexth;
+                break;
+            case funct7_rot:
+                if (funct3 == funct3_sll)
+                    return bm_rol;
+                if (funct3 == funct3_srx)
+                    return bm_ror;
+                break;
+            case funct7_bclr:
+                if (funct3 == funct3_sll)
+                    return bm_bclr;
+                if (funct3 == funct3_srx)
+                    return bm_bext;
+                break;
+            case funct7_binv:
+                if (funct3 == funct3_sll)
+                    return bm_binv;
+                break;
+            case funct7_bset:
+                if (funct3 == funct3_sll)
+                    return bm_bset;
+                break;
+        }
+        return bm_none;
+    }
 
-int32_t rv32i_decode::get_imm_b(uint32_t insn)      ///< Get the imm of an b instruction.
-{
-    int32_t val = insn;
+    if (get_opcode(insn) == opcode_alu_imm)
+    {
+        uint32_t imm = get_imm_i(insn) & 0xfff;
 
-    val = (val) >> 31;  // Shift 31 for sign extension.
-    val <<= 12;         // Shift back 12 to make space for other sections.
-    
-    val = val | ((insn & 0x7e000000) >> 20);    // Shift and place b-g.
-    val = val | ((insn & 0x00000080) << 4);     // Shift and place y.
-    val = val | ((insn & 0x00000f00) >> 7);     // Shift and place u-x.
+        if (funct3 == funct3_sll)
+        {
+            switch (funct7)
+            {
+                case funct7_rot:
+                    // The unary instructions are picked by rs2.
+                    switch (rs2)
+                    {
+                        case 0:
+                            return bm_clz;
+                        case 1:
+                            return bm_ctz;
+                        case 2:
+                            return bm_cpop;
+                        case 4:
+                            return bm_sextb;
+                        case 5:
+                            return bm_sexth;
+                    }
+                    break;
+                case funct7_bclr:
+                    return bm_bclri;
+                case funct7_binv:
+                    return bm_binvi;
+                case funct7_bset:
+                    return bm_bseti;
+            }
+        }
+        else if (funct3 == funct3_srx)
+        {
+            if (imm == imm_orcb)
+                return bm_orcb;
+            if (imm == imm_rev8)
+                return bm_rev8;
+            if (funct7 == funct7_rot)
+                return bm_rori;
+            if (funct7 == funct7_bclr)
+                return bm_bexti;
+        }
+    }
 
-    return val;
+    return bm_none;
 }
 
-int32_t rv32i_decode::get_imm_s(uint32_t insn)      ///< Get the imm of an s instruction.
+/**
+ * @brief Renders a bit-manipulation instruction.
+ * 
+ * @param insn The instruction.
+ * @param op The bm_X value of the instruction.
+ * 
+ * @return A rendered bit-manipulation instruction string.
+*/
+std::string rv32i_decode::render_bitmanip(uint32_t insn, int op)
 {
-    return ((int32_t)(insn & 0xfe000000) >> 20) | get_rd(insn);
-}
+    const bitmanip_info &info = get_bitmanip_info(op);
 
-int32_t rv32i_decode::get_imm_j(uint32_t insn)      ///< Get the imm of an j instruction.
-{
-    int32_t val = insn;
+    switch (info.format)
+    {
+        case bm_fmt_r:
+            return render_rtype(insn, info.mnemonic);
+        case bm_fmt_imm:
+            return render_itype_alu(insn, info.mnemonic, get_rs2(insn));
+        default:
+            break;
+    }
 
-    val = (val) >> 31;  // Shift 31 for sign extension.
-    val <<= 19;         // Shift back 19 to make space for other sections.
-    
-    val = val | ((insn & 0x7fe00000) >> 20);    // Shift and place b-k.
-    val = val | ((insn & 0x00100000) >> 9);     // Shift and place l.
-    val = val | ((insn & 0x000ff000));          // Place m-t.
+    // The unary instructions only have rd and rs1.
+    std::ostringstream os;
+    os << render_mnemonic(info.mnemonic) << render_reg(get_rd(insn)) << "," << render_reg(get_rs1(insn));
 
-    return val;
+    // Return osstringstream as a string.
+    return os.str();
 }
 
-/**@}*/
-
 /**
- * @brief Renders the parameter as a register.
+ * @brief Renders the atomic instructions.
  * 
- * @param r The register.
+ * @param insn The instruction.
+ * @param mnemonic The mnemonic of the instruction.
  * 
- * @return A rendered register string.
+ * @return A rendered atomic instruction string. The aq and rl bits
+ *  are shown as a suffix on the mnemonic, and lr.w has no rs2.
 */
-
-std::string rv32i_decode::render_reg(int r)
+std::string rv32i_decode::render_amo(uint32_t insn, const char *mnemonic)
 {
+    // Get the needed parts.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    bool aq = (insn & 0x04000000) != 0;
+    bool rl = (insn & 0x02000000) != 0;
+
+    // Build the mnemonic.
+    std::string m(mnemonic);
+    if (aq)
+        m += ".aq";
+    if (rl)
+        m += aq ? "rl" : ".rl";
+
+    // Build the ostringstream.
     std::ostringstream os;
-    os << "x" << r;
+    os << render_mnemonic(m) << render_reg(rd) << ",";
+    if (get_funct5(insn) != funct5_lr)
+        os << render_reg(rs2) << ",";
+    os << "(" << render_reg(rs1) << ")";
+
+    // Return osstringstream as a string.
     return os.str();
 }
 
 /**
- * @brief Renders the parameters as disp(base)
+ * @brief Gets the mnemonic, format and rounding of a floating-point
+ * instruction.
  * 
- * @param base The base register.
- * @param disp The displacement.
+ * @param op The fp_X value of the instruction.
  * 
- * @return A rendered string in the form of disp(base).
+ * @return The table entry for op.
 */
-
-std::string rv32i_decode::render_base_disp(uint32_t base, int32_t disp)
+const rv32i_decode::fp_info &rv32i_decode::get_fp_info(int op)
 {
-    std::ostringstream os;
-    os << disp << "(" << render_reg(base) << ")";
-    return os.str();
+    // In the order of the fp_X values.
+    static const fp_info table[fp_count] =
+    {
+        { "fadd.%", fp_fmt_fff, true },         { "fsub.%", fp_fmt_fff, true },
+        { "fmul.%", fp_fmt_fff, true },         { "fdiv.%", fp_fmt_fff, true },
+        { "fsqrt.%", fp_fmt_ff, true },         { "fsgnj.%", fp_fmt_fff, false },
+        { "fsgnjn.%", fp_fmt_fff, false },      { "fsgnjx.%", fp_fmt_fff, false },
+        { "fmin.%", fp_fmt_fff, false },        { "fmax.%", fp_fmt_fff, false },
+        { "feq.%", fp_fmt_xff, false },         { "flt.%", fp_fmt_xff, false },
+        { "fle.%", fp_fmt_xff, false },         { "fclass.%", fp_fmt_xf, false },
+        { "fcvt.w.%", fp_fmt_xf, true },        { "fcvt.wu.%", fp_fmt_xf, true },
+        { "fcvt.%.w", fp_fmt_fx, true },        { "fcvt.%.wu", fp_fmt_fx, true },
+        { "fmv.x.w", fp_fmt_xf, false },        { "fmv.w.x", fp_fmt_fx, false },
+        { "fcvt.s.d", fp_fmt_ff, true },        { "fcvt.d.s", fp_fmt_ff, true },
+        { "fmadd.%", fp_fmt_ffff, true },       { "fmsub.%", fp_fmt_ffff, true },
+        { "fnmsub.%", fp_fmt_ffff, true },      { "fnmadd.%", fp_fmt_ffff, true },
+    };
+
+    return table[op];
 }
 
 /**
- * @brief Renders the mnemonic.
+ * @brief Finds which F or D computational instruction an insn is.
  * 
- * @param m The mnemonic to render.
+ * @param insn The instruction.
  * 
- * @return A rendered mnemonic string.
- * @note The mnemonic is padded with spaces for formatting.
+ * @return The fp_X value of the instruction, or fp_none if it is not
+ *  a legal floating-point instruction. A static rounding mode of 101
+ *  or 110 is reserved, so it makes the instruction illegal.
 */
-
-std::string rv32i_decode::render_mnemonic(const std::string &m)
+int rv32i_decode::get_fp_op(uint32_t insn)
 {
-    std::ostringstream os;
-    os << std::setfill(' ') << std::setw(mnemonic_width) << std::left << m;
+    // Get the needed parts.
+    uint32_t fmt = get_fmt(insn);
+    uint32_t funct3 = get_funct3(insn);
+    uint32_t rs2 = get_rs2(insn);
+    int op = fp_none;
+
+    // Only single and double precision exist.
+    if (fmt != fmt_s && fmt != fmt_d)
+    {
+        return fp_none;
+    }
+
+    switch (get_opcode(insn))
+    {
+        case opcode_fmadd:
+            op = fp_madd;
+            break;
+        case opcode_fmsub:
+            op = fp_msub;
+            break;
+        case opcode_fnmsub:
+            op = fp_nmsub;
+            break;
+        case opcode_fnmadd:
+            op = fp_nmadd;
+            break;
+        case opcode_op_fp:
+            switch (get_funct5(insn))
+            {
+                case funct5_fadd:
+                    op = fp_add;
+                    break;
+                case funct5_fsub:
+                    op = fp_sub;
+                    break;
+                case funct5_fmul:
+                    op = fp_mul;
+                    break;
+                case funct5_fdiv:
+                    op = fp_div;
+                    break;
+                case funct5_fsqrt:
+                    if (rs2 == 0)
+                        op = fp_sqrt;
+                    break;
+                case funct5_fsgnj:
+                    if (funct3 == funct3_fsgnj)
+                        op = fp_sgnj;
+                    else if (funct3 == funct3_fsgnjn)
+                        op = fp_sgnjn;
+                    else if (funct3 == funct3_fsgnjx)
+                        op = fp_sgnjx;
+                    break;
+                case funct5_fminmax:
+                    if (funct3 == funct3_fmin)
+                        op = fp_min;
+                    else if (funct3 == funct3_fmax)
+                        op = fp_max;
+                    break;
+                case funct5_fcvt_fmt:
+                    // The rs2 field holds the precision of the source.
+                    if (fmt == fmt_s && rs2 == fmt_d)
+                        op = fp_cvt_s_d;
+                    else if (fmt == fmt_d && rs2 == fmt_s)
+                        op = fp_cvt_d_s;
+                    break;
+                case funct5_fcmp:
+                    if (funct3 == funct3_feq)
+                        op = fp_eq;
+                    else if (funct3 == funct3_flt)
+                        op = fp_lt;
+                    else if (funct3 == funct3_fle)
+                        op = fp_le;
+                    break;
+                case funct5_fclass:
+                    if (rs2 != 0)
+                        break;
+                    if (funct3 == funct3_fclass)
+                        op = fp_class;
+                    else if (funct3 == funct3_fmv && fmt == fmt_s)
+                        op = fp_mv_x_w;
+                    break;
+                case funct5_fcvt_w:
+                    if (rs2 == 0)
+                        op = fp_cvt_w;
+                    else if (rs2 == 1)
+                        op = fp_cvt_wu;
+                    break;
+                case funct5_fcvt_from_w:
+                    if (rs2 == 0)
+                        op = fp_cvt_from_w;
+                    else if (rs2 == 1)
+                        op = fp_cvt_from_wu;
+                    break;
+                case funct5_fmv_w_x:
+                    if (rs2 == 0 && funct3 == funct3_fmv && fmt == fmt_s)
+                        op = fp_mv_w_x;
+                    break;
+            }
+            break;
+    }
+
+    if (op != fp_none && get_fp_info(op).rounds && funct3 > rm_rmm && funct3 != rm_dyn)
+    {
+        return fp_none;
+    }
+    return op;
+}
+
+/**
+ * @brief Gets the mnemonic of a floating-point instruction.
+ * 
+ * @param insn The instruction.
+ * @param op The fp_X value of the instruction.
+ * 
+ * @return The mnemonic, with the precision filled in from fmt.
+*/
+std::string rv32i_decode::get_fp_mnemonic(uint32_t insn, int op)
+{
+    std::string m(get_fp_info(op).mnemonic);
+    size_t p = m.find('%');
+    if (p != std::string::npos)
+    {
+        m[p] = (get_fmt(insn) == fmt_d) ? 'd' : 's';
+    }
+    return m;
+}
+
+/**
+ * @brief Renders the F and D computational instructions.
+ * 
+ * @param insn The instruction.
+ * @param op The fp_X value of the instruction.
+ * 
+ * @return A rendered floating-point instruction string. A static
+ *  rounding mode is shown after the operands.
+*/
+std::string rv32i_decode::render_fp(uint32_t insn, int op)
+{
+    static const char *rm_names[] = { "rne", "rtz", "rdn", "rup", "rmm" };
+
+    // Get the needed parts.
+    const fp_info &info = get_fp_info(op);
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    uint32_t rm = get_funct3(insn);
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic(get_fp_mnemonic(insn, op));
+    switch (info.format)
+    {
+        case fp_fmt_fff:
+            os << render_freg(rd) << "," << render_freg(rs1) << "," << render_freg(rs2);
+            break;
+        case fp_fmt_ff:
+            os << render_freg(rd) << "," << render_freg(rs1);
+            break;
+        case fp_fmt_ffff:
+            os << render_freg(rd) << "," << render_freg(rs1) << "," << render_freg(rs2)
+               << "," << render_freg(get_rs3(insn));
+            break;
+        case fp_fmt_xff:
+            os << render_reg(rd) << "," << render_freg(rs1) << "," << render_freg(rs2);
+            break;
+        case fp_fmt_xf:
+            os << render_reg(rd) << "," << render_freg(rs1);
+            break;
+        case fp_fmt_fx:
+            os << render_freg(rd) << "," << render_reg(rs1);
+            break;
+    }
+    if (info.rounds && rm != rm_dyn)
+    {
+        os << "," << rm_names[rm];
+    }
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @brief Renders the floating-point loads.
+ * 
+ * @param insn The instruction.
+ * @param mnemonic The mnemonic of the load.
+ * 
+ * @return A rendered load string.
+*/
+std::string rv32i_decode::render_fp_load(uint32_t insn, const char *mnemonic)
+{
+    // Get the needed parts.
+    uint32_t rd = get_rd(insn);
+    int32_t immi = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic(mnemonic) << render_freg(rd) << "," << render_base_disp(rs1, immi);
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @brief Renders the floating-point stores.
+ * 
+ * @param insn The instruction.
+ * @param mnemonic The mnemonic of the store.
+ * 
+ * @return A rendered store string.
+*/
+std::string rv32i_decode::render_fp_store(uint32_t insn, const char *mnemonic)
+{
+    // Get the needed parts.
+    uint32_t rs2 = get_rs2(insn);
+    int32_t imms = get_imm_s(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic(mnemonic) << render_freg(rs2) << "," << render_base_disp(rs1, imms);
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @brief Gets the mnemonic, forms and format of a vector instruction.
+ * 
+ * @param op The vec_X value of the instruction.
+ * 
+ * @return The table entry for op.
+*/
+const rv32i_decode::vec_info &rv32i_decode::get_vec_info(int op)
+{
+    static constexpr int vvxi = vec_form_vv | vec_form_vx | vec_form_vi;
+    static constexpr int vvx = vec_form_vv | vec_form_vx;
+    static constexpr int vxi = vec_form_vx | vec_form_vi;
+
+    // In the order of the vec_X values.
+    static const vec_info table[vec_count] =
+    {
+        { "vadd.v%", vvxi, vec_fmt_vvv },       { "vsub.v%", vvx, vec_fmt_vvv },
+        { "vrsub.v%", vxi, vec_fmt_vvv },       { "vminu.v%", vvx, vec_fmt_vvv },
+        { "vmin.v%", vvx, vec_fmt_vvv },        { "vmaxu.v%", vvx, vec_fmt_vvv },
+        { "vmax.v%", vvx, vec_fmt_vvv },        { "vand.v%", vvxi, vec_fmt_vvv },
+        { "vor.v%", vvxi, vec_fmt_vvv },        { "vxor.v%", vvxi, vec_fmt_vvv },
+        { "vmul.v%", vvx, vec_fmt_vvv },        { "vmerge.v%m", vvxi, vec_fmt_vvvm },
+        { "vmv.v.%", vvxi, vec_fmt_vv },        { "vmseq.v%", vvxi, vec_fmt_vvv },
+        { "vmsne.v%", vvxi, vec_fmt_vvv },      { "vmsltu.v%", vvx, vec_fmt_vvv },
+        { "vmslt.v%", vvx, vec_fmt_vvv },       { "vmsleu.v%", vvxi, vec_fmt_vvv },
+        { "vmsle.v%", vvxi, vec_fmt_vvv },      { "vmsgtu.v%", vxi, vec_fmt_vvv },
+        { "vmsgt.v%", vxi, vec_fmt_vvv },       { "vredsum.vs", vec_form_vv, vec_fmt_vvv },
+        { "vredand.vs", vec_form_vv, vec_fmt_vvv }, { "vredor.vs", vec_form_vv, vec_fmt_vvv },
+        { "vredxor.vs", vec_form_vv, vec_fmt_vvv }, { "vredminu.vs", vec_form_vv, vec_fmt_vvv },
+        { "vredmin.vs", vec_form_vv, vec_fmt_vvv }, { "vredmaxu.vs", vec_form_vv, vec_fmt_vvv },
+        { "vredmax.vs", vec_form_vv, vec_fmt_vvv }, { "vmv.x.s", vec_form_vv, vec_fmt_xv },
+        { "vmv.s.x", vec_form_vx, vec_fmt_vx },
+    };
+
+    return table[op];
+}
+
+/**
+ * @brief Finds which V integer instruction an OP-V insn is.
+ * 
+ * @param insn The instruction.
+ * 
+ * @return The vec_X value of the instruction, or vec_none if it is not
+ *  one of the supported vector instructions or its operand form does
+ *  not exist. The vset*vl* instructions are not handled here.
+*/
+int rv32i_decode::get_vec_op(uint32_t insn)
+{
+    // Get the needed parts.
+    uint32_t funct3 = get_funct3(insn);
+    uint32_t funct6 = get_funct6(insn);
+    bool vm = get_vm(insn);
+    int op = vec_none;
+    int form;
+
+    switch (funct3)
+    {
+        case funct3_opivv:
+        case funct3_opmvv:
+            form = vec_form_vv;
+            break;
+        case funct3_opivx:
+        case funct3_opmvx:
+            form = vec_form_vx;
+            break;
+        case funct3_opivi:
+            form = vec_form_vi;
+            break;
+        default:
+            return vec_none;
+    }
+
+    if (funct3 == funct3_opmvv || funct3 == funct3_opmvx)
+    {
+        // The OPM* instructions.
+        if (funct6 == funct6_vmul)
+        {
+            op = vec_mul;
+        }
+        else if (funct3 == funct3_opmvv && funct6 >= funct6_vredsum && funct6 <= funct6_vredmax)
+        {
+            op = vec_redsum + funct6;
+        }
+        else if (funct6 == funct6_vwxunary0 && vm)
+        {
+            // vmv.x.s has vs1 = 0 and vmv.s.x has vs2 = 0.
+            if (funct3 == funct3_opmvv && get_rs1(insn) == 0)
+                op = vec_mv_x_s;
+            else if (funct3 == funct3_opmvx && get_rs2(insn) == 0)
+                op = vec_mv_s_x;
+        }
+    }
+    else
+    {
+        // The OPI* instructions.
+        switch (funct6)
+        {
+            case funct6_vadd:   op = vec_add; break;
+            case funct6_vsub:   op = vec_sub; break;
+            case funct6_vrsub:  op = vec_rsub; break;
+            case funct6_vminu:  op = vec_minu; break;
+            case funct6_vmin:   op = vec_min; break;
+            case funct6_vmaxu:  op = vec_maxu; break;
+            case funct6_vmax:   op = vec_max; break;
+            case funct6_vand:   op = vec_and; break;
+            case funct6_vor:    op = vec_or; break;
+            case funct6_vxor:   op = vec_xor; break;
+            case funct6_vmseq:  op = vec_mseq; break;
+            case funct6_vmsne:  op = vec_msne; break;
+            case funct6_vmsltu: op = vec_msltu; break;
+            case funct6_vmslt:  op = vec_mslt; break;
+            case funct6_vmsleu: op = vec_msleu; break;
+            case funct6_vmsle:  op = vec_msle; break;
+            case funct6_vmsgtu: op = vec_msgtu; break;
+            case funct6_vmsgt:  op = vec_msgt; break;
+            case funct6_vmerge:
+                // Unmasked, it is vmv.v.*, which has vs2 = 0.
+                if (!vm)
+                    op = vec_merge;
+                else if (get_rs2(insn) == 0)
+                    op = vec_mv_v;
+                break;
+        }
+    }
+
+    if (op == vec_none || !(get_vec_info(op).forms & form))
+    {
+        return vec_none;
+    }
+    return op;
+}
+
+/**
+ * @brief Gets the mnemonic of a vector instruction.
+ * 
+ * @param insn The instruction.
+ * @param op The vec_X value of the instruction.
+ * 
+ * @return The mnemonic, with the operand form filled in from funct3.
+*/
+std::string rv32i_decode::get_vec_mnemonic(uint32_t insn, int op)
+{
+    std::string m(get_vec_info(op).mnemonic);
+    size_t p = m.find('%');
+    if (p != std::string::npos)
+    {
+        switch (get_funct3(insn))
+        {
+            case funct3_opivx:
+            case funct3_opmvx:
+                m[p] = 'x';
+                break;
+            case funct3_opivi:
+                m[p] = 'i';
+                break;
+            default:
+                m[p] = 'v';
+                break;
+        }
+    }
+    return m;
+}
+
+/**
+ * @brief Gets the element width of a vector load or store.
+ * 
+ * @param insn The instruction, with a LOAD-FP or STORE-FP opcode.
+ * 
+ * @return The element width in bits, or 0 if insn is not a unit-stride
+ *  or strided vector load or store.
+*/
+uint32_t rv32i_decode::get_vec_eew(uint32_t insn)
+{
+    uint32_t eew;
+    switch (get_funct3(insn))
+    {
+        case funct3_vle8:
+            eew = 8;
+            break;
+        case funct3_vle16:
+            eew = 16;
+            break;
+        case funct3_vle32:
+            eew = 32;
+            break;
+        case funct3_vle64:
+            eew = 64;
+            break;
+        default:
+            return 0;
+    }
+
+    // No segments and no mew, and a unit-stride access has no lumop.
+    if ((insn >> 28) != 0)
+    {
+        return 0;
+    }
+    if (get_mop(insn) == mop_strided || (get_mop(insn) == mop_unit && get_rs2(insn) == 0))
+    {
+        return eew;
+    }
+    return 0;
+}
+
+/**
+ * @brief Renders the V integer instructions.
+ * 
+ * @param insn The instruction.
+ * @param op The vec_X value of the instruction.
+ * 
+ * @return A rendered vector instruction string. A masked instruction
+ *  ends in v0.t.
+*/
+std::string rv32i_decode::render_vec(uint32_t insn, int op)
+{
+    // Get the needed parts.
+    const vec_info &info = get_vec_info(op);
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // The last operand depends on the form.
+    std::string src;
+    switch (get_funct3(insn))
+    {
+        case funct3_opivx:
+        case funct3_opmvx:
+            src = render_reg(rs1);
+            break;
+        case funct3_opivi:
+            src = std::to_string(get_simm5(insn));
+            break;
+        default:
+            src = render_vreg(rs1);
+            break;
+    }
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic(get_vec_mnemonic(insn, op));
+    switch (info.format)
+    {
+        case vec_fmt_vvv:
+            os << render_vreg(rd) << "," << render_vreg(rs2) << "," << src;
+            break;
+        case vec_fmt_vvvm:
+            os << render_vreg(rd) << "," << render_vreg(rs2) << "," << src << ",v0";
+            break;
+        case vec_fmt_vv:
+            os << render_vreg(rd) << "," << src;
+            break;
+        case vec_fmt_xv:
+            os << render_reg(rd) << "," << render_vreg(rs2);
+            break;
+        case vec_fmt_vx:
+            os << render_vreg(rd) << "," << render_reg(rs1);
+            break;
+    }
+    if (!get_vm(insn) && info.format != vec_fmt_vvvm)
+    {
+        os << ",v0.t";
+    }
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @brief Renders the vsetvli, vsetivli and vsetvl instructions.
+ * 
+ * @param insn The instruction.
+ * 
+ * @return A rendered instruction string.
+*/
+std::string rv32i_decode::render_vsetvl(uint32_t insn)
+{
+    // Get the needed parts.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    if ((insn >> 31) == 0)
+    {
+        os << render_mnemonic("vsetvli") << render_reg(rd) << "," << render_reg(rs1)
+           << "," << render_vtype((insn >> 20) & 0x7ff);
+    }
+    else if ((insn >> 30) == 0b11)
+    {
+        os << render_mnemonic("vsetivli") << render_reg(rd) << "," << rs1
+           << "," << render_vtype((insn >> 20) & 0x3ff);
+    }
+    else if (get_funct7(insn) == 0b1000000)
+    {
+        os << render_mnemonic("vsetvl") << render_reg(rd) << "," << render_reg(rs1)
+           << "," << render_reg(get_rs2(insn));
+    }
+    else
+    {
+        return render_illegal_insn(insn);
+    }
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @brief Renders the vector loads and stores.
+ * 
+ * @param insn The instruction.
+ * @param store True for a store, False for a load.
+ * 
+ * @return A rendered load or store string. A strided access ends in
+ *  the stride register.
+*/
+std::string rv32i_decode::render_vec_mem(uint32_t insn, bool store)
+{
+    // Get the needed parts.
+    uint32_t vd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    bool strided = (get_mop(insn) == mop_strided);
+
+    std::ostringstream m;
+    m << (store ? "vs" : "vl") << (strided ? "se" : "e") << get_vec_eew(insn) << ".v";
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic(m.str()) << render_vreg(vd) << ",(" << render_reg(rs1) << ")";
+    if (strided)
+    {
+        os << "," << render_reg(get_rs2(insn));
+    }
+    if (!get_vm(insn))
+    {
+        os << ",v0.t";
+    }
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @brief Renders a vtype value as its element width, group multiplier
+ * and tail and mask policies.
+ * 
+ * @param vtype The vtype value.
+ * 
+ * @return A string like e32,m1,ta,ma, or the plain number if the value
+ *  is reserved.
+*/
+std::string rv32i_decode::render_vtype(uint32_t vtype)
+{
+    static const char *lmul_names[] = { "m1", "m2", "m4", "m8", "", "mf8", "mf4", "mf2" };
+
+    uint32_t vsew = (vtype >> vtype_vsew_shift) & 0x7;
+    uint32_t vlmul = vtype & vtype_vlmul;
+
+    std::ostringstream os;
+    if ((vtype & ~vtype_legal) || vsew > 3 || vlmul == 4)
+    {
+        os << vtype;
+    }
+    else
+    {
+        os << "e" << (8 << vsew) << "," << lmul_names[vlmul]
+           << "," << ((vtype & vtype_vta) ? "ta" : "tu")
+           << "," << ((vtype & vtype_vma) ? "ma" : "mu");
+    }
+    return os.str();
+}
+
+/**
+ * @brief Renders the csrrx instructions.
+ * 
+ * @param insn The instruction.
+ * @param mnemonic The mnemonic of the instruction.
+ * 
+ * @return A rendered csrrx instruction string.
+*/
+std::string rv32i_decode::render_csrrx(uint32_t insn, const char *mnemonic)
+{
+    // Get the needed parts.
+    uint32_t rd = get_rd(insn);
+    uint32_t csr = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << to_hex0x12(csr) << "," << render_reg(rs1);
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @brief Renders the csrrxi instructions.
+ * 
+ * @param insn The instruction.
+ * @param mnemonic The mnemonic of the instruction.
+ * 
+ * @return A rendered csrrxi instruction string.
+*/
+std::string rv32i_decode::render_csrrxi(uint32_t insn, const char *mnemonic)
+{
+    // Get the needed parts.
+    uint32_t rd = get_rd(insn);
+    int32_t csr = get_imm_i(insn);
+    uint32_t zimm = get_rs1(insn);
+
+    // Build the ostringstream.
+    std::ostringstream os;
+    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << to_hex0x12(csr) << "," << zimm;
+
+    // Return osstringstream as a string.
+    return os.str();
+}
+
+/**
+ * @defgroup encode_x Encode instructions
+ * Build a 32-bit instruction from its fields. Immediates are given as
+ * values and scattered into the instruction bits of their format.
+ * @{
+*/
+uint32_t rv32i_decode::encode_rtype(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1, uint32_t rs2, uint32_t funct7)    ///< Encode an r-type insn.
+{
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+uint32_t rv32i_decode::encode_itype(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1, int32_t imm)     ///< Encode an i-type insn.
+{
+    return ((imm & 0xfff) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+uint32_t rv32i_decode::encode_stype(uint32_t opcode, uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)     ///< Encode an s-type insn.
+{
+    return (((imm >> 5) & 0x7f) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12)
+         | ((imm & 0x1f) << 7) | opcode;
+}
+
+uint32_t rv32i_decode::encode_btype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)     ///< Encode a b-type insn.
+{
+    return (((imm >> 12) & 0x1) << 31) | (((imm >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15)
+         | (funct3 << 12) | (((imm >> 1) & 0xf) << 8) | (((imm >> 11) & 0x1) << 7) | opcode_btype;
+}
+
+uint32_t rv32i_decode::encode_jal(uint32_t rd, int32_t imm)     ///< Encode a jal insn.
+{
+    return (((imm >> 20) & 0x1) << 31) | (((imm >> 1) & 0x3ff) << 21) | (((imm >> 11) & 0x1) << 20)
+         | (((imm >> 12) & 0xff) << 12) | (rd << 7) | opcode_jal;
+}
+/**@}*/
+
+/**
+ * @brief Gets a field of a compressed instruction.
+ * 
+ * @param c The compressed instruction.
+ * @param hi The highest bit of the field.
+ * @param lo The lowest bit of the field.
+ * 
+ * @return The field, shifted down to bit 0.
+*/
+uint32_t rv32i_decode::cbits(uint32_t c, int hi, int lo)
+{
+    return (c >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+/**
+ * @brief Expands a compressed instruction to the 32-bit instruction it
+ * stands for.
+ * 
+ * @param c The compressed instruction.
+ * @param xlen 32 for RV32C, 64 for RV64C. RV64C trades c.jal and the
+ *  single-precision loads and stores for c.addiw and the doubleword
+ *  loads and stores, and adds c.subw and c.addw.
+ * 
+ * @return The 32-bit instruction, or 0 if c is not a legal RV32C or
+ *  RV64C instruction, including the F and D loads and stores. 0 is itself an illegal instruction.
+ * 
+ * @note The immediates of the compressed formats are scrambled
+ *  differently for almost every instruction. Each case below gathers
+ *  the bits of its immediate in the order the spec lists them.
+*/
+uint32_t rv32i_decode::expand_compressed(uint16_t c, uint32_t xlen)
+{
+    // The full and the 3-bit (x8-x15) register fields.
+    uint32_t rd = cbits(c, 11, 7);
+    uint32_t rs2 = cbits(c, 6, 2);
+    uint32_t rdp = cbits(c, 4, 2) + 8;
+    uint32_t rs1p = cbits(c, 9, 7) + 8;
+
+    // The 6-bit signed immediate of the CI format.
+    int32_t imm6 = (cbits(c, 12, 12) << 5) | cbits(c, 6, 2);
+    imm6 = (imm6 << 26) >> 26;
+
+    switch ((cbits(c, 1, 0) << 3) | cbits(c, 15, 13))
+    {
+        case 0b00000:
+        {
+            // c.addi4spn
+            uint32_t imm = (cbits(c, 12, 11) << 4) | (cbits(c, 10, 7) << 6)
+                         | (cbits(c, 6, 6) << 2) | (cbits(c, 5, 5) << 3);
+            if (imm == 0)
+                return 0;
+            return encode_itype(opcode_alu_imm, rdp, funct3_add, 2, imm);
+        }
+        case 0b00010:
+        case 0b00110:
+        {
+            // c.lw, c.sw
+            uint32_t imm = (cbits(c, 12, 10) << 3) | (cbits(c, 6, 6) << 2) | (cbits(c, 5, 5) << 6);
+            if (cbits(c, 15, 13) == 0b010)
+                return encode_itype(opcode_load_imm, rdp, funct3_lw, rs1p, imm);
+            return encode_stype(opcode_stype, funct3_sw, rs1p, rdp, imm);
+        }
+        case 0b00011:
+        case 0b00111:
+        {
+            if (xlen == 64)
+            {
+                // c.ld, c.sd
+                uint32_t imm = (cbits(c, 12, 10) << 3) | (cbits(c, 6, 5) << 6);
+                if (cbits(c, 15, 13) == 0b011)
+                    return encode_itype(opcode_load_imm, rdp, funct3_ld, rs1p, imm);
+                return encode_stype(opcode_stype, funct3_sd, rs1p, rdp, imm);
+            }
+            // c.flw, c.fsw
+            uint32_t imm = (cbits(c, 12, 10) << 3) | (cbits(c, 6, 6) << 2) | (cbits(c, 5, 5) << 6);
+            if (cbits(c, 15, 13) == 0b011)
+                return encode_itype(opcode_load_fp, rdp, funct3_flw, rs1p, imm);
+            return encode_stype(opcode_store_fp, funct3_fsw, rs1p, rdp, imm);
+        }
+        case 0b00001:
+        case 0b00101:
+        {
+            // c.fld, c.fsd
+            uint32_t imm = (cbits(c, 12, 10) << 3) | (cbits(c, 6, 5) << 6);
+            if (cbits(c, 15, 13) == 0b001)
+                return encode_itype(opcode_load_fp, rdp, funct3_fld, rs1p, imm);
+            return encode_stype(opcode_store_fp, funct3_fsd, rs1p, rdp, imm);
+        }
+        case 0b01000:
+            // c.addi, c.nop
+            return encode_itype(opcode_alu_imm, rd, funct3_add, rd, imm6);
+        case 0b01001:
+            if (xlen == 64)
+            {
+                // c.addiw
+                if (rd == 0)
+                    return 0;
+                return encode_itype(opcode_alu_imm_32, rd, funct3_add, rd, imm6);
+            }
+            // On RV32 it is c.jal.
+            // Fall through.
+        case 0b01101:
+        {
+            // c.jal, c.j
+            int32_t imm = (cbits(c, 12, 12) << 11) | (cbits(c, 11, 11) << 4) | (cbits(c, 10, 9) << 8)
+                        | (cbits(c, 8, 8) << 10) | (cbits(c, 7, 7) << 6) | (cbits(c, 6, 6) << 7)
+                        | (cbits(c, 5, 3) << 1) | (cbits(c, 2, 2) << 5);
+            imm = (imm << 20) >> 20;
+            return encode_jal(cbits(c, 15, 13) == 0b001 ? 1 : 0, imm);
+        }
+        case 0b01010:
+            // c.li
+            return encode_itype(opcode_alu_imm, rd, funct3_add, 0, imm6);
+        case 0b01011:
+        {
+            if (rd == 2)
+            {
+                // c.addi16sp
+                int32_t imm = (cbits(c, 12, 12) << 9) | (cbits(c, 6, 6) << 4) | (cbits(c, 5, 5) << 6)
+                            | (cbits(c, 4, 3) << 7) | (cbits(c, 2, 2) << 5);
+                imm = (imm << 22) >> 22;
+                if (imm == 0)
+                    return 0;
+                return encode_itype(opcode_alu_imm, 2, funct3_add, 2, imm);
+            }
+            // c.lui
+            if (imm6 == 0)
+                return 0;
+            return ((imm6 & 0xfffff) << 12) | (rd << 7) | opcode_lui;
+        }
+        case 0b01100:
+        {
+            uint32_t shamt = (cbits(c, 12, 12) << 5) | cbits(c, 6, 2);
+            switch (cbits(c, 11, 10))
+            {
+                case 0b00:
+                    // c.srli, shamt[5] must be 0 on RV32.
+                    if (shamt >= xlen)
+                        return 0;
+                    return encode_itype(opcode_alu_imm, rs1p, funct3_srx, rs1p, shamt);
+                case 0b01:
+                    // c.srai
+                    if (shamt >= xlen)
+                        return 0;
+                    return encode_itype(opcode_alu_imm, rs1p, funct3_srx, rs1p, shamt | 0x400);
+                case 0b10:
+                    // c.andi
+                    return encode_itype(opcode_alu_imm, rs1p, funct3_and, rs1p, imm6);
+                default:
+                    break;
+            }
+            // The bit 12 set forms are RV64 only.
+            if (cbits(c, 12, 12))
+            {
+                if (xlen != 64)
+                    return 0;
+                switch (cbits(c, 6, 5))
+                {
+                    case 0b00:
+                        // c.subw
+                        return encode_rtype(opcode_rtype_32, rs1p, funct3_add, rs1p, rdp, funct7_sub);
+                    case 0b01:
+                        // c.addw
+                        return encode_rtype(opcode_rtype_32, rs1p, funct3_add, rs1p, rdp, 0);
+                    default:
+                        return 0;
+                }
+            }
+            switch (cbits(c, 6, 5))
+            {
+                case 0b00:
+                    // c.sub
+                    return encode_rtype(opcode_rtype, rs1p, funct3_add, rs1p, rdp, funct7_sub);
+                case 0b01:
+                    // c.xor
+                    return encode_rtype(opcode_rtype, rs1p, funct3_xor, rs1p, rdp, 0);
+                case 0b10:
+                    // c.or
+                    return encode_rtype(opcode_rtype, rs1p, funct3_or, rs1p, rdp, 0);
+                default:
+                    // c.and
+                    return encode_rtype(opcode_rtype, rs1p, funct3_and, rs1p, rdp, 0);
+            }
+        }
+        case 0b01110:
+        case 0b01111:
+        {
+            // c.beqz, c.bnez
+            int32_t imm = (cbits(c, 12, 12) << 8) | (cbits(c, 11, 10) << 3) | (cbits(c, 6, 5) << 6)
+                        | (cbits(c, 4, 3) << 1) | (cbits(c, 2, 2) << 5);
+            imm = (imm << 23) >> 23;
+            return encode_btype(cbits(c, 13, 13) ? funct3_bne : funct3_beq, rs1p, 0, imm);
+        }
+        case 0b10000:
+        {
+            // c.slli
+            uint32_t shamt = (cbits(c, 12, 12) << 5) | rs2;
+            if (shamt >= xlen)
+                return 0;
+            return encode_itype(opcode_alu_imm, rd, funct3_sll, rd, shamt);
+        }
+        case 0b10010:
+        {
+            // c.lwsp
+            uint32_t imm = (cbits(c, 12, 12) << 5) | (cbits(c, 6, 4) << 2) | (cbits(c, 3, 2) << 6);
+            if (rd == 0)
+                return 0;
+            return encode_itype(opcode_load_imm, rd, funct3_lw, 2, imm);
+        }
+        case 0b10011:
+        {
+            if (xlen == 64)
+            {
+                // c.ldsp
+                uint32_t imm = (cbits(c, 12, 12) << 5) | (cbits(c, 6, 5) << 3) | (cbits(c, 4, 2) << 6);
+                if (rd == 0)
+                    return 0;
+                return encode_itype(opcode_load_imm, rd, funct3_ld, 2, imm);
+            }
+            // c.flwsp, any register including f0
+            uint32_t imm = (cbits(c, 12, 12) << 5) | (cbits(c, 6, 4) << 2) | (cbits(c, 3, 2) << 6);
+            return encode_itype(opcode_load_fp, rd, funct3_flw, 2, imm);
+        }
+        case 0b10001:
+        {
+            // c.fldsp
+            uint32_t imm = (cbits(c, 12, 12) << 5) | (cbits(c, 6, 5) << 3) | (cbits(c, 4, 2) << 6);
+            return encode_itype(opcode_load_fp, rd, funct3_fld, 2, imm);
+        }
+        case 0b10100:
+            if (cbits(c, 12, 12) == 0)
+            {
+                if (rs2 == 0)
+                {
+                    // c.jr
+                    if (rd == 0)
+                        return 0;
+                    return encode_itype(opcode_jalr, 0, 0, rd, 0);
+                }
+                // c.mv
+                return encode_rtype(opcode_rtype, rd, funct3_add, 0, rs2, 0);
+            }
+            if (rs2 == 0)
+            {
+                // c.ebreak, c.jalr
+                if (rd == 0)
+                    return insn_ebreak;
+                return encode_itype(opcode_jalr, 1, 0, rd, 0);
+            }
+            // c.add
+            return encode_rtype(opcode_rtype, rd, funct3_add, rd, rs2, 0);
+        case 0b10110:
+        {
+            // c.swsp
+            uint32_t imm = (cbits(c, 12, 9) << 2) | (cbits(c, 8, 7) << 6);
+            return encode_stype(opcode_stype, funct3_sw, 2, rs2, imm);
+        }
+        case 0b10111:
+        {
+            if (xlen == 64)
+            {
+                // c.sdsp
+                uint32_t imm = (cbits(c, 12, 10) << 3) | (cbits(c, 9, 7) << 6);
+                return encode_stype(opcode_stype, funct3_sd, 2, rs2, imm);
+            }
+            // c.fswsp
+            uint32_t imm = (cbits(c, 12, 9) << 2) | (cbits(c, 8, 7) << 6);
+            return encode_stype(opcode_store_fp, funct3_fsw, 2, rs2, imm);
+        }
+        case 0b10101:
+        {
+            // c.fsdsp
+            uint32_t imm = (cbits(c, 12, 10) << 3) | (cbits(c, 9, 7) << 6);
+            return encode_stype(opcode_store_fp, funct3_fsd, 2, rs2, imm);
+        }
+        default:
+            // The reserved encodings.
+            return 0;
+    }
+}
+
+/**
+ * @defgroup get_X Get instruction parts.
+ * Return various parts of a given insn.
+ * 
+ * @param insn The instruction we are taking from.
+ * @return The desired part of the insn.
+ * @{
+*/
+
+uint32_t rv32i_decode::get_opcode(uint32_t insn)    ///< Get the opcode from the insn.
+{
+    return (insn & 0x0000007f);
+}
+
+uint32_t rv32i_decode::get_rd(uint32_t insn)        ///< Get the rd of the insn.
+{
+    return ((insn & 0x00000f80) >> 7);
+}
+
+uint32_t rv32i_decode::get_rs1(uint32_t insn)       ///< Get the rs1 of the insn.
+{
+    return ((insn & 0x000f8000) >> 15);
+}
+
+uint32_t rv32i_decode::get_rs2(uint32_t insn)       ///< Get the rs2 of the insn.
+{
+    return ((insn & 0x01f00000) >> 20);
+}
+
+uint32_t rv32i_decode::get_funct3(uint32_t insn)    ///< Get the funct3 of the insn.
+{
+    return ((insn & 0x00007000) >> 12);
+}
+
+uint32_t rv32i_decode::get_funct7(uint32_t insn)    ///< Get the funct7 of the insn.
+{
+    return ((insn & 0xfe000000) >> 25);
+}
+
+uint32_t rv32i_decode::get_funct5(uint32_t insn)    ///< Get the funct5 of an atomic or fp insn.
+{
+    return ((insn & 0xf8000000) >> 27);
+}
+
+uint32_t rv32i_decode::get_fmt(uint32_t insn)       ///< Get the precision of an fp insn.
+{
+    return ((insn & 0x06000000) >> 25);
+}
+
+uint32_t rv32i_decode::get_rs3(uint32_t insn)       ///< Get the rs3 of a fused multiply-add.
+{
+    return ((insn & 0xf8000000) >> 27);
+}
+
+uint32_t rv32i_decode::get_funct6(uint32_t insn)    ///< Get the funct6 of a vector insn.
+{
+    return ((insn & 0xfc000000) >> 26);
+}
+
+uint32_t rv32i_decode::get_vm(uint32_t insn)        ///< Get the vm bit of a vector insn, 0 if masked.
+{
+    return ((insn & 0x02000000) >> 25);
+}
+
+uint32_t rv32i_decode::get_mop(uint32_t insn)       ///< Get the addressing mode of a vector load or store.
+{
+    return ((insn & 0x0c000000) >> 26);
+}
+
+int32_t rv32i_decode::get_simm5(uint32_t insn)      ///< Get the simm5 of a vector insn.
+{
+    return ((int32_t)(insn << 12) >> 27);
+}
+
+/**@}*/
+
+/**
+ * @defgroup get_imm_x Get imm
+ * Get the imm of the current instruction type.
+ * 
+ * @param insn The instruction.
+ * @return The imm value.
+ * @{
+*/
+
+int32_t rv32i_decode::get_imm_i(uint32_t insn)      ///< Get the imm of an i instruction.
+{
+    return ((int32_t)(insn & 0xfff00000) >> 20);
+}
+
+int32_t rv32i_decode::get_imm_u(uint32_t insn)      ///< Get the imm of an u instruction.
+{
+    return ((insn & 0xfffff000));
+}
+
+int32_t rv32i_decode::get_imm_b(uint32_t insn)      ///< Get the imm of an b instruction.
+{
+    int32_t val = insn;
+
+    val = (val) >> 31;  // Shift 31 for sign extension.
+    val <<= 12;         // Shift back 12 to make space for other sections.
+    
+    val = val | ((insn & 0x7e000000) >> 20);    // Shift and place b-g.
+    val = val | ((insn & 0x00000080) << 4);     // Shift and place y.
+    val = val | ((insn & 0x00000f00) >> 7);     // Shift and place u-x.
+
+    return val;
+}
+
+int32_t rv32i_decode::get_imm_s(uint32_t insn)      ///< Get the imm of an s instruction.
+{
+    return ((int32_t)(insn & 0xfe000000) >> 20) | get_rd(insn);
+}
+
+int32_t rv32i_decode::get_imm_j(uint32_t insn)      ///< Get the imm of an j instruction.
+{
+    int32_t val = insn;
+
+    val = (val) >> 31;  // Shift 31 for sign extension.
+    val <<= 19;         // Shift back 19 to make space for other sections.
+    
+    val = val | ((insn & 0x7fe00000) >> 20);    // Shift and place b-k.
+    val = val | ((insn & 0x00100000) >> 9);     // Shift and place l.
+    val = val | ((insn & 0x000ff000));          // Place m-t.
+
+    return val;
+}
+
+/**@}*/
+
+/**
+ * @brief Renders the parameter as a register.
+ * 
+ * @param r The register.
+ * 
+ * @return A rendered register string.
+*/
+
+std::string rv32i_decode::render_reg(int r)
+{
+    std::ostringstream os;
+    os << "x" << r;
+    return os.str();
+}
+
+/**
+ * @brief Renders the parameter as a floating-point register.
+ * 
+ * @param r The register.
+ * 
+ * @return A rendered register string.
+*/
+
+std::string rv32i_decode::render_freg(int r)
+{
+    std::ostringstream os;
+    os << "f" << r;
+    return os.str();
+}
+
+/**
+ * @brief Renders the parameter as a vector register.
+ * 
+ * @param r The register.
+ * 
+ * @return A rendered register string.
+*/
+
+std::string rv32i_decode::render_vreg(int r)
+{
+    std::ostringstream os;
+    os << "v" << r;
+    return os.str();
+}
+
+/**
+ * @brief Renders the parameters as disp(base)
+ * 
+ * @param base The base register.
+ * @param disp The displacement.
+ * 
+ * @return A rendered string in the form of disp(base).
+*/
+
+std::string rv32i_decode::render_base_disp(uint32_t base, int32_t disp)
+{
+    std::ostringstream os;
+    os << disp << "(" << render_reg(base) << ")";
+    return os.str();
+}
+
+/**
+ * @brief Renders the mnemonic.
+ * 
+ * @param m The mnemonic to render.
+ * 
+ * @return A rendered mnemonic string.
+ * @note The mnemonic is padded with spaces for formatting.
+*/
+
+std::string rv32i_decode::render_mnemonic(const std::string &m)
+{
+    std::ostringstream os;
+    os << std::setfill(' ') << std::setw(mnemonic_width) << std::left << m;
+
+    // Keep a long mnemonic like amomaxu.w apart from its operands.
+    if (m.size() >= mnemonic_width)
+    {
+        os << ' ';
+    }
     return os.str();
 }
\ No newline at end of file
@@ -1,3 +1,6 @@
+#ifndef RV32I_DECODE_H
+#define RV32I_DECODE_H
+
 #include "memory.h"
 
 //***************************************************************************
@@ -15,7 +18,18 @@ class rv32i_decode : public hex
 public:
 
     ///@parm addr The memory address where the insn is stored.
-    static std::string decode(uint32_t addr, uint32_t insn);
+    ///@parm xlen 32 for RV32, 64 for RV64.
+    static std::string decode(uint32_t addr, uint32_t insn, uint32_t xlen = 32);
+
+    /**
+     * @brief Checks if an instruction is a 16-bit compressed one.
+     * 
+     * @param insn The instruction, or at least its low half.
+     * 
+     * @return True if the low two bits are not 11.
+    */
+    static bool is_compressed(uint32_t insn) { return (insn & 0x3) != 0x3; }
+    static uint32_t expand_compressed(uint16_t c, uint32_t xlen = 32);
 
 protected:
     static constexpr int mnemonic_width             = 8;
@@ -29,7 +43,18 @@ protected:
     static constexpr uint32_t opcode_stype          = 0b0100011;
     static constexpr uint32_t opcode_alu_imm        = 0b0010011;
     static constexpr uint32_t opcode_rtype          = 0b0110011;
+    static constexpr uint32_t opcode_alu_imm_32     = 0b0011011;
+    static constexpr uint32_t opcode_rtype_32       = 0b0111011;
     static constexpr uint32_t opcode_system         = 0b1110011;
+    static constexpr uint32_t opcode_amo            = 0b0101111;
+    static constexpr uint32_t opcode_load_fp        = 0b0000111;
+    static constexpr uint32_t opcode_store_fp       = 0b0100111;
+    static constexpr uint32_t opcode_op_fp          = 0b1010011;
+    static constexpr uint32_t opcode_fmadd          = 0b1000011;
+    static constexpr uint32_t opcode_fmsub          = 0b1000111;
+    static constexpr uint32_t opcode_fnmsub         = 0b1001011;
+    static constexpr uint32_t opcode_fnmadd         = 0b1001111;
+    static constexpr uint32_t opcode_op_v           = 0b1010111;
 
     static constexpr uint32_t funct3_beq            = 0b000;
     static constexpr uint32_t funct3_bne            = 0b001;
@@ -41,12 +66,15 @@ protected:
     static constexpr uint32_t funct3_lb             = 0b000;
     static constexpr uint32_t funct3_lh             = 0b001;
     static constexpr uint32_t funct3_lw             = 0b010;
+    static constexpr uint32_t funct3_ld             = 0b011;
     static constexpr uint32_t funct3_lbu            = 0b100;
     static constexpr uint32_t funct3_lhu            = 0b101;
+    static constexpr uint32_t funct3_lwu            = 0b110;
 
     static constexpr uint32_t funct3_sb             = 0b000;
     static constexpr uint32_t funct3_sh             = 0b001;
     static constexpr uint32_t funct3_sw             = 0b010;
+    static constexpr uint32_t funct3_sd             = 0b011;
 
     static constexpr uint32_t funct3_add            = 0b000;
     static constexpr uint32_t funct3_sll            = 0b001;
@@ -63,8 +91,311 @@ protected:
     static constexpr uint32_t funct7_add            = 0b0000000;
     static constexpr uint32_t funct7_sub            = 0b0100000;
 
+    static constexpr uint32_t funct7_muldiv         = 0b0000001;
+
+    static constexpr uint32_t funct3_mul            = 0b000;
+    static constexpr uint32_t funct3_mulh           = 0b001;
+    static constexpr uint32_t funct3_mulhsu         = 0b010;
+    static constexpr uint32_t funct3_mulhu          = 0b011;
+    static constexpr uint32_t funct3_div            = 0b100;
+    static constexpr uint32_t funct3_divu           = 0b101;
+    static constexpr uint32_t funct3_rem            = 0b110;
+    static constexpr uint32_t funct3_remu           = 0b111;
+
+    static constexpr uint32_t funct3_amo_w          = 0b010;
+
+    static constexpr uint32_t funct5_lr             = 0b00010;
+    static constexpr uint32_t funct5_sc             = 0b00011;
+    static constexpr uint32_t funct5_amoswap        = 0b00001;
+    static constexpr uint32_t funct5_amoadd         = 0b00000;
+    static constexpr uint32_t funct5_amoxor         = 0b00100;
+    static constexpr uint32_t funct5_amoand         = 0b01100;
+    static constexpr uint32_t funct5_amoor          = 0b01000;
+    static constexpr uint32_t funct5_amomin         = 0b10000;
+    static constexpr uint32_t funct5_amomax         = 0b10100;
+    static constexpr uint32_t funct5_amominu        = 0b11000;
+    static constexpr uint32_t funct5_amomaxu        = 0b11100;
+
+    static constexpr uint32_t funct7_zba            = 0b0010000;
+    static constexpr uint32_t funct7_minmax         = 0b0000101;
+    static constexpr uint32_t funct7_zexth          = 0b0000100;
+    static constexpr uint32_t funct7_rot            = 0b0110000;
+    static constexpr uint32_t funct7_bclr           = 0b0100100;
+    static constexpr uint32_t funct7_binv           = 0b0110100;
+    static constexpr uint32_t funct7_bset           = 0b0010100;
+
+    static constexpr uint32_t funct3_sh1add         = 0b010;
+    static constexpr uint32_t funct3_sh2add         = 0b100;
+    static constexpr uint32_t funct3_sh3add         = 0b110;
+    static constexpr uint32_t funct3_min            = 0b100;
+    static constexpr uint32_t funct3_minu           = 0b101;
+    static constexpr uint32_t funct3_max            = 0b110;
+    static constexpr uint32_t funct3_maxu           = 0b111;
+
+    static constexpr uint32_t imm_orcb              = 0x287;
+    static constexpr uint32_t imm_rev8              = 0x698;
+
+    // The Zba/Zbb/Zbs instructions.
+    static constexpr int bm_none    = -1;
+    static constexpr int bm_sh1add  = 0;
+    static constexpr int bm_sh2add  = 1;
+    static constexpr int bm_sh3add  = 2;
+    static constexpr int bm_andn    = 3;
+    static constexpr int bm_orn     = 4;
+    static constexpr int bm_xnor    = 5;
+    static constexpr int bm_min     = 6;
+    static constexpr int bm_minu    = 7;
+    static constexpr int bm_max     = 8;
+    static constexpr int bm_maxu    = 9;
+    static constexpr int bm_rol     = 10;
+    static constexpr int bm_ror     = 11;
+    static constexpr int bm_bclr    = 12;
+    static constexpr int bm_bext    = 13;
+    static constexpr int bm_binv    = 14;
+    static constexpr int bm_bset    = 15;
+    static constexpr int bm_zexth   = 16;
+    static constexpr int bm_clz     = 17;
+    static constexpr int bm_ctz     = 18;
+    static constexpr int bm_cpop    = 19;
+    static constexpr int bm_sextb   = 20;
+    static constexpr int bm_sexth   = 21;
+    static constexpr int bm_orcb    = 22;
+    static constexpr int bm_rev8    = 23;
+    static constexpr int bm_rori    = 24;
+    static constexpr int bm_bclri   = 25;
+    static constexpr int bm_bexti   = 26;
+    static constexpr int bm_binvi   = 27;
+    static constexpr int bm_bseti   = 28;
+    static constexpr int bm_count   = 29;
+
+    static constexpr int bm_fmt_r       = 0;    ///< rd, rs1, rs2
+    static constexpr int bm_fmt_unary   = 1;    ///< rd, rs1
+    static constexpr int bm_fmt_imm     = 2;    ///< rd, rs1, shamt
+
+    /**
+     * @brief The mnemonic and operand format of a bit-manipulation insn.
+    */
+    struct bitmanip_info
+    {
+        const char *mnemonic;
+        int format;
+    };
+
+    static int get_bitmanip(uint32_t insn);
+    static const bitmanip_info &get_bitmanip_info(int op);
+
+    static constexpr uint32_t funct3_flw            = 0b010;
+    static constexpr uint32_t funct3_fld            = 0b011;
+    static constexpr uint32_t funct3_fsw            = 0b010;
+    static constexpr uint32_t funct3_fsd            = 0b011;
+
+    static constexpr uint32_t fmt_s                 = 0b00;
+    static constexpr uint32_t fmt_d                 = 0b01;
+
+    static constexpr uint32_t funct5_fadd           = 0b00000;
+    static constexpr uint32_t funct5_fsub           = 0b00001;
+    static constexpr uint32_t funct5_fmul           = 0b00010;
+    static constexpr uint32_t funct5_fdiv           = 0b00011;
+    static constexpr uint32_t funct5_fsqrt          = 0b01011;
+    static constexpr uint32_t funct5_fsgnj          = 0b00100;
+    static constexpr uint32_t funct5_fminmax        = 0b00101;
+    static constexpr uint32_t funct5_fcvt_fmt       = 0b01000;
+    static constexpr uint32_t funct5_fcmp           = 0b10100;
+    static constexpr uint32_t funct5_fclass         = 0b11100;
+    static constexpr uint32_t funct5_fcvt_w         = 0b11000;
+    static constexpr uint32_t funct5_fcvt_from_w    = 0b11010;
+    static constexpr uint32_t funct5_fmv_w_x        = 0b11110;
+
+    static constexpr uint32_t funct3_fsgnj          = 0b000;
+    static constexpr uint32_t funct3_fsgnjn         = 0b001;
+    static constexpr uint32_t funct3_fsgnjx         = 0b010;
+    static constexpr uint32_t funct3_fmin           = 0b000;
+    static constexpr uint32_t funct3_fmax           = 0b001;
+    static constexpr uint32_t funct3_fle            = 0b000;
+    static constexpr uint32_t funct3_flt            = 0b001;
+    static constexpr uint32_t funct3_feq            = 0b010;
+    static constexpr uint32_t funct3_fmv            = 0b000;
+    static constexpr uint32_t funct3_fclass         = 0b001;
+
+    // The rounding modes of the rm field and the frm CSR.
+    static constexpr uint32_t rm_rne                = 0b000;
+    static constexpr uint32_t rm_rtz                = 0b001;
+    static constexpr uint32_t rm_rdn                = 0b010;
+    static constexpr uint32_t rm_rup                = 0b011;
+    static constexpr uint32_t rm_rmm                = 0b100;
+    static constexpr uint32_t rm_dyn                = 0b111;
+
+    // The F and D computational instructions. Each one covers both
+    // precisions, told apart by the fmt field.
+    static constexpr int fp_none        = -1;
+    static constexpr int fp_add         = 0;
+    static constexpr int fp_sub         = 1;
+    static constexpr int fp_mul         = 2;
+    static constexpr int fp_div         = 3;
+    static constexpr int fp_sqrt        = 4;
+    static constexpr int fp_sgnj        = 5;
+    static constexpr int fp_sgnjn       = 6;
+    static constexpr int fp_sgnjx       = 7;
+    static constexpr int fp_min         = 8;
+    static constexpr int fp_max         = 9;
+    static constexpr int fp_eq          = 10;
+    static constexpr int fp_lt          = 11;
+    static constexpr int fp_le          = 12;
+    static constexpr int fp_class       = 13;
+    static constexpr int fp_cvt_w       = 14;
+    static constexpr int fp_cvt_wu      = 15;
+    static constexpr int fp_cvt_from_w  = 16;
+    static constexpr int fp_cvt_from_wu = 17;
+    static constexpr int fp_mv_x_w      = 18;
+    static constexpr int fp_mv_w_x      = 19;
+    static constexpr int fp_cvt_s_d     = 20;
+    static constexpr int fp_cvt_d_s     = 21;
+    static constexpr int fp_madd        = 22;
+    static constexpr int fp_msub        = 23;
+    static constexpr int fp_nmsub       = 24;
+    static constexpr int fp_nmadd       = 25;
+    static constexpr int fp_count       = 26;
+
+    static constexpr int fp_fmt_fff     = 0;    ///< fd, fs1, fs2
+    static constexpr int fp_fmt_ff      = 1;    ///< fd, fs1
+    static constexpr int fp_fmt_ffff    = 2;    ///< fd, fs1, fs2, fs3
+    static constexpr int fp_fmt_xff     = 3;    ///< rd, fs1, fs2
+    static constexpr int fp_fmt_xf      = 4;    ///< rd, fs1
+    static constexpr int fp_fmt_fx      = 5;    ///< fd, rs1
+
+    /**
+     * @brief The mnemonic, operand format and use of the rounding mode
+     * of a floating-point insn. A % in the mnemonic stands for the
+     * precision, s or d.
+    */
+    struct fp_info
+    {
+        const char *mnemonic;
+        int format;
+        bool rounds;
+    };
+
+    static int get_fp_op(uint32_t insn);
+    static const fp_info &get_fp_info(int op);
+    static std::string get_fp_mnemonic(uint32_t insn, int op);
+
+    // The vector loads and stores share the floating-point opcodes and
+    // are told apart by the width field. Only nf = 0 and mew = 0 exist.
+    static constexpr uint32_t funct3_vle8           = 0b000;
+    static constexpr uint32_t funct3_vle16          = 0b101;
+    static constexpr uint32_t funct3_vle32          = 0b110;
+    static constexpr uint32_t funct3_vle64          = 0b111;
+    static constexpr uint32_t mop_unit              = 0b00;
+    static constexpr uint32_t mop_strided           = 0b10;
+
+    // The operand kinds of the OP-V major opcode.
+    static constexpr uint32_t funct3_opivv          = 0b000;
+    static constexpr uint32_t funct3_opmvv          = 0b010;
+    static constexpr uint32_t funct3_opivi          = 0b011;
+    static constexpr uint32_t funct3_opivx          = 0b100;
+    static constexpr uint32_t funct3_opmvx          = 0b110;
+    static constexpr uint32_t funct3_opcfg          = 0b111;
+
+    static constexpr uint32_t funct6_vadd           = 0b000000;
+    static constexpr uint32_t funct6_vsub           = 0b000010;
+    static constexpr uint32_t funct6_vrsub          = 0b000011;
+    static constexpr uint32_t funct6_vminu          = 0b000100;
+    static constexpr uint32_t funct6_vmin           = 0b000101;
+    static constexpr uint32_t funct6_vmaxu          = 0b000110;
+    static constexpr uint32_t funct6_vmax           = 0b000111;
+    static constexpr uint32_t funct6_vand           = 0b001001;
+    static constexpr uint32_t funct6_vor            = 0b001010;
+    static constexpr uint32_t funct6_vxor           = 0b001011;
+    static constexpr uint32_t funct6_vmerge         = 0b010111;
+    static constexpr uint32_t funct6_vmseq          = 0b011000;
+    static constexpr uint32_t funct6_vmsne          = 0b011001;
+    static constexpr uint32_t funct6_vmsltu         = 0b011010;
+    static constexpr uint32_t funct6_vmslt          = 0b011011;
+    static constexpr uint32_t funct6_vmsleu         = 0b011100;
+    static constexpr uint32_t funct6_vmsle          = 0b011101;
+    static constexpr uint32_t funct6_vmsgtu         = 0b011110;
+    static constexpr uint32_t funct6_vmsgt          = 0b011111;
+    static constexpr uint32_t funct6_vredsum        = 0b000000;
+    static constexpr uint32_t funct6_vredmax        = 0b000111;
+    static constexpr uint32_t funct6_vwxunary0      = 0b010000;
+    static constexpr uint32_t funct6_vmul           = 0b100101;
+
+    // The vtype fields.
+    static constexpr uint32_t vtype_vlmul           = 0x07;
+    static constexpr uint32_t vtype_vsew_shift      = 3;
+    static constexpr uint32_t vtype_vta             = 0x40;
+    static constexpr uint32_t vtype_vma             = 0x80;
+    static constexpr uint32_t vtype_legal           = 0xff;
+
+    // The V integer instructions of OP-V, other than the vset*vl*.
+    static constexpr int vec_none       = -1;
+    static constexpr int vec_add        = 0;
+    static constexpr int vec_sub        = 1;
+    static constexpr int vec_rsub       = 2;
+    static constexpr int vec_minu       = 3;
+    static constexpr int vec_min        = 4;
+    static constexpr int vec_maxu       = 5;
+    static constexpr int vec_max        = 6;
+    static constexpr int vec_and        = 7;
+    static constexpr int vec_or         = 8;
+    static constexpr int vec_xor        = 9;
+    static constexpr int vec_mul        = 10;
+    static constexpr int vec_merge      = 11;
+    static constexpr int vec_mv_v       = 12;
+    static constexpr int vec_mseq       = 13;
+    static constexpr int vec_msne       = 14;
+    static constexpr int vec_msltu      = 15;
+    static constexpr int vec_mslt       = 16;
+    static constexpr int vec_msleu      = 17;
+    static constexpr int vec_msle       = 18;
+    static constexpr int vec_msgtu      = 19;
+    static constexpr int vec_msgt       = 20;
+    static constexpr int vec_redsum     = 21;
+    static constexpr int vec_redand     = 22;
+    static constexpr int vec_redor      = 23;
+    static constexpr int vec_redxor     = 24;
+    static constexpr int vec_redminu    = 25;
+    static constexpr int vec_redmin     = 26;
+    static constexpr int vec_redmaxu    = 27;
+    static constexpr int vec_redmax     = 28;
+    static constexpr int vec_mv_x_s     = 29;
+    static constexpr int vec_mv_s_x     = 30;
+    static constexpr int vec_count      = 31;
+
+    static constexpr int vec_form_vv    = 1;    ///< vs1 operand
+    static constexpr int vec_form_vx    = 2;    ///< rs1 operand
+    static constexpr int vec_form_vi    = 4;    ///< simm5 operand
+
+    static constexpr int vec_fmt_vvv    = 0;    ///< vd, vs2, vs1/rs1/imm
+    static constexpr int vec_fmt_vvvm   = 1;    ///< vd, vs2, vs1/rs1/imm, v0
+    static constexpr int vec_fmt_vv     = 2;    ///< vd, vs1/rs1/imm
+    static constexpr int vec_fmt_xv     = 3;    ///< rd, vs2
+    static constexpr int vec_fmt_vx     = 4;    ///< vd, rs1
+
+    /**
+     * @brief The mnemonic, legal operand forms and operand format of a
+     * vector insn. A % in the mnemonic stands for the operand form, v,
+     * x or i.
+    */
+    struct vec_info
+    {
+        const char *mnemonic;
+        int forms;
+        int format;
+    };
+
+    static int get_vec_op(uint32_t insn);
+    static const vec_info &get_vec_info(int op);
+    static std::string get_vec_mnemonic(uint32_t insn, int op);
+    static uint32_t get_vec_eew(uint32_t insn);
+
     static constexpr uint32_t insn_ecall            = 0x00000073;
     static constexpr uint32_t insn_ebreak           = 0x00100073;
+    static constexpr uint32_t insn_mret             = 0x30200073;
+    static constexpr uint32_t insn_sret             = 0x10200073;
+    static constexpr uint32_t insn_wfi              = 0x10500073;
+    static constexpr uint32_t insn_sfence_vma       = 0x12000073;  ///< With rs1 and rs2 zero.
+    static constexpr uint32_t sfence_vma_mask       = 0xfe007fff;  ///< All but rs1 and rs2.
 
     static constexpr uint32_t funct3_csrrw          = 0b001;
     static constexpr uint32_t funct3_csrrs          = 0b010;
@@ -79,13 +410,25 @@ protected:
     static uint32_t get_rs1(uint32_t insn);
     static uint32_t get_rs2(uint32_t insn);
     static uint32_t get_funct7(uint32_t insn);
+    static uint32_t get_funct5(uint32_t insn);
+    static uint32_t get_fmt(uint32_t insn);
+    static uint32_t get_rs3(uint32_t insn);
+    static uint32_t get_funct6(uint32_t insn);
+    static uint32_t get_vm(uint32_t insn);
+    static uint32_t get_mop(uint32_t insn);
+    static int32_t get_simm5(uint32_t insn);
     static int32_t get_imm_i(uint32_t insn);
     static int32_t get_imm_u(uint32_t insn);
     static int32_t get_imm_b(uint32_t insn);
     static int32_t get_imm_s(uint32_t insn);
     static int32_t get_imm_j(uint32_t insn);
 
-    static constexpr uint32_t XLEN = 32;
+    static uint32_t encode_rtype(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1, uint32_t rs2, uint32_t funct7);
+    static uint32_t encode_itype(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1, int32_t imm);
+    static uint32_t encode_stype(uint32_t opcode, uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm);
+    static uint32_t encode_btype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm);
+    static uint32_t encode_jal(uint32_t rd, int32_t imm);
+    static uint32_t cbits(uint32_t c, int hi, int lo);
 
     static std::string render_illegal_insn(uint32_t insn);
     static std::string render_lui(uint32_t insn);
@@ -105,10 +448,27 @@ protected:
     static std::string render_rtype(uint32_t insn, const char *mnemonic);
     static std::string render_ecall(uint32_t insn);
     static std::string render_ebreak(uint32_t insn);
+    static std::string render_mret(uint32_t insn);
+    static std::string render_sret(uint32_t insn);
+    static std::string render_wfi(uint32_t insn);
+    static std::string render_sfence_vma(uint32_t insn);
+    static std::string render_amo(uint32_t insn, const char *mnemonic);
+    static std::string render_bitmanip(uint32_t insn, int op);
+    static std::string render_fp(uint32_t insn, int op);
+    static std::string render_fp_load(uint32_t insn, const char *mnemonic);
+    static std::string render_fp_store(uint32_t insn, const char *mnemonic);
+    static std::string render_vec(uint32_t insn, int op);
+    static std::string render_vsetvl(uint32_t insn);
+    static std::string render_vec_mem(uint32_t insn, bool store);
+    static std::string render_vtype(uint32_t vtype);
     static std::string render_csrrx(uint32_t insn, const char *mnemonic);
     static std::string render_csrrxi(uint32_t insn, const char *mnemonic);
 
     static std::string render_reg(int r);
+    static std::string render_freg(int r);
+    static std::string render_vreg(int r);
     static std::string render_base_disp(uint32_t base, int32_t disp);
     static std::string render_mnemonic(const std::string &m);
 };
+
+#endif
@@ -14,7 +14,8 @@
  * @brief Resets the hart.
 */
 
-void rv32i_hart::reset()
+template <uint32_t XLEN>
+void rv_hart<XLEN>::reset()
 {
     // Set program counter to 0.
     pc = 0;
@@ -30,6 +31,73 @@ void rv32i_hart::reset()
 
     // Set halt_reason to "none".
     halt_reason = "none";
+
+    // Drop any reservation.
+    reservation_valid = false;
+
+    // Reset the floating-point registers and fcsr.
+    fregs.reset();
+    frm = 0;
+    fflags = 0;
+    fp_used = false;
+
+    // Reset the vector registers and CSRs, with vtype illegal until the
+    // first vset*vl*.
+    vregs.reset();
+    vl = 0;
+    vtype = vtype_vill;
+    vstart = 0;
+    vxrm = 0;
+    vxsat = 0;
+    vec_used = false;
+
+    // Reset the trap CSRs, with no handler and interrupts disabled.
+    mstatus = mstatus_mpp;
+    mie = 0;
+    mtvec = 0;
+    mepc = 0;
+    mcause = 0;
+    mtval = 0;
+    irq_check_at = UINT64_MAX;
+    traps = 0;
+    interrupts = 0;
+    idle = idle_none;
+    idle_step = 0;
+    wfi_cycles = 0;
+    idle_skips = 0;
+    idle_skipped = 0;
+    medeleg = 0;
+    mideleg = 0;
+    mip_sw = 0;
+    stvec = 0;
+    sscratch = 0;
+    sepc = 0;
+    scause = 0;
+    stval = 0;
+
+    // Start in M-mode with translation and PMP off.
+    priv = prv_m;
+    satp = 0;
+    for (uint32_t i = 0; i < pmp_entries; ++i)
+    {
+        pmpcfg[i] = 0;
+        pmpaddr[i] = 0;
+    }
+    update_pmp();
+    update_vm();
+    flush_tlb();
+    tlb_misses = 0;
+    page_faults = 0;
+    pmp_misses = 0;
+
+    // Reset the CSRs, with every counter starting from 0.
+    mscratch = 0;
+    mcountinhibit = 0;
+    for (uint32_t i = 0; i < 32; ++i)
+    {
+        hpm_event[i] = 0;
+        counter_delta[i] = 0;
+    }
 }
 
 /**
@@ -39,13 +107,286 @@ void rv32i_hart::reset()
  * 
 */
 
-void rv32i_hart::dump(const std::string &hdr) const
+template <uint32_t XLEN>
+void rv_hart<XLEN>::dump(const std::string &hdr) const
 {
     // Dump the regs with hdr.
     regs.dump(hdr);
 
-    // Print the program counter.
-    cout << " pc " << to_hex32(pc) << endl;
+    // The floating-point registers only once the program uses them.
+    if (fp_used)
+    {
+        fregs.dump(hdr);
+    }
+
+    // The vector registers likewise.
+    if (vec_used)
+    {
+        vregs.dump(hdr);
+    }
+
+    // Print the program counter, and fcsr with the f registers.
+    cout << " pc " << ((XLEN == 32) ? to_hex32(pc) : to_hex64(pc));
+    if (fp_used)
+    {
+        cout << " fcsr " << to_hex32((frm << 5) | fflags);
+    }
+    if (vec_used)
+    {
+        cout << " vl " << vl << " vtype " << to_hex0xlen(vtype);
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Sets VLEN, the width of the vector registers.
+ * 
+ * @param vlen The width in bits, a power of two from 64 up.
+ * 
+ * @note This resets the vector registers.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::set_vlen(uint32_t vlen)
+{
+    vregs.set_vlen(vlen);
+
+    // Room for a splatted scalar and a result, each of 8 registers.
+    vec_tmp.assign(2 * 8 * vregs.get_vlenb(), 0);
+}
+
+/**
+ * @brief Connects the hart to the CLINT that raises its timer and
+ * software interrupts.
+ * 
+ * @param c The CLINT.
+ * 
+ * @note The hart ID must be set first.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::set_clint(clint *c)
+{
+    timer = c;
+    timer->attach_hart(mhartid, &insn_counter, &irq_check_at);
+}
+
+/**
+ * @brief Connects the hart to the PLIC that raises its external
+ * interrupt.
+ * 
+ * @param p The PLIC.
+ * 
+ * @note The hart ID must be set first.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::set_plic(plic *p)
+{
+    irqc = p;
+    irqc->attach_hart(mhartid, &irq_check_at);
+}
+
+/**
+ * @brief Checks if a trap goes to S-mode.
+ * 
+ * @param cause The trap's cause, with the top bit set for an interrupt.
+ * 
+ * @return True if the trap is delegated by medeleg or mideleg and the
+ *  hart is not in M-mode, which never traps to a lower mode.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::delegated(reg_t cause) const
+{
+    reg_t code = cause & ~cause_interrupt;
+    reg_t deleg = (cause & cause_interrupt) ? mideleg : medeleg;
+    return priv <= prv_s && code < XLEN && ((deleg >> code) & 1);
+}
+
+/**
+ * @brief Gets the handler a trap goes to.
+ * 
+ * @param cause The trap's cause.
+ * 
+ * @return stvec or mtvec, whichever takes the trap. 0 means there is
+ *  no handler.
+*/
+
+template <uint32_t XLEN>
+typename rv_hart<XLEN>::reg_t rv_hart<XLEN>::trap_vector(reg_t cause) const
+{
+    return delegated(cause) ? stvec : mtvec;
+}
+
+/**
+ * @brief Takes a trap to the handler at mtvec, or at stvec if it is
+ * delegated to S-mode.
+ * 
+ * @param cause The value for mcause or scause, with the top bit set
+ * for an interrupt.
+ * @param tval The value for mtval or stval.
+ * @param reason Why the hart halts, if there is no handler.
+ * 
+ * @note Until the guest sets the trap vector there is no handler, and
+ * a trap halts the hart as it always did.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::trap(reg_t cause, reg_t tval, const std::string &reason)
+{
+    // A replay has to take each interrupt where the run it replays did.
+    if ((cause & cause_interrupt) && log)
+    {
+        if (!log->is_replaying())
+        {
+            log->add(replay_log::kind_irq, cause, "");
+        }
+        else
+        {
+            const replay_log::entry *e = log->take(replay_log::kind_irq);
+            if (!e || e->value != cause)
+            {
+                log->diverge("interrupt " + to_hex0xlen(cause) + " is not the next input in the log");
+                halt = true;
+                halt_reason = log->get_divergence();
+                return;
+            }
+        }
+    }
+
+    bool to_s = delegated(cause);
+    reg_t tvec = to_s ? stvec : mtvec;
+    if (tvec == 0)
+    {
+        halt = true;
+        halt_reason = reason;
+        return;
+    }
+
+    if (!(cause & cause_interrupt))
+    {
+        ++traps;
+    }
+
+    // A trap ends any wait, and breaks the loop being watched.
+    idle = idle_none;
+    idle_pure = false;
+
+    if (to_s)
+    {
+        sepc = pc;
+        scause = cause;
+        stval = tval;
+
+        // Save and clear the interrupt enable, and the mode.
+        mstatus = ((mstatus & mstatus_sie) ? (mstatus | mstatus_spie) : (mstatus & ~mstatus_spie)) & ~mstatus_sie;
+        mstatus = (priv == prv_s) ? (mstatus | mstatus_spp) : (mstatus & ~mstatus_spp);
+        priv = prv_s;
+    }
+    else
+    {
+        mepc = pc;
+        mcause = cause;
+        mtval = tval;
+
+        // Save and clear the interrupt enable, and the mode.
+        mstatus = ((mstatus & mstatus_mie) ? (mstatus | mstatus_mpie) : (mstatus & ~mstatus_mpie)) & ~mstatus_mie;
+        mstatus = (mstatus & ~mstatus_mpp) | ((reg_t) priv << 11);
+        priv = prv_m;
+    }
+    update_vm();
+
+    // In vectored mode an interrupt goes to its own entry.
+    reg_t base = tvec & ~(reg_t) 3;
+    if ((tvec & 1) && (cause & cause_interrupt))
+    {
+        pc = base + 4 * (cause & ~cause_interrupt);
+    }
+    else
+    {
+        pc = base;
+    }
+}
+
+/**
+ * @brief Gets the pending interrupts.
+ * 
+ * @return mip, with MSIP and MTIP as the CLINT has them, MEIP as the
+ *  PLIC has it, and the S-mode bits as M-mode last wrote them.
+*/
+
+template <uint32_t XLEN>
+typename rv_hart<XLEN>::reg_t rv_hart<XLEN>::get_mip() const
+{
+    reg_t mip = mip_sw;
+    if (timer)
+    {
+        if (timer->get_msip(mhartid))
+            mip |= mip_msip;
+        if (timer->get_mtip(mhartid))
+            mip |= mip_mtip;
+    }
+    if (irqc && irqc->get_meip(mhartid))
+    {
+        mip |= mip_meip;
+    }
+    return mip;
+}
+
+/**
+ * @brief Takes an interrupt if one is pending and enabled, and works
+ * out when to look again.
+ * 
+ * Nothing can change without a CSR write, mret, a CLINT write or a
+ * change at the PLIC, which all bring the hart back here, except the
+ * timer reaching mtimecmp. So
+ * the next look is at the timer's deadline, if the timer interrupt is
+ * enabled, and never otherwise.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::check_interrupts()
+{
+    // A CLINT write or PLIC change from here on sets this back to 0.
+    irq_check_at.store(UINT64_MAX, std::memory_order_relaxed);
+
+    // An M-mode interrupt is taken below M-mode or with MIE set, and
+    // a delegated one below S-mode or in S-mode with SIE set.
+    bool m_enabled = priv < prv_m || (mstatus & mstatus_mie);
+    bool s_enabled = priv < prv_s || (priv == prv_s && (mstatus & mstatus_sie));
+    reg_t mip = get_mip();
+    reg_t pending = mip & mie;
+    reg_t take = m_enabled ? (pending & ~mideleg) : 0;
+    if (!take && s_enabled)
+    {
+        take = pending & mideleg;
+    }
+
+    if (take)
+    {
+        // External, then software, then timer, M-mode before S-mode.
+        ++interrupts;
+        if (take & mip_meip)
+            trap(cause_interrupt | 11, 0, "Machine external interrupt");
+        else if (take & mip_msip)
+            trap(cause_interrupt | 3, 0, "Machine software interrupt");
+        else if (take & mip_mtip)
+            trap(cause_interrupt | 7, 0, "Machine timer interrupt");
+        else if (take & mip_seip)
+            trap(cause_interrupt | 9, 0, "Supervisor external interrupt");
+        else if (take & mip_ssip)
+            trap(cause_interrupt | 1, 0, "Supervisor software interrupt");
+        else
+            trap(cause_interrupt | 5, 0, "Supervisor timer interrupt");
+        return;
+    }
+
+    if (m_enabled && (mie & mip_mtip) && !(mip & mip_mtip))
+    {
+        uint64_t expected = UINT64_MAX;
+        irq_check_at.compare_exchange_strong(expected, timer->get_deadline(mhartid), std::memory_order_relaxed);
+    }
 }
 
 /**
@@ -56,41 +397,84 @@ void rv32i_hart::dump(const std::string &hdr) const
  * @note The hart ticks until it is halted.
 */
 
-void rv32i_hart::tick(const std::string &hdr)
+template <uint32_t XLEN>
+void rv_hart<XLEN>::tick(const std::string &hdr)
 {
     // If the hart has not been halted...
     if (!halt)
     {
         // Dump registers if show_regs is true.
-        if (show_registers)
+        if (show_registers && detailed)
         {
             dump(hdr);
         }
 
-        // If pc % 4 does not equal 0, the program counter
-        // is not aligned.
-        if (pc % 4 != 0)
+        // If pc % 2 does not equal 0, the program counter
+        // is not aligned. With the C extension instructions
+        // only need to be 2-byte aligned.
+        if (pc % 2 != 0)
         {
-            // Halt the hart.
-            halt = true;
+            // Trap, or halt the hart if there is no handler.
+            trap(cause_insn_misaligned, pc, "PC alignment error");
 
-            // Set the halt reason.
-            halt_reason = "PC alignment error";
+            return;
+        }
 
+        // Get the instruction at the program counter. A compressed
+        // instruction is replaced by the 32-bit one it stands for, so
+        // it executes exactly like one. A fetch that faults traps
+        // before the instruction counts.
+        uint32_t fetch_addr;
+        if (!translate(pc, access_fetch, fetch_addr, 2))
+        {
             return;
         }
+        uint32_t raw = mem.get16(fetch_addr);
+        uint32_t insn;
+        if (is_compressed(raw))
+        {
+            insn = expansion_table()[raw];
+            insn_len = 2;
+        }
+        else if ((vm_fetch && (pc & (page_size - 1)) == page_size - 2) || pmp_fetch)
+        {
+            // The upper half may be on the next page, or outside the
+            // PMP entry the lower half is in.
+            uint32_t upper_addr;
+            if (!translate(pc + 2, access_fetch, upper_addr, 2))
+            {
+                return;
+            }
+            raw |= mem.get16(upper_addr) << 16;
+            insn = raw;
+            insn_len = 4;
+        }
+        else
+        {
+            raw = mem.get32(fetch_addr);
+            insn = raw;
+            insn_len = 4;
+        }
 
         // Increment the instruction counter.
         insn_counter += 1;
 
-        // Get the instruction at the program counter.
-        uint32_t insn = mem.get32(pc);
+        // If a sink is attached, record the instruction before it
+        // executes so the effective address uses the old rs1.
+        insn_record *rec = nullptr;
+        if (tracing)
+        {
+            rec = trace_insn(insn);
+        }
+
+        // Remember where the instruction was to spot taken transfers.
+        reg_t insn_pc = pc;
 
         // If show_instructions is true, print the instruction
         // and what it does.
-        if (show_instructions)
+        if (show_instructions && detailed)
         {
-            cout << hdr << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
+            cout << hdr << hex::to_hex32(pc) << ": " << render_raw(raw) << "  ";
             // Execute the instruction, pass in cout.
             exec(insn, &std::cout);
             cout << endl;
@@ -100,6 +484,43 @@ void rv32i_hart::tick(const std::string &hdr)
             // Execute the instruction, don't pass in cout.
             exec(insn, nullptr);
         }
+
+        // Count the instruction by kind, and the length of the run of
+        // instructions since the last taken transfer.
+        ++kind_counts[insn_kind(insn)];
+        if (idle_step && !idle_opcode(insn))
+        {
+            idle_pure = false;
+        }
+        if (pc != insn_pc + insn_len && !halt)
+        {
+            ++taken_transfers;
+            block_len.sample(insn_counter - last_transfer);
+            last_transfer = insn_counter;
+
+            // A short loop may be one that waits without doing anything.
+            if (pc <= insn_pc && insn_pc - pc < idle_span && !tracing)
+            {
+                watch_idle(insn_pc);
+            }
+
+            // Interrupts are only looked at between blocks, and only
+            // once one may be due.
+            if (insn_counter >= irq_check_at.load(std::memory_order_relaxed))
+            {
+                check_interrupts();
+            }
+        }
+
+        // Finish the record and hand a full batch to the sinks.
+        if (rec)
+        {
+            rec->next_pc = pc;
+            if (trace_buf.size() >= trace_batch)
+            {
+                flush_trace();
+            }
+        }
     }
     else
     {
@@ -108,1259 +529,5613 @@ void rv32i_hart::tick(const std::string &hdr)
 }
 
 /**
- * @brief Determines what the insn is and executes it.
+ * @brief Watches a short loop for one that waits without doing
+ * anything, such as j . or a poll of a device register that reads the
+ * same each time.
  * 
- * @param insn The instruction.
- * @param pos The ostream. In this program, it is cout.
+ * Called at each taken transfer back to a little before it. A pass
+ * round the loop that made no stores and loaded only from devices, or
+ * that was a single jump or branch to itself, is quiet. The pass after
+ * a quiet one is watched, and if it too is quiet, runs only integer
+ * and branch instructions and leaves every register as it found it,
+ * every later pass will do the same until something outside the hart
+ * changes. Loops that load from RAM are never watched, so compute
+ * loops only cost the loads of a few counters here.
  * 
- * @note If the instruction given is unrecognized, a message declaring
- * the instruction was unrecognized is printed.
+ * @param from The address of the transfer.
 */
 
-void rv32i_hart::exec(uint32_t insn, std::ostream* pos)
+template <uint32_t XLEN>
+void rv_hart<XLEN>::watch_idle(reg_t from)
 {
-    // Get the opcode, funct3, and funct7 of the insn.
-    uint32_t opcode = get_opcode(insn);
-    uint32_t funct3 = get_funct3(insn);
-    uint32_t funct7 = get_funct7(insn);
+    uint64_t loads = kind_counts[insn_record::kind_load];
+    uint64_t stores = kind_counts[insn_record::kind_store];
+    uint64_t mmio = mem.get_mmio_accesses();
 
-    switch (opcode)
+    bool quiet = pc == idle_head && stores == idle_stores &&
+                 loads - idle_loads == mmio - idle_mmio && (loads != idle_loads || pc == from);
+
+    if (quiet && idle_step && idle_pure)
     {
-        case opcode_lui:
-            exec_lui(insn, pos);
+        bool same = true;
+        for (uint32_t r = 1; r < 32 && same; ++r)
+        {
+            same = regs.get(r) == idle_regs[r];
+        }
+        if (same)
+        {
+            // Keep the watched pass for fast_forward to repeat.
+            idle = idle_loop;
             return;
+        }
+    }
+
+    // Watch the next pass after a quiet one.
+    idle_step = quiet;
+    if (quiet)
+    {
+        idle_pure = true;
+        idle_mark = insn_counter;
+        idle_taken = taken_transfers;
+        std::copy(kind_counts, kind_counts + insn_record::num_kinds, idle_kinds);
+        idle_regs.resize(32);
+        for (uint32_t r = 1; r < 32; ++r)
+        {
+            idle_regs[r] = regs.get(r);
+        }
+    }
+
+    idle_head = pc;
+    idle_loads = loads;
+    idle_stores = stores;
+    idle_mmio = mmio;
+}
+
+/**
+ * @brief Checks if an instruction may be part of an idle loop.
+ * 
+ * @param insn The instruction.
+ * 
+ * @return True for the instructions that change nothing but integer
+ *  registers and the pc: the integer ALU, loads, branches and jal.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::idle_opcode(uint32_t insn)
+{
+    switch (get_opcode(insn))
+    {
+        case opcode_lui:
         case opcode_auipc:
-            exec_auipc(insn, pos);
-            return;
         case opcode_jal:
-            exec_jal(insn, pos);
-            return;
-        case opcode_jalr:
-            exec_jalr(insn, pos);
-            return;
         case opcode_btype:
-            // A switch defined by funct3. This determines which b-type
-            // instruction the insn is.
-            switch(funct3)
-            {
-                case funct3_beq:
-                    exec_beq(insn, pos);
-                    return;
-                case funct3_bne:
-                    exec_bne(insn, pos);
-                    return;
-                case funct3_blt:
-                    exec_blt(insn, pos);
-                    return;
-                case funct3_bge:
-                    exec_bge(insn, pos);
-                    return;
-                case funct3_bltu:
-                    exec_bltu(insn, pos);
-                    return;
-                case funct3_bgeu:
-                    exec_bgeu(insn, pos);
-                    return;
-                default:
-                    // If none of the others, render the illegal_insn()
-                    exec_illegal_insn(insn, pos);
-                    return;
-            }
-            assert(0 && "unrecognized funct3"); // We should not get here
         case opcode_load_imm:
-            // A switch defined by funct3. This determines which load
-            // instruction the insn is.
-            switch(funct3)
-                {
-                    case funct3_lb:
-                        exec_lb(insn, pos);
-                        return;
-                    case funct3_lh:
-                        exec_lh(insn, pos);
-                        return;
-                    case funct3_lw:
-                        exec_lw(insn, pos);
-                        return;
-                    case funct3_lbu:
-                        exec_lbu(insn, pos);
-                        return;
-                    case funct3_lhu:
-                        exec_lhu(insn, pos);
-                        return;
-                    default:
-                        // If none of the others, render the illegal_insn()
-                        exec_illegal_insn(insn, pos);
-                        return;
-                }
-                assert(0 && "unrecognized funct3"); // We should not get here
-        case opcode_stype:
-            // A switch defined by funct3. This determines which s-type
-            // instruction the insn is.
-            switch(funct3)
-                {
-                    case funct3_sb:
-                        exec_sb(insn, pos);
-                        return;
-                    case funct3_sh:
-                        exec_sh(insn, pos);
-                        return;
-                    case funct3_sw:
-                        exec_sw(insn, pos);
-                        return;
-                    default:
-                        // If none of the others, render the illegal_insn()
-                        exec_illegal_insn(insn, pos);
-                        return;
-                }
-                assert(0 && "unrecognized funct3"); // We should not get here
         case opcode_alu_imm:
-            // A switch defined by funct3. This determines which alu
-            // instruction the insn is.
-            switch(funct3)
-                {
-                    case funct3_add:
-                        exec_addi(insn, pos);
-                        return;
-                    case funct3_slt:
-                        exec_slti(insn, pos);
-                        return;
-                    case funct3_sltu:
-                        exec_sltiu(insn, pos);
-                        return;
-                    case funct3_xor:
-                        exec_xori(insn, pos);
-                        return;
-                    case funct3_or:
-                        exec_ori(insn, pos);
-                        return;
-                    case funct3_and:
-                        exec_andi(insn, pos);
-                        return;
-                    case funct3_sll:
-                        exec_slli(insn, pos);
-                        return;
-                    case funct3_srx:
-                        // An inner switch defiend by funct7. This determines which
-                        // srx instruction the insn is.
-                        switch(funct7)
-                        {
-                            case funct7_srl:
-                                exec_srli(insn, pos);
-                                return;
-                            case funct7_sra:
-                                exec_srai(insn, pos);
-                                return;
-                            default:
-                                exec_illegal_insn(insn, pos);
-                                return;
-                        }
-                        assert(0 && "unrecognized funct7"); // We should not get here
-                    default:
-                        // If none of the others, render the illegal_insn()
-                        exec_illegal_insn(insn, pos);
-                        return;
-                }
-                assert(0 && "unrecognized funct3"); // We should not get here
         case opcode_rtype:
-            // A switch defined by funct3. This determines which r-type
-            // instruction the insn is.
-            switch(funct3)
-                {
-                    case funct3_add:
-                        // An inner switch defiend by funct7. This determines which
-                        // add instruction the insn is.
-                        switch(funct7)
-                        {
-                            case funct7_add:
-                                exec_add(insn, pos);
-                                return;
-                            case funct7_sub:
-                                exec_sub(insn, pos);
-                                return;
-                            default:
-                                // If none of the others, render the illegal_insn()
-                                exec_illegal_insn(insn, pos);
-                                return;
-                        }
-                        assert(0 && "unrecognized funct7"); // We should not get here
-                    case funct3_sll:
-                        exec_sll(insn, pos);
-                        return;
-                    case funct3_slt:
-                        exec_slt(insn, pos);
-                        return;
-                    case funct3_sltu:
-                        exec_sltu(insn, pos);
-                        return;
-                    case funct3_xor:
-                        exec_xor(insn, pos);
-                        return;
-                    case funct3_srx:
-                        // Another inner switch defiend by funct7. This determines which
-                        // srx instruction the insn is.
-                        switch(funct7)
-                        {
-                            case funct7_srl:
-                                exec_srl(insn, pos);
-                                return;
-                            case funct7_sra:
-                                exec_sra(insn, pos);
-                                return;
-                            default:
-                                exec_illegal_insn(insn, pos);
-                                return;
-                        }
-                        assert(0 && "unrecognized funct7"); // We should not get here
-                    case funct3_or:
-                        exec_or(insn, pos);
-                        return;
-                    case funct3_and:
-                        exec_and(insn, pos);
-                        return;
-                    default:
-                        // If none of the others, render the illegal_insn()
-                        exec_illegal_insn(insn, pos);
-                        return;
-                }
-                assert(0 && "unrecognized funct3"); // We should not get here
-        case opcode_system:
-            // A switch defined by funct3. This determines which system
-            // instruction the insn is.
-            switch(funct3)
-                {
-                    case 0b000:
-                        // An inner switch defiend by the insn itself. This determines
-                        // e instruction the insn is.
-                        switch(insn)
-                        {
-                            case insn_ecall:
-                                exec_ecall(insn, pos);
-                                return;
-                            case insn_ebreak:
-                                exec_ebreak(insn, pos);
-                                return;
-                            default:
-                                // If none of the others, render the illegal_insn()
-                                exec_illegal_insn(insn, pos);
-                                return;
-                        }
-                        assert(0 && "unrecognized insn"); // We should not get here
-                    case funct3_csrrs:
-                        exec_csrrs(insn, pos);
-                        return;
-                    default:
-                        exec_illegal_insn(insn, pos);
-                        return;
-                }
-                assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_alu_imm_32:
+        case opcode_rtype_32:
+            return true;
         default:
-            // If none of the others, render the illegal_insn()
-            exec_illegal_insn(insn, pos);
-            return;
+            return false;
+    }
+}
+
+/**
+ * @brief Moves time on to the end of a wait in wfi or an idle loop.
+ * 
+ * The wait ends when an interrupt may be taken, the point irq_check_at
+ * holds, or for wfi once the timer interrupt is pending even if
+ * interrupts are disabled. mtime and cycle follow insn_counter, so
+ * they move with it. A stall in wfi retires nothing, so it is counted
+ * apart from instret. An idle loop is moved on by whole passes, and
+ * every count a pass makes moves as if it had run them, leaving the
+ * hart at the head of the loop. A wait in wfi that the bound cuts short
+ * goes on when the run loop calls again. A wait with nothing to end it
+ * is not moved at all, whatever the bound.
+ * 
+ * @param bound The instruction count the run loop has to stop at
+ *  anyway, for a device event, a statistics dump or the limit.
+ * 
+ * @return False if nothing this hart can see will ever end the wait.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::fast_forward(uint64_t bound)
+{
+    uint32_t why = idle;
+    idle = idle_none;
+    idle_step = 0;
+
+    // wfi ends once an enabled interrupt is pending, so a prompt to look
+    // at the interrupts that finds none leaves it waiting.
+    if (why == idle_wfi && insn_counter >= irq_check_at.load(std::memory_order_relaxed))
+    {
+        check_interrupts();
+        if (get_mip() & mie)
+        {
+            return true;
+        }
+    }
+
+    uint64_t wake = irq_check_at.load(std::memory_order_relaxed);
+    if (why == idle_wfi && timer && (mie & mip_mtip))
+    {
+        wake = std::min(wake, timer->get_deadline(mhartid));
+    }
+    uint64_t until = std::min(bound, wake);
+
+    // Output the guest is waiting on goes out now, and a device being
+    // polled gets to look for input before the hart stops reading it.
+    mem.flush();
+    bool polling = why == idle_loop && kind_counts[insn_record::kind_load] != idle_kinds[insn_record::kind_load];
+    if (polling && mem.has_input())
+    {
+        return true;
+    }
+    // The bound is only where the run loop looks in again, so a wait
+    // nothing will end is not skipped up to it.
+    if (wake == UINT64_MAX)
+    {
+        return polling;
+    }
+    uint64_t gap = until > insn_counter ? until - insn_counter : 0;
+
+    if (why == idle_wfi)
+    {
+        wfi_cycles += gap;
+        last_transfer += gap;
+        insn_counter += gap;
+        if (until < wake)
+        {
+            idle = idle_wfi;
+        }
+    }
+    else if (gap / (insn_counter - idle_mark))
+    {
+        uint64_t len = insn_counter - idle_mark;
+        uint64_t passes = gap / len;
+        for (uint32_t i = 0; i < insn_record::num_kinds; ++i)
+        {
+            kind_counts[i] += passes * (kind_counts[i] - idle_kinds[i]);
+        }
+        taken_transfers += passes * (taken_transfers - idle_taken);
+        insn_counter += passes * len;
+        last_transfer += passes * len;
+        idle_skipped += passes * len;
+        ++idle_skips;
+    }
+
+    // An interrupt due now is taken where the wait ended.
+    if (insn_counter >= irq_check_at.load(std::memory_order_relaxed))
+    {
+        check_interrupts();
+    }
+    return true;
+}
+
+/**
+ * @brief Attaches a consumer of the retired instruction stream.
+ * 
+ * @param s The sink. It must outlive the hart's execution.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::add_sink(insn_sink *s)
+{
+    // Reserve a full batch so records never move while being filled in.
+    trace_buf.reserve(trace_batch);
+    sinks.push_back(s);
+    tracing = detailed;
+}
+
+/**
+ * @brief Switches between fast functional and detailed execution.
+ * 
+ * Detailed execution feeds the sinks and does the instruction and
+ * register printing. Functional execution skips all of it.
+ * 
+ * @param b True for detailed execution.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::set_detailed(bool b)
+{
+    // Hand over what was recorded before the models stop.
+    if (!b)
+    {
+        flush_trace();
+    }
+
+    detailed = b;
+    tracing = detailed && !sinks.empty();
+}
+
+/**
+ * @brief Hands the buffered instruction records to every sink.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::flush_trace()
+{
+    for (insn_sink *s : sinks)
+    {
+        s->consume(trace_buf.data(), trace_buf.size());
+    }
+    trace_buf.clear();
+}
+
+/**
+ * @brief Prints the report of every sink.
+ * 
+ * @param os The stream to print to.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::report_sinks(std::ostream &os) const
+{
+    for (const insn_sink *s : sinks)
+    {
+        s->report(os);
+    }
+}
+
+/**
+ * @brief Registers the statistics of the hart.
+ * 
+ * @param s The statistics registry.
+ * @param prefix The name the statistics are grouped under.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::register_stats(stats &s, const std::string &prefix) const
+{
+    static const std::vector<std::string> kind_names =
+        { "alu", "mul", "div", "load", "store", "branch", "jump", "system", "fp" };
+
+    s.add_scalar(prefix + ".insns", &insn_counter, "Instructions executed");
+    s.add_vector(prefix + ".kind", kind_counts, kind_names, "Instructions executed by kind");
+    s.add_scalar(prefix + ".taken_transfers", &taken_transfers, "Taken branches and jumps");
+    s.add_histogram(prefix + ".block_len", &block_len, "Instructions between taken transfers");
+    s.add_scalar(prefix + ".traps", &traps, "Exceptions taken");
+    s.add_scalar(prefix + ".interrupts", &interrupts, "Interrupts taken");
+    s.add_scalar(prefix + ".tlb_misses", &tlb_misses, "Page-table walks after a TLB miss");
+    s.add_scalar(prefix + ".page_faults", &page_faults, "Page faults taken");
+    s.add_scalar(prefix + ".pmp_misses", &pmp_misses, "PMP checks outside the cached window");
+    s.add_scalar(prefix + ".wfi_cycles", &wfi_cycles, "Cycles stalled in wfi");
+    s.add_scalar(prefix + ".idle_skips", &idle_skips, "Idle loops skipped ahead");
+    s.add_scalar(prefix + ".idle_skipped", &idle_skipped, "Instructions of idle loops skipped");
+}
+
+/**
+ * @brief Registers the hart's architectural state for checkpoints.
+ * 
+ * Besides the registers, the pc and the CSRs, this takes the counts the
+ * performance counters are made from, so they read on after a restore
+ * as if the run had never stopped. The TLBs and the decoded PMP entries
+ * follow from the CSRs and are rebuilt after a restore.
+ * 
+ * @param c The checkpoint registry.
+ * @param prefix The name the fields are grouped under.
+ * 
+ * @note Register after set_vlen, which moves the vector registers.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::register_state(checkpoint &c, const std::string &prefix)
+{
+    regs.register_state(c, prefix + ".x");
+    fregs.register_state(c, prefix + ".f");
+    vregs.register_state(c, prefix + ".v");
+    c.add(prefix + ".pc", &pc);
+    c.add(prefix + ".insn_counter", &insn_counter);
+    c.add(prefix + ".halt", &halt);
+    c.add(prefix + ".halt_reason", &halt_reason);
+    c.add(prefix + ".priv", &priv);
+    c.add(prefix + ".reservation_valid", &reservation_valid);
+    c.add(prefix + ".reservation_addr", &reservation_addr);
+    c.add(prefix + ".reservation_value", &reservation_value);
+
+    c.add(prefix + ".misa", &misa);
+    c.add(prefix + ".mstatus", &mstatus);
+    c.add(prefix + ".mie", &mie);
+    c.add(prefix + ".mtvec", &mtvec);
+    c.add(prefix + ".mepc", &mepc);
+    c.add(prefix + ".mcause", &mcause);
+    c.add(prefix + ".mtval", &mtval);
+    c.add(prefix + ".mscratch", &mscratch);
+    c.add(prefix + ".medeleg", &medeleg);
+    c.add(prefix + ".mideleg", &mideleg);
+    c.add(prefix + ".mip_sw", &mip_sw);
+    c.add(prefix + ".stvec", &stvec);
+    c.add(prefix + ".sscratch", &sscratch);
+    c.add(prefix + ".sepc", &sepc);
+    c.add(prefix + ".scause", &scause);
+    c.add(prefix + ".stval", &stval);
+    c.add(prefix + ".satp", &satp);
+    c.add(prefix + ".pmpcfg", &pmpcfg);
+    c.add(prefix + ".pmpaddr", &pmpaddr);
+    c.add(prefix + ".frm", &frm);
+    c.add(prefix + ".fflags", &fflags);
+    c.add(prefix + ".fp_used", &fp_used);
+    c.add(prefix + ".vl", &vl);
+    c.add(prefix + ".vtype", &vtype);
+    c.add(prefix + ".vstart", &vstart);
+    c.add(prefix + ".vxrm", &vxrm);
+    c.add(prefix + ".vxsat", &vxsat);
+    c.add(prefix + ".vec_used", &vec_used);
+
+    c.add(prefix + ".mcountinhibit", &mcountinhibit);
+    c.add(prefix + ".hpm_event", &hpm_event);
+    c.add(prefix + ".counter_delta", &counter_delta);
+    c.add(prefix + ".kind_counts", &kind_counts);
+    c.add(prefix + ".taken_transfers", &taken_transfers);
+    c.add(prefix + ".wfi_cycles", &wfi_cycles);
+    c.add(prefix + ".idle", &idle);
+
+    c.on_restore([this]
+    {
+        update_pmp();
+        update_vm();
+        flush_tlb();
+
+        // A hart saved in wfi goes on waiting. An idle loop is found
+        // again from scratch.
+        if (idle != idle_wfi)
+        {
+            idle = idle_none;
+        }
+        idle_step = 0;
+        last_transfer = insn_counter;
+
+        // Look at the interrupts before the first instruction.
+        irq_check_at = 0;
+    });
+}
+
+/**
+ * @brief Gets the table of instruction kinds.
+ * 
+ * @return A table giving the insn_record kind of every opcode.
+*/
+
+template <uint32_t XLEN>
+const uint8_t *rv_hart<XLEN>::kind_table()
+{
+    struct kinds
+    {
+        uint8_t kind[128];
+    };
+
+    // Every opcode not listed is an ALU instruction.
+    static const kinds table = []
+    {
+        kinds t = { };
+        t.kind[opcode_jal] = insn_record::kind_jump;
+        t.kind[opcode_jalr] = insn_record::kind_jump;
+        t.kind[opcode_btype] = insn_record::kind_branch;
+        t.kind[opcode_load_imm] = insn_record::kind_load;
+        t.kind[opcode_stype] = insn_record::kind_store;
+        t.kind[opcode_system] = insn_record::kind_system;
+        t.kind[opcode_amo] = insn_record::kind_load;
+        t.kind[opcode_load_fp] = insn_record::kind_load;
+        t.kind[opcode_store_fp] = insn_record::kind_store;
+        t.kind[opcode_op_fp] = insn_record::kind_fp;
+        t.kind[opcode_fmadd] = insn_record::kind_fp;
+        t.kind[opcode_fmsub] = insn_record::kind_fp;
+        t.kind[opcode_fnmsub] = insn_record::kind_fp;
+        t.kind[opcode_fnmadd] = insn_record::kind_fp;
+        return t;
+    }();
+
+    return table.kind;
+}
+
+/**
+ * @brief Gets the table of compressed instruction expansions.
+ * 
+ * @return A table giving the 32-bit expansion of every 16-bit value.
+ * 
+ * @note The table is filled once, the first time it is used, so
+ * fetching a compressed instruction costs one lookup.
+*/
+
+template <uint32_t XLEN>
+const uint32_t *rv_hart<XLEN>::expansion_table()
+{
+    struct expansions
+    {
+        uint32_t insn[0x10000];
+    };
+
+    static const std::unique_ptr<expansions> table = []
+    {
+        std::unique_ptr<expansions> t(new expansions);
+        for (uint32_t c = 0; c < 0x10000; ++c)
+        {
+            t->insn[c] = is_compressed(c) ? expand_compressed(c, XLEN) : 0;
+        }
+        return t;
+    }();
+
+    return table->insn;
+}
+
+/**
+ * @brief Renders a fetched instruction in hex.
+ * 
+ * @param raw The instruction as it is in memory.
+ * 
+ * @return 8 hex digits, or 4 right-aligned for a compressed instruction.
+*/
+
+template <uint32_t XLEN>
+std::string rv_hart<XLEN>::render_raw(uint32_t raw)
+{
+    if (is_compressed(raw))
+    {
+        return "    " + hex::to_hex32(raw).substr(4);
+    }
+    return hex::to_hex32(raw);
+}
+
+/**
+ * @brief Renders a register value in hex.
+ * 
+ * @param v The value.
+ * 
+ * @return 0x and 8 hex digits on RV32, 16 on RV64.
+*/
+
+template <uint32_t XLEN>
+std::string rv_hart<XLEN>::to_hex0xlen(reg_t v)
+{
+    return (XLEN == 32) ? hex::to_hex0x32(v) : hex::to_hex0x64(v);
+}
+
+/**
+ * @brief Gets the memory address of an effective address.
+ * 
+ * @param addr The effective address.
+ * 
+ * @return The address itself on RV32. The memory holds at most 4 GiB,
+ *  so an RV64 address beyond that becomes one the memory rejects
+ *  instead of wrapping around onto a legal one.
+*/
+
+template <uint32_t XLEN>
+uint32_t rv_hart<XLEN>::mem_addr(reg_t addr)
+{
+    return (addr == (uint32_t) addr) ? addr : 0xffffffff;
+}
+
+/**
+ * @brief Works out which accesses are translated and which are checked
+ * by PMP, after a change of mode, satp, MPRV or the PMP entries.
+ * 
+ * @note Only RV32 has a paging mode. M-mode fetches are never
+ * translated, and M-mode loads and stores only with MPRV set and MPP
+ * below M. PMP binds S and U once any entry is on, and M only through
+ * a locked entry.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::update_vm()
+{
+    bool sv32 = XLEN == 32 && (satp & satp_sv32);
+    uint32_t eff = (mstatus & mstatus_mprv) ? (mstatus & mstatus_mpp) >> 11 : priv;
+    vm_fetch = sv32 && priv < prv_m;
+    fetch_mode = vm_fetch ? priv : 0;
+    vm_data = sv32 && eff < prv_m;
+    data_mode = vm_data ? eff : 0;
+
+    pmp_fetch = pmp_count && (priv < prv_m || pmp_locked);
+    pmp_data = pmp_count && (eff < prv_m || pmp_locked);
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        pmp_last[i] = pmp_window();
+    }
+}
+
+/**
+ * @brief Forgets every cached translation, as sfence.vma and writes to
+ * satp must.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::flush_tlb()
+{
+    for (uint32_t m = 0; m < 2; ++m)
+    {
+        for (uint32_t i = 0; i < tlb_size; ++i)
+        {
+            itlb[m][i] = tlb_entry();
+            dtlb[m][i] = tlb_entry();
+        }
+    }
+}
+
+/**
+ * @brief Decodes the PMP entries into the byte ranges they cover.
+ * 
+ * @note Called after every write to pmpcfg or pmpaddr. The caller
+ * then calls update_vm, which works out what is checked.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::update_pmp()
+{
+    pmp_count = 0;
+    pmp_locked = false;
+    for (uint32_t i = 0; i < pmp_entries; ++i)
+    {
+        pmp_rule &r = pmp_rules[i];
+        r = pmp_rule();
+        r.cfg = pmpcfg[i];
+        uint64_t a = (uint64_t) pmpaddr[i] << 2;
+        switch (pmpcfg[i] & pmp_a)
+        {
+            case pmp_tor:
+                r.lo = i ? (uint64_t) pmpaddr[i - 1] << 2 : 0;
+                r.hi = std::max(a, r.lo);
+                break;
+            case pmp_na4:
+                r.lo = a;
+                r.hi = a + 4;
+                break;
+            case pmp_napot:
+            {
+                // The trailing ones of pmpaddr give the size.
+                uint64_t size = (uint64_t) 8 << __builtin_ctzll(~(uint64_t) pmpaddr[i]);
+                r.lo = a & ~(size - 1);
+                r.hi = r.lo + size;
+                break;
+            }
+            default:
+                continue;
+        }
+        pmp_count = i + 1;
+        pmp_locked = pmp_locked || (pmpcfg[i] & pmp_l);
+    }
+}
+
+/**
+ * @brief Checks an access against the PMP entries.
+ * 
+ * @param pa The physical address.
+ * @param len The number of bytes.
+ * @param access access_fetch, access_load or access_store.
+ * @param mode The privilege mode of the access.
+ * @param w If not nullptr and the access is allowed, set to the
+ *  largest run around it that every access of this type and mode is
+ *  allowed in, as long as it stays inside the run.
+ * 
+ * @return True if the access is allowed.
+ * 
+ * @note The lowest-numbered entry that matches any byte decides, and
+ * it must match every byte. With no match, M-mode is allowed and the
+ * other modes are not.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::pmp_allows(uint64_t pa, uint32_t len, int access, uint32_t mode, pmp_window *w) const
+{
+    static const uint8_t perm[3] = { pmp_x, pmp_r, pmp_w };
+
+    // The run shrinks to stay clear of every entry that did not match.
+    uint64_t lo = 0;
+    uint64_t hi = UINT64_MAX;
+    for (uint32_t i = 0; i < pmp_count; ++i)
+    {
+        const pmp_rule &r = pmp_rules[i];
+        if (r.lo >= r.hi)
+            continue;
+        if (pa + len <= r.lo)
+        {
+            hi = std::min(hi, r.lo);
+            continue;
+        }
+        if (pa >= r.hi)
+        {
+            lo = std::max(lo, r.hi);
+            continue;
+        }
+        if (pa < r.lo || pa + len > r.hi)
+            return false;
+
+        bool ok = (mode == prv_m && !(r.cfg & pmp_l)) || (r.cfg & perm[access]);
+        if (ok && w)
+        {
+            w->lo = std::max(lo, r.lo);
+            w->len = std::min(hi, r.hi) - w->lo;
+        }
+        return ok;
+    }
+
+    if (mode != prv_m)
+        return false;
+    if (w)
+    {
+        w->lo = lo;
+        w->len = hi - lo;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks an access against the PMP entries, outside the window
+ * the last check of its type left.
+ * 
+ * @param addr The virtual address, for mtval or stval.
+ * @param pa The physical address.
+ * @param len The number of bytes.
+ * @param access access_fetch, access_load or access_store.
+ * 
+ * @return False if the access faulted, and the trap has been taken.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::pmp_check(reg_t addr, uint32_t pa, uint32_t len, int access)
+{
+    static const reg_t access_cause[3] = { cause_fetch_access, cause_load_access, cause_store_access };
+
+    ++pmp_misses;
+    uint32_t mode = (access == access_fetch || !(mstatus & mstatus_mprv)) ? priv : (mstatus & mstatus_mpp) >> 11;
+    if (pmp_allows(pa, len, access, mode, &pmp_last[access]))
+    {
+        return true;
+    }
+    trap(access_cause[access], addr, "PMP access fault");
+    return false;
+}
+
+/**
+ * @brief Translates a virtual address.
+ * 
+ * @param addr The virtual address.
+ * @param access access_fetch, access_load or access_store.
+ * @param pa Set to the physical address.
+ * @param len The number of bytes, all on the page addr is on.
+ * 
+ * @return False if the access faulted, and the trap has been taken.
+ * 
+ * @note The TLBs are direct mapped on the low bits of the VPN, with
+ * one pair per mode. A hit is one compare and an add, and only a miss
+ * walks the page table. PMP is then checked on the physical address,
+ * and an access inside the window the last check of its type left
+ * needs no more than two compares.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::translate(reg_t addr, int access, uint32_t &pa, uint32_t len)
+{
+    if (!(access == access_fetch ? vm_fetch : vm_data))
+    {
+        pa = mem_addr(addr);
+    }
+    else
+    {
+        uint32_t vpn = (uint32_t) addr >> 12;
+        const tlb_entry &e = (access == access_fetch) ?
+            itlb[fetch_mode][vpn % tlb_size] : dtlb[data_mode][vpn % tlb_size];
+        if ((access == access_store ? e.tag_w : e.tag_r) == vpn)
+        {
+            pa = (uint32_t) addr + e.delta;
+        }
+        else if (!walk(addr, access, pa))
+        {
+            return false;
+        }
+    }
+
+    if (!(access == access_fetch ? pmp_fetch : pmp_data))
+    {
+        return true;
+    }
+    const pmp_window &w = pmp_last[access];
+    if (pa >= w.lo && (uint64_t) pa + len <= w.lo + w.len)
+    {
+        return true;
+    }
+    return pmp_check(addr, pa, len, access);
+}
+
+/**
+ * @brief Walks the Sv32 page table for a TLB miss, and fills the TLB.
+ * 
+ * @param addr The virtual address.
+ * @param access access_fetch, access_load or access_store.
+ * @param pa Set to the physical address.
+ * 
+ * @return False if the access faulted, and the trap has been taken.
+ * 
+ * @note The A and D bits are set by the walk, with an atomic OR so a
+ * walk on another hart cannot lose them. A store through a clean page
+ * misses the TLB once to set D.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::walk(reg_t addr, int access, uint32_t &pa)
+{
+    static const reg_t fault_cause[3] = { cause_fetch_page_fault, cause_load_page_fault, cause_store_page_fault };
+    static const reg_t access_cause[3] = { cause_fetch_access, cause_load_access, cause_store_access };
+    static const char *fault_reason[3] = { "Instruction page fault", "Load page fault", "Store/AMO page fault" };
+
+    ++tlb_misses;
+    uint32_t va = addr;
+    uint32_t mode = (access == access_fetch) ? fetch_mode : data_mode;
+
+    uint64_t table = (uint64_t) (satp & satp_ppn) << 12;
+    uint64_t pte_addr = 0;
+    uint32_t pte = 0;
+    int level = 1;
+    for (; level >= 0; --level)
+    {
+        pte_addr = table + 4 * ((va >> (12 + 10 * level)) & 0x3ff);
+        if (pte_addr >= mem.get_size())
+        {
+            trap(access_cause[access], addr, "Page table access fault");
+            return false;
+        }
+        // The walk reads the table as S-mode as far as PMP goes.
+        if (pmp_count && !pmp_allows(pte_addr, 4, access_load, prv_s, nullptr))
+        {
+            trap(access_cause[access], addr, "PMP access fault");
+            return false;
+        }
+        pte = mem.get32(pte_addr);
+        if (!(pte & pte_v) || ((pte & pte_w) && !(pte & pte_r)))
+        {
+            break;
+        }
+        if (pte & (pte_r | pte_x))
+        {
+            break;
+        }
+        // A pointer to the next level.
+        table = (uint64_t) (pte >> 10) << 12;
+    }
+
+    bool ok = level >= 0 && (pte & pte_v) && !((pte & pte_w) && !(pte & pte_r));
+    if (ok)
+    {
+        // The permissions of the leaf, for the mode the access uses.
+        if (access == access_fetch)
+            ok = (pte & pte_x) != 0;
+        else if (access == access_load)
+            ok = (pte & pte_r) || ((mstatus & mstatus_mxr) && (pte & pte_x));
+        else
+            ok = (pte & pte_w) != 0;
+
+        if (mode == prv_u)
+            ok = ok && (pte & pte_u);
+        else if (pte & pte_u)
+            ok = ok && access != access_fetch && (mstatus & mstatus_sum);
+
+        // A superpage must be aligned to 4 MiB.
+        if (level == 1 && ((pte >> 10) & 0x3ff))
+            ok = false;
+    }
+    if (!ok)
+    {
+        ++page_faults;
+        trap(fault_cause[access], addr, fault_reason[access]);
+        return false;
+    }
+
+    uint32_t want = pte_a | (access == access_store ? pte_d : 0);
+    if ((pte & want) != want)
+    {
+        pte |= mem.atomic_rmw32(pte_addr, memory::amo_or, want) | want;
+    }
+
+    uint64_t page = (uint64_t) (pte >> 10) << 12;
+    if (level == 1)
+    {
+        page |= va & 0x003ff000;
+    }
+    if (page > UINT32_MAX)
+    {
+        trap(access_cause[access], addr, "Physical address beyond 4 GiB");
+        return false;
+    }
+
+    // Cache the 4 KiB page the access is in, readable or writable only
+    // as far as the next access may use it without a walk.
+    uint32_t vpn = va >> 12;
+    tlb_entry &e = (access == access_fetch) ? itlb[mode][vpn % tlb_size] : dtlb[mode][vpn % tlb_size];
+    e = tlb_entry();
+    e.delta = (uint32_t) page - (va & ~(page_size - 1));
+    if (access == access_fetch)
+    {
+        e.tag_r = vpn;
+    }
+    else
+    {
+        if ((pte & pte_r) || ((mstatus & mstatus_mxr) && (pte & pte_x)))
+            e.tag_r = vpn;
+        if ((pte & pte_w) && (pte & pte_d))
+            e.tag_w = vpn;
+    }
+
+    pa = va + e.delta;
+    return true;
+}
+
+/**
+ * @brief Copies bytes between guest virtual memory and a host buffer.
+ * 
+ * @param addr The virtual address of the first byte.
+ * @param buf The host buffer.
+ * @param len The number of bytes.
+ * @param store True to copy into the guest, False to copy out of it.
+ * 
+ * @return False if an access faulted, and the trap has been taken.
+ * 
+ * @note Every page is translated and checked before any byte moves, so
+ * a store that faults on its second page leaves the first one
+ * untouched.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::copy_guest(reg_t addr, uint8_t *buf, uint32_t len, bool store)
+{
+    if (!vm_data && !pmp_data)
+    {
+        if (store)
+            mem.set_block(mem_addr(addr), buf, len);
+        else
+            mem.get_block(mem_addr(addr), buf, len);
+        return true;
+    }
+
+    int access = store ? access_store : access_load;
+    uint32_t pa;
+    for (uint32_t done = 0; done < len; )
+    {
+        reg_t a = addr + done;
+        uint32_t chunk = std::min<uint32_t>(len - done, page_size - (a & (page_size - 1)));
+        if (!translate(a, access, pa, chunk))
+            return false;
+        done += chunk;
+    }
+
+    uint32_t done = 0;
+    while (done < len)
+    {
+        reg_t a = addr + done;
+        uint32_t chunk = std::min<uint32_t>(len - done, page_size - (a & (page_size - 1)));
+        translate(a, access, pa, chunk);
+        if (store)
+            mem.set_block(pa, buf + done, chunk);
+        else
+            mem.get_block(pa, buf + done, chunk);
+        done += chunk;
+    }
+    return true;
+}
+
+/**
+ * @defgroup guest_access Guest loads and stores
+ * Load or store a value at a virtual address. A value inside one page
+ * is one translation and one memory access, and one that straddles two
+ * pages is copied a page at a time.
+ * @return False if the access faulted, and the trap has been taken.
+ * @{
+*/
+
+template <uint32_t XLEN>
+template <typename T>
+bool rv_hart<XLEN>::load(reg_t addr, T &val)
+{
+    if (vm_data && (addr & (page_size - 1)) > page_size - sizeof(T))
+    {
+        uint8_t b[sizeof(T)];
+        if (!copy_guest(addr, b, sizeof(T), false))
+            return false;
+        memcpy(&val, b, sizeof(T));
+        return true;
+    }
+
+    uint32_t pa;
+    if (!translate(addr, access_load, pa, sizeof(T)))
+        return false;
+    val = mem.get<typename std::make_unsigned<T>::type>(pa);
+    return true;
+}
+
+template <uint32_t XLEN>
+template <typename T>
+bool rv_hart<XLEN>::store(reg_t addr, T val)
+{
+    if (vm_data && (addr & (page_size - 1)) > page_size - sizeof(T))
+    {
+        uint8_t b[sizeof(T)];
+        memcpy(b, &val, sizeof(T));
+        return copy_guest(addr, b, sizeof(T), true);
+    }
+
+    uint32_t pa;
+    if (!translate(addr, access_store, pa, sizeof(T)))
+        return false;
+    mem.set<T>(pa, val);
+    return true;
+}
+/**@}*/
+
+/**
+ * @brief Gets the kind of an instruction.
+ * 
+ * @param insn The instruction.
+ * 
+ * @return The insn_record kind of the instruction.
+*/
+
+template <uint32_t XLEN>
+uint8_t rv_hart<XLEN>::insn_kind(uint32_t insn)
+{
+    uint32_t opcode = get_opcode(insn);
+
+    // Multiplies and divides share the r-type opcodes.
+    if ((opcode == opcode_rtype || opcode == opcode_rtype_32) && get_funct7(insn) == funct7_muldiv)
+    {
+        return (get_funct3(insn) & 0b100) ? insn_record::kind_div : insn_record::kind_mul;
+    }
+    return kind_table()[opcode];
+}
+
+/**
+ * @brief Records an instruction that is about to execute.
+ * 
+ * @param insn The instruction.
+ * 
+ * @return The new record. The caller fills in next_pc once the
+ * instruction has executed.
+*/
+
+template <uint32_t XLEN>
+insn_record *rv_hart<XLEN>::trace_insn(uint32_t insn)
+{
+    trace_buf.push_back(insn_record());
+    insn_record &r = trace_buf.back();
+
+    r.pc = pc;
+    r.next_pc = pc;
+    r.insn = insn;
+    r.len = insn_len;
+    r.addr = 0;
+    r.rd = 0;
+    r.rs1 = 0;
+    r.rs2 = 0;
+    r.rs3 = 0;
+    r.kind = insn_record::kind_alu;
+
+    // Pick out the registers each format actually uses.
+    switch (get_opcode(insn))
+    {
+        case opcode_lui:
+        case opcode_auipc:
+            r.rd = get_rd(insn);
+            break;
+        case opcode_jal:
+            r.rd = get_rd(insn);
+            r.kind = insn_record::kind_jump;
+            break;
+        case opcode_jalr:
+            r.rd = get_rd(insn);
+            r.rs1 = get_rs1(insn);
+            r.kind = insn_record::kind_jump;
+            break;
+        case opcode_btype:
+            r.rs1 = get_rs1(insn);
+            r.rs2 = get_rs2(insn);
+            r.kind = insn_record::kind_branch;
+            break;
+        case opcode_load_imm:
+            r.rd = get_rd(insn);
+            r.rs1 = get_rs1(insn);
+            r.addr = regs.get(r.rs1) + get_imm_i(insn);
+            r.kind = insn_record::kind_load;
+            break;
+        case opcode_stype:
+            r.rs1 = get_rs1(insn);
+            r.rs2 = get_rs2(insn);
+            r.addr = regs.get(r.rs1) + get_imm_s(insn);
+            r.kind = insn_record::kind_store;
+            break;
+        case opcode_alu_imm:
+        case opcode_alu_imm_32:
+            r.rd = get_rd(insn);
+            r.rs1 = get_rs1(insn);
+            break;
+        case opcode_rtype:
+        case opcode_rtype_32:
+            r.rd = get_rd(insn);
+            r.rs1 = get_rs1(insn);
+            r.rs2 = get_rs2(insn);
+            r.kind = insn_kind(insn);
+            break;
+        case opcode_amo:
+            // An atomic both reads and writes memory, but its result in
+            // rd makes it behave like a load to the models.
+            r.rd = get_rd(insn);
+            r.rs1 = get_rs1(insn);
+            r.rs2 = get_rs2(insn);
+            r.addr = regs.get(r.rs1);
+            r.kind = insn_record::kind_load;
+            break;
+        case opcode_load_fp:
+            r.rd = insn_record::fp_reg_base + get_rd(insn);
+            r.rs1 = get_rs1(insn);
+            r.addr = regs.get(r.rs1) + get_imm_i(insn);
+            r.kind = insn_record::kind_load;
+            if (get_vec_eew(insn))
+            {
+                // A vector load has no offset, and a strided one reads
+                // the stride from rs2.
+                r.rd = insn_record::vec_reg_base + get_rd(insn);
+                r.rs2 = (get_mop(insn) == mop_strided) ? get_rs2(insn) : 0;
+                r.addr = regs.get(r.rs1);
+            }
+            break;
+        case opcode_store_fp:
+            r.rs1 = get_rs1(insn);
+            r.rs2 = insn_record::fp_reg_base + get_rs2(insn);
+            r.addr = regs.get(r.rs1) + get_imm_s(insn);
+            r.kind = insn_record::kind_store;
+            if (get_vec_eew(insn))
+            {
+                // The data of a vector store is in the rd field.
+                r.rs2 = insn_record::vec_reg_base + get_rd(insn);
+                r.rs3 = (get_mop(insn) == mop_strided) ? get_rs2(insn) : 0;
+                r.addr = regs.get(r.rs1);
+            }
+            break;
+        case opcode_op_fp:
+        case opcode_fmadd:
+        case opcode_fmsub:
+        case opcode_fnmsub:
+        case opcode_fnmadd:
+        {
+            // Which operands are f registers depends on the format.
+            int fp = get_fp_op(insn);
+            if (fp == fp_none)
+            {
+                break;
+            }
+            int format = get_fp_info(fp).format;
+            bool x_rd = (format == fp_fmt_xff || format == fp_fmt_xf);
+            r.rd = get_rd(insn) + (x_rd ? 0 : insn_record::fp_reg_base);
+            r.rs1 = get_rs1(insn) + (format == fp_fmt_fx ? 0 : insn_record::fp_reg_base);
+            if (format == fp_fmt_fff || format == fp_fmt_ffff || format == fp_fmt_xff)
+            {
+                r.rs2 = insn_record::fp_reg_base + get_rs2(insn);
+            }
+            if (format == fp_fmt_ffff)
+            {
+                r.rs3 = insn_record::fp_reg_base + get_rs3(insn);
+            }
+            r.kind = insn_record::kind_fp;
+            break;
+        }
+        case opcode_op_v:
+        {
+            r.rd = get_rd(insn);
+            if (get_funct3(insn) == funct3_opcfg)
+            {
+                // vsetivli has an immediate AVL, and vsetvl reads vtype
+                // from rs2.
+                if ((insn >> 30) != 0b11)
+                {
+                    r.rs1 = get_rs1(insn);
+                }
+                if ((insn >> 31) && (insn >> 30) != 0b11)
+                {
+                    r.rs2 = get_rs2(insn);
+                }
+                break;
+            }
+
+            // Which operands are v registers depends on the format and
+            // the form. A masked insn also reads v0.
+            int vec = get_vec_op(insn);
+            if (vec == vec_none)
+            {
+                break;
+            }
+            int format = get_vec_info(vec).format;
+            uint32_t funct3 = get_funct3(insn);
+            if (format != vec_fmt_xv)
+            {
+                r.rd += insn_record::vec_reg_base;
+            }
+            if (funct3 == funct3_opivx || funct3 == funct3_opmvx)
+            {
+                r.rs1 = get_rs1(insn);
+            }
+            else if (funct3 != funct3_opivi && format != vec_fmt_xv)
+            {
+                r.rs1 = insn_record::vec_reg_base + get_rs1(insn);
+            }
+            if (format != vec_fmt_vv && format != vec_fmt_vx)
+            {
+                r.rs2 = insn_record::vec_reg_base + get_rs2(insn);
+            }
+            if (!get_vm(insn))
+            {
+                r.rs3 = insn_record::vec_reg_base;
+            }
+            if (vec == vec_mul)
+            {
+                r.kind = insn_record::kind_mul;
+            }
+            break;
+        }
+        case opcode_system:
+            r.rd = get_rd(insn);
+            // The immediate CSR forms have no source register.
+            if ((get_funct3(insn) & 0b100) == 0)
+            {
+                r.rs1 = get_rs1(insn);
+            }
+            r.kind = insn_record::kind_system;
+            break;
+    }
+
+    return &r;
+}
+
+/**
+ * @brief Determines what the insn is and executes it.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream. In this program, it is cout.
+ * 
+ * @note If the instruction given is unrecognized, a message declaring
+ * the instruction was unrecognized is printed.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec(uint32_t insn, std::ostream* pos)
+{
+    // Get the opcode, funct3, and funct7 of the insn.
+    uint32_t opcode = get_opcode(insn);
+    uint32_t funct3 = get_funct3(insn);
+    uint32_t funct7 = get_funct7(insn);
+
+    switch (opcode)
+    {
+        case opcode_lui:
+            exec_lui(insn, pos);
+            return;
+        case opcode_auipc:
+            exec_auipc(insn, pos);
+            return;
+        case opcode_jal:
+            exec_jal(insn, pos);
+            return;
+        case opcode_jalr:
+            exec_jalr(insn, pos);
+            return;
+        case opcode_btype:
+            // A switch defined by funct3. This determines which b-type
+            // instruction the insn is.
+            switch(funct3)
+            {
+                case funct3_beq:
+                    exec_beq(insn, pos);
+                    return;
+                case funct3_bne:
+                    exec_bne(insn, pos);
+                    return;
+                case funct3_blt:
+                    exec_blt(insn, pos);
+                    return;
+                case funct3_bge:
+                    exec_bge(insn, pos);
+                    return;
+                case funct3_bltu:
+                    exec_bltu(insn, pos);
+                    return;
+                case funct3_bgeu:
+                    exec_bgeu(insn, pos);
+                    return;
+                default:
+                    // If none of the others, render the illegal_insn()
+                    exec_illegal_insn(insn, pos);
+                    return;
+            }
+            assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_load_imm:
+            // A switch defined by funct3. This determines which load
+            // instruction the insn is.
+            switch(funct3)
+                {
+                    case funct3_lb:
+                        exec_lb(insn, pos);
+                        return;
+                    case funct3_lh:
+                        exec_lh(insn, pos);
+                        return;
+                    case funct3_lw:
+                        exec_lw(insn, pos);
+                        return;
+                    case funct3_lbu:
+                        exec_lbu(insn, pos);
+                        return;
+                    case funct3_lhu:
+                        exec_lhu(insn, pos);
+                        return;
+                    case funct3_ld:
+                        // The doubleword and unsigned word loads are RV64 only.
+                        if (XLEN == 64)
+                        {
+                            exec_ld(insn, pos);
+                            return;
+                        }
+                        exec_illegal_insn(insn, pos);
+                        return;
+                    case funct3_lwu:
+                        if (XLEN == 64)
+                        {
+                            exec_lwu(insn, pos);
+                            return;
+                        }
+                        exec_illegal_insn(insn, pos);
+                        return;
+                    default:
+                        // If none of the others, render the illegal_insn()
+                        exec_illegal_insn(insn, pos);
+                        return;
+                }
+                assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_stype:
+            // A switch defined by funct3. This determines which s-type
+            // instruction the insn is.
+            switch(funct3)
+                {
+                    case funct3_sb:
+                        exec_sb(insn, pos);
+                        return;
+                    case funct3_sh:
+                        exec_sh(insn, pos);
+                        return;
+                    case funct3_sw:
+                        exec_sw(insn, pos);
+                        return;
+                    case funct3_sd:
+                        if (XLEN == 64)
+                        {
+                            exec_sd(insn, pos);
+                            return;
+                        }
+                        exec_illegal_insn(insn, pos);
+                        return;
+                    default:
+                        // If none of the others, render the illegal_insn()
+                        exec_illegal_insn(insn, pos);
+                        return;
+                }
+                assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_alu_imm:
+            {
+                // The bit-manipulation extensions share the opcode. They
+                // are only implemented for RV32.
+                int bm = (XLEN == 32) ? get_bitmanip(insn) : bm_none;
+                if (bm != bm_none)
+                {
+                    exec_bitmanip(insn, pos, bm);
+                    return;
+                }
+            }
+            // A switch defined by funct3. This determines which alu
+            // instruction the insn is.
+            switch(funct3)
+                {
+                    case funct3_add:
+                        exec_addi(insn, pos);
+                        return;
+                    case funct3_slt:
+                        exec_slti(insn, pos);
+                        return;
+                    case funct3_sltu:
+                        exec_sltiu(insn, pos);
+                        return;
+                    case funct3_xor:
+                        exec_xori(insn, pos);
+                        return;
+                    case funct3_or:
+                        exec_ori(insn, pos);
+                        return;
+                    case funct3_and:
+                        exec_andi(insn, pos);
+                        return;
+                    case funct3_sll:
+                        exec_slli(insn, pos);
+                        return;
+                    case funct3_srx:
+                        // An inner switch defiend by funct7. This determines which
+                        // srx instruction the insn is. On RV64 the low bit of
+                        // funct7 is the top bit of the 6-bit shift amount.
+                        switch(funct7 & ~(XLEN == 64 ? 1u : 0u))
+                        {
+                            case funct7_srl:
+                                exec_srli(insn, pos);
+                                return;
+                            case funct7_sra:
+                                exec_srai(insn, pos);
+                                return;
+                            default:
+                                exec_illegal_insn(insn, pos);
+                                return;
+                        }
+                        assert(0 && "unrecognized funct7"); // We should not get here
+                    default:
+                        // If none of the others, render the illegal_insn()
+                        exec_illegal_insn(insn, pos);
+                        return;
+                }
+                assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_rtype:
+            {
+                // The bit-manipulation extensions share the opcode.
+                int bm = (XLEN == 32) ? get_bitmanip(insn) : bm_none;
+                if (bm != bm_none)
+                {
+                    exec_bitmanip(insn, pos, bm);
+                    return;
+                }
+            }
+            // The M extension shares the opcode, told apart by funct7.
+            if (funct7 == funct7_muldiv)
+            {
+                // A switch defined by funct3. This determines which
+                // multiply or divide instruction the insn is.
+                switch(funct3)
+                {
+                    case funct3_mul:
+                        exec_mul(insn, pos);
+                        return;
+                    case funct3_mulh:
+                        exec_mulh(insn, pos);
+                        return;
+                    case funct3_mulhsu:
+                        exec_mulhsu(insn, pos);
+                        return;
+                    case funct3_mulhu:
+                        exec_mulhu(insn, pos);
+                        return;
+                    case funct3_div:
+                        exec_div(insn, pos);
+                        return;
+                    case funct3_divu:
+                        exec_divu(insn, pos);
+                        return;
+                    case funct3_rem:
+                        exec_rem(insn, pos);
+                        return;
+                    case funct3_remu:
+                        exec_remu(insn, pos);
+                        return;
+                }
+                assert(0 && "unrecognized funct3"); // We should not get here
+            }
+            // A switch defined by funct3. This determines which r-type
+            // instruction the insn is.
+            switch(funct3)
+                {
+                    case funct3_add:
+                        // An inner switch defiend by funct7. This determines which
+                        // add instruction the insn is.
+                        switch(funct7)
+                        {
+                            case funct7_add:
+                                exec_add(insn, pos);
+                                return;
+                            case funct7_sub:
+                                exec_sub(insn, pos);
+                                return;
+                            default:
+                                // If none of the others, render the illegal_insn()
+                                exec_illegal_insn(insn, pos);
+                                return;
+                        }
+                        assert(0 && "unrecognized funct7"); // We should not get here
+                    case funct3_sll:
+                        exec_sll(insn, pos);
+                        return;
+                    case funct3_slt:
+                        exec_slt(insn, pos);
+                        return;
+                    case funct3_sltu:
+                        exec_sltu(insn, pos);
+                        return;
+                    case funct3_xor:
+                        exec_xor(insn, pos);
+                        return;
+                    case funct3_srx:
+                        // Another inner switch defiend by funct7. This determines which
+                        // srx instruction the insn is.
+                        switch(funct7)
+                        {
+                            case funct7_srl:
+                                exec_srl(insn, pos);
+                                return;
+                            case funct7_sra:
+                                exec_sra(insn, pos);
+                                return;
+                            default:
+                                exec_illegal_insn(insn, pos);
+                                return;
+                        }
+                        assert(0 && "unrecognized funct7"); // We should not get here
+                    case funct3_or:
+                        exec_or(insn, pos);
+                        return;
+                    case funct3_and:
+                        exec_and(insn, pos);
+                        return;
+                    default:
+                        // If none of the others, render the illegal_insn()
+                        exec_illegal_insn(insn, pos);
+                        return;
+                }
+                assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_alu_imm_32:
+            // The W instructions are RV64 only.
+            if (XLEN != 64)
+            {
+                exec_illegal_insn(insn, pos);
+                return;
+            }
+            // A switch defined by funct3. This determines which alu
+            // W instruction the insn is.
+            switch(funct3)
+            {
+                case funct3_add:
+                    exec_addiw(insn, pos);
+                    return;
+                case funct3_sll:
+                    if (funct7 != 0)
+                    {
+                        exec_illegal_insn(insn, pos);
+                        return;
+                    }
+                    exec_slliw(insn, pos);
+                    return;
+                case funct3_srx:
+                    switch(funct7)
+                    {
+                        case funct7_srl:
+                            exec_srliw(insn, pos);
+                            return;
+                        case funct7_sra:
+                            exec_sraiw(insn, pos);
+                            return;
+                        default:
+                            exec_illegal_insn(insn, pos);
+                            return;
+                    }
+                    assert(0 && "unrecognized funct7"); // We should not get here
+                default:
+                    // If none of the others, render the illegal_insn()
+                    exec_illegal_insn(insn, pos);
+                    return;
+            }
+            assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_rtype_32:
+            if (XLEN != 64)
+            {
+                exec_illegal_insn(insn, pos);
+                return;
+            }
+            // A switch defined by funct7 and funct3. This determines
+            // which r-type W instruction the insn is.
+            switch((funct7 << 3) | funct3)
+            {
+                case (funct7_add << 3) | funct3_add:
+                    exec_addw(insn, pos);
+                    return;
+                case (funct7_sub << 3) | funct3_add:
+                    exec_subw(insn, pos);
+                    return;
+                case (funct7_add << 3) | funct3_sll:
+                    exec_sllw(insn, pos);
+                    return;
+                case (funct7_srl << 3) | funct3_srx:
+                    exec_srlw(insn, pos);
+                    return;
+                case (funct7_sra << 3) | funct3_srx:
+                    exec_sraw(insn, pos);
+                    return;
+                case (funct7_muldiv << 3) | funct3_mul:
+                    exec_mulw(insn, pos);
+                    return;
+                case (funct7_muldiv << 3) | funct3_div:
+                    exec_divw(insn, pos);
+                    return;
+                case (funct7_muldiv << 3) | funct3_divu:
+                    exec_divuw(insn, pos);
+                    return;
+                case (funct7_muldiv << 3) | funct3_rem:
+                    exec_remw(insn, pos);
+                    return;
+                case (funct7_muldiv << 3) | funct3_remu:
+                    exec_remuw(insn, pos);
+                    return;
+                default:
+                    // If none of the others, render the illegal_insn()
+                    exec_illegal_insn(insn, pos);
+                    return;
+            }
+            assert(0 && "unrecognized funct7"); // We should not get here
+        case opcode_amo:
+            // Only the word-sized atomics are implemented.
+            if (funct3 != funct3_amo_w)
+            {
+                exec_illegal_insn(insn, pos);
+                return;
+            }
+            // A switch defined by funct5. This determines which atomic
+            // instruction the insn is.
+            switch(get_funct5(insn))
+            {
+                case funct5_lr:
+                    if (get_rs2(insn) != 0)
+                    {
+                        exec_illegal_insn(insn, pos);
+                        return;
+                    }
+                    exec_lr_w(insn, pos);
+                    return;
+                case funct5_sc:
+                    exec_sc_w(insn, pos);
+                    return;
+                case funct5_amoswap:
+                    exec_amo(insn, pos, "amoswap.w", memory::amo_swap);
+                    return;
+                case funct5_amoadd:
+                    exec_amo(insn, pos, "amoadd.w", memory::amo_add);
+                    return;
+                case funct5_amoxor:
+                    exec_amo(insn, pos, "amoxor.w", memory::amo_xor);
+                    return;
+                case funct5_amoand:
+                    exec_amo(insn, pos, "amoand.w", memory::amo_and);
+                    return;
+                case funct5_amoor:
+                    exec_amo(insn, pos, "amoor.w", memory::amo_or);
+                    return;
+                case funct5_amomin:
+                    exec_amo(insn, pos, "amomin.w", memory::amo_min);
+                    return;
+                case funct5_amomax:
+                    exec_amo(insn, pos, "amomax.w", memory::amo_max);
+                    return;
+                case funct5_amominu:
+                    exec_amo(insn, pos, "amominu.w", memory::amo_minu);
+                    return;
+                case funct5_amomaxu:
+                    exec_amo(insn, pos, "amomaxu.w", memory::amo_maxu);
+                    return;
+                default:
+                    // If none of the others, render the illegal_insn()
+                    exec_illegal_insn(insn, pos);
+                    return;
+            }
+            assert(0 && "unrecognized funct5"); // We should not get here
+        case opcode_load_fp:
+            // The vector loads have widths of their own.
+            if (get_vec_eew(insn))
+            {
+                exec_vec_mem(insn, pos, false);
+                return;
+            }
+
+            // A switch defined by funct3. This determines the precision
+            // of the load.
+            switch(funct3)
+            {
+                case funct3_flw:
+                    exec_flw(insn, pos);
+                    return;
+                case funct3_fld:
+                    exec_fld(insn, pos);
+                    return;
+                default:
+                    // If none of the others, render the illegal_insn()
+                    exec_illegal_insn(insn, pos);
+                    return;
+            }
+            assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_store_fp:
+            // The vector stores have widths of their own.
+            if (get_vec_eew(insn))
+            {
+                exec_vec_mem(insn, pos, true);
+                return;
+            }
+
+            // A switch defined by funct3. This determines the precision
+            // of the store.
+            switch(funct3)
+            {
+                case funct3_fsw:
+                    exec_fsw(insn, pos);
+                    return;
+                case funct3_fsd:
+                    exec_fsd(insn, pos);
+                    return;
+                default:
+                    // If none of the others, render the illegal_insn()
+                    exec_illegal_insn(insn, pos);
+                    return;
+            }
+            assert(0 && "unrecognized funct3"); // We should not get here
+        case opcode_op_fp:
+        case opcode_fmadd:
+        case opcode_fmsub:
+        case opcode_fnmsub:
+        case opcode_fnmadd:
+            {
+                int fp = get_fp_op(insn);
+                if (fp == fp_none)
+                {
+                    exec_illegal_insn(insn, pos);
+                    return;
+                }
+                exec_fp(insn, pos, fp);
+                return;
+            }
+        case opcode_op_v:
+            {
+                if (funct3 == funct3_opcfg)
+                {
+                    exec_vsetvl(insn, pos);
+                    return;
+                }
+                int vec = get_vec_op(insn);
+                if (vec == vec_none)
+                {
+                    exec_illegal_insn(insn, pos);
+                    return;
+                }
+                exec_vec(insn, pos, vec);
+                return;
+            }
+        case opcode_system:
+            // A switch defined by funct3. This determines which system
+            // instruction the insn is.
+            switch(funct3)
+                {
+                    case 0b000:
+                        // An inner switch defiend by the insn itself. This determines
+                        // e instruction the insn is.
+                        switch(insn)
+                        {
+                            case insn_ecall:
+                                exec_ecall(insn, pos);
+                                return;
+                            case insn_ebreak:
+                                exec_ebreak(insn, pos);
+                                return;
+                            case insn_mret:
+                                exec_mret(insn, pos);
+                                return;
+                            case insn_sret:
+                                exec_sret(insn, pos);
+                                return;
+                            case insn_wfi:
+                                exec_wfi(insn, pos);
+                                return;
+                            default:
+                                if ((insn & sfence_vma_mask) == insn_sfence_vma)
+                                {
+                                    exec_sfence_vma(insn, pos);
+                                    return;
+                                }
+                                // If none of the others, render the illegal_insn()
+                                exec_illegal_insn(insn, pos);
+                                return;
+                        }
+                        assert(0 && "unrecognized insn"); // We should not get here
+                    case funct3_csrrw:
+                        exec_csrrw(insn, pos);
+                        return;
+                    case funct3_csrrs:
+                        exec_csrrs(insn, pos);
+                        return;
+                    case funct3_csrrc:
+                        exec_csrrc(insn, pos);
+                        return;
+                    case funct3_csrrwi:
+                        exec_csrrwi(insn, pos);
+                        return;
+                    case funct3_csrrsi:
+                        exec_csrrsi(insn, pos);
+                        return;
+                    case funct3_csrrci:
+                        exec_csrrci(insn, pos);
+                        return;
+                    default:
+                        exec_illegal_insn(insn, pos);
+                        return;
+                }
+                assert(0 && "unrecognized funct3"); // We should not get here
+        default:
+            // If none of the others, render the illegal_insn()
+            exec_illegal_insn(insn, pos);
+            return;
+    }
+    assert(0 && "unrecognized opcode"); // We should not get here
+}
+
+/**
+ * @defgroup exec_x
+ * Executes an instruction.
+ * 
+ * @param insn The instruction to execute.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * 
+ * @note If pos is passed in and not nullptr, the fucntion prints what
+ * the instruction does.
+ * 
+ * @{
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_illegal_insn(uint32_t insn, std::ostream* pos) ///< Execute illegal_insn
+{
+    if (pos)
+    {
+        *pos << render_illegal_insn(insn);
+    }
+    
+    // Trap, or halt if there is no handler.
+    trap(cause_illegal_insn, insn, "Illegal instruction");
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lui(uint32_t insn, std::ostream* pos)          ///< Execute lui
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_u(insn);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_lui(insn);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(imm);
+    }
+
+    // Set the register at rd to the value of imm.
+    regs.set(rd, imm);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_auipc(uint32_t insn, std::ostream* pos)    ///< Execite auipc
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_u(insn);
+
+    // Determine the value.
+    sreg_t val = pc + imm;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_auipc(insn);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(pc) << " + " 
+             << to_hex0xlen(imm) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_jal(uint32_t insn, std::ostream* pos)      ///< Execute jal
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_j(insn);
+
+    // Determine the values.
+    sreg_t val = pc + insn_len;
+    reg_t val2 = pc + imm;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_jal(pc, insn);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(val) << ",  pc = "
+             << to_hex0xlen(pc) << " + " << to_hex0xlen(imm) << " = " << to_hex0xlen(val2);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Set the pc to pc + imm.
+    pc = val2;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_jalr(uint32_t insn, std::ostream* pos)     ///< Execute jalr
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    reg_t val = (regs.get(rs1) + imm) & ~1;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_jalr(insn);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(pc + insn_len) << ",  pc = ("
+             << to_hex0xlen(imm) << " + " << to_hex0xlen(regs.get(rs1)) << ") & " 
+             << to_hex0xlen(~1) << " = " <<  to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the address of the next instruction.
+    regs.set(rd, (pc + insn_len));
+    // Set the pc to val.
+    pc = val;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_beq(uint32_t insn, std::ostream* pos)      ///< Execute beq
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_b(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    reg_t val = pc + ((regs.get(rs1) == regs.get(rs2)) ? (sreg_t) imm : insn_len);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_btype(pc, insn, "beq");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << "pc += (" << to_hex0xlen(regs.get(rs1)) << " == "
+             << to_hex0xlen(regs.get(rs2)) << " ? " << to_hex0xlen(imm) << " : " << insn_len << ") = "
+             << to_hex0xlen(val);
+    }
+
+    // Set the pc to val.
+    pc = val;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_bne(uint32_t insn, std::ostream* pos)      ///< Execute bne
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_b(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    reg_t val = pc + ((regs.get(rs1) != regs.get(rs2)) ? (sreg_t) imm : insn_len);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_btype(pc, insn, "bne");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << "pc += (" << to_hex0xlen(regs.get(rs1)) << " != "
+             << to_hex0xlen(regs.get(rs2)) << " ? " << to_hex0xlen(imm) << " : " << insn_len << ") = "
+             << to_hex0xlen(val);
+    }
+
+    // Set the pc to val.
+    pc = val;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_blt(uint32_t insn, std::ostream* pos)      ///< Execute blt
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_b(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    reg_t val = pc + ((regs.get(rs1) < regs.get(rs2)) ? (sreg_t) imm : insn_len);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_btype(pc, insn, "blt");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << "pc += (" << to_hex0xlen(regs.get(rs1)) << " < "
+             << to_hex0xlen(regs.get(rs2)) << " ? " << to_hex0xlen(imm) << " : " << insn_len << ") = "
+             << to_hex0xlen(val);
+    }
+
+    // Set the pc to val.
+    pc = val;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_bge(uint32_t insn, std::ostream* pos)      ///< Execute bge
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_b(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    reg_t val = pc + ((regs.get(rs1) >= regs.get(rs2)) ? (sreg_t) imm : insn_len);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_btype(pc, insn, "bge");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << "pc += (" << to_hex0xlen(regs.get(rs1)) << " >= "
+             << to_hex0xlen(regs.get(rs2)) << " ? " << to_hex0xlen(imm) << " : " << insn_len << ") = "
+             << to_hex0xlen(val);
+    }
+
+    // Set the pc to val.
+    pc = val;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_bltu(uint32_t insn, std::ostream* pos)     ///< Execute bltu
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_b(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    reg_t val = pc + (((reg_t)regs.get(rs1)) < ((reg_t)regs.get(rs2)) ? (sreg_t) imm : insn_len);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_btype(pc, insn, "bltu");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << "pc += (" << to_hex0xlen(regs.get(rs1)) << " <U "
+             << to_hex0xlen(regs.get(rs2)) << " ? " << to_hex0xlen(imm) << " : " << insn_len << ") = "
+             << to_hex0xlen(val);
+    }
+
+    // Set the pc to val.
+    pc = val;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_bgeu(uint32_t insn, std::ostream* pos)     ///< Execute bgeu
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_b(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    reg_t val = pc + (((reg_t)regs.get(rs1)) >= ((reg_t)regs.get(rs2)) ? (sreg_t) imm : insn_len);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_btype(pc, insn, "bgeu");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << "pc += (" << to_hex0xlen(regs.get(rs1)) << " >=U "
+             << to_hex0xlen(regs.get(rs2)) << " ? " << to_hex0xlen(imm) << " : " << insn_len << ") = "
+             << to_hex0xlen(val);
+    }
+
+    // Set the pc to val.
+    pc = val;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lb(uint32_t insn, std::ostream* pos)       ///< Execute lb
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    int8_t m;
+    if (!load(regs.get(rs1) + imm, m))
+        return;
+    sreg_t val = m;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_load(insn, "lb");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << "sx(m8(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ")) = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lh(uint32_t insn, std::ostream* pos)       ///< Execute lh
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    int16_t m;
+    if (!load(regs.get(rs1) + imm, m))
+        return;
+    sreg_t val = m;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_load(insn, "lh");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << "sx(m16(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ")) = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lw(uint32_t insn, std::ostream* pos)       ///< Execute lw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    int32_t m;
+    if (!load(regs.get(rs1) + imm, m))
+        return;
+    sreg_t val = m;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_load(insn, "lw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << "sx(m32(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ")) = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lbu(uint32_t insn, std::ostream* pos)      ///< Execute lbu
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    uint8_t m;
+    if (!load(regs.get(rs1) + imm, m))
+        return;
+    sreg_t val = m;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_load(insn, "lbu");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << "zx(m8(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ")) = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lhu(uint32_t insn, std::ostream* pos)      ///< Execute lhu
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    uint16_t m;
+    if (!load(regs.get(rs1) + imm, m))
+        return;
+    sreg_t val = m;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_load(insn, "lhu");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << "zx(m16(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ")) = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_ld(uint32_t insn, std::ostream* pos)       ///< Execute ld
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    uint64_t m;
+    if (!load(regs.get(rs1) + imm, m))
+        return;
+    sreg_t val = m;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_load(insn, "ld");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << "m64(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ") = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lwu(uint32_t insn, std::ostream* pos)      ///< Execute lwu
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    uint32_t m;
+    if (!load(regs.get(rs1) + imm, m))
+        return;
+    sreg_t val = m;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_load(insn, "lwu");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << "zx(m32(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ")) = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sb(uint32_t insn, std::ostream* pos)       ///< Execute sb
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_s(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    uint8_t val = (regs.get(rs2) /*& 0x000000ff*/);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_stype(insn, "sb");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// m8(" << to_hex0xlen(regs.get(rs1)) << " + " << to_hex0xlen(imm) 
+             << ") = " << hex::to_hex0x32(val);
+    }
+
+    // Set the 8 bytes at rs1+imm to val.
+    if (!store(regs.get(rs1) + imm, val))
+        return;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sh(uint32_t insn, std::ostream* pos)       ///< Execute sh
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_s(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    uint16_t val = (regs.get(rs2) /*& 0x0000ffff*/);
+
+    if (pos)
+    {
+        std::string s = render_stype(insn, "sh");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// m16(" << to_hex0xlen(regs.get(rs1)) << " + " << to_hex0xlen(imm) 
+             << ") = " << hex::to_hex0x32(val);
+    }
+
+    // Set the 16 bytes at rs1+imm to val.
+    if (!store(regs.get(rs1) + imm, val))
+        return;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sw(uint32_t insn, std::ostream* pos)       ///< Execute sw
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_s(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    int32_t val = regs.get(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_stype(insn, "sw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// m32(" << to_hex0xlen(regs.get(rs1)) << " + " << to_hex0xlen(imm) 
+             << ") = " << hex::to_hex0x32(val);
+    }
+
+    // Set the 32 bytes at rs1+imm to val.
+    if (!store(regs.get(rs1) + imm, val))
+        return;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sd(uint32_t insn, std::ostream* pos)       ///< Execute sd
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_s(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    uint64_t val = regs.get(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_stype(insn, "sd");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// m64(" << to_hex0xlen(regs.get(rs1)) << " + " << to_hex0xlen(imm) 
+             << ") = " << to_hex0xlen(val);
+    }
+
+    // Set the 8 bytes at rs1+imm to val.
+    if (!store(regs.get(rs1) + imm, val))
+        return;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_flw(uint32_t insn, std::ostream* pos)      ///< Execute flw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    uint32_t val;
+    if (!load(regs.get(rs1) + imm, val))
+        return;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_fp_load(insn, "flw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_freg(rd) << " = " << "m32(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ") = " << hex::to_hex0x32(val);
+    }
+
+    // Set the register at rd to the NaN-boxed value of val.
+    fregs.set_s(rd, val);
+    fp_used = true;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_fld(uint32_t insn, std::ostream* pos)      ///< Execute fld
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    uint64_t val;
+    if (!load(regs.get(rs1) + imm, val))
+        return;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_fp_load(insn, "fld");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_freg(rd) << " = " << "m64(" << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << ") = " << hex::to_hex0x32(val >> 32)
+             << hex::to_hex32(val);
+    }
+
+    // Set the register at rd to the value of val.
+    fregs.set_d(rd, val);
+    fp_used = true;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_fsw(uint32_t insn, std::ostream* pos)      ///< Execute fsw
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_s(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value. fsw stores the low bits whether or not
+    // they are NaN-boxed.
+    uint32_t val = fregs.get_d(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_fp_store(insn, "fsw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// m32(" << to_hex0xlen(regs.get(rs1)) << " + " << to_hex0xlen(imm) 
+             << ") = " << hex::to_hex0x32(val);
+    }
+
+    // Set the 4 bytes at rs1+imm to val.
+    if (!store(regs.get(rs1) + imm, val))
+        return;
+    fp_used = true;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_fsd(uint32_t insn, std::ostream* pos)      ///< Execute fsd
+{
+    // Get the required parts of the insn.
+    int32_t imm = get_imm_s(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    uint64_t val = fregs.get_d(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_fp_store(insn, "fsd");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// m64(" << to_hex0xlen(regs.get(rs1)) << " + " << to_hex0xlen(imm) 
+             << ") = " << hex::to_hex0x32(val >> 32) << hex::to_hex32(val);
+    }
+
+    // Set the 8 bytes at rs1+imm to val.
+    if (!store(regs.get(rs1) + imm, val))
+        return;
+    fp_used = true;
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_addi(uint32_t insn, std::ostream* pos)     ///< Execute addi
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) + imm;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "addi", imm);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_slti(uint32_t insn, std::ostream* pos)     ///< Execute slti
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = ((regs.get(rs1) < imm) ? 1 : 0);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "slti", imm);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = (" << to_hex0xlen(regs.get(rs1)) 
+             << " < " << imm << ") ? 1 : 0 = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sltiu(uint32_t insn, std::ostream* pos)    ///< Execute sltiu
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = ((( reg_t) regs.get(rs1) < (reg_t) imm) ? 1 : 0);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "sltiu", imm);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = (" << to_hex0xlen(regs.get(rs1)) 
+             << " <U " << imm << ") ? 1 : 0 = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_xori(uint32_t insn, std::ostream* pos)     ///< Execute xori
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) ^ imm;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "xori", imm);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " ^ " << to_hex0xlen(imm) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_ori(uint32_t insn, std::ostream* pos)      ///< Execute ori
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) | imm;
+
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "ori", imm);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " | " << to_hex0xlen(imm) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_andi(uint32_t insn, std::ostream* pos)     ///< Execute andi
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) & imm;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "andi", imm);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " & " << to_hex0xlen(imm) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_slli(uint32_t insn, std::ostream* pos)     ///< Execute slli
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t shamt = (get_imm_i(insn) & (XLEN - 1));
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = (regs.get(rs1) << shamt);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "slli", shamt);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " << " << shamt << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_srli(uint32_t insn, std::ostream* pos)     ///< Execute srli
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t shamt = (get_imm_i(insn) & (XLEN - 1));
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = ((reg_t)regs.get(rs1) >> shamt);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "srli", shamt);
+        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << shamt << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_srai(uint32_t insn, std::ostream* pos)     ///< Execute srai
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t shamt = (get_imm_i(insn) & (XLEN - 1));
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value.
+    sreg_t val = (regs.get(rs1) >> shamt);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "srai", shamt);
+        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << shamt << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_add(uint32_t insn, std::ostream* pos)      ///< Execute add
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) + regs.get(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "add");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sub(uint32_t insn, std::ostream* pos)      ///< Execute sub
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) - regs.get(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "sub");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " - " << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sll(uint32_t insn, std::ostream* pos)      ///< Execute sll
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) << (((reg_t) regs.get(rs2))%XLEN);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "sll");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " << " << ((reg_t) regs.get(rs2))%XLEN << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_slt(uint32_t insn, std::ostream* pos)      ///< Execute slt
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = (regs.get(rs1) < regs.get(rs2)) ? 1 : 0;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "slt");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = (" << to_hex0xlen(regs.get(rs1)) << " < "
+             << to_hex0xlen(regs.get(rs2)) << ") ? 1 : 0 = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sltu(uint32_t insn, std::ostream* pos)     ///< Execute sltu
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = (regs.get(rs1) < regs.get(rs2)) ? 1 : 0;
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "sltu");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = (" << to_hex0xlen(regs.get(rs1)) << " <U "
+             << to_hex0xlen(regs.get(rs2)) << ") ? 1 : 0 = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_xor(uint32_t insn, std::ostream* pos)      ///< Execute xor
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) ^ regs.get(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "xor");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " ^ "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_srl(uint32_t insn, std::ostream* pos)      ///< Execute srl
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = (reg_t) regs.get(rs1) >> ((reg_t)(regs.get(rs2))%XLEN);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "srl");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << ((reg_t) regs.get(rs2))%XLEN << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sra(uint32_t insn, std::ostream* pos)      ///< Execute sra
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) >> (((reg_t) regs.get(rs2))%XLEN);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "sra");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << ((reg_t) regs.get(rs2))%XLEN << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_or(uint32_t insn, std::ostream* pos)       ///< Execute or
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) | regs.get(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "or");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " | "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
     }
-    assert(0 && "unrecognized opcode"); // We should not get here
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-/**
- * @defgroup exec_x
- * Executes an instruction.
- * 
- * @param insn The instruction to execute.
- * @param pos The ostream passed in. In this program, it is cout.
- * 
- * @note If pos is passed in and not nullptr, the fucntion prints what
- * the instruction does.
- * 
- * @{
-*/
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_and(uint32_t insn, std::ostream* pos)      ///< Execute and
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value.
+    sreg_t val = regs.get(rs1) & regs.get(rs2);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "and");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " & "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
+    }
 
-void rv32i_hart::exec_illegal_insn(uint32_t insn, std::ostream* pos)    ///< Execute illegal_insn
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_addiw(uint32_t insn, std::ostream* pos)    ///< Execute addiw
 {
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    int32_t imm = get_imm_i(insn);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) (regs.get(rs1) + imm);
+
+    // If cout was passed, print what the instruction does.
     if (pos)
     {
-        *pos << render_illegal_insn(insn);
+        std::string s = render_itype_alu(insn, "addiw", imm);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(imm) << " = " << to_hex0xlen(val);
     }
-    
-    // Set halt to true.
-    halt = true;
-    // Set the halt_reason.
-    halt_reason = "Illegal instruction";
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_lui(uint32_t insn, std::ostream* pos)             ///< Execute lui
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_slliw(uint32_t insn, std::ostream* pos)    ///< Execute slliw
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_u(insn);
+    uint32_t shamt = (get_imm_i(insn) & 0x0000001f);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((uint32_t) regs.get(rs1) << shamt);
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_lui(insn);
+        std::string s = render_itype_alu(insn, "slliw", shamt);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(imm);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " << " << shamt << " = " << to_hex0xlen(val);
     }
 
-    // Set the register at rd to the value of imm.
-    regs.set(rd, imm);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_auipc(uint32_t insn, std::ostream* pos)       ///< Execite auipc
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_srliw(uint32_t insn, std::ostream* pos)    ///< Execute srliw
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_u(insn);
+    uint32_t shamt = (get_imm_i(insn) & 0x0000001f);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((uint32_t) regs.get(rs1) >> shamt);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "srliw", shamt);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << shamt << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sraiw(uint32_t insn, std::ostream* pos)    ///< Execute sraiw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t shamt = (get_imm_i(insn) & 0x0000001f);
+    uint32_t rs1 = get_rs1(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((int32_t) regs.get(rs1) >> shamt);
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_itype_alu(insn, "sraiw", shamt);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << shamt << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_addw(uint32_t insn, std::ostream* pos)     ///< Execute addw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((uint32_t) regs.get(rs1) + (uint32_t) regs.get(rs2));
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "addw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " + " << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_subw(uint32_t insn, std::ostream* pos)     ///< Execute subw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((uint32_t) regs.get(rs1) - (uint32_t) regs.get(rs2));
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "subw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " - " << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sllw(uint32_t insn, std::ostream* pos)     ///< Execute sllw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((uint32_t) regs.get(rs1) << (regs.get(rs2) & 0x1f));
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "sllw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " << " << (regs.get(rs2) & 0x1f) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_srlw(uint32_t insn, std::ostream* pos)     ///< Execute srlw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((uint32_t) regs.get(rs1) >> (regs.get(rs2) & 0x1f));
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "srlw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << (regs.get(rs2) & 0x1f) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sraw(uint32_t insn, std::ostream* pos)     ///< Execute sraw
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((int32_t) regs.get(rs1) >> (regs.get(rs2) & 0x1f));
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "sraw");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " >> " << (regs.get(rs2) & 0x1f) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_mul(uint32_t insn, std::ostream* pos)      ///< Execute mul
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
 
     // Determine the value.
-    int32_t val = pc + imm;
+    sreg_t val = (reg_t) regs.get(rs1) * (reg_t) regs.get(rs2);
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_auipc(insn);
+        std::string s = render_rtype(insn, "mul");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(pc) << " + " 
-             << hex::to_hex0x32(imm) << " = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " * "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_jal(uint32_t insn, std::ostream* pos)         ///< Execute jal
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_mulh(uint32_t insn, std::ostream* pos)     ///< Execute mulh
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_j(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
 
-    // Determine the values.
-    int32_t val = pc + 4;
-    uint32_t val2 = pc + imm;
+    // Determine the value.
+    sreg_t val = ((swide_t) regs.get(rs1) * (swide_t) regs.get(rs2)) >> XLEN;
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_jal(pc, insn);
+        std::string s = render_rtype(insn, "mulh");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(val) << ",  pc = "
-             << hex::to_hex0x32(pc) << " + " << hex::to_hex0x32(imm) << " = " << hex::to_hex0x32(val2);
+        *pos << "// " << render_reg(rd) << " = (" << to_hex0xlen(regs.get(rs1)) << " * "
+             << to_hex0xlen(regs.get(rs2)) << ") >> " << XLEN << " = " << to_hex0xlen(val);
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Set the pc to pc + imm.
-    pc = val2;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_jalr(uint32_t insn, std::ostream* pos)        ///< Execute jalr
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_mulhsu(uint32_t insn, std::ostream* pos)   ///< Execute mulhsu
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
     uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
 
     // Determine the value.
-    uint32_t val = (regs.get(rs1) + imm) & ~1;
+    sreg_t val = ((swide_t) regs.get(rs1) * (swide_t)(reg_t) regs.get(rs2)) >> XLEN;
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_jalr(insn);
+        std::string s = render_rtype(insn, "mulhsu");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(pc + 4) << ",  pc = ("
-             << hex::to_hex0x32(imm) << " + " << hex::to_hex0x32(regs.get(rs1)) << ") & " 
-             << hex::to_hex0x32(~1) << " = " <<  hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = (" << to_hex0xlen(regs.get(rs1)) << " * "
+             << to_hex0xlen(regs.get(rs2)) << ") >> " << XLEN << " = " << to_hex0xlen(val);
     }
 
-    // Set the register at rd to the value of pc+4.
-    regs.set(rd, (pc + 4));
-    // Set the pc to val.
-    pc = val;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_beq(uint32_t insn, std::ostream* pos)         ///< Execute beq
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_mulhu(uint32_t insn, std::ostream* pos)    ///< Execute mulhu
 {
     // Get the required parts of the insn.
-    int32_t imm = get_imm_b(insn);
+    uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
 
     // Determine the value.
-    uint32_t val = pc + ((regs.get(rs1) == regs.get(rs2)) ? imm : 4);
+    sreg_t val = ((wide_t)(reg_t) regs.get(rs1) * (wide_t)(reg_t) regs.get(rs2)) >> XLEN;
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "beq");
+        std::string s = render_rtype(insn, "mulhu");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << "pc += (" << hex::to_hex0x32(regs.get(rs1)) << " == "
-             << hex::to_hex0x32(regs.get(rs2)) << " ? " << hex::to_hex0x32(imm) << " : 4) = "
-             << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = (" << to_hex0xlen(regs.get(rs1)) << " * "
+             << to_hex0xlen(regs.get(rs2)) << ") >> " << XLEN << " = " << to_hex0xlen(val);
     }
 
-    // Set the pc to val.
-    pc = val;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_bne(uint32_t insn, std::ostream* pos)         ///< Execute bne
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_div(uint32_t insn, std::ostream* pos)      ///< Execute div
 {
     // Get the required parts of the insn.
-    int32_t imm = get_imm_b(insn);
+    uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
+    sreg_t dividend = regs.get(rs1);
+    sreg_t divisor = regs.get(rs2);
 
     // Determine the value.
-    uint32_t val = pc + ((regs.get(rs1) != regs.get(rs2)) ? imm : 4);
+    // Divide by zero gives -1, and the one overflowing case gives the
+    // dividend back.
+    sreg_t val;
+    if (divisor == 0)
+    {
+        val = -1;
+    }
+    else if (dividend == std::numeric_limits<sreg_t>::min() && divisor == -1)
+    {
+        val = dividend;
+    }
+    else
+    {
+        val = dividend / divisor;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bne");
+        std::string s = render_rtype(insn, "div");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << "pc += (" << hex::to_hex0x32(regs.get(rs1)) << " != "
-             << hex::to_hex0x32(regs.get(rs2)) << " ? " << hex::to_hex0x32(imm) << " : 4) = "
-             << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " / "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
     }
 
-    // Set the pc to val.
-    pc = val;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_blt(uint32_t insn, std::ostream* pos)         ///< Execute blt
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_divu(uint32_t insn, std::ostream* pos)     ///< Execute divu
 {
     // Get the required parts of the insn.
-    int32_t imm = get_imm_b(insn);
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    reg_t dividend = regs.get(rs1);
+    reg_t divisor = regs.get(rs2);
+
+    // Determine the value.
+    // Divide by zero gives all ones.
+    sreg_t val;
+    if (divisor == 0)
+    {
+        val = -1;
+    }
+    else
+    {
+        val = dividend / divisor;
+    }
+
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_rtype(insn, "divu");
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " / "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
+    }
+
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_rem(uint32_t insn, std::ostream* pos)      ///< Execute rem
+{
+    // Get the required parts of the insn.
+    uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
+    sreg_t dividend = regs.get(rs1);
+    sreg_t divisor = regs.get(rs2);
 
     // Determine the value.
-    uint32_t val = pc + ((regs.get(rs1) < regs.get(rs2)) ? imm : 4);
+    // Divide by zero gives the dividend back, and the one overflowing
+    // case has no remainder.
+    sreg_t val;
+    if (divisor == 0)
+    {
+        val = dividend;
+    }
+    else if (dividend == std::numeric_limits<sreg_t>::min() && divisor == -1)
+    {
+        val = 0;
+    }
+    else
+    {
+        val = dividend % divisor;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "blt");
+        std::string s = render_rtype(insn, "rem");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << "pc += (" << hex::to_hex0x32(regs.get(rs1)) << " < "
-             << hex::to_hex0x32(regs.get(rs2)) << " ? " << hex::to_hex0x32(imm) << " : 4) = "
-             << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " % "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
     }
 
-    // Set the pc to val.
-    pc = val;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_bge(uint32_t insn, std::ostream* pos)         ///< Execute bge
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_remu(uint32_t insn, std::ostream* pos)     ///< Execute remu
 {
     // Get the required parts of the insn.
-    int32_t imm = get_imm_b(insn);
+    uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
+    reg_t dividend = regs.get(rs1);
+    reg_t divisor = regs.get(rs2);
 
     // Determine the value.
-    uint32_t val = pc + ((regs.get(rs1) >= regs.get(rs2)) ? imm : 4);
+    // Divide by zero gives the dividend back.
+    sreg_t val;
+    if (divisor == 0)
+    {
+        val = dividend;
+    }
+    else
+    {
+        val = dividend % divisor;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bge");
+        std::string s = render_rtype(insn, "remu");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << "pc += (" << hex::to_hex0x32(regs.get(rs1)) << " >= "
-             << hex::to_hex0x32(regs.get(rs2)) << " ? " << hex::to_hex0x32(imm) << " : 4) = "
-             << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " % "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
     }
 
-    // Set the pc to val.
-    pc = val;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_bltu(uint32_t insn, std::ostream* pos)        ///< Execute bltu
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_mulw(uint32_t insn, std::ostream* pos)     ///< Execute mulw
 {
     // Get the required parts of the insn.
-    int32_t imm = get_imm_b(insn);
+    uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
 
-    // Determine the value.
-    uint32_t val = pc + (((uint32_t)regs.get(rs1)) < ((uint32_t)regs.get(rs2)) ? imm : 4);
+    // Determine the value, sign-extended from 32 bits.
+    sreg_t val = (int32_t) ((uint32_t) regs.get(rs1) * (uint32_t) regs.get(rs2));
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bltu");
+        std::string s = render_rtype(insn, "mulw");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << "pc += (" << hex::to_hex0x32(regs.get(rs1)) << " <U "
-             << hex::to_hex0x32(regs.get(rs2)) << " ? " << hex::to_hex0x32(imm) << " : 4) = "
-             << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) 
+             << " * " << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen(val);
     }
 
-    // Set the pc to val.
-    pc = val;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_bgeu(uint32_t insn, std::ostream* pos)        ///< Execute bgeu
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_divw(uint32_t insn, std::ostream* pos)     ///< Execute divw
 {
     // Get the required parts of the insn.
-    int32_t imm = get_imm_b(insn);
+    uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
-
-    // Determine the value.
-    uint32_t val = pc + (((uint32_t)regs.get(rs1)) >= ((uint32_t)regs.get(rs2)) ? imm : 4);
+    int32_t dividend = regs.get(rs1);
+    int32_t divisor = regs.get(rs2);
+
+    // Determine the value from the low words, sign-extended from 32 bits.
+    // Divide by zero gives -1, and the one overflowing case gives the
+    // dividend back.
+    int32_t val;
+    if (divisor == 0)
+    {
+        val = -1;
+    }
+    else if (dividend == INT32_MIN && divisor == -1)
+    {
+        val = dividend;
+    }
+    else
+    {
+        val = dividend / divisor;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bgeu");
+        std::string s = render_rtype(insn, "divw");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << "pc += (" << hex::to_hex0x32(regs.get(rs1)) << " >=U "
-             << hex::to_hex0x32(regs.get(rs2)) << " ? " << hex::to_hex0x32(imm) << " : 4) = "
-             << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " / "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen((sreg_t) val);
     }
 
-    // Set the pc to val.
-    pc = val;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_lb(uint32_t insn, std::ostream* pos)          ///< Execute lb
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_divuw(uint32_t insn, std::ostream* pos)    ///< Execute divuw
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
     uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    uint32_t dividend = regs.get(rs1);
+    uint32_t divisor = regs.get(rs2);
 
-    // Determine the value.
-    uint32_t val = mem.get8_sx(regs.get(rs1) + imm);
+    // Determine the value from the low words, sign-extended from 32 bits.
+    // Divide by zero gives all ones.
+    int32_t val;
+    if (divisor == 0)
+    {
+        val = -1;
+    }
+    else
+    {
+        val = dividend / divisor;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lb");
+        std::string s = render_rtype(insn, "divuw");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << "sx(m8(" << hex::to_hex0x32(regs.get(rs1)) 
-             << " + " << hex::to_hex0x32(imm) << ")) = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " / "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen((sreg_t) val);
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_lh(uint32_t insn, std::ostream* pos)          ///< Execute lh
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_remw(uint32_t insn, std::ostream* pos)     ///< Execute remw
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
     uint32_t rs1 = get_rs1(insn);
-
-    // Determine the value.
-    uint32_t val = mem.get16_sx(regs.get(rs1) + imm);
+    uint32_t rs2 = get_rs2(insn);
+    int32_t dividend = regs.get(rs1);
+    int32_t divisor = regs.get(rs2);
+
+    // Determine the value from the low words, sign-extended from 32 bits.
+    // Divide by zero gives the dividend back, and the one overflowing
+    // case has no remainder.
+    int32_t val;
+    if (divisor == 0)
+    {
+        val = dividend;
+    }
+    else if (dividend == INT32_MIN && divisor == -1)
+    {
+        val = 0;
+    }
+    else
+    {
+        val = dividend % divisor;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lh");
+        std::string s = render_rtype(insn, "remw");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << "sx(m16(" << hex::to_hex0x32(regs.get(rs1)) 
-             << " + " << hex::to_hex0x32(imm) << ")) = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " % "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen((sreg_t) val);
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_lw(uint32_t insn, std::ostream* pos)          ///< Execute lw
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_remuw(uint32_t insn, std::ostream* pos)    ///< Execute remuw
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
     uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    uint32_t dividend = regs.get(rs1);
+    uint32_t divisor = regs.get(rs2);
 
-    // Determine the value.
-    uint32_t val = mem.get32_sx(regs.get(rs1) + imm);
+    // Determine the value from the low words, sign-extended from 32 bits.
+    // Divide by zero gives the dividend back.
+    int32_t val;
+    if (divisor == 0)
+    {
+        val = dividend;
+    }
+    else
+    {
+        val = dividend % divisor;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lw");
+        std::string s = render_rtype(insn, "remuw");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << "sx(m32(" << hex::to_hex0x32(regs.get(rs1)) 
-             << " + " << hex::to_hex0x32(imm) << ")) = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(regs.get(rs1)) << " % "
+             << to_hex0xlen(regs.get(rs2)) << " = " << to_hex0xlen((sreg_t) val);
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_lbu(uint32_t insn, std::ostream* pos)         ///< Execute lbu
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_ecall(uint32_t insn, std::ostream* pos)    ///< Execute ecall
 {
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
+    // With system call emulation, a7 is the call and a0-a5 the arguments.
+    if (sys)
+    {
+        uint64_t nr = regs.get(17);
+        uint64_t args[6];
+        for (int i = 0; i < 6; ++i)
+        {
+            args[i] = (uint64_t) (int64_t) regs.get(10 + i);
+        }
 
-    // Determine the value.
-    uint32_t val = mem.get8(regs.get(rs1) + imm);
+        uint64_t ret = 0;
+        bool running = sys->call(nr, args, ret);
+        if (log && log->has_diverged())
+        {
+            halt = true;
+            halt_reason = log->get_divergence();
+            return;
+        }
+
+        if (pos)
+        {
+            std::string s = render_ecall(insn);
+            *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+            if (running)
+                *pos << "// " << render_reg(10) << " = " << syscall_emu::get_name(nr) << "() = " << to_hex0xlen((reg_t) ret);
+            else
+                *pos << "// " << syscall_emu::get_name(nr) << "(" << (int) args[0] << "), HALT";
+        }
+
+        if (!running)
+        {
+            halt = true;
+            halt_reason = std::string(syscall_emu::get_name(nr)) + " with status " + std::to_string((int) args[0]);
+            return;
+        }
+
+        regs.set(10, (reg_t) ret);
+        pc += insn_len;
+        return;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lbu");
+        std::string s = render_ecall(insn);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << "zx(m8(" << hex::to_hex0x32(regs.get(rs1)) 
-             << " + " << hex::to_hex0x32(imm) << ")) = " << hex::to_hex0x32(val);
+        *pos << (trap_vector(cause_ecall_u + priv) ? "// TRAP" : "// HALT");
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Trap, or halt if there is no handler. The cause says which mode
+    // the call came from.
+    trap(cause_ecall_u + priv, 0, "ECALL instruction");
 }
 
-void rv32i_hart::exec_lhu(uint32_t insn, std::ostream* pos)         ///< Execute lhu
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_ebreak(uint32_t insn, std::ostream* pos)   ///< Execute ebreak
 {
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_ebreak(insn);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << (trap_vector(cause_breakpoint) ? "// TRAP" : "// HALT");
+    }
 
-    // Determine the value.
-    uint32_t val = mem.get16(regs.get(rs1) + imm);
+    // Trap, or halt if there is no handler.
+    trap(cause_breakpoint, pc, "EBREAK instruction");
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_mret(uint32_t insn, std::ostream* pos)     ///< Execute mret
+{
+    if (priv < prv_m)
+    {
+        exec_illegal_insn(insn, pos);
+        return;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lhu");
+        std::string s = render_mret(insn);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << "zx(m16(" << hex::to_hex0x32(regs.get(rs1)) 
-             << " + " << hex::to_hex0x32(imm) << ")) = " << hex::to_hex0x32(val);
+        *pos << "// pc = " << to_hex0xlen(mepc);
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Restore the mode and interrupt enable from before the trap.
+    priv = (mstatus & mstatus_mpp) >> 11;
+    mstatus = (mstatus & mstatus_mpie) ? (mstatus | mstatus_mie) : (mstatus & ~mstatus_mie);
+    mstatus = (mstatus | mstatus_mpie) & ~mstatus_mpp;
+    if (priv < prv_m)
+    {
+        mstatus &= ~mstatus_mprv;
+    }
+    update_vm();
+    pc = mepc;
+
+    // An interrupt that came in during the handler is taken now.
+    check_interrupts();
 }
 
-void rv32i_hart::exec_sb(uint32_t insn, std::ostream* pos)          ///< Execute sb
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sret(uint32_t insn, std::ostream* pos)     ///< Execute sret
 {
-    // Get the required parts of the insn.
-    int32_t imm = get_imm_s(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
-
-    // Determine the value.
-    uint8_t val = (regs.get(rs2) /*& 0x000000ff*/);
+    if (priv < prv_s)
+    {
+        exec_illegal_insn(insn, pos);
+        return;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_stype(insn, "sb");
+        std::string s = render_sret(insn);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// m8(" << hex::to_hex0x32(regs.get(rs1)) << " + " << hex::to_hex0x32(imm) 
-             << ") = " << hex::to_hex0x32(val);
+        *pos << "// pc = " << to_hex0xlen(sepc);
     }
 
-    // Set the 8 bytes at rs1+imm to val.
-    mem.set8((regs.get(rs1)+imm), val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Restore the mode and interrupt enable from before the trap.
+    priv = (mstatus & mstatus_spp) ? prv_s : prv_u;
+    mstatus = (mstatus & mstatus_spie) ? (mstatus | mstatus_sie) : (mstatus & ~mstatus_sie);
+    mstatus = (mstatus | mstatus_spie) & ~(mstatus_spp | mstatus_mprv);
+    update_vm();
+    pc = sepc;
+
+    // An interrupt that came in during the handler is taken now.
+    check_interrupts();
 }
 
-void rv32i_hart::exec_sh(uint32_t insn, std::ostream* pos)          ///< Execute sh
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sfence_vma(uint32_t insn, std::ostream* pos)   ///< Execute sfence.vma
 {
-    // Get the required parts of the insn.
-    int32_t imm = get_imm_s(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
+    if (priv < prv_s)
+    {
+        exec_illegal_insn(insn, pos);
+        return;
+    }
 
-    // Determine the value.
-    uint16_t val = (regs.get(rs2) /*& 0x0000ffff*/);
+    // If cout was passed, print what the instruction does.
+    if (pos)
+    {
+        std::string s = render_sfence_vma(insn);
+        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
+        *pos << "// flush TLB";
+    }
+
+    // The address and ASID are ignored, and every translation goes.
+    flush_tlb();
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
 
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_wfi(uint32_t insn, std::ostream* pos)     ///< Execute wfi
+{
+    // U-mode may not wait, nor S-mode with TW set.
+    if (priv == prv_u || (priv == prv_s && (mstatus & mstatus_tw)))
+    {
+        exec_illegal_insn(insn, pos);
+        return;
+    }
+
+    // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_stype(insn, "sh");
+        std::string s = render_wfi(insn);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// m16(" << hex::to_hex0x32(regs.get(rs1)) << " + " << hex::to_hex0x32(imm) 
-             << ") = " << hex::to_hex0x32(val);
+        *pos << "// wait for interrupt";
     }
 
-    // Set the 16 bytes at rs1+imm to val.
-    mem.set16((regs.get(rs1)+imm), val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction, where the wait
+    // ends. The hart stalls until an enabled interrupt is pending,
+    // whether or not interrupts are enabled globally, and the run loop
+    // moves time on to then.
+    pc += insn_len;
+    if (!(get_mip() & mie))
+    {
+        idle = idle_wfi;
+    }
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_csrrw(uint32_t insn, std::ostream* pos)    ///< Execute csrrw
+{
+    exec_csr(insn, pos, "csrrw", csr_op_write, regs.get(get_rs1(insn)), true);
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_csrrs(uint32_t insn, std::ostream* pos)    ///< Execute csrrs
+{
+    exec_csr(insn, pos, "csrrs", csr_op_set, regs.get(get_rs1(insn)), get_rs1(insn) != 0);
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_csrrc(uint32_t insn, std::ostream* pos)    ///< Execute csrrc
+{
+    exec_csr(insn, pos, "csrrc", csr_op_clear, regs.get(get_rs1(insn)), get_rs1(insn) != 0);
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_csrrwi(uint32_t insn, std::ostream* pos)   ///< Execute csrrwi
+{
+    exec_csr(insn, pos, "csrrwi", csr_op_write, get_rs1(insn), true);
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_csrrsi(uint32_t insn, std::ostream* pos)   ///< Execute csrrsi
+{
+    exec_csr(insn, pos, "csrrsi", csr_op_set, get_rs1(insn), get_rs1(insn) != 0);
+}
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_csrrci(uint32_t insn, std::ostream* pos)   ///< Execute csrrci
+{
+    exec_csr(insn, pos, "csrrci", csr_op_clear, get_rs1(insn), get_rs1(insn) != 0);
+}
+
+/**@}*/
+
+/**
+ * @brief Computes the result of a bit-manipulation instruction.
+ * 
+ * @param op The bm_X value of the instruction.
+ * @param a The value of rs1.
+ * @param b The value of rs2, or the shift amount of an immediate form.
+ * 
+ * @return The value written to rd.
+ * 
+ * @note Each operation maps to a host builtin or a short branch-free
+ * sequence, so none of them costs more than a base instruction.
+*/
+
+template <uint32_t XLEN>
+uint32_t rv_hart<XLEN>::bitmanip(int op, uint32_t a, uint32_t b)
+{
+    uint32_t sh = b % 32;
+
+    switch (op)
+    {
+        case bm_sh1add:
+            return (a << 1) + b;
+        case bm_sh2add:
+            return (a << 2) + b;
+        case bm_sh3add:
+            return (a << 3) + b;
+        case bm_andn:
+            return a & ~b;
+        case bm_orn:
+            return a | ~b;
+        case bm_xnor:
+            return ~(a ^ b);
+        case bm_min:
+            return ((int32_t) a < (int32_t) b) ? a : b;
+        case bm_minu:
+            return std::min(a, b);
+        case bm_max:
+            return ((int32_t) a > (int32_t) b) ? a : b;
+        case bm_maxu:
+            return std::max(a, b);
+        case bm_rol:
+            return (a << sh) | (a >> ((32 - sh) % 32));
+        case bm_ror:
+        case bm_rori:
+            return (a >> sh) | (a << ((32 - sh) % 32));
+        case bm_bclr:
+        case bm_bclri:
+            return a & ~(1u << sh);
+        case bm_bext:
+        case bm_bexti:
+            return (a >> sh) & 1;
+        case bm_binv:
+        case bm_binvi:
+            return a ^ (1u << sh);
+        case bm_bset:
+        case bm_bseti:
+            return a | (1u << sh);
+        case bm_zexth:
+            return a & 0xffff;
+        case bm_clz:
+            // The builtins are undefined for 0.
+            return a ? __builtin_clz(a) : 32;
+        case bm_ctz:
+            return a ? __builtin_ctz(a) : 32;
+        case bm_cpop:
+            return __builtin_popcount(a);
+        case bm_sextb:
+            return (int32_t)(int8_t) a;
+        case bm_sexth:
+            return (int32_t)(int16_t) a;
+        case bm_orcb:
+        {
+            // Set the top bit of every nonzero byte, then fill the bytes.
+            uint32_t m = (((a & 0x7f7f7f7f) + 0x7f7f7f7f) | a) & 0x80808080;
+            return (m >> 7) * 0xff;
+        }
+        case bm_rev8:
+            return __builtin_bswap32(a);
+    }
+
+    assert(0 && "unrecognized bitmanip op"); // We should not get here
+    return 0;
 }
 
-void rv32i_hart::exec_sw(uint32_t insn, std::ostream* pos)          ///< Execute sw
+/**
+ * @brief Executes a Zba, Zbb or Zbs instruction.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * @param op The bm_X value of the instruction.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_bitmanip(uint32_t insn, std::ostream* pos, int op)
 {
     // Get the required parts of the insn.
-    int32_t imm = get_imm_s(insn);
+    uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
+    const bitmanip_info &info = get_bitmanip_info(op);
+
+    // The immediate forms use the rs2 field as the shift amount.
+    uint32_t a = regs.get(rs1);
+    uint32_t b = (info.format == bm_fmt_imm) ? rs2 : regs.get(rs2);
 
     // Determine the value.
-    int32_t val = regs.get(rs2);
+    int32_t val = bitmanip(op, a, b);
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_stype(insn, "sw");
+        std::string s = render_bitmanip(insn, op);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// m32(" << hex::to_hex0x32(regs.get(rs1)) << " + " << hex::to_hex0x32(imm) 
-             << ") = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << info.mnemonic << "(" << hex::to_hex0x32(a);
+        if (info.format == bm_fmt_r)
+        {
+            *pos << ", " << hex::to_hex0x32(b);
+        }
+        else if (info.format == bm_fmt_imm)
+        {
+            *pos << ", " << b;
+        }
+        *pos << ") = " << hex::to_hex0x32(val);
     }
 
-    // Set the 32 bytes at rs1+imm to val.
-    mem.set32((regs.get(rs1)+imm), val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Set the register at rd to the value of val.
+    regs.set(rd, val);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
+
+/**
+ * @brief The bit layout of a host float or double.
+*/
+template <typename T> struct fp_traits;
+
+template <> struct fp_traits<float>
+{
+    typedef uint32_t bits;
+    static constexpr uint32_t sign = 0x80000000;
+    static constexpr uint32_t inf = 0x7f800000;
+    static constexpr uint32_t quiet = 0x00400000;
+    static constexpr uint32_t canonical_nan = 0x7fc00000;
+};
+
+template <> struct fp_traits<double>
+{
+    typedef uint64_t bits;
+    static constexpr uint64_t sign = 0x8000000000000000ull;
+    static constexpr uint64_t inf = 0x7ff0000000000000ull;
+    static constexpr uint64_t quiet = 0x0008000000000000ull;
+    static constexpr uint64_t canonical_nan = 0x7ff8000000000000ull;
+};
+
+/**
+ * @defgroup fp_x Floating-point helpers
+ * Move values between host floats, their bit patterns and the
+ * floating-point registers. NaNs are told apart by their bits, since
+ * a host compare against a signaling NaN raises invalid.
+ * @{
+*/
+template <typename T> static typename fp_traits<T>::bits fp_to_bits(T v)    ///< The bits of v.
+{
+    typename fp_traits<T>::bits b;
+    std::memcpy(&b, &v, sizeof(b));
+    return b;
+}
+
+template <typename T> static T fp_from_bits(typename fp_traits<T>::bits b)  ///< The value of b.
+{
+    T v;
+    std::memcpy(&v, &b, sizeof(v));
+    return v;
+}
+
+template <typename T> static bool fp_is_nan(T v)                            ///< True if v is a NaN.
+{
+    return (fp_to_bits(v) & ~fp_traits<T>::sign) > fp_traits<T>::inf;
+}
+
+template <typename T> static bool fp_is_snan(T v)                           ///< True if v is a signaling NaN.
+{
+    return fp_is_nan(v) && !(fp_to_bits(v) & fp_traits<T>::quiet);
+}
+
+template <typename T> static T fp_read(const fpregisterfile &f, uint32_t r);  ///< Read register r.
+
+template <> float fp_read<float>(const fpregisterfile &f, uint32_t r)
+{
+    return fp_from_bits<float>(f.get_s(r));
+}
+
+template <> double fp_read<double>(const fpregisterfile &f, uint32_t r)
+{
+    return fp_from_bits<double>(f.get_d(r));
+}
+
+static void fp_write(fpregisterfile &f, uint32_t r, float v)               ///< Write register r, NaN-boxed.
+{
+    f.set_s(r, fp_to_bits(v));
+}
+
+static void fp_write(fpregisterfile &f, uint32_t r, double v)              ///< Write register r.
+{
+    f.set_d(r, fp_to_bits(v));
 }
 
-void rv32i_hart::exec_addi(uint32_t insn, std::ostream* pos)        ///< Execute addi
+template <typename T> static uint32_t fp_classify(T v)                     ///< The fclass mask of v.
 {
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
+    typename fp_traits<T>::bits mag = fp_to_bits(v) & ~fp_traits<T>::sign;
+    bool neg = std::signbit(v);
+
+    if (fp_is_nan(v))
+        return fp_is_snan(v) ? 1u << 8 : 1u << 9;
+    if (mag == fp_traits<T>::inf)
+        return neg ? 1u << 0 : 1u << 7;
+    if (mag == 0)
+        return neg ? 1u << 3 : 1u << 4;
+    if ((mag & fp_traits<T>::inf) == 0)
+        return neg ? 1u << 2 : 1u << 5;
+    return neg ? 1u << 1 : 1u << 6;
+}
+/**@}*/
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) + imm;
+/**
+ * @brief Gets the exceptions the host raised as fflags bits.
+ * 
+ * @return The NV, DZ, OF, UF and NX bits of the host exceptions.
+*/
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+template <uint32_t XLEN>
+uint32_t rv_hart<XLEN>::host_fflags()
+{
+    int e = std::fetestexcept(FE_ALL_EXCEPT);
+    uint32_t flags = 0;
+    if (e & FE_INEXACT)
+        flags |= fflag_nx;
+    if (e & FE_UNDERFLOW)
+        flags |= fflag_uf;
+    if (e & FE_OVERFLOW)
+        flags |= fflag_of;
+    if (e & FE_DIVBYZERO)
+        flags |= fflag_dz;
+    if (e & FE_INVALID)
+        flags |= fflag_nv;
+    return flags;
+}
+
+/**
+ * @brief Gets the host rounding mode for a RISC-V one.
+ * 
+ * @param rm The rounding mode, one of the rm_X values.
+ * 
+ * @return The <cfenv> mode. The host has no round to nearest, ties to
+ *  max magnitude, so rmm gets round to nearest, ties to even.
+*/
+
+template <uint32_t XLEN>
+int rv_hart<XLEN>::host_rounding(uint32_t rm)
+{
+    switch (rm)
     {
-        std::string s = render_itype_alu(insn, "addi", imm);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " + " << hex::to_hex0x32(imm) << " = " << hex::to_hex0x32(val);
+        case rm_rtz:
+            return FE_TOWARDZERO;
+        case rm_rdn:
+            return FE_DOWNWARD;
+        case rm_rup:
+            return FE_UPWARD;
+        default:
+            return FE_TONEAREST;
     }
-
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
 }
 
-void rv32i_hart::exec_slti(uint32_t insn, std::ostream* pos)        ///< Execute slti
+/**
+ * @brief Converts a float or double to a 32-bit integer.
+ * 
+ * @param v The value.
+ * @param rm The rounding mode, one of the rm_X values.
+ * @param is_unsigned True for fcvt.wu, False for fcvt.w.
+ * @param flags The fflags bits raised are ORed in.
+ * 
+ * @return The integer. NaN and values out of range give the largest or
+ *  smallest integer and raise NV, and a value that was rounded raises
+ *  NX. The host conversion would give 0x80000000 for all of them.
+*/
+
+template <uint32_t XLEN>
+template <typename T>
+uint32_t rv_hart<XLEN>::fp_to_int(T v, uint32_t rm, bool is_unsigned, uint32_t &flags)
 {
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
+    double lo = is_unsigned ? 0.0 : -2147483648.0;
+    double hi = is_unsigned ? 4294967295.0 : 2147483647.0;
 
-    // Determine the value.
-    int32_t val = ((regs.get(rs1) < imm) ? 1 : 0);
+    if (fp_is_nan(v))
+    {
+        flags |= fflag_nv;
+        return is_unsigned ? 0xffffffff : 0x7fffffff;
+    }
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    // Round to an integral value without raising any host exception.
+    T r;
+    switch (rm)
     {
-        std::string s = render_itype_alu(insn, "slti", imm);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(regs.get(rs1)) 
-             << " < " << imm << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        case rm_rtz:
+            r = std::trunc(v);
+            break;
+        case rm_rdn:
+            r = std::floor(v);
+            break;
+        case rm_rup:
+            r = std::ceil(v);
+            break;
+        case rm_rmm:
+            r = std::round(v);
+            break;
+        default:
+            r = std::nearbyint(v);
+            break;
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    if (r < lo)
+    {
+        flags |= fflag_nv;
+        return is_unsigned ? 0 : 0x80000000;
+    }
+    if (r > hi)
+    {
+        flags |= fflag_nv;
+        return is_unsigned ? 0xffffffff : 0x7fffffff;
+    }
+    if (r != v)
+    {
+        flags |= fflag_nx;
+    }
+    return is_unsigned ? (uint32_t)(double) r : (uint32_t)(int32_t) r;
 }
 
-void rv32i_hart::exec_sltiu(uint32_t insn, std::ostream* pos)       ///< Execute sltiu
-{
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
-
-    // Determine the value.
-    int32_t val = ((( uint32_t) regs.get(rs1) < (uint32_t) imm) ? 1 : 0);
+/**
+ * @brief Executes an F or D computational instruction.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * @param op The fp_X value of the instruction.
+*/
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_fp(uint32_t insn, std::ostream* pos, int op)
+{
+    // The fmt field is the precision of the result and of the operands,
+    // except for the conversions between the two precisions.
+    if (get_fmt(insn) == fmt_d)
     {
-        std::string s = render_itype_alu(insn, "sltiu", imm);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(regs.get(rs1)) 
-             << " <U " << imm << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        exec_fp_op<double>(insn, pos, op);
+    }
+    else
+    {
+        exec_fp_op<float>(insn, pos, op);
     }
-
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
 }
 
-void rv32i_hart::exec_xori(uint32_t insn, std::ostream* pos)        ///< Execute xori
+/**
+ * @brief Executes an F or D computational instruction in one precision.
+ * 
+ * Every operation runs as the host operation of the same precision.
+ * The host already rounds to nearest, ties to even, so in the common
+ * case an fadd.s is one host addition plus reading back the host
+ * exception flags. Only the directed rounding modes take the slow path
+ * of switching the host rounding mode and back. RISC-V results that
+ * differ from the host's are fixed up after the host operation: a NaN
+ * result is always the canonical NaN, and fmin/fmax, the compares and
+ * the conversions to integer are done by hand.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * @param op The fp_X value of the instruction.
+ * 
+ * @note rmm arithmetic rounds ties to even, since the host cannot round
+ * ties away from zero. The conversions to integer do round ties away.
+*/
+
+template <uint32_t XLEN>
+template <typename T>
+void rv_hart<XLEN>::exec_fp_op(uint32_t insn, std::ostream* pos, int op)
 {
+    typedef typename fp_traits<T>::bits U;
+
     // Get the required parts of the insn.
+    const fp_info &info = get_fp_info(op);
     uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
     uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    uint32_t rs3 = get_rs3(insn);
+    uint32_t rm = get_funct3(insn);
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) ^ imm;
-
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    // A dynamic rounding mode comes from frm, which may hold a reserved
+    // mode.
+    if (info.rounds && rm == rm_dyn)
     {
-        std::string s = render_itype_alu(insn, "xori", imm);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " ^ " << hex::to_hex0x32(imm) << " = " << hex::to_hex0x32(val);
+        rm = frm;
+        if (rm > rm_rmm)
+        {
+            exec_illegal_insn(insn, pos);
+            return;
+        }
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
-}
+    T a = fp_read<T>(fregs, rs1);
+    T b = fp_read<T>(fregs, rs2);
+    T c = fp_read<T>(fregs, rs3);
+    uint32_t x = regs.get(rs1);
+    double src = a;
 
-void rv32i_hart::exec_ori(uint32_t insn, std::ostream* pos)         ///< Execute ori
-{
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
+    T val = 0;
+    uint32_t xval = 0;
+    bool canonical = true;
+    uint32_t flags = 0;
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) | imm;
+    bool directed = info.rounds && rm != rm_rne && rm != rm_rmm;
+    std::feclearexcept(FE_ALL_EXCEPT);
+    if (directed)
+    {
+        std::fesetround(host_rounding(rm));
+    }
 
-    if (pos)
+    switch (op)
     {
-        std::string s = render_itype_alu(insn, "ori", imm);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " | " << hex::to_hex0x32(imm) << " = " << hex::to_hex0x32(val);
+        case fp_add:
+            val = a + b;
+            break;
+        case fp_sub:
+            val = a - b;
+            break;
+        case fp_mul:
+            val = a * b;
+            break;
+        case fp_div:
+            val = a / b;
+            break;
+        case fp_sqrt:
+            val = std::sqrt(a);
+            break;
+        case fp_madd:
+            val = std::fma(a, b, c);
+            break;
+        case fp_msub:
+            val = std::fma(a, b, -c);
+            break;
+        case fp_nmsub:
+            val = std::fma(-a, b, c);
+            break;
+        case fp_nmadd:
+            val = std::fma(-a, b, -c);
+            break;
+        case fp_sgnj:
+        case fp_sgnjn:
+        case fp_sgnjx:
+        {
+            // Only the sign bit changes, even for a NaN.
+            U sign = fp_traits<T>::sign;
+            U ua = fp_to_bits(a);
+            U ub = fp_to_bits(b);
+            U s = (op == fp_sgnj) ? (ub & sign) : (op == fp_sgnjn) ? (~ub & sign) : ((ua ^ ub) & sign);
+            val = fp_from_bits<T>((ua & ~sign) | s);
+            canonical = false;
+            break;
+        }
+        case fp_min:
+        case fp_max:
+            // A NaN operand loses to a number, and -0 is less than +0.
+            if (fp_is_snan(a) || fp_is_snan(b))
+                flags |= fflag_nv;
+            if (fp_is_nan(a))
+                val = b;
+            else if (fp_is_nan(b))
+                val = a;
+            else if (a == b)
+                val = (std::signbit(a) == (op == fp_min)) ? a : b;
+            else
+                val = ((a < b) == (op == fp_min)) ? a : b;
+            break;
+        case fp_eq:
+            // feq is a quiet compare, flt and fle are signaling ones.
+            if (fp_is_nan(a) || fp_is_nan(b))
+            {
+                if (fp_is_snan(a) || fp_is_snan(b))
+                    flags |= fflag_nv;
+                break;
+            }
+            xval = (a == b);
+            break;
+        case fp_lt:
+        case fp_le:
+            if (fp_is_nan(a) || fp_is_nan(b))
+            {
+                flags |= fflag_nv;
+                break;
+            }
+            xval = (op == fp_lt) ? (a < b) : (a <= b);
+            break;
+        case fp_class:
+            xval = fp_classify(a);
+            break;
+        case fp_cvt_w:
+        case fp_cvt_wu:
+            xval = fp_to_int(a, rm, op == fp_cvt_wu, flags);
+            break;
+        case fp_cvt_from_w:
+            val = (T)(int32_t) x;
+            src = (int32_t) x;
+            break;
+        case fp_cvt_from_wu:
+            val = (T) x;
+            src = x;
+            break;
+        case fp_mv_x_w:
+            // The low bits move whether or not they are NaN-boxed.
+            xval = fregs.get_d(rs1);
+            break;
+        case fp_mv_w_x:
+            val = fp_from_bits<T>(x);
+            canonical = false;
+            break;
+        case fp_cvt_s_d:
+            src = fp_read<double>(fregs, rs1);
+            val = (T) src;
+            break;
+        case fp_cvt_d_s:
+            src = fp_read<float>(fregs, rs1);
+            val = (T) src;
+            break;
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
-}
+    if (directed)
+    {
+        std::fesetround(FE_TONEAREST);
+    }
+    flags |= host_fflags();
 
-void rv32i_hart::exec_andi(uint32_t insn, std::ostream* pos)        ///< Execute andi
-{
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    int32_t imm = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
+    if (canonical && fp_is_nan(val))
+    {
+        val = fp_from_bits<T>(fp_traits<T>::canonical_nan);
+    }
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) & imm;
+    bool to_x = (info.format == fp_fmt_xff || info.format == fp_fmt_xf);
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "andi", imm);
+        std::string s = render_fp(insn, op);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " & " << hex::to_hex0x32(imm) << " = " << hex::to_hex0x32(val);
+        *pos << "// " << (to_x ? render_reg(rd) : render_freg(rd)) << " = "
+             << get_fp_mnemonic(insn, op) << "(";
+        switch (info.format)
+        {
+            case fp_fmt_fff:
+            case fp_fmt_xff:
+                *pos << a << ", " << b;
+                break;
+            case fp_fmt_ffff:
+                *pos << a << ", " << b << ", " << c;
+                break;
+            case fp_fmt_fx:
+                *pos << hex::to_hex0x32(x);
+                break;
+            default:
+                *pos << src;
+                break;
+        }
+        *pos << ") = ";
+        if (to_x)
+            *pos << hex::to_hex0x32(xval);
+        else
+            *pos << val;
+        if (flags)
+            *pos << ", fflags |= " << hex::to_hex0x12(flags);
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
-}
-
-void rv32i_hart::exec_slli(uint32_t insn, std::ostream* pos)        ///< Execute slli
-{
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    uint32_t shamt = (get_imm_i(insn) & 0x0000001f);
-    uint32_t rs1 = get_rs1(insn);
-
-    // Determine the value.
-    int32_t val = (regs.get(rs1) << shamt);
+    // Accrue the exception flags.
+    fflags |= flags;
+    fp_used = true;
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    // Set the register at rd to the result.
+    if (to_x)
     {
-        std::string s = render_itype_alu(insn, "slli", shamt);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " << " << shamt << " = " << hex::to_hex0x32(val);
+        regs.set(rd, (int32_t) xval);
+    }
+    else
+    {
+        fp_write(fregs, rd, val);
     }
+    // Move the program counter past the instruction.
+    pc += insn_len;
+}
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+/**
+ * @brief Gets the register group multiplier of a vtype.
+ * 
+ * @param vt The vtype value.
+ * 
+ * @return log2 of LMUL, from -3 for mf8 to 3 for m8.
+*/
+
+template <uint32_t XLEN>
+int rv_hart<XLEN>::lmul_log2(reg_t vt)
+{
+    uint32_t vlmul = vt & vtype_vlmul;
+    return (vlmul & 0x4) ? (int) vlmul - 8 : (int) vlmul;
 }
 
-void rv32i_hart::exec_srli(uint32_t insn, std::ostream* pos)        ///< Execute srli
+/**
+ * @brief Checks that a register can start a register group.
+ * 
+ * @param r The first register of the group.
+ * @param emul_log2 log2 of the number of registers in the group. A
+ *  fractional group is one register.
+ * 
+ * @return True if r is a multiple of the group size.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::vreg_ok(uint32_t r, int emul_log2)
 {
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    uint32_t shamt = (get_imm_i(insn) & 0x0000001f);
-    uint32_t rs1 = get_rs1(insn);
+    return emul_log2 <= 0 || (r & ((1u << emul_log2) - 1)) == 0;
+}
 
-    // Determine the value.
-    int32_t val = ((uint32_t)regs.get(rs1) >> shamt);
+/**
+ * @brief Renders the first elements of a register group.
+ * 
+ * @param v The register group.
+ * @param sew The element width in bits.
+ * @param n The number of elements.
+ * 
+ * @return A string like {0x01, 0x02, ...}, with at most 8 elements.
+*/
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+template <uint32_t XLEN>
+std::string rv_hart<XLEN>::render_vec_elems(const uint8_t *v, uint32_t sew, uint32_t n)
+{
+    std::ostringstream os;
+    os << "{";
+    for (uint32_t i = 0; i < n && i < 8; ++i)
     {
-        std::string s = render_itype_alu(insn, "srli", shamt);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " >> " << shamt << " = " << hex::to_hex0x32(val);
+        os << (i ? ", " : "") << "0x" << std::hex << std::setw(sew / 4) << std::setfill('0')
+           << vector_simd::get_elem(v, sew, i);
+    }
+    if (n > 8)
+    {
+        os << ", ...";
     }
+    os << "}";
+    return os.str();
+}
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+/**
+ * @brief Renders the first bits of a mask register.
+ * 
+ * @param m The mask register.
+ * @param n The number of bits.
+ * 
+ * @return The bits as one hex number, element 0 in the low bit.
+*/
+
+template <uint32_t XLEN>
+std::string rv_hart<XLEN>::render_vec_mask(const uint8_t *m, uint32_t n)
+{
+    std::ostringstream os;
+    os << "0x";
+    if (n == 0)
+    {
+        os << "0";
+    }
+    for (uint32_t b = (n + 7) / 8; b > 0; --b)
+    {
+        uint8_t byte = m[b - 1];
+        if (b * 8 > n)
+        {
+            byte &= (1u << (n % 8)) - 1;
+        }
+        os << hex::to_hex8(byte);
+    }
+    return os.str();
 }
 
-void rv32i_hart::exec_srai(uint32_t insn, std::ostream* pos)        ///< Execute srai
+/**
+ * @brief Executes vsetvli, vsetivli and vsetvl.
+ * 
+ * A vtype with reserved bits set, a reserved SEW or LMUL, or an SEW
+ * wider than LMUL * ELEN sets vill and a vl of 0. Otherwise vl is the
+ * AVL capped at VLMAX, where an rs1 of x0 asks for VLMAX if rd is not
+ * x0 and for the current vl if it is.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_vsetvl(uint32_t insn, std::ostream* pos)
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    uint32_t shamt = (get_imm_i(insn) & 0x0000001f);
     uint32_t rs1 = get_rs1(insn);
+    reg_t vt;
+    reg_t avl;
 
-    // Determine the value.
-    int32_t val = (regs.get(rs1) >> shamt);
-
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    if ((insn >> 31) == 0)
     {
-        std::string s = render_itype_alu(insn, "srai", shamt);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " >> " << shamt << " = " << hex::to_hex0x32(val);
+        vt = (insn >> 20) & 0x7ff;
+    }
+    else if ((insn >> 30) == 0b11)
+    {
+        vt = (insn >> 20) & 0x3ff;
+    }
+    else if (get_funct7(insn) == 0b1000000)
+    {
+        vt = regs.get(get_rs2(insn));
+    }
+    else
+    {
+        exec_illegal_insn(insn, pos);
+        return;
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
-}
+    if ((insn >> 30) == 0b11)
+        avl = rs1;
+    else if (rs1 != 0)
+        avl = regs.get(rs1);
+    else if (rd != 0)
+        avl = ~(reg_t) 0;
+    else
+        avl = vl;
 
-void rv32i_hart::exec_add(uint32_t insn, std::ostream* pos)         ///< Execute add
-{
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
+    // Check the new vtype, with an ELEN of 64.
+    uint32_t vsew = (vt >> vtype_vsew_shift) & 0x7;
+    int lm = lmul_log2(vt);
+    bool vill = (vt & ~(reg_t) vtype_legal) || vsew > 3 || (vt & vtype_vlmul) == 4 ||
+                (lm < 0 && (8u << vsew) > (64u >> -lm));
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) + regs.get(rs2);
+    if (vill)
+    {
+        vtype = vtype_vill;
+        vl = 0;
+    }
+    else
+    {
+        uint32_t vlen = vregs.get_vlenb() * 8;
+        reg_t vlmax = ((lm >= 0) ? (vlen << lm) : (vlen >> -lm)) >> (3 + vsew);
+        vtype = vt;
+        vl = std::min(avl, vlmax);
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_rtype(insn, "add");
+        std::string s = render_vsetvl(insn);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " + " << hex::to_hex0x32(regs.get(rs2)) << " = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = vl = " << vl << ", vtype = "
+             << (vill ? "vill" : render_vtype(vt));
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Set the register at rd to the new vl.
+    regs.set(rd, vl);
+    vstart = 0;
+    vec_used = true;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_sub(uint32_t insn, std::ostream* pos)         ///< Execute sub
+/**
+ * @brief Executes the unit-stride and strided vector loads and stores.
+ * 
+ * An unmasked unit-stride access is one block copy between the memory
+ * and the register group. A strided or masked access copies each
+ * active element on its own, so a masked-off element never touches
+ * memory.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * @param store True for a store, False for a load.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_vec_mem(uint32_t insn, std::ostream* pos, bool store)
 {
     // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
+    uint32_t vd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
+    uint32_t eew = get_vec_eew(insn);
+    bool masked = !get_vm(insn);
+    bool strided = (get_mop(insn) == mop_strided);
+
+    // The data group is EEW/SEW times the size of an LMUL group, and a
+    // masked load may not overwrite its mask.
+    int sew_log2 = 3 + ((vtype >> vtype_vsew_shift) & 0x7);
+    int emul_log2 = lmul_log2(vtype) + __builtin_ctz(eew) - sew_log2;
+    if ((vtype & vtype_vill) || emul_log2 < -3 || emul_log2 > 3 || !vreg_ok(vd, emul_log2) ||
+        (masked && !store && vd == 0))
+    {
+        exec_illegal_insn(insn, pos);
+        return;
+    }
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) - regs.get(rs2);
+    uint32_t bytes = eew / 8;
+    reg_t base = regs.get(rs1);
+    reg_t stride = strided ? (reg_t) regs.get(rs2) : bytes;
+    uint8_t *v = vregs.get(vd);
+    const uint8_t *m = vregs.get(0);
+
+    if (!masked && stride == bytes)
+    {
+        if (!copy_guest(base, v, vl * bytes, store))
+            return;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < vl; ++i)
+        {
+            if (masked && !vector_simd::mask_bit(m, i))
+                continue;
+            if (!copy_guest(base + i * stride, v + i * bytes, bytes, store))
+                return;
+        }
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_rtype(insn, "sub");
+        std::string s = render_vec_mem(insn, store);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " - " << hex::to_hex0x32(regs.get(rs2)) << " = " << hex::to_hex0x32(val);
+        std::ostringstream addr;
+        addr << "m" << eew << "(" << to_hex0xlen(base) << " + " << to_hex0xlen(stride) << " * i)";
+        if (store)
+            *pos << "// " << addr.str() << " = " << render_vreg(vd) << " = ";
+        else
+            *pos << "// " << render_vreg(vd) << " = " << addr.str() << " = ";
+        *pos << render_vec_elems(v, eew, vl) << ", vl = " << vl;
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    vstart = 0;
+    vec_used = true;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_sll(uint32_t insn, std::ostream* pos)         ///< Execute sll
+/**
+ * @brief Executes the V integer instructions.
+ * 
+ * The element loops run in vector_simd, so one guest instruction is a
+ * few host SIMD instructions per 32 bytes of the register group. A .vx
+ * or .vi operand is first splatted out to a group of its own, and a
+ * masked instruction computes every element and then merges the active
+ * ones in under v0. Elements past vl are left undisturbed.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * @param op The vec_X value of the instruction.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_vec(uint32_t insn, std::ostream* pos, int op)
 {
     // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
+    const vec_info &info = get_vec_info(op);
+    uint32_t vd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
-
-    // Determine the value.
-    int32_t val = regs.get(rs1) << ((regs.get(rs2))%XLEN);
+    uint32_t vs2 = get_rs2(insn);
+    uint32_t funct3 = get_funct3(insn);
+    bool masked = !get_vm(insn);
+    bool vv = (funct3 == funct3_opivv || funct3 == funct3_opmvv);
+    bool is_cmp = (op >= vec_mseq && op <= vec_msgt);
+    bool is_red = (op >= vec_redsum && op <= vec_redmax);
+    uint32_t sew = 8u << ((vtype >> vtype_vsew_shift) & 0x7);
+    int lm = lmul_log2(vtype);
+
+    // Every group must be aligned to LMUL. A mask, a reduction scalar
+    // and the vmv.x.s and vmv.s.x operands are single registers.
+    bool legal = !(vtype & vtype_vill);
+    if (info.format == vec_fmt_vvv || info.format == vec_fmt_vvvm)
+    {
+        legal = legal && vreg_ok(vs2, lm);
+        legal = legal && (is_cmp || is_red || vreg_ok(vd, lm));
+        legal = legal && (!vv || is_red || vreg_ok(rs1, lm));
+    }
+    else if (info.format == vec_fmt_vv)
+    {
+        legal = legal && vreg_ok(vd, lm) && (!vv || vreg_ok(rs1, lm));
+    }
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    // Only a mask or a scalar result may overwrite the mask.
+    if (!legal || (masked && vd == 0 && !is_cmp && !is_red))
     {
-        std::string s = render_rtype(insn, "sll");
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " << " << (regs.get(rs2))%XLEN << " = " << hex::to_hex0x32(val);
+        exec_illegal_insn(insn, pos);
+        return;
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
-}
+    uint8_t *d = vregs.get(vd);
+    const uint8_t *a = vregs.get(vs2);
+    const uint8_t *m = vregs.get(0);
+    uint8_t *scalar = &vec_tmp[0];
+    uint8_t *result = &vec_tmp[vec_tmp.size() / 2];
+    uint32_t n = vl;
+
+    // The .vx and .vi operands are sign-extended to SEW.
+    uint64_t x = (funct3 == funct3_opivi) ? (uint64_t)(int64_t) get_simm5(insn)
+                                          : (uint64_t)(int64_t) regs.get(rs1);
+    const uint8_t *b = scalar;
+    if (vv)
+    {
+        b = vregs.get(rs1);
+    }
+    else if (info.format != vec_fmt_vx)
+    {
+        vector_simd::splat(sew, scalar, x, n);
+    }
 
-void rv32i_hart::exec_slt(uint32_t insn, std::ostream* pos)         ///< Execute slt
-{
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
+    // The vector_simd op of an arithmetic op or a reduction.
+    int simd = vector_simd::op_add;
+    switch (op)
+    {
+        case vec_sub:
+        case vec_rsub:
+            simd = vector_simd::op_sub;
+            break;
+        case vec_minu:
+        case vec_redminu:
+            simd = vector_simd::op_minu;
+            break;
+        case vec_min:
+        case vec_redmin:
+            simd = vector_simd::op_min;
+            break;
+        case vec_maxu:
+        case vec_redmaxu:
+            simd = vector_simd::op_maxu;
+            break;
+        case vec_max:
+        case vec_redmax:
+            simd = vector_simd::op_max;
+            break;
+        case vec_and:
+        case vec_redand:
+            simd = vector_simd::op_and;
+            break;
+        case vec_or:
+        case vec_redor:
+            simd = vector_simd::op_or;
+            break;
+        case vec_xor:
+        case vec_redxor:
+            simd = vector_simd::op_xor;
+            break;
+        case vec_mul:
+            simd = vector_simd::op_mul;
+            break;
+    }
 
-    // Determine the value.
-    int32_t val = (regs.get(rs1) < regs.get(rs2)) ? 1 : 0;
+    uint64_t xval = 0;
+    if (is_cmp)
+    {
+        // The vmsX ops are in the order of the vector_simd compares.
+        vector_simd::compare(vector_simd::cmp_eq + (op - vec_mseq), sew, result, a, b, n);
+        vector_simd::merge_bits(d, result, masked ? m : nullptr, n);
+    }
+    else if (is_red)
+    {
+        // Masked-off elements are replaced by the identity of the op.
+        if (n > 0)
+        {
+            const uint8_t *src = a;
+            if (masked)
+            {
+                vector_simd::splat(sew, result, vector_simd::identity(simd, sew), n);
+                vector_simd::merge(sew, result, a, m, n);
+                src = result;
+            }
+            uint64_t init = vector_simd::get_elem(b, sew, 0);
+            vector_simd::set_elem(d, sew, 0, vector_simd::reduce(simd, sew, src, n, init));
+        }
+    }
+    else
+    {
+        switch (op)
+        {
+            case vec_merge:
+                memcpy(result, a, (size_t) n * sew / 8);
+                vector_simd::merge(sew, result, b, m, n);
+                memcpy(d, result, (size_t) n * sew / 8);
+                break;
+            case vec_mv_v:
+                memmove(d, b, (size_t) n * sew / 8);
+                break;
+            case vec_mv_x_s:
+                // Sign-extend element 0 to XLEN, whatever vl is.
+                xval = vector_simd::get_elem(a, sew, 0);
+                xval = (uint64_t)((int64_t)(xval << (64 - sew)) >> (64 - sew));
+                regs.set(vd, (sreg_t) xval);
+                break;
+            case vec_mv_s_x:
+                if (n > 0)
+                    vector_simd::set_elem(d, sew, 0, x);
+                break;
+            default:
+                // vrsub is vsub with the operands swapped.
+                if (op == vec_rsub)
+                    std::swap(a, b);
+                if (masked)
+                {
+                    vector_simd::binary(simd, sew, result, a, b, n);
+                    vector_simd::merge(sew, d, result, m, n);
+                }
+                else
+                {
+                    vector_simd::binary(simd, sew, d, a, b, n);
+                }
+                break;
+        }
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_rtype(insn, "slt");
+        std::string s = render_vec(insn, op);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(regs.get(rs1)) << " < "
-             << hex::to_hex0x32(regs.get(rs2)) << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        if (op == vec_mv_x_s)
+            *pos << "// " << render_reg(vd) << " = " << render_vreg(vs2) << "[0] = " << to_hex0xlen(xval);
+        else if (is_cmp)
+            *pos << "// " << render_vreg(vd) << " = " << render_vec_mask(d, n) << ", vl = " << n;
+        else if (is_red || op == vec_mv_s_x)
+            *pos << "// " << render_vreg(vd) << "[0] = " << render_vec_elems(d, sew, n ? 1 : 0);
+        else
+            *pos << "// " << render_vreg(vd) << " = " << render_vec_elems(d, sew, n) << ", vl = " << n;
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    vstart = 0;
+    vec_used = true;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_sltu(uint32_t insn, std::ostream* pos)        ///< Execute sltu
+/**
+ * @brief Executes lr.w.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_lr_w(uint32_t insn, std::ostream* pos)
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
+    reg_t addr = regs.get(rs1);
 
-    // Determine the value.
-    int32_t val = (regs.get(rs1) < regs.get(rs2)) ? 1 : 0;
+    if (addr % 4 != 0)
+    {
+        // Trap, or halt if there is no handler.
+        trap(cause_load_misaligned, addr, "Misaligned address in LR.W instruction");
+        return;
+    }
+
+    // Load the word and reserve it.
+    uint32_t pa;
+    if (!translate(addr, access_load, pa, 4))
+        return;
+    int32_t val = mem.atomic_get32(pa);
+    reservation_valid = true;
+    reservation_addr = addr;
+    reservation_value = val;
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_rtype(insn, "sltu");
+        std::string s = render_amo(insn, "lr.w");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(regs.get(rs1)) << " <U "
-             << hex::to_hex0x32(regs.get(rs2)) << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = m32(" << to_hex0xlen(addr) << ") = "
+             << hex::to_hex0x32(val);
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_xor(uint32_t insn, std::ostream* pos)         ///< Execute xor
+/**
+ * @brief Executes sc.w.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * 
+ * @note The reservation holds the value lr.w loaded, and the store
+ * is a compare and swap against it. A store by another hart that
+ * changes the word makes sc.w fail. A store that writes back the same
+ * value does not, which only matters to guests that depend on ABA
+ * detection, and no spinlock or lock-free queue built on lr/sc does.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_sc_w(uint32_t insn, std::ostream* pos)
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
+    reg_t addr = regs.get(rs1);
+    uint32_t src = regs.get(rs2);
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) ^ regs.get(rs2);
+    if (addr % 4 != 0)
+    {
+        // Trap, or halt if there is no handler.
+        trap(cause_store_misaligned, addr, "Misaligned address in SC.W instruction");
+        return;
+    }
+
+    // Store only if this hart still holds a reservation on the word,
+    // and then give the reservation up either way.
+    uint32_t pa;
+    if (!translate(addr, access_store, pa, 4))
+        return;
+    bool ok = reservation_valid && reservation_addr == addr &&
+              mem.atomic_cas32(pa, reservation_value, src);
+    reservation_valid = false;
+    int32_t val = ok ? 0 : 1;
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_rtype(insn, "xor");
+        std::string s = render_amo(insn, "sc.w");
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " ^ "
-             << hex::to_hex0x32(regs.get(rs2)) << " = " << hex::to_hex0x32(val);
+        *pos << "// ";
+        if (ok)
+        {
+            *pos << "m32(" << to_hex0xlen(addr) << ") = " << hex::to_hex0x32(src) << ", ";
+        }
+        *pos << render_reg(rd) << " = " << val;
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_srl(uint32_t insn, std::ostream* pos)         ///< Execute srl
+/**
+ * @brief Executes an amo*.w instruction.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * @param mnemonic The mnemonic of the instruction.
+ * @param op The memory::amo_X operation.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_amo(uint32_t insn, std::ostream* pos, const char *mnemonic, int op)
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
+    reg_t addr = regs.get(rs1);
+    uint32_t src = regs.get(rs2);
 
-    // Determine the value.
-    int32_t val = (uint32_t) regs.get(rs1) >> ((uint32_t)(regs.get(rs2))%XLEN);
+    if (addr % 4 != 0)
+    {
+        // Trap, or halt if there is no handler.
+        trap(cause_store_misaligned, addr, "Misaligned address in AMO instruction");
+        return;
+    }
+
+    // Read, modify and write the word in one host atomic.
+    uint32_t pa;
+    if (!translate(addr, access_store, pa, 4))
+        return;
+    int32_t val = mem.atomic_rmw32(pa, op, src);
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_rtype(insn, "srl");
+        std::string s = render_amo(insn, mnemonic);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " >> " << (regs.get(rs2))%XLEN << " = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = m32(" << to_hex0xlen(addr) << ") = "
+             << hex::to_hex0x32(val) << ", m32(" << to_hex0xlen(addr) << ") = "
+             << hex::to_hex0x32(mem.atomic_get32(pa));
     }
 
     // Set the register at rd to the value of val.
     regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Move the program counter past the instruction.
+    pc += insn_len;
 }
 
-void rv32i_hart::exec_sra(uint32_t insn, std::ostream* pos)         ///< Execute sra
+/**
+ * @brief Executes a CSR instruction.
+ * 
+ * @param insn The instruction.
+ * @param pos The ostream passed in. In this program, it is cout.
+ * @param mnemonic The mnemonic of the instruction.
+ * @param op How src is combined with the CSR: csr_op_write, csr_op_set
+ * or csr_op_clear.
+ * @param src The value of rs1, or the zimm of the immediate forms.
+ * @param write False if the instruction must not write the CSR. csrrs
+ * and csrrc with rs1 = x0 only read it.
+ * 
+ * @note csrrw and csrrwi with rd = x0 do not read the CSR, so they
+ * have no read side effects. An unknown CSR, or a write to a read-only
+ * one, halts the hart.
+*/
+
+template <uint32_t XLEN>
+void rv_hart<XLEN>::exec_csr(uint32_t insn, std::ostream* pos, const char *mnemonic, int op, reg_t src, bool write)
 {
     // Get the required parts of the insn.
     uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
+    uint32_t csr = (get_imm_i(insn) & 0x00000fff);
+    bool imm_form = (get_funct3(insn) & 0b100) != 0;
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) >> ((regs.get(rs2))%XLEN);
+    reg_t old = 0;
+    // Bits 9:8 of the number are the lowest mode that may use the CSR.
+    bool legal = ((csr >> 8) & 3) <= priv;
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    // Read the CSR, unless this is a write that discards the old value.
+    if (legal && (op != csr_op_write || rd != 0))
     {
-        std::string s = render_rtype(insn, "sra");
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) 
-             << " >> " << (regs.get(rs2))%XLEN << " = " << hex::to_hex0x32(val);
+        legal = csr_read(csr, old);
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
-}
+    // Combine the old value with the source.
+    reg_t val = src;
+    if (op == csr_op_set)
+    {
+        val = old | src;
+    }
+    else if (op == csr_op_clear)
+    {
+        val = old & ~src;
+    }
 
-void rv32i_hart::exec_or(uint32_t insn, std::ostream* pos)          ///< Execute or
-{
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
+    if (legal && write)
+    {
+        legal = csr_write(csr, val);
+    }
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) | regs.get(rs2);
+    if (!legal)
+    {
+        // Trap, or halt if there is no handler.
+        std::string upper(mnemonic);
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        trap(cause_illegal_insn, insn, "Illegal CSR in " + upper + " instruction");
+        return;
+    }
 
     // If cout was passed, print what the instruction does.
     if (pos)
     {
-        std::string s = render_rtype(insn, "or");
+        std::string s = imm_form ? render_csrrxi(insn, mnemonic) : render_csrrx(insn, mnemonic);
         *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " | "
-             << hex::to_hex0x32(regs.get(rs2)) << " = " << hex::to_hex0x32(val);
+        *pos << "// " << render_reg(rd) << " = " << to_hex0xlen(old);
+        if (write)
+        {
+            *pos << ",  " << hex::to_hex0x12(csr) << " = " << to_hex0xlen(val);
+        }
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
+    // Set the register at rd to the old value of the CSR.
+    regs.set(rd, old);
+    // Move the program counter past the instruction.
+    pc += insn_len;
+
+    // Act on a marker only after the instruction is complete.
+    if (write && csr == csr_marker)
+    {
+        on_marker(val);
+    }
+
+    // Enabling an interrupt that is pending takes it right away.
+    if (write && (csr == csr_mstatus || csr == csr_mie || csr == csr_mip || csr == csr_mideleg ||
+                  csr == csr_sstatus || csr == csr_sie || csr == csr_sip))
+    {
+        check_interrupts();
+    }
 }
 
-void rv32i_hart::exec_and(uint32_t insn, std::ostream* pos)         ///< Execute and
+/**
+ * @brief Gets the number of cycles the hart has run.
+ * 
+ * @return The cycle count. Every instruction takes one cycle.
+*/
+
+template <uint32_t XLEN>
+uint64_t rv_hart<XLEN>::get_cycles() const
 {
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
+    return insn_counter;
+}
 
-    // Determine the value.
-    int32_t val = regs.get(rs1) & regs.get(rs2);
+/**
+ * @brief Gets what a performance counter counts, before its offset.
+ * 
+ * Nothing is counted per instruction for the counters. Each one is an
+ * event count the hart keeps anyway plus an offset, and a write only
+ * changes the offset.
+ * 
+ * @param i The counter: 0 is cycle, 2 is instret and 3-31 are the
+ * hpmcounters.
+ * 
+ * @return The event count, or 0 if the counter is inhibited.
+*/
 
-    // If cout was passed, print what the instruction does.
-    if (pos)
+template <uint32_t XLEN>
+uint64_t rv_hart<XLEN>::counter_source(uint32_t i) const
+{
+    if (mcountinhibit & (1u << i))
     {
-        std::string s = render_rtype(insn, "and");
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " & "
-             << hex::to_hex0x32(regs.get(rs2)) << " = " << hex::to_hex0x32(val);
+        return 0;
     }
 
-    // Set the register at rd to the value of val.
-    regs.set(rd, val);
-    // Increment the program coutner by 4.
-    pc += 4;
-}
+    switch (i)
+    {
+        case 0:
+            return get_cycles();
+        case 2:
+            // The CSR instruction itself has not retired yet, and the
+            // cycles stalled in wfi retired nothing.
+            return insn_counter - 1 - wfi_cycles;
+        default:
+            break;
+    }
 
-void rv32i_hart::exec_ecall(uint32_t insn, std::ostream* pos)       ///< Execute ecall
-{
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    uint32_t event = hpm_event[i];
+    if (event >= hpm_event_alu && event < hpm_event_alu + insn_record::num_kinds)
     {
-        std::string s = render_ecall(insn);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// HALT";
+        return kind_counts[event - hpm_event_alu];
+    }
+    if (event == hpm_event_taken)
+    {
+        return taken_transfers;
     }
+    return 0;
+}
+
+/**
+ * @brief Gets the value of a performance counter.
+ * 
+ * @param i The counter.
+ * 
+ * @return The 64-bit counter value.
+*/
+
+template <uint32_t XLEN>
+uint64_t rv_hart<XLEN>::counter_value(uint32_t i) const
+{
+    return counter_source(i) + counter_delta[i];
+}
+
+/**
+ * @brief Sets the value of a performance counter.
+ * 
+ * @param i The counter.
+ * @param val The new 64-bit counter value.
+*/
 
-    // Set halt to true.
-    halt = true;
-    // Set halt_reason.
-    halt_reason = "ECALL instruction";
+template <uint32_t XLEN>
+void rv_hart<XLEN>::set_counter(uint32_t i, uint64_t val)
+{
+    counter_delta[i] = val - counter_source(i);
 }
 
-void rv32i_hart::exec_ebreak(uint32_t insn, std::ostream* pos)      ///< Execute ebreak
+/**
+ * @brief Reads a CSR.
+ * 
+ * @param csr The CSR number.
+ * @param val Set to the value of the CSR.
+ * 
+ * @return False if the CSR does not exist.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::csr_read(uint32_t csr, reg_t &val)
 {
-    // If cout was passed, print what the instruction does.
-    if (pos)
+    // The user and machine counters, low and high halves.
+    if ((csr >= csr_cycle && csr <= csr_hpmcounter31) ||
+        (csr >= csr_mcycle && csr <= csr_mhpmcounter31))
     {
-        std::string s = render_ebreak(insn);
-        *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-        *pos << "// HALT";
+        uint32_t i = csr & 0x1f;
+        if (i == 1)
+        {
+            // time has no machine-mode counterpart.
+            if (csr != csr_time)
+                return false;
+            val = get_cycles();
+            return true;
+        }
+        val = counter_value(i);
+        return true;
+    }
+    // The high halves only exist on RV32.
+    if (XLEN == 32 && ((csr >= csr_cycleh && csr <= csr_hpmcounter31h) ||
+                       (csr >= csr_mcycleh && csr <= csr_mhpmcounter31h)))
+    {
+        uint32_t i = csr & 0x1f;
+        if (i == 1)
+        {
+            if (csr != csr_timeh)
+                return false;
+            val = get_cycles() >> 32;
+            return true;
+        }
+        val = counter_value(i) >> 32;
+        return true;
+    }
+    if (csr >= csr_mhpmevent3 && csr <= csr_mhpmevent31)
+    {
+        val = hpm_event[csr & 0x1f];
+        return true;
+    }
+    // RV64 packs eight PMP entries into each even pmpcfg, and has no
+    // odd ones.
+    if (csr >= csr_pmpcfg0 && csr <= csr_pmpcfg3)
+    {
+        uint32_t n = csr - csr_pmpcfg0;
+        if (XLEN == 64 && (n & 1))
+            return false;
+        val = 0;
+        for (uint32_t i = 0; i < XLEN / 8; ++i)
+            val |= (reg_t) pmpcfg[4 * n + i] << (8 * i);
+        return true;
+    }
+    if (csr >= csr_pmpaddr0 && csr <= csr_pmpaddr15)
+    {
+        val = pmpaddr[csr - csr_pmpaddr0];
+        return true;
     }
 
-    // Set halt to true.
-    halt = true;
-    // Set halt_reason.
-    halt_reason = "EBREAK instruction";
+    switch (csr)
+    {
+        case csr_fflags:
+            fp_used = true;
+            val = fflags;
+            return true;
+        case csr_frm:
+            fp_used = true;
+            val = frm;
+            return true;
+        case csr_fcsr:
+            fp_used = true;
+            val = (frm << 5) | fflags;
+            return true;
+        case csr_vstart:
+            vec_used = true;
+            val = vstart;
+            return true;
+        case csr_vxsat:
+            vec_used = true;
+            val = vxsat;
+            return true;
+        case csr_vxrm:
+            vec_used = true;
+            val = vxrm;
+            return true;
+        case csr_vcsr:
+            vec_used = true;
+            val = (vxrm << 1) | vxsat;
+            return true;
+        case csr_vl:
+            vec_used = true;
+            val = vl;
+            return true;
+        case csr_vtype:
+            vec_used = true;
+            val = vtype;
+            return true;
+        case csr_vlenb:
+            vec_used = true;
+            val = vregs.get_vlenb();
+            return true;
+        case csr_mvendorid:
+        case csr_marchid:
+        case csr_mimpid:
+            val = 0;
+            return true;
+        case csr_mhartid:
+            val = mhartid;
+            return true;
+        case csr_misa:
+            val = misa;
+            return true;
+        case csr_mscratch:
+            val = mscratch;
+            return true;
+        case csr_mstatus:
+            val = mstatus;
+            return true;
+        case csr_mstatush:
+            // Only RV32 has the upper half, and it is all zero.
+            val = 0;
+            return XLEN == 32;
+        case csr_mie:
+            val = mie;
+            return true;
+        case csr_medeleg:
+            val = medeleg;
+            return true;
+        case csr_mideleg:
+            val = mideleg;
+            return true;
+        case csr_sstatus:
+            val = mstatus & sstatus_mask;
+            return true;
+        case csr_sie:
+            val = mie & mideleg;
+            return true;
+        case csr_sip:
+            val = get_mip() & mideleg;
+            return true;
+        case csr_stvec:
+            val = stvec;
+            return true;
+        case csr_sscratch:
+            val = sscratch;
+            return true;
+        case csr_sepc:
+            val = sepc;
+            return true;
+        case csr_scause:
+            val = scause;
+            return true;
+        case csr_stval:
+            val = stval;
+            return true;
+        case csr_satp:
+            // RV64 has no paging mode, and satp reads as bare.
+            val = satp;
+            return true;
+        case csr_mtvec:
+            val = mtvec;
+            return true;
+        case csr_mepc:
+            val = mepc;
+            return true;
+        case csr_mcause:
+            val = mcause;
+            return true;
+        case csr_mtval:
+            val = mtval;
+            return true;
+        case csr_mip:
+            val = get_mip();
+            return true;
+        case csr_mcountinhibit:
+            val = mcountinhibit;
+            return true;
+        case csr_marker:
+            val = 0;
+            return true;
+        default:
+            return false;
+    }
 }
 
-void rv32i_hart::exec_csrrs(uint32_t insn, std::ostream* pos)       ///< Execute csrrs
+/**
+ * @brief Writes a CSR.
+ * 
+ * @param csr The CSR number.
+ * @param val The value to write.
+ * 
+ * @return False if the CSR does not exist or is read-only.
+*/
+
+template <uint32_t XLEN>
+bool rv_hart<XLEN>::csr_write(uint32_t csr, reg_t val)
 {
-    // Get the required parts of the insn.
-    uint32_t rd = get_rd(insn);
-    uint32_t csr = (get_imm_i(insn) & 0x00000fff);
-    //uint32_t rs1 = get_rs1(insn);
+    // CSRs with both top bits of the number set are read-only.
+    if ((csr & 0xc00) == 0xc00)
+    {
+        return false;
+    }
 
-    if (csr == 0xf14 && rd != 0)
+    if (csr >= csr_mcycle && csr <= csr_mhpmcounter31 && csr != csr_mcycle + 1)
     {
-        // If cout was passed, print what the instruction does.
-        if (pos)
+        uint32_t i = csr & 0x1f;
+        // On RV64 the whole counter is written at once.
+        set_counter(i, (XLEN == 32) ? ((counter_value(i) & 0xffffffff00000000ull) | val) : val);
+        return true;
+    }
+    if (XLEN == 32 && csr >= csr_mcycleh && csr <= csr_mhpmcounter31h && csr != csr_mcycleh + 1)
+    {
+        uint32_t i = csr & 0x1f;
+        set_counter(i, (counter_value(i) & 0xffffffffull) | ((uint64_t)val << 32));
+        return true;
+    }
+    if (csr >= csr_mhpmevent3 && csr <= csr_mhpmevent31)
+    {
+        // Keep the counter's value across the change of event.
+        uint32_t i = csr & 0x1f;
+        uint64_t v = counter_value(i);
+        hpm_event[i] = val;
+        set_counter(i, v);
+        return true;
+    }
+    // A locked PMP entry ignores writes until reset, and so does the
+    // address below a locked TOR entry.
+    if (csr >= csr_pmpcfg0 && csr <= csr_pmpcfg3)
+    {
+        uint32_t n = csr - csr_pmpcfg0;
+        if (XLEN == 64 && (n & 1))
+            return false;
+        for (uint32_t i = 0; i < XLEN / 8; ++i)
         {
-            std::string s = render_csrrx(insn, "csrrs");
-            *pos << std::setw(instruction_width) << std:: setfill(' ') << std::left << s;
-            *pos << "// " << render_reg(rd) << " = " << mhartid;
+            if (!(pmpcfg[4 * n + i] & pmp_l))
+                pmpcfg[4 * n + i] = (val >> (8 * i)) & (pmp_l | pmp_a | pmp_x | pmp_w | pmp_r);
         }
-
-        // Set the register at rd to the hart id.
-        regs.set(rd, mhartid);
-        //csr = rs1;
-        // Increment the program coutner by 4.
-        pc += 4;
+        update_pmp();
+        update_vm();
+        return true;
     }
-    else
+    if (csr >= csr_pmpaddr0 && csr <= csr_pmpaddr15)
     {
-        // Set halt to true.
-        halt = true;
-        // Set halt_reason.
-        halt_reason = "Illegal CSR in CSRRS instruction";
+        uint32_t i = csr - csr_pmpaddr0;
+        bool locked = (pmpcfg[i] & pmp_l) ||
+                      (i + 1 < pmp_entries && (pmpcfg[i + 1] & pmp_l) && (pmpcfg[i + 1] & pmp_a) == pmp_tor);
+        if (!locked)
+        {
+            // RV64 keeps bits 55:2 of the address.
+            pmpaddr[i] = (XLEN == 32) ? val : (val & 0x003fffffffffffffull);
+            update_pmp();
+            update_vm();
+        }
+        return true;
+    }
+
+    switch (csr)
+    {
+        case csr_fflags:
+            fp_used = true;
+            fflags = val & 0x1f;
+            return true;
+        case csr_frm:
+            fp_used = true;
+            frm = val & 0x7;
+            return true;
+        case csr_fcsr:
+            fp_used = true;
+            frm = (val >> 5) & 0x7;
+            fflags = val & 0x1f;
+            return true;
+        case csr_vstart:
+            vec_used = true;
+            vstart = val;
+            return true;
+        case csr_vxsat:
+            vec_used = true;
+            vxsat = val & 0x1;
+            return true;
+        case csr_vxrm:
+            vec_used = true;
+            vxrm = val & 0x3;
+            return true;
+        case csr_vcsr:
+            vec_used = true;
+            vxrm = (val >> 1) & 0x3;
+            vxsat = val & 0x1;
+            return true;
+        case csr_misa:
+            // The extensions cannot be turned off, so writes are ignored.
+            return true;
+        case csr_mscratch:
+            mscratch = val;
+            return true;
+        case csr_mstatus:
+        {
+            // MPP has no encoding for mode 2, and keeps its old value.
+            reg_t keep = mstatus_sie | mstatus_mie | mstatus_spie | mstatus_mpie | mstatus_spp |
+                         mstatus_mpp | mstatus_mprv | mstatus_sum | mstatus_mxr;
+            reg_t old = mstatus;
+            mstatus = val & keep;
+            if (((mstatus & mstatus_mpp) >> 11) == 2)
+                mstatus = (mstatus & ~mstatus_mpp) | (old & mstatus_mpp);
+            // The TLB holds permissions SUM and MXR decided.
+            if ((old ^ mstatus) & (mstatus_sum | mstatus_mxr))
+                flush_tlb();
+            update_vm();
+            return true;
+        }
+        case csr_sstatus:
+        {
+            reg_t old = mstatus;
+            mstatus = (mstatus & ~sstatus_mask) | (val & sstatus_mask);
+            if ((old ^ mstatus) & (mstatus_sum | mstatus_mxr))
+                flush_tlb();
+            return true;
+        }
+        case csr_medeleg:
+            medeleg = val & medeleg_mask;
+            return true;
+        case csr_mideleg:
+            mideleg = val & mideleg_mask;
+            return true;
+        case csr_sie:
+            mie = (mie & ~mideleg) | (val & mideleg);
+            return true;
+        case csr_sip:
+            // Only the software interrupt may be cleared or raised by S-mode.
+            mip_sw = (mip_sw & ~(mideleg & mip_ssip)) | (val & mideleg & mip_ssip);
+            return true;
+        case csr_stvec:
+            stvec = val & ~(reg_t) 2;
+            return true;
+        case csr_sscratch:
+            sscratch = val;
+            return true;
+        case csr_sepc:
+            sepc = val & ~(reg_t) 1;
+            return true;
+        case csr_scause:
+            scause = val;
+            return true;
+        case csr_stval:
+            stval = val;
+            return true;
+        case csr_satp:
+            // Only Sv32 on RV32. RV64 stays bare, and ignores a write of
+            // any other mode.
+            if (XLEN == 32)
+                satp = val & (satp_sv32 | satp_ppn);
+            else if (val == 0)
+                satp = 0;
+            // No ASIDs are kept, so every change of satp flushes.
+            flush_tlb();
+            update_vm();
+            return true;
+        case csr_mstatush:
+            return XLEN == 32;
+        case csr_mie:
+            mie = val & (mip_msip | mip_mtip | mip_meip | mip_s_mask);
+            return true;
+        case csr_mtvec:
+            // Direct or vectored mode, the base 4-byte aligned.
+            mtvec = val & ~(reg_t) 2;
+            return true;
+        case csr_mepc:
+            mepc = val & ~(reg_t) 1;
+            return true;
+        case csr_mcause:
+            mcause = val;
+            return true;
+        case csr_mtval:
+            mtval = val;
+            return true;
+        case csr_mip:
+            // The M-mode bits follow the CLINT and PLIC and cannot be
+            // written. The S-mode bits are M-mode's to raise.
+            mip_sw = val & mip_s_mask;
+            return true;
+        case csr_mcountinhibit:
+        {
+            // Freeze or restart each counter without changing its value.
+            // Bit 1 (time) is read-only zero.
+            val &= ~0x2u;
+            uint64_t v[32];
+            for (uint32_t i = 0; i < 32; ++i)
+                v[i] = counter_value(i);
+            mcountinhibit = val;
+            for (uint32_t i = 0; i < 32; ++i)
+                set_counter(i, v[i]);
+            return true;
+        }
+        case csr_marker:
+            return true;
+        default:
+            return false;
     }
 }
 
-/**@}*/
\ No newline at end of file
+template class rv_hart<32>;
+template class rv_hart<64>;
@@ -1,4 +1,17 @@
+#ifndef RV32I_HART_H
+#define RV32I_HART_H
+
 #include "registerfile.h"
+#include "insn_trace.h"
+#include "stats.h"
+#include "vector_simd.h"
+#include "syscall_emu.h"
+#include "clint.h"
+#include "plic.h"
+#include <cfenv>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 //***************************************************************************
 //
@@ -10,15 +23,56 @@
 //
 //***************************************************************************
 
-class rv32i_hart : public rv32i_decode
+/**
+ * @brief The register types and misa value of each XLEN.
+*/
+template <uint32_t XLEN> struct xlen_traits;
+
+template <> struct xlen_traits<32>
+{
+    typedef uint32_t reg_t;
+    typedef int32_t sreg_t;
+    typedef int64_t swide_t;                ///< Holds a full signed product.
+    typedef uint64_t wide_t;                ///< Holds a full unsigned product.
+    static constexpr uint64_t misa = 0x4034112f;        ///< MXL = 32, A, B, C, D, F, I, M, S, U, V.
+};
+
+template <> struct xlen_traits<64>
+{
+    typedef uint64_t reg_t;
+    typedef int64_t sreg_t;
+    __extension__ typedef __int128 swide_t;
+    __extension__ typedef unsigned __int128 wide_t;
+    static constexpr uint64_t misa = 0x8000000000341104ull;  ///< MXL = 64, C, I, M, S, U, V.
+};
+
+/**
+ * @brief A RISC-V hart of either register width.
+ * 
+ * The decoder tables and the execution of every instruction are
+ * shared, and only the register type changes with XLEN. Every XLEN
+ * test is a constant, so rv_hart<32> compiles to the same code the
+ * hart had before it was a template. rv_hart<64> adds the RV64I W
+ * instructions, the doubleword loads and stores, and 6-bit shift
+ * amounts.
+ * 
+ * @tparam XLEN 32 for RV32, 64 for RV64.
+*/
+template <uint32_t XLEN>
+class rv_hart : public rv32i_decode
 {
 public:
+    typedef typename xlen_traits<XLEN>::reg_t reg_t;     ///< An unsigned register value.
+    typedef typename xlen_traits<XLEN>::sreg_t sreg_t;   ///< A signed register value.
+    typedef typename xlen_traits<XLEN>::swide_t swide_t; ///< A signed double-width value.
+    typedef typename xlen_traits<XLEN>::wide_t wide_t;   ///< An unsigned double-width value.
+
     /**
-     * @brief Constructs the hart.
+     * @brief Constructs the hart, with a VLEN of 128.
      * 
      * @param mem The memory assigned to the hart.
     */
-    rv32i_hart(memory &m) : mem(m) { }
+    rv_hart(memory &m) : mem(m) { set_vlen(128); }
     /**
      * @brief Sets show_instructions
      * 
@@ -51,17 +105,151 @@ public:
      * @return The value of insn_counter.
     */
     uint64_t get_insn_counter() const { return insn_counter; }
+    /**
+     * @brief Gets insn_counter for something that follows its value.
+     * 
+     * @return A pointer to insn_counter, valid as long as the hart.
+    */
+    const uint64_t *get_clock() const { return &insn_counter; }
     /**
      * @brief Setter for mhartid
     */
     void set_mhartid(int i) { mhartid = i; }
+    /**
+     * @brief Getter for mhartid
+     * 
+     * @return The hart ID.
+    */
+    uint32_t get_mhartid() const { return mhartid; }
+    /**
+     * @brief Getter for pc
+     * 
+     * @return The address of the next instruction.
+    */
+    reg_t get_pc() const { return pc; }
 
     void tick(const std::string &hdr="");
+    /**
+     * @brief Checks if the hart is waiting, in wfi or an idle loop.
+     * 
+     * @return True until fast_forward is called.
+    */
+    bool is_idle() const { return idle != idle_none; }
+    bool fast_forward(uint64_t bound);
     void dump(const std::string &hdr="") const;
     void reset();
 
+    void add_sink(insn_sink *s);
+    void flush_trace();
+    void report_sinks(std::ostream &os) const;
+
+    void register_stats(stats &s, const std::string &prefix) const;
+    void register_state(checkpoint &c, const std::string &prefix);
+
+    void set_detailed(bool b);
+    /**
+     * @brief Getter for detailed
+     * 
+     * @return True if the detailed models and tracing are running.
+    */
+    bool is_detailed() const { return detailed; }
+
+    void set_vlen(uint32_t vlen);
+    /**
+     * @brief Sets sys
+     * 
+     * @param s The system call emulation ecall goes to, or nullptr for
+     * ecall to halt the hart.
+    */
+    void set_syscalls(syscall_emu *s) { sys = s; }
+    void set_clint(clint *c);
+    void set_plic(plic *p);
+    /**
+     * @brief Sets log
+     * 
+     * @param l The log the interrupts taken are recorded to, or checked
+     * against under replay.
+    */
+    void set_replay(replay_log *l) { log = l; }
+
+    static constexpr uint32_t csr_fflags        = 0x001;
+    static constexpr uint32_t csr_frm           = 0x002;
+    static constexpr uint32_t csr_fcsr          = 0x003;
+    static constexpr uint32_t csr_vstart        = 0x008;
+    static constexpr uint32_t csr_vxsat         = 0x009;
+    static constexpr uint32_t csr_vxrm          = 0x00a;
+    static constexpr uint32_t csr_vcsr          = 0x00f;
+    static constexpr uint32_t csr_sstatus       = 0x100;
+    static constexpr uint32_t csr_sie           = 0x104;
+    static constexpr uint32_t csr_stvec         = 0x105;
+    static constexpr uint32_t csr_sscratch      = 0x140;
+    static constexpr uint32_t csr_sepc          = 0x141;
+    static constexpr uint32_t csr_scause        = 0x142;
+    static constexpr uint32_t csr_stval         = 0x143;
+    static constexpr uint32_t csr_sip           = 0x144;
+    static constexpr uint32_t csr_satp          = 0x180;
+    static constexpr uint32_t csr_mstatus       = 0x300;
+    static constexpr uint32_t csr_medeleg       = 0x302;
+    static constexpr uint32_t csr_mideleg       = 0x303;
+    static constexpr uint32_t csr_mie           = 0x304;
+    static constexpr uint32_t csr_mtvec         = 0x305;
+    static constexpr uint32_t csr_mstatush      = 0x310;
+    static constexpr uint32_t csr_mepc          = 0x341;
+    static constexpr uint32_t csr_mcause        = 0x342;
+    static constexpr uint32_t csr_mtval         = 0x343;
+    static constexpr uint32_t csr_mip           = 0x344;
+    static constexpr uint32_t csr_mscratch      = 0x340;
+    static constexpr uint32_t csr_misa          = 0x301;
+    static constexpr uint32_t csr_mcountinhibit = 0x320;
+    static constexpr uint32_t csr_pmpcfg0       = 0x3a0;
+    static constexpr uint32_t csr_pmpcfg3       = 0x3a3;
+    static constexpr uint32_t csr_pmpaddr0      = 0x3b0;
+    static constexpr uint32_t csr_pmpaddr15     = 0x3bf;
+    static constexpr uint32_t csr_mhpmevent3    = 0x323;
+    static constexpr uint32_t csr_mhpmevent31   = 0x33f;
+    static constexpr uint32_t csr_mcycle        = 0xb00;
+    static constexpr uint32_t csr_mhpmcounter31 = 0xb1f;
+    static constexpr uint32_t csr_mcycleh       = 0xb80;
+    static constexpr uint32_t csr_mhpmcounter31h = 0xb9f;
+    static constexpr uint32_t csr_cycle         = 0xc00;
+    static constexpr uint32_t csr_time          = 0xc01;
+    static constexpr uint32_t csr_hpmcounter31  = 0xc1f;
+    static constexpr uint32_t csr_vl            = 0xc20;
+    static constexpr uint32_t csr_vtype         = 0xc21;
+    static constexpr uint32_t csr_vlenb         = 0xc22;
+    static constexpr uint32_t csr_cycleh        = 0xc80;
+    static constexpr uint32_t csr_timeh         = 0xc81;
+    static constexpr uint32_t csr_hpmcounter31h = 0xc9f;
+    static constexpr uint32_t csr_mvendorid     = 0xf11;
+    static constexpr uint32_t csr_marchid       = 0xf12;
+    static constexpr uint32_t csr_mimpid        = 0xf13;
+    static constexpr uint32_t csr_mhartid       = 0xf14;
+    static constexpr uint32_t csr_marker        = 0x8c0;
+
+    // The events an mhpmevent CSR can select. Events hpm_event_alu and
+    // up count the instructions of each insn_record kind in turn.
+    static constexpr uint32_t hpm_event_alu     = 1;
+    static constexpr uint32_t hpm_event_taken   = hpm_event_alu + insn_record::num_kinds;
+
+    static constexpr uint32_t marker_roi_begin  = 1;
+    static constexpr uint32_t marker_roi_end    = 2;
+    static constexpr uint32_t marker_dump_stats = 3;
+    static constexpr uint32_t marker_reset_stats = 4;
+    static constexpr uint32_t marker_checkpoint = 5;
+
 private:
     static constexpr int instruction_width = 35;
+    static constexpr size_t trace_batch = 4096;
+
+    static constexpr int block_len_buckets = 16;
+
+    static const uint8_t *kind_table();
+    static const uint32_t *expansion_table();
+    static std::string render_raw(uint32_t raw);
+    static std::string to_hex0xlen(reg_t v);
+    static uint32_t mem_addr(reg_t addr);
+    static uint8_t insn_kind(uint32_t insn);
+    insn_record *trace_insn(uint32_t insn);
     void exec(uint32_t insn, std::ostream*);
     void exec_illegal_insn(uint32_t insn, std::ostream*);
 
@@ -82,10 +270,18 @@ private:
     void exec_lw(uint32_t insn, std::ostream*);
     void exec_lbu(uint32_t insn, std::ostream*);
     void exec_lhu(uint32_t insn, std::ostream*);
+    void exec_ld(uint32_t insn, std::ostream*);
+    void exec_lwu(uint32_t insn, std::ostream*);
 
     void exec_sb(uint32_t insn, std::ostream*);
     void exec_sh(uint32_t insn, std::ostream*);
     void exec_sw(uint32_t insn, std::ostream*);
+    void exec_sd(uint32_t insn, std::ostream*);
+
+    void exec_flw(uint32_t insn, std::ostream*);
+    void exec_fld(uint32_t insn, std::ostream*);
+    void exec_fsw(uint32_t insn, std::ostream*);
+    void exec_fsd(uint32_t insn, std::ostream*);
 
     void exec_addi(uint32_t insn, std::ostream*);
     void exec_slti(uint32_t insn, std::ostream*);
@@ -110,22 +306,338 @@ private:
     void exec_srl(uint32_t insn, std::ostream*);
     void exec_sra(uint32_t insn, std::ostream*);
 
+    void exec_addiw(uint32_t insn, std::ostream*);
+    void exec_slliw(uint32_t insn, std::ostream*);
+    void exec_srliw(uint32_t insn, std::ostream*);
+    void exec_sraiw(uint32_t insn, std::ostream*);
+    void exec_addw(uint32_t insn, std::ostream*);
+    void exec_subw(uint32_t insn, std::ostream*);
+    void exec_sllw(uint32_t insn, std::ostream*);
+    void exec_srlw(uint32_t insn, std::ostream*);
+    void exec_sraw(uint32_t insn, std::ostream*);
+
+    void exec_mul(uint32_t insn, std::ostream*);
+    void exec_mulh(uint32_t insn, std::ostream*);
+    void exec_mulhsu(uint32_t insn, std::ostream*);
+    void exec_mulhu(uint32_t insn, std::ostream*);
+    void exec_div(uint32_t insn, std::ostream*);
+    void exec_divu(uint32_t insn, std::ostream*);
+    void exec_rem(uint32_t insn, std::ostream*);
+    void exec_remu(uint32_t insn, std::ostream*);
+
+    void exec_mulw(uint32_t insn, std::ostream*);
+    void exec_divw(uint32_t insn, std::ostream*);
+    void exec_divuw(uint32_t insn, std::ostream*);
+    void exec_remw(uint32_t insn, std::ostream*);
+    void exec_remuw(uint32_t insn, std::ostream*);
+
+    static uint32_t bitmanip(int op, uint32_t a, uint32_t b);
+    void exec_bitmanip(uint32_t insn, std::ostream*, int op);
+
+    static constexpr uint32_t fflag_nx  = 0x01;    ///< Inexact.
+    static constexpr uint32_t fflag_uf  = 0x02;    ///< Underflow.
+    static constexpr uint32_t fflag_of  = 0x04;    ///< Overflow.
+    static constexpr uint32_t fflag_dz  = 0x08;    ///< Divide by zero.
+    static constexpr uint32_t fflag_nv  = 0x10;    ///< Invalid operation.
+
+    static uint32_t host_fflags();
+    static int host_rounding(uint32_t rm);
+    template <typename T> static uint32_t fp_to_int(T v, uint32_t rm, bool is_unsigned, uint32_t &flags);
+    void exec_fp(uint32_t insn, std::ostream*, int op);
+    template <typename T> void exec_fp_op(uint32_t insn, std::ostream*, int op);
+
+    static constexpr reg_t vtype_vill = (reg_t) 1 << (XLEN - 1);  ///< vtype is illegal.
+
+    static constexpr uint32_t prv_u         = 0;
+    static constexpr uint32_t prv_s         = 1;
+    static constexpr uint32_t prv_m         = 3;
+
+    static constexpr reg_t mstatus_sie      = 0x00002;  ///< S-mode interrupts enabled.
+    static constexpr reg_t mstatus_mie      = 0x00008;  ///< M-mode interrupts enabled.
+    static constexpr reg_t mstatus_spie     = 0x00020;  ///< SIE before the trap.
+    static constexpr reg_t mstatus_mpie     = 0x00080;  ///< MIE before the trap.
+    static constexpr reg_t mstatus_spp      = 0x00100;  ///< Mode before an S-mode trap.
+    static constexpr reg_t mstatus_mpp      = 0x01800;  ///< Mode before an M-mode trap.
+    static constexpr reg_t mstatus_mprv     = 0x20000;  ///< Loads and stores use MPP.
+    static constexpr reg_t mstatus_sum      = 0x40000;  ///< S-mode may touch U pages.
+    static constexpr reg_t mstatus_mxr      = 0x80000;  ///< Loads may read X pages.
+    static constexpr reg_t mstatus_tw       = 0x200000; ///< wfi traps below M-mode.
+    static constexpr reg_t sstatus_mask     = mstatus_sie | mstatus_spie | mstatus_spp | mstatus_sum | mstatus_mxr;
+
+    static constexpr reg_t mip_ssip         = 0x002;    ///< S-mode software interrupt.
+    static constexpr reg_t mip_msip         = 0x008;    ///< Software interrupt.
+    static constexpr reg_t mip_stip         = 0x020;    ///< S-mode timer interrupt.
+    static constexpr reg_t mip_mtip         = 0x080;    ///< Timer interrupt.
+    static constexpr reg_t mip_seip         = 0x200;    ///< S-mode external interrupt.
+    static constexpr reg_t mip_meip         = 0x800;    ///< External interrupt.
+    static constexpr reg_t mip_s_mask       = mip_ssip | mip_stip | mip_seip;
+
+    static constexpr reg_t cause_insn_misaligned    = 0;
+    static constexpr reg_t cause_fetch_access       = 1;
+    static constexpr reg_t cause_illegal_insn       = 2;
+    static constexpr reg_t cause_breakpoint         = 3;
+    static constexpr reg_t cause_load_misaligned    = 4;
+    static constexpr reg_t cause_load_access        = 5;
+    static constexpr reg_t cause_store_misaligned   = 6;
+    static constexpr reg_t cause_store_access       = 7;
+    static constexpr reg_t cause_ecall_u            = 8;    ///< Plus the mode, for S and M.
+    static constexpr reg_t cause_ecall_m            = 11;
+    static constexpr reg_t cause_fetch_page_fault   = 12;
+    static constexpr reg_t cause_load_page_fault    = 13;
+    static constexpr reg_t cause_store_page_fault   = 15;
+    static constexpr reg_t cause_interrupt          = (reg_t) 1 << (XLEN - 1);
+
+    static constexpr reg_t medeleg_mask     = 0xb3ff;   ///< All but ecall from M.
+    static constexpr reg_t mideleg_mask     = mip_s_mask;
+
+    bool delegated(reg_t cause) const;
+    reg_t trap_vector(reg_t cause) const;
+    void trap(reg_t cause, reg_t tval, const std::string &reason);
+    void check_interrupts();
+    reg_t get_mip() const;
+    void exec_mret(uint32_t insn, std::ostream*);
+    void exec_sret(uint32_t insn, std::ostream*);
+    void exec_sfence_vma(uint32_t insn, std::ostream*);
+    void exec_wfi(uint32_t insn, std::ostream*);
+
+    static constexpr uint32_t idle_none     = 0;
+    static constexpr uint32_t idle_wfi      = 1;    ///< Stalled in wfi.
+    static constexpr uint32_t idle_loop     = 2;    ///< Going round a loop that changes nothing.
+    static constexpr reg_t idle_span        = 64;   ///< The longest loop watched, in bytes.
+
+    void watch_idle(reg_t from);
+    static bool idle_opcode(uint32_t insn);
+
+    static constexpr reg_t satp_sv32        = 0x80000000;   ///< MODE, Sv32 on RV32.
+    static constexpr reg_t satp_ppn         = 0x003fffff;
+
+    static constexpr uint32_t pte_v         = 0x01;
+    static constexpr uint32_t pte_r         = 0x02;
+    static constexpr uint32_t pte_w         = 0x04;
+    static constexpr uint32_t pte_x         = 0x08;
+    static constexpr uint32_t pte_u         = 0x10;
+    static constexpr uint32_t pte_a         = 0x40;
+    static constexpr uint32_t pte_d         = 0x80;
+
+    static constexpr int access_fetch       = 0;
+    static constexpr int access_load        = 1;
+    static constexpr int access_store       = 2;    ///< Also AMOs and sc.w.
+
+    static constexpr uint32_t page_size     = 0x1000;
+    static constexpr uint32_t tlb_size      = 256;
+    static constexpr uint32_t tlb_invalid   = 0xffffffff;   ///< Never a 20-bit VPN.
+
+    /**
+     * @brief A cached translation of one 4 KiB page.
+    */
+    struct tlb_entry
+    {
+        uint32_t tag_r = { tlb_invalid };   ///< The VPN, if fetches (ITLB) or loads (DTLB) may use it.
+        uint32_t tag_w = { tlb_invalid };   ///< The VPN, if stores may use it.
+        uint32_t delta = { 0 };             ///< The physical minus the virtual address.
+    };
+
+    static constexpr uint32_t pmp_entries   = 16;
+    static constexpr uint8_t pmp_r          = 0x01;
+    static constexpr uint8_t pmp_w          = 0x02;
+    static constexpr uint8_t pmp_x          = 0x04;
+    static constexpr uint8_t pmp_a          = 0x18;     ///< How the address matches.
+    static constexpr uint8_t pmp_tor        = 0x08;
+    static constexpr uint8_t pmp_na4        = 0x10;
+    static constexpr uint8_t pmp_napot      = 0x18;
+    static constexpr uint8_t pmp_l          = 0x80;     ///< Locked, and enforced on M-mode.
+
+    /**
+     * @brief The bytes one PMP entry covers, decoded from its address
+     * register and the one before it.
+    */
+    struct pmp_rule
+    {
+        uint64_t lo = { 0 };
+        uint64_t hi = { 0 };                ///< One past the last byte, lo for none.
+        uint8_t cfg = { 0 };
+    };
+
+    /**
+     * @brief A run of physical addresses the last PMP check found one
+     * answer for.
+    */
+    struct pmp_window
+    {
+        uint64_t lo = { 0 };
+        uint64_t len = { 0 };               ///< 0 for no window.
+    };
+
+    void update_vm();
+    void flush_tlb();
+    void update_pmp();
+    bool pmp_allows(uint64_t pa, uint32_t len, int access, uint32_t mode, pmp_window *w) const;
+    bool pmp_check(reg_t addr, uint32_t pa, uint32_t len, int access);
+    bool translate(reg_t addr, int access, uint32_t &pa, uint32_t len = 1);
+    bool walk(reg_t addr, int access, uint32_t &pa);
+    bool copy_guest(reg_t addr, uint8_t *buf, uint32_t len, bool store);
+    template <typename T> bool load(reg_t addr, T &val);
+    template <typename T> bool store(reg_t addr, T val);
+
+    static int lmul_log2(reg_t vt);
+    static bool vreg_ok(uint32_t r, int emul_log2);
+    static std::string render_vec_elems(const uint8_t *v, uint32_t sew, uint32_t n);
+    static std::string render_vec_mask(const uint8_t *m, uint32_t n);
+    void exec_vsetvl(uint32_t insn, std::ostream*);
+    void exec_vec_mem(uint32_t insn, std::ostream*, bool store);
+    void exec_vec(uint32_t insn, std::ostream*, int op);
+
+    void exec_lr_w(uint32_t insn, std::ostream*);
+    void exec_sc_w(uint32_t insn, std::ostream*);
+    void exec_amo(uint32_t insn, std::ostream*, const char *mnemonic, int op);
+
     void exec_ecall(uint32_t insn, std::ostream*);
     void exec_ebreak(uint32_t insn, std::ostream*);
 
+    void exec_csrrw(uint32_t insn, std::ostream*);
     void exec_csrrs(uint32_t insn, std::ostream*);
+    void exec_csrrc(uint32_t insn, std::ostream*);
+    void exec_csrrwi(uint32_t insn, std::ostream*);
+    void exec_csrrsi(uint32_t insn, std::ostream*);
+    void exec_csrrci(uint32_t insn, std::ostream*);
+
+    static constexpr int csr_op_write   = 0;
+    static constexpr int csr_op_set     = 1;
+    static constexpr int csr_op_clear   = 2;
+
+    void exec_csr(uint32_t insn, std::ostream*, const char *mnemonic, int op, reg_t src, bool write);
+    bool csr_read(uint32_t csr, reg_t &val);
+    bool csr_write(uint32_t csr, reg_t val);
+
+    uint64_t get_cycles() const;
+    uint64_t counter_source(uint32_t i) const;
+    uint64_t counter_value(uint32_t i) const;
+    void set_counter(uint32_t i, uint64_t val);
 
     bool show_instructions = false;
     bool show_registers = false;
+    bool detailed = true;
+    bool tracing = false;
 
     bool halt = { false };
     std::string halt_reason = { "none" };
 
     uint64_t insn_counter = { 0 };
-    uint32_t pc = { 0 };
+    reg_t pc = { 0 };
+    uint32_t insn_len = { 4 };          ///< Length of the executing insn.
     uint32_t mhartid = { 0 };
 
+    bool reservation_valid = { false };
+    reg_t reservation_addr = { 0 };
+    uint32_t reservation_value = { 0 }; ///< The word lr.w loaded.
+
+    reg_t misa = { (reg_t) xlen_traits<XLEN>::misa };
+    uint32_t priv = { prv_m };          ///< The current privilege mode.
+    reg_t mstatus = { mstatus_mpp };
+    reg_t mie = { 0 };
+    reg_t mtvec = { 0 };                ///< 0 means no handler, traps halt.
+    reg_t mepc = { 0 };
+    reg_t mcause = { 0 };
+    reg_t mtval = { 0 };
+    reg_t medeleg = { 0 };
+    reg_t mideleg = { 0 };
+    reg_t mip_sw = { 0 };               ///< The S-mode pending bits M-mode wrote.
+    reg_t stvec = { 0 };                ///< 0 means no handler, as for mtvec.
+    reg_t sscratch = { 0 };
+    reg_t sepc = { 0 };
+    reg_t scause = { 0 };
+    reg_t stval = { 0 };
+    reg_t satp = { 0 };
+    bool vm_fetch = { false };          ///< Fetches are translated.
+    bool vm_data = { false };           ///< Loads and stores are translated.
+    uint32_t fetch_mode = { 0 };        ///< The ITLB in use, by privilege.
+    uint32_t data_mode = { 0 };         ///< The DTLB in use, by privilege.
+    tlb_entry itlb[2][tlb_size];        ///< Per U and S mode.
+    tlb_entry dtlb[2][tlb_size];
+    uint64_t tlb_misses = { 0 };
+    uint64_t page_faults = { 0 };
+    uint8_t pmpcfg[pmp_entries] = { };
+    reg_t pmpaddr[pmp_entries] = { };
+    pmp_rule pmp_rules[pmp_entries];
+    uint32_t pmp_count = { 0 };         ///< Entries up to the last one that is on.
+    bool pmp_locked = { false };        ///< Some entry applies to M-mode.
+    bool pmp_fetch = { false };         ///< Fetches are checked.
+    bool pmp_data = { false };          ///< Loads and stores are checked.
+    pmp_window pmp_last[3];             ///< By access type, the window that last passed.
+    uint64_t pmp_misses = { 0 };
+    uint32_t idle = { idle_none };
+    reg_t idle_head = { 0 };            ///< Where the loop being watched starts.
+    uint32_t idle_step = { 0 };         ///< 1 while one iteration of it is watched.
+    bool idle_pure = { false };         ///< The watched iteration only read registers and devices.
+    uint64_t idle_mark = { 0 };         ///< insn_counter at the start of the watched iteration.
+    uint64_t idle_loads = { 0 };        ///< Loads, stores and device accesses at the last pass.
+    uint64_t idle_stores = { 0 };
+    uint64_t idle_mmio = { 0 };
+    uint64_t idle_taken = { 0 };        ///< taken_transfers at the start of the watched iteration.
+    uint64_t idle_kinds[insn_record::num_kinds] = { };
+    std::vector<sreg_t> idle_regs;      ///< The registers at the start of the watched iteration.
+    uint64_t wfi_cycles = { 0 };        ///< Cycles spent stalled in wfi.
+    uint64_t idle_skips = { 0 };
+    uint64_t idle_skipped = { 0 };      ///< Instructions of idle loops skipped.
+    std::atomic<uint64_t> irq_check_at = { UINT64_MAX };  ///< insn_counter at which to look at interrupts.
+    uint64_t traps = { 0 };
+    uint64_t interrupts = { 0 };
+    reg_t mscratch = { 0 };
+    uint32_t mcountinhibit = { 0 };
+    uint32_t hpm_event[32] = { };
+    uint32_t frm = { 0 };               ///< Dynamic rounding mode.
+    uint32_t fflags = { 0 };            ///< Accrued exception flags.
+    bool fp_used = { false };           ///< An F or D insn or CSR was used.
+    reg_t vl = { 0 };                   ///< Vector length.
+    reg_t vtype = { vtype_vill };       ///< Vector type, illegal until a vset*vl*.
+    reg_t vstart = { 0 };
+    uint32_t vxrm = { 0 };
+    uint32_t vxsat = { 0 };
+    bool vec_used = { false };          ///< A V insn or CSR was used.
+    std::vector<uint8_t> vec_tmp;       ///< Scalar operands and masked results.
+    uint64_t counter_delta[32] = { };   ///< Counter value minus its source.
+
+    std::vector<insn_sink*> sinks;
+    std::vector<insn_record> trace_buf;
+
+    uint64_t kind_counts[insn_record::num_kinds] = { };
+    uint64_t taken_transfers = { 0 };
+    uint64_t last_transfer = { 0 };
+    stat_histogram block_len = { block_len_buckets };
+
 protected:
-    registerfile regs;
+    registerfile<sreg_t> regs;
+    fpregisterfile fregs;
+    vregisterfile vregs;
     memory &mem;
-};
\ No newline at end of file
+    syscall_emu *sys = { nullptr };
+    clint *timer = { nullptr };
+    plic *irqc = { nullptr };
+    replay_log *log = { nullptr };
+
+    /**
+     * @brief Halts the hart from outside an instruction.
+     * 
+     * @param reason The reason to report.
+    */
+    void stop(const std::string &reason) { halt = true; halt_reason = reason; }
+    /**
+     * @brief Moves the hart to another pc from outside an instruction,
+     * ending any wait.
+     * 
+     * @param new_pc The pc.
+    */
+    void set_pc(reg_t new_pc) { pc = new_pc; idle = idle_none; idle_step = 0; }
+
+    /**
+     * @brief Called when the guest writes a command to the marker CSR.
+     * 
+     * @param cmd The command, one of the marker_X values.
+    */
+    virtual void on_marker(uint32_t cmd) { (void) cmd; }
+};
+
+typedef rv_hart<32> rv32i_hart;
+typedef rv_hart<64> rv64i_hart;
+
+#endif
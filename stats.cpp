@@ -0,0 +1,147 @@
+#include "stats.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Registers a scalar counter.
+ * 
+ * @param name The dotted name of the statistic.
+ * @param counter The counter. It must outlive the registry.
+ * @param desc A short description.
+*/
+void stats::add_scalar(const std::string &name, const uint64_t *counter, const std::string &desc)
+{
+    entries.push_back(entry { name, desc, counter, std::vector<std::string>(), std::vector<uint64_t>(1, 0) });
+}
+
+/**
+ * @brief Registers a vector of counters.
+ * 
+ * @param name The dotted name of the statistic.
+ * @param counters The first counter. It must outlive the registry.
+ * @param labels The label of each counter.
+ * @param desc A short description.
+*/
+void stats::add_vector(const std::string &name, const uint64_t *counters,
+                       const std::vector<std::string> &labels, const std::string &desc)
+{
+    entries.push_back(entry { name, desc, counters, labels, std::vector<uint64_t>(labels.size(), 0) });
+}
+
+/**
+ * @brief Registers a histogram.
+ * 
+ * @param name The dotted name of the statistic.
+ * @param h The histogram. It must outlive the registry.
+ * @param desc A short description.
+*/
+void stats::add_histogram(const std::string &name, const stat_histogram *h, const std::string &desc)
+{
+    // Label each bucket with the range of values it counts.
+    std::vector<std::string> labels;
+    for (size_t b = 0; b < h->buckets.size(); ++b)
+    {
+        std::ostringstream os;
+        if (b == 0)
+            os << "0";
+        else if (b == h->buckets.size() - 1)
+            os << (1ull << (b - 1)) << "+";
+        else if (b == 1)
+            os << "1";
+        else
+            os << (1ull << (b - 1)) << "-" << ((1ull << b) - 1);
+        labels.push_back(os.str());
+    }
+    add_vector(name, h->buckets.data(), labels, desc);
+}
+
+/**
+ * @brief Starts every statistic counting from zero again.
+*/
+void stats::reset()
+{
+    for (entry &e : entries)
+    {
+        for (size_t i = 0; i < e.base.size(); ++i)
+            e.base[i] = e.values[i];
+    }
+}
+
+/**
+ * @brief Dumps every statistic.
+ * 
+ * @param os The stream to print to.
+ * @param insns The instruction count at the time of the dump.
+*/
+void stats::dump(std::ostream &os, uint64_t insns)
+{
+    if (json)
+        dump_json(os, insns);
+    else
+        dump_text(os, insns);
+
+    ++dumps;
+}
+
+/**
+ * @brief Dumps every statistic as one line per value.
+ * 
+ * @param os The stream to print to.
+ * @param insns The instruction count at the time of the dump.
+*/
+void stats::dump_text(std::ostream &os, uint64_t insns) const
+{
+    os << "---------- Begin stats dump " << dumps << " @ " << insns << " instructions ----------" << endl;
+    for (const entry &e : entries)
+    {
+        if (e.labels.empty())
+        {
+            os << std::setw(40) << std::left << e.name << std::right << std::setw(16)
+               << e.values[0] - e.base[0] << "  # " << e.desc << endl;
+            continue;
+        }
+
+        for (size_t i = 0; i < e.labels.size(); ++i)
+        {
+            os << std::setw(40) << std::left << e.name + "::" + e.labels[i] << std::right
+               << std::setw(16) << e.values[i] - e.base[i] << "  # " << e.desc << endl;
+        }
+    }
+    os << "---------- End stats dump ----------" << endl;
+}
+
+/**
+ * @brief Dumps every statistic as a single-line JSON object.
+ * 
+ * @param os The stream to print to.
+ * @param insns The instruction count at the time of the dump.
+*/
+void stats::dump_json(std::ostream &os, uint64_t insns) const
+{
+    os << "{\"dump\":" << dumps << ",\"insns\":" << insns;
+    for (const entry &e : entries)
+    {
+        os << ",\"" << e.name << "\":";
+        if (e.labels.empty())
+        {
+            os << e.values[0] - e.base[0];
+            continue;
+        }
+
+        os << "{";
+        for (size_t i = 0; i < e.labels.size(); ++i)
+        {
+            os << (i ? "," : "") << "\"" << e.labels[i] << "\":" << e.values[i] - e.base[i];
+        }
+        os << "}";
+    }
+    os << "}" << endl;
+}
@@ -0,0 +1,98 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "hex.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A log2 histogram of sampled values.
+ * 
+ * Bucket 0 counts the value 0 and bucket b counts values in
+ * [2^(b-1), 2^b). The last bucket also takes everything larger.
+*/
+class stat_histogram
+{
+public:
+    /**
+     * @brief Constructor for the histogram.
+     * 
+     * @param n The number of buckets.
+    */
+    stat_histogram(int n) : buckets(n, 0) {}
+
+    /**
+     * @brief Adds a sample to the histogram.
+     * 
+     * @param v The sampled value.
+    */
+    void sample(uint64_t v)
+    {
+        size_t b = v ? 64 - __builtin_clzll(v) : 0;
+        ++buckets[b < buckets.size() ? b : buckets.size() - 1];
+    }
+
+    std::vector<uint64_t> buckets;
+};
+
+/**
+ * @brief A registry of named statistics.
+ * 
+ * Components keep their counters as plain uint64_t members and register
+ * their addresses here, so counting costs a plain add on storage owned
+ * by the thread running that component. The registry only reads the
+ * counters when it dumps them. Names are dotted paths such as
+ * "hart0.loads" that group the statistics by component.
+ * 
+ * A reset does not write to the counters. It remembers their current
+ * values and later dumps subtract them, so architectural counters such
+ * as the instruction count can be registered too.
+*/
+class stats
+{
+public:
+    void add_scalar(const std::string &name, const uint64_t *counter, const std::string &desc);
+    void add_vector(const std::string &name, const uint64_t *counters,
+                    const std::vector<std::string> &labels, const std::string &desc);
+    void add_histogram(const std::string &name, const stat_histogram *h, const std::string &desc);
+
+    void reset();
+    void dump(std::ostream &os, uint64_t insns);
+
+    /**
+     * @brief Sets json
+     * 
+     * @param b True to dump one JSON object per line instead of text.
+    */
+    void set_json(bool b) { json = b; }
+
+private:
+    /**
+     * @brief One registered statistic.
+    */
+    struct entry
+    {
+        std::string name;
+        std::string desc;
+        const uint64_t *values;
+        std::vector<std::string> labels;    ///< Empty for a scalar.
+        std::vector<uint64_t> base;         ///< The values at the last reset.
+    };
+
+    void dump_text(std::ostream &os, uint64_t insns) const;
+    void dump_json(std::ostream &os, uint64_t insns) const;
+
+    std::vector<entry> entries;
+    uint64_t dumps = { 0 };
+    bool json = { false };
+};
+
+#endif
@@ -0,0 +1,615 @@
+#include "syscall_emu.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor for the system call emulation.
+ * 
+ * The guest starts with fds 0, 1 and 2 open on the host's, and with the
+ * program break just past the loaded image.
+ * 
+ * @param m The simulated memory.
+ * @param xlen The register width of the guest, 32 or 64.
+*/
+syscall_emu::syscall_emu(memory &m, uint32_t xlen) : mem(m), long_bytes(xlen / 8)
+{
+    fds = { 0, 1, 2 };
+
+    brk_start = (mem.get_image_size() + 15) & ~15u;
+    brk_cur = brk_start;
+    brk_limit = mem.get_size();
+    stack_top = mem.get_size();
+}
+
+/**
+ * @brief Closes the host files the guest left open.
+*/
+syscall_emu::~syscall_emu()
+{
+    for (int h : fds)
+    {
+        if (h > 2)
+        {
+            close(h);
+        }
+    }
+}
+
+/**
+ * @brief Builds the initial stack at the top of memory.
+ * 
+ * From the stack pointer up the stack holds argc, the argv pointers and
+ * a null, the envp pointers and a null, the auxiliary vector and then
+ * the strings, as a Linux kernel leaves it.
+ * 
+ * @param argv The guest's arguments, argv[0] first.
+ * @param envp The guest's environment, as NAME=value strings.
+ * 
+ * @return True if it fit above the program image, False otherwise.
+*/
+bool syscall_emu::setup_stack(const std::vector<std::string> &argv, const std::vector<std::string> &envp)
+{
+    uint64_t sp = mem.get_size() & ~15u;
+
+    // Place the strings, first one highest.
+    std::vector<uint64_t> ptrs;
+    for (const std::vector<std::string> *v : { &argv, &envp })
+    {
+        for (const std::string &s : *v)
+        {
+            if (sp < s.size() + 1)
+            {
+                return false;
+            }
+            sp -= s.size() + 1;
+            ptrs.push_back(sp);
+        }
+    }
+
+    // argc, argv, null, envp, null and the AT_PAGESZ and AT_NULL pairs.
+    uint64_t slots = 1 + argv.size() + 1 + envp.size() + 1 + 4;
+    uint64_t vec = ((sp & ~15u) - slots * long_bytes) & ~15u;
+    if (sp < slots * long_bytes + 16 || vec < mem.get_image_size())
+    {
+        return false;
+    }
+
+    size_t n = 0;
+    for (const std::vector<std::string> *v : { &argv, &envp })
+    {
+        for (const std::string &s : *v)
+        {
+            mem.set_block(ptrs[n++], (const uint8_t *) s.c_str(), s.size() + 1);
+        }
+    }
+
+    std::vector<uint64_t> words;
+    words.push_back(argv.size());
+    words.insert(words.end(), ptrs.begin(), ptrs.begin() + argv.size());
+    words.push_back(0);
+    words.insert(words.end(), ptrs.begin() + argv.size(), ptrs.end());
+    words.push_back(0);
+    words.insert(words.end(), { at_pagesz, page_size, 0, 0 });
+
+    for (uint64_t i = 0; i < words.size(); ++i)
+    {
+        put(mem.get_ptr(vec + i * long_bytes, long_bytes), words[i], long_bytes);
+    }
+
+    stack_top = vec;
+    return true;
+}
+
+/**
+ * @brief Sets brk_limit
+ * 
+ * @param limit The highest address the program break may move to,
+ *  normally the bottom of the lowest hart's stack.
+*/
+void syscall_emu::set_brk_limit(uint32_t limit)
+{
+    brk_limit = limit;
+}
+
+/**
+ * @brief Performs one system call.
+ * 
+ * @param nr The call number, from a7.
+ * @param args The six arguments, from a0-a5, sign-extended to 64 bits.
+ * @param ret Set to the value for a0, a negated errno on failure.
+ * 
+ * @return False if the calling hart exited, True otherwise.
+*/
+bool syscall_emu::call(uint64_t nr, const uint64_t *args, uint64_t &ret)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    // A call that asks the host is logged, and answered from the log
+    // where the log has it. exit and brk ask nothing of the host.
+    bool logged = log && nr != sys_exit && nr != sys_exit_group && nr != sys_brk;
+    if (logged && log->is_replaying())
+    {
+        return replay(nr, args, ret);
+    }
+    filled.clear();
+
+    int64_t r = 0;
+    switch (nr)
+    {
+        case sys_read:
+            {
+                int h = host_fd(args[0]);
+                uint8_t *buf = guest_ptr(args[1], args[2]);
+                if (h < 0)
+                    r = -EBADF;
+                else if (!buf)
+                    r = -EFAULT;
+                else
+                    r = host_result(read(h, buf, args[2]));
+                if (r > 0)
+                    fill(buf, r);
+            }
+            break;
+        case sys_write:
+            {
+                int h = host_fd(args[0]);
+                uint8_t *buf = guest_ptr(args[1], args[2]);
+                if (h < 0)
+                    r = -EBADF;
+                else if (!buf)
+                    r = -EFAULT;
+                else
+                {
+                    // Keep the guest's output in order with the simulator's.
+                    if (h == 1)
+                        cout.flush();
+                    r = host_result(write(h, buf, args[2]));
+                }
+            }
+            break;
+        case sys_openat:
+            r = do_openat(args);
+            break;
+        case sys_close:
+            r = do_close(args[0]);
+            break;
+        case sys_lseek:
+            {
+                int h = host_fd(args[0]);
+                r = h < 0 ? -EBADF : host_result(lseek(h, (off_t) args[1], (int) args[2]));
+            }
+            break;
+        case sys_fstat:
+            r = do_fstat(args[0], args[1]);
+            break;
+        case sys_brk:
+            r = do_brk(args[0]);
+            break;
+        case sys_gettimeofday:
+        case sys_clock_gettime:
+        case sys_clock_gettime64:
+            r = do_gettime(nr, args);
+            break;
+        case sys_exit_group:
+            group_exited = true;
+            exit_status = (int) args[0];
+            return false;
+        case sys_exit:
+            exit_status = (int) args[0];
+            return false;
+        default:
+            cerr << "WARNING: Unimplemented system call " << nr << endl;
+            r = -ENOSYS;
+            break;
+    }
+
+    ret = (uint64_t) r;
+    if (logged)
+    {
+        record(nr, ret);
+    }
+    return true;
+}
+
+/**
+ * @brief Notes guest memory the current call wrote, for the log.
+ * 
+ * @param p The host pointer to the guest bytes.
+ * @param len The number of bytes.
+*/
+void syscall_emu::fill(const uint8_t *p, uint64_t len)
+{
+    filled.push_back({ static_cast<uint32_t>(p - mem.get_ptr(0, 1)), static_cast<uint32_t>(len) });
+}
+
+/**
+ * @brief Logs a call: its number, and the address, length and bytes of
+ * each piece of guest memory it wrote.
+ * 
+ * @param nr The call number.
+ * @param ret The value for a0.
+*/
+void syscall_emu::record(uint64_t nr, uint64_t ret)
+{
+    std::string data(reinterpret_cast<const char *>(&nr), sizeof(nr));
+    for (const auto &f : filled)
+    {
+        data.append(reinterpret_cast<const char *>(&f.first), sizeof(f.first));
+        data.append(reinterpret_cast<const char *>(&f.second), sizeof(f.second));
+        data.append(reinterpret_cast<const char *>(mem.get_ptr(f.first, f.second)), f.second);
+    }
+    log->add(replay_log::kind_syscall, ret, data);
+}
+
+/**
+ * @brief Answers a call from the log rather than the host. The guest's
+ * console output is written again, unless the run is going over time it
+ * has already shown.
+ * 
+ * @param nr The call number.
+ * @param args The six arguments.
+ * @param ret Set to the logged value for a0.
+ * 
+ * @return True, as the calls that end a hart are not logged.
+*/
+bool syscall_emu::replay(uint64_t nr, const uint64_t *args, uint64_t &ret)
+{
+    const replay_log::entry *e = log->take(replay_log::kind_syscall);
+    uint64_t logged_nr = 0;
+    if (e && e->data.size() >= sizeof(logged_nr))
+    {
+        memcpy(&logged_nr, e->data.data(), sizeof(logged_nr));
+    }
+    if (!e || logged_nr != nr)
+    {
+        log->diverge(std::string(get_name(nr)) + " is not the next input in the log");
+        ret = (uint64_t) -ENOSYS;
+        return true;
+    }
+
+    const char *d = e->data.data();
+    for (size_t i = sizeof(logged_nr); i + 8 <= e->data.size(); )
+    {
+        uint32_t addr;
+        uint32_t len;
+        memcpy(&addr, d + i, sizeof(addr));
+        memcpy(&len, d + i + 4, sizeof(len));
+        mem.set_block(addr, reinterpret_cast<const uint8_t *>(d + i + 8), len);
+        i += 8 + len;
+    }
+
+    int h = host_fd(args[0]);
+    if (nr == sys_write && (h == 1 || h == 2) && (int64_t) e->value > 0 && !log->is_quiet())
+    {
+        uint8_t *buf = guest_ptr(args[1], e->value);
+        if (buf)
+        {
+            cout.flush();
+            if (write(h, buf, e->value) < 0)
+                cerr << "WARNING: Can't write replayed output" << endl;
+        }
+    }
+
+    ret = e->value;
+    return true;
+}
+
+/**
+ * @brief Gets the name of a system call, for the instruction trace.
+ * 
+ * @param nr The call number.
+ * 
+ * @return The name, or "syscall" if it is not emulated.
+*/
+const char *syscall_emu::get_name(uint64_t nr)
+{
+    switch (nr)
+    {
+        case sys_openat:            return "openat";
+        case sys_close:             return "close";
+        case sys_lseek:             return "lseek";
+        case sys_read:              return "read";
+        case sys_write:             return "write";
+        case sys_fstat:             return "fstat";
+        case sys_exit:              return "exit";
+        case sys_exit_group:        return "exit_group";
+        case sys_clock_gettime:     return "clock_gettime";
+        case sys_gettimeofday:      return "gettimeofday";
+        case sys_brk:               return "brk";
+        case sys_clock_gettime64:   return "clock_gettime64";
+    }
+    return "syscall";
+}
+
+/**
+ * @brief Gets a host pointer to a guest buffer.
+ * 
+ * @param addr The guest address.
+ * @param len The length of the buffer.
+ * 
+ * @return The host pointer, or nullptr if the buffer is not wholly in
+ *  the simulated memory.
+*/
+uint8_t *syscall_emu::guest_ptr(uint64_t addr, uint64_t len)
+{
+    // An RV32 address came in sign-extended.
+    if (long_bytes == 4)
+        addr = (uint32_t) addr;
+
+    if (addr > UINT32_MAX || len > UINT32_MAX)
+        return nullptr;
+    return mem.get_ptr(addr, len);
+}
+
+/**
+ * @brief Gets a host pointer to a guest string.
+ * 
+ * @param addr The guest address of the string.
+ * 
+ * @return The string, or nullptr if it is not terminated inside the
+ *  simulated memory.
+*/
+const char *syscall_emu::guest_str(uint64_t addr)
+{
+    if (long_bytes == 4)
+        addr = (uint32_t) addr;
+
+    if (addr >= mem.get_size())
+        return nullptr;
+
+    uint32_t len = mem.get_size() - addr;
+    const char *s = (const char *) mem.get_ptr(addr, len);
+    return memchr(s, 0, len) ? s : nullptr;
+}
+
+/**
+ * @brief Maps a guest fd to the host's.
+ * 
+ * @param fd The guest fd.
+ * 
+ * @return The host fd, or -1 if the guest fd is not open.
+*/
+int syscall_emu::host_fd(uint64_t fd) const
+{
+    return fd < fds.size() ? fds[fd] : -1;
+}
+
+/**
+ * @brief Stores a little-endian value into guest memory.
+ * 
+ * @param p The host pointer to the guest bytes.
+ * @param val The value.
+ * @param len The number of bytes to store, at most 8.
+*/
+void syscall_emu::put(uint8_t *p, uint64_t val, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; ++i)
+        p[i] = (uint8_t) (val >> (8 * i));
+}
+
+/**
+ * @brief Converts the result of a host call to the guest's convention.
+ * 
+ * @param r What the host call returned, -1 with errno set on failure.
+ * 
+ * @return r, or the negated errno on failure.
+*/
+int64_t syscall_emu::host_result(int64_t r)
+{
+    return r < 0 ? -errno : r;
+}
+
+/**
+ * @brief Translates the open flags of the RISC-V Linux ABI to the host's.
+ * 
+ * @param flags The guest's flags.
+ * 
+ * @return The host's flags.
+*/
+int syscall_emu::open_flags(uint64_t flags)
+{
+    static const struct { uint64_t guest; int host; } map[] =
+    {
+        { 00000100, O_CREAT },
+        { 00000200, O_EXCL },
+        { 00000400, O_NOCTTY },
+        { 00001000, O_TRUNC },
+        { 00002000, O_APPEND },
+        { 00004000, O_NONBLOCK },
+        { 00200000, O_DIRECTORY },
+        { 02000000, O_CLOEXEC },
+    };
+
+    int host = flags & O_ACCMODE;
+    for (const auto &m : map)
+    {
+        if (flags & m.guest)
+            host |= m.host;
+    }
+    return host;
+}
+
+/**
+ * @brief Opens a file, on the lowest free guest fd.
+ * 
+ * @param args dirfd, path, flags and mode.
+ * 
+ * @return The guest fd or a negated errno.
+*/
+int64_t syscall_emu::do_openat(const uint64_t *args)
+{
+    int dir = (int64_t) args[0] == at_fdcwd ? AT_FDCWD : host_fd(args[0]);
+    const char *path = guest_str(args[1]);
+    if (dir == -1)
+        return -EBADF;
+    if (!path)
+        return -EFAULT;
+
+    int h = openat(dir, path, open_flags(args[2]), (mode_t) args[3]);
+    if (h < 0)
+        return -errno;
+
+    size_t fd = std::find(fds.begin(), fds.end(), -1) - fds.begin();
+    if (fd == fds.size())
+        fds.push_back(h);
+    else
+        fds[fd] = h;
+    return fd;
+}
+
+/**
+ * @brief Closes a guest fd. The host's stdin, stdout and stderr stay
+ * open, so the simulator can still print after the guest closes them.
+ * 
+ * @param fd The guest fd.
+ * 
+ * @return 0 or a negated errno.
+*/
+int64_t syscall_emu::do_close(uint64_t fd)
+{
+    int h = host_fd(fd);
+    if (h < 0)
+        return -EBADF;
+
+    fds[fd] = -1;
+    if (h > 2 && close(h) < 0)
+        return -errno;
+    return 0;
+}
+
+/**
+ * @brief Fills in a guest struct stat.
+ * 
+ * @param fd The guest fd.
+ * @param buf The guest address of the struct stat.
+ * 
+ * @return 0 or a negated errno.
+*/
+int64_t syscall_emu::do_fstat(uint64_t fd, uint64_t buf)
+{
+    int h = host_fd(fd);
+    if (h < 0)
+        return -EBADF;
+
+    // dev, ino, mode, nlink, uid, gid, rdev, pad, size, blksize, pad,
+    // blocks, then seconds and nanoseconds of the three times and two
+    // reserved ints.
+    uint32_t times = 72;
+    uint32_t size = times + 6 * long_bytes + 8;
+    uint8_t *p = guest_ptr(buf, size);
+    if (!p)
+        return -EFAULT;
+
+    struct stat st;
+    if (fstat(h, &st) < 0)
+        return -errno;
+
+    memset(p, 0, size);
+    put(p + 0, st.st_dev, 8);
+    put(p + 8, st.st_ino, 8);
+    put(p + 16, st.st_mode, 4);
+    put(p + 20, st.st_nlink, 4);
+    put(p + 24, st.st_uid, 4);
+    put(p + 28, st.st_gid, 4);
+    put(p + 32, st.st_rdev, 8);
+    put(p + 48, st.st_size, 8);
+    put(p + 56, st.st_blksize, 4);
+    put(p + 64, st.st_blocks, 8);
+
+    const struct timespec *ts[] = { &st.st_atim, &st.st_mtim, &st.st_ctim };
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        put(p + times + 2 * i * long_bytes, ts[i]->tv_sec, long_bytes);
+        put(p + times + (2 * i + 1) * long_bytes, ts[i]->tv_nsec, long_bytes);
+    }
+    fill(p, size);
+    return 0;
+}
+
+/**
+ * @brief Moves the program break.
+ * 
+ * @param addr The new break, or 0 to ask for the current one.
+ * 
+ * @return The break after the call. As on Linux a request outside the
+ *  heap leaves the break where it was.
+*/
+int64_t syscall_emu::do_brk(uint64_t addr)
+{
+    if (long_bytes == 4)
+        addr = (uint32_t) addr;
+
+    if (addr >= brk_start && addr <= brk_limit)
+        brk_cur = addr;
+    return brk_cur;
+}
+
+/**
+ * @brief Reads a host clock for gettimeofday or clock_gettime.
+ * 
+ * Seconds are 64 bits. The microseconds or nanoseconds are a long,
+ * except for clock_gettime64, where they are 64 bits as well.
+ * 
+ * @param nr The call number.
+ * @param args The clock ID and struct for clock_gettime, or the timeval
+ *  and timezone for gettimeofday.
+ * 
+ * @return 0 or a negated errno.
+*/
+int64_t syscall_emu::do_gettime(uint64_t nr, const uint64_t *args)
+{
+    uint32_t frac = nr == sys_clock_gettime64 ? 8 : long_bytes;
+    uint64_t addr = nr == sys_gettimeofday ? args[0] : args[1];
+
+    struct timespec ts;
+    if (clock_gettime(nr == sys_gettimeofday ? CLOCK_REALTIME : (clockid_t) args[0], &ts) < 0)
+        return -errno;
+
+    uint8_t *p = guest_ptr(addr, 8 + frac);
+    if (!p)
+        return -EFAULT;
+
+    put(p, ts.tv_sec, 8);
+    put(p + 8, nr == sys_gettimeofday ? ts.tv_nsec / 1000 : ts.tv_nsec, frac);
+    fill(p, 8 + frac);
+
+    // The timezone is always UTC.
+    if (nr == sys_gettimeofday && args[1])
+    {
+        uint8_t *tz = guest_ptr(args[1], 8);
+        if (!tz)
+            return -EFAULT;
+        memset(tz, 0, 8);
+        fill(tz, 8);
+    }
+    return 0;
+}
+
+/**
+ * @brief Registers the program break and how the guest exited, so going
+ * back to a snapshot takes back the calls made since. The host files
+ * are left out: only calls past the end of the replay log reach them.
+ * 
+ * @param c The checkpoint registry.
+ * @param prefix The name the fields are grouped under.
+*/
+void syscall_emu::register_state(checkpoint &c, const std::string &prefix)
+{
+    c.add(prefix + ".brk_cur", &brk_cur);
+    c.add(prefix + ".exit_status", &exit_status);
+    c.add(prefix + ".group_exited", &group_exited);
+}
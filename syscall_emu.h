@@ -0,0 +1,122 @@
+#ifndef SYSCALL_EMU_H
+#define SYSCALL_EMU_H
+
+#include "checkpoint.h"
+#include "replay.h"
+#include <atomic>
+#include <mutex>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Linux system call emulation for ecall.
+ * 
+ * The guest puts the call number in a7 and the arguments in a0-a5, as
+ * newlib and the Linux ABI do, and gets the result or a negated errno
+ * back in a0. Files, time and the program break are proxied to the
+ * host. Guest buffers are handed to the host calls as pointers into the
+ * simulated memory, so nothing is copied on the way in or out.
+ * 
+ * The structs the guest gets back use the RISC-V Linux layouts with
+ * 64-bit seconds, with long being XLEN bits wide. One instance is shared
+ * by every hart, and a mutex keeps the file table and the break
+ * consistent between them.
+*/
+class syscall_emu
+{
+public:
+    syscall_emu(memory &m, uint32_t xlen);
+    ~syscall_emu();
+
+    bool setup_stack(const std::vector<std::string> &argv, const std::vector<std::string> &envp);
+    void set_brk_limit(uint32_t limit);
+    /**
+     * @brief Sets the log the calls that ask the host are recorded to,
+     * or replayed from.
+     * 
+     * @param l The log.
+    */
+    void set_replay(replay_log *l) { log = l; }
+    void register_state(checkpoint &c, const std::string &prefix);
+
+    bool call(uint64_t nr, const uint64_t *args, uint64_t &ret);
+
+    static const char *get_name(uint64_t nr);
+
+    /**
+     * @brief Getter for stack_top
+     * 
+     * @return The guest's initial stack pointer, which points at argc.
+    */
+    uint32_t get_stack_top() const { return stack_top; }
+    /**
+     * @brief Getter for exit_status
+     * 
+     * @return The status the guest last passed to exit or exit_group.
+    */
+    int get_exit_status() const { return exit_status; }
+    /**
+     * @brief Checks if a hart called exit_group.
+     * 
+     * @return True once the whole program has exited.
+    */
+    bool has_exited() const { return group_exited.load(std::memory_order_relaxed); }
+
+    static constexpr uint64_t sys_openat            = 56;
+    static constexpr uint64_t sys_close             = 57;
+    static constexpr uint64_t sys_lseek             = 62;
+    static constexpr uint64_t sys_read              = 63;
+    static constexpr uint64_t sys_write             = 64;
+    static constexpr uint64_t sys_fstat             = 80;
+    static constexpr uint64_t sys_exit              = 93;
+    static constexpr uint64_t sys_exit_group        = 94;
+    static constexpr uint64_t sys_clock_gettime     = 113;
+    static constexpr uint64_t sys_gettimeofday      = 169;
+    static constexpr uint64_t sys_brk               = 214;
+    static constexpr uint64_t sys_clock_gettime64   = 403;
+
+private:
+    static constexpr int64_t at_fdcwd   = -100;
+    static constexpr uint64_t at_pagesz = 6;
+    static constexpr uint64_t page_size = 0x1000;
+
+    uint8_t *guest_ptr(uint64_t addr, uint64_t len);
+    const char *guest_str(uint64_t addr);
+    int host_fd(uint64_t fd) const;
+    void put(uint8_t *p, uint64_t val, uint32_t len);
+    void fill(const uint8_t *p, uint64_t len);
+    void record(uint64_t nr, uint64_t ret);
+    bool replay(uint64_t nr, const uint64_t *args, uint64_t &ret);
+
+    int64_t do_openat(const uint64_t *args);
+    int64_t do_close(uint64_t fd);
+    int64_t do_fstat(uint64_t fd, uint64_t buf);
+    int64_t do_brk(uint64_t addr);
+    int64_t do_gettime(uint64_t nr, const uint64_t *args);
+
+    static int64_t host_result(int64_t r);
+    static int open_flags(uint64_t flags);
+
+    memory &mem;
+    uint32_t long_bytes;                ///< sizeof(long) in the guest.
+    std::vector<int> fds;               ///< Host fd of each guest fd, -1 if free.
+    uint32_t brk_start = { 0 };
+    uint32_t brk_cur = { 0 };
+    uint32_t brk_limit = { 0 };
+    uint32_t stack_top = { 0 };
+    int exit_status = { 0 };
+    std::atomic<bool> group_exited = { false };
+    replay_log *log = { nullptr };
+    std::vector<std::pair<uint32_t, uint32_t>> filled;  ///< Guest memory the current call wrote, as address and length.
+    std::mutex lock;
+};
+
+#endif
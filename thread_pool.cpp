@@ -0,0 +1,77 @@
+#include "thread_pool.h"
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor. Starts the threads.
+ * 
+ * @param threads The number of threads, at least 1.
+*/
+thread_pool::thread_pool(uint32_t threads)
+{
+    for (uint32_t i = 0; i < std::max(threads, 1u); ++i)
+    {
+        workers.emplace_back(&thread_pool::worker, this);
+    }
+}
+
+/**
+ * @brief Runs the jobs still queued, then stops the threads.
+*/
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+
+    for (std::thread &t : workers)
+    {
+        t.join();
+    }
+}
+
+/**
+ * @brief Queues a job for the next free thread.
+ * 
+ * @param job The job.
+*/
+void thread_pool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(std::move(job));
+    }
+    ready.notify_one();
+}
+
+/**
+ * @brief Runs jobs until the pool is stopped and none are left.
+*/
+void thread_pool::worker()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
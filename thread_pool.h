@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "hex.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A fixed set of host threads that run jobs in the background.
+ * 
+ * Devices hand their host I/O to the pool so the hart that started it
+ * keeps running. Jobs start in the order they were submitted but may
+ * finish in any order. The destructor runs every job still queued
+ * before it returns.
+*/
+class thread_pool
+{
+public:
+    thread_pool(uint32_t threads);
+    ~thread_pool();
+
+    void submit(std::function<void()> job);
+
+private:
+    void worker();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = { false };
+    std::mutex lock;
+    std::condition_variable ready;
+};
+
+#endif
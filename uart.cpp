@@ -0,0 +1,298 @@
+#include "uart.h"
+#include <poll.h>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor for the UART.
+*/
+uart::uart()
+{
+    out.reserve(out_capacity);
+}
+
+/**
+ * @brief Sends whatever the guest left in the buffer.
+*/
+uart::~uart()
+{
+    flush();
+}
+
+/**
+ * @brief Reads a UART register.
+ * 
+ * @param offset The offset from the UART's base.
+ * 
+ * @return The register, or 0 for an offset with no register.
+*/
+uint8_t uart::read8(uint32_t offset)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    switch (offset)
+    {
+        case reg_rbr:
+            if (lcr & lcr_dlab)
+            {
+                return dll;
+            }
+            if (rx_ready())
+            {
+                uint8_t ch = rx.front();
+                rx.pop_front();
+                ++rx_bytes;
+                return ch;
+            }
+            return 0;
+
+        case reg_ier:
+            return (lcr & lcr_dlab) ? dlm : ier;
+
+        case reg_iir:
+        {
+            // The highest priority interrupt that is enabled and pending,
+            // or 1 for none, with the FIFO bits if the FIFOs are on.
+            uint8_t id = 0x01;
+            if ((ier & ier_rdi) && rx_ready())
+            {
+                id = 0x04;
+            }
+            else if ((ier & ier_thri) && thre_pending)
+            {
+                id = 0x02;
+                thre_pending = false;
+            }
+            return id | ((fcr & fcr_enable) ? 0xc0 : 0);
+        }
+
+        case reg_lcr:
+            return lcr;
+        case reg_mcr:
+            return mcr;
+        case reg_lsr:
+            return lsr_thre | lsr_temt | (rx_ready() ? lsr_dr : 0);
+        case reg_msr:
+            return 0xb0;    // DCD, DSR and CTS, the host is always there.
+        case reg_scr:
+            return scr;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Writes a UART register.
+ * 
+ * @param offset The offset from the UART's base.
+ * @param val The byte.
+*/
+void uart::write8(uint32_t offset, uint8_t val)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    switch (offset)
+    {
+        case reg_rbr:
+            if (lcr & lcr_dlab)
+            {
+                dll = val;
+                break;
+            }
+            // Output the run has already shown is not shown again.
+            if (!log || !log->is_quiet())
+            {
+                out.push_back(val);
+            }
+            ++tx_bytes;
+            thre_pending = true;
+            if (val == '\n' || out.size() >= out_capacity)
+            {
+                flush_locked();
+            }
+            break;
+
+        case reg_ier:
+            if (lcr & lcr_dlab)
+            {
+                dlm = val;
+            }
+            else
+            {
+                ier = val & 0x0f;
+                thre_pending = true;
+            }
+            break;
+
+        case reg_iir:
+            fcr = val;
+            if (val & fcr_clear_rx)
+            {
+                rx.clear();
+            }
+            break;
+
+        case reg_lcr:
+            lcr = val;
+            break;
+        case reg_mcr:
+            mcr = val;
+            break;
+        case reg_scr:
+            scr = val;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Sends the buffered output to stdout.
+*/
+void uart::flush()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    flush_locked();
+}
+
+/**
+ * @brief Sends the buffered output to stdout. The caller holds the lock.
+*/
+void uart::flush_locked()
+{
+    if (out.empty())
+    {
+        return;
+    }
+
+    cout.write(out.data(), out.size());
+    cout.flush();
+    out.clear();
+    ++host_writes;
+}
+
+/**
+ * @brief Looks at stdin now rather than at the next poll_interval-th
+ * status read, since a hart is about to stop reading for a while.
+ * 
+ * @return True if a received byte is waiting.
+*/
+bool uart::has_input()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (rx.empty() && !rx_eof)
+    {
+        polls_skipped = poll_interval - 1;
+    }
+    return rx_ready();
+}
+
+/**
+ * @brief Checks if a received byte is waiting, reading more from stdin
+ * if none are and it is time to look.
+ * 
+ * @return True if rx holds a byte.
+*/
+bool uart::rx_ready()
+{
+    if (!rx.empty())
+    {
+        return true;
+    }
+    if (rx_eof || ++polls_skipped < poll_interval)
+    {
+        return false;
+    }
+    polls_skipped = 0;
+    ++host_polls;
+
+    // Under replay the bytes come from the log, at the poll that got
+    // them.
+    if (log && log->is_replaying())
+    {
+        const replay_log::entry *e = log->take(replay_log::kind_input);
+        if (!e)
+        {
+            return false;
+        }
+        if (e->data.empty())
+        {
+            rx_eof = true;
+            return false;
+        }
+        rx.insert(rx.end(), e->data.begin(), e->data.end());
+        return true;
+    }
+
+    pollfd p = { 0, POLLIN, 0 };
+    if (poll(&p, 1, 0) <= 0 || !(p.revents & (POLLIN | POLLHUP)))
+    {
+        return false;
+    }
+
+    uint8_t buf[256];
+    ssize_t n = ::read(0, buf, sizeof(buf));
+    if (n <= 0)
+    {
+        rx_eof = true;
+        if (log)
+        {
+            log->add(replay_log::kind_input, 0, "");
+        }
+        return false;
+    }
+    rx.insert(rx.end(), buf, buf + n);
+    if (log)
+    {
+        log->add(replay_log::kind_input, n, std::string(buf, buf + n));
+    }
+    return true;
+}
+
+/**
+ * @brief Registers the UART's registers for checkpoints, with the bytes
+ * received but not yet read and the count to the next poll of stdin, so
+ * a restored guest reads the same input at the same point. Bytes still
+ * to be sent are flushed before a checkpoint is saved.
+ * 
+ * @param c The checkpoint registry.
+ * @param prefix The name the fields are grouped under.
+*/
+void uart::register_state(checkpoint &c, const std::string &prefix)
+{
+    c.add(prefix + ".ier", &ier);
+    c.add(prefix + ".lcr", &lcr);
+    c.add(prefix + ".mcr", &mcr);
+    c.add(prefix + ".fcr", &fcr);
+    c.add(prefix + ".scr", &scr);
+    c.add(prefix + ".dll", &dll);
+    c.add(prefix + ".dlm", &dlm);
+    c.add(prefix + ".thre_pending", &thre_pending);
+    c.add(prefix + ".rx",
+        [this] { return std::string(rx.begin(), rx.end()); },
+        [this] (const std::string &s) { rx.assign(s.begin(), s.end()); return true; });
+    c.add(prefix + ".rx_eof", &rx_eof);
+    c.add(prefix + ".polls_skipped", &polls_skipped);
+}
+
+/**
+ * @brief Registers the statistics of the UART.
+ * 
+ * @param s The statistics registry.
+ * @param prefix The name the statistics are grouped under.
+*/
+void uart::register_stats(stats &s, const std::string &prefix) const
+{
+    s.add_scalar(prefix + ".tx_bytes", &tx_bytes, "Bytes the guest sent");
+    s.add_scalar(prefix + ".rx_bytes", &rx_bytes, "Bytes the guest received");
+    s.add_scalar(prefix + ".host_writes", &host_writes, "Writes of the output buffer to stdout");
+    s.add_scalar(prefix + ".host_polls", &host_polls, "Polls of stdin for input");
+}
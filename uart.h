@@ -0,0 +1,107 @@
+#ifndef UART_H
+#define UART_H
+
+#include "checkpoint.h"
+#include "replay.h"
+#include <deque>
+#include <mutex>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A 16550 UART on the host's stdin and stdout.
+ * 
+ * The eight registers sit a byte apart at the 16550 offsets, with the
+ * divisor latch behind LCR's DLAB bit, and the transmitter is always
+ * empty, so the usual polled drivers work unchanged. The line settings
+ * are kept for the guest to read back but change nothing.
+ * 
+ * Bytes the guest sends collect in a large buffer that goes to stdout
+ * in one write at each newline, when it fills and when the run ends,
+ * rather than a host call per byte. Received bytes are read from stdin
+ * with a poll that does not block, and only every so many status reads
+ * while none are waiting, so a driver spinning on LSR costs no host
+ * calls either.
+*/
+class uart : public mmio_device
+{
+public:
+    uart();
+    ~uart();
+
+    uint8_t read8(uint32_t offset) override;
+    void write8(uint32_t offset, uint8_t val) override;
+
+    void flush() override;
+    bool has_input() override;
+
+    void register_stats(stats &s, const std::string &prefix) const;
+    void register_state(checkpoint &c, const std::string &prefix);
+    /**
+     * @brief Sets the log the bytes read from stdin are recorded to, or
+     * replayed from.
+     * 
+     * @param l The log.
+    */
+    void set_replay(replay_log *l) { log = l; }
+
+    static constexpr uint32_t base          = 0x10000000;
+    static constexpr uint32_t size          = 0x100;
+
+private:
+    static constexpr uint32_t reg_rbr       = 0;    ///< RBR/THR, or DLL with DLAB set.
+    static constexpr uint32_t reg_ier       = 1;    ///< IER, or DLM with DLAB set.
+    static constexpr uint32_t reg_iir       = 2;    ///< IIR on read, FCR on write.
+    static constexpr uint32_t reg_lcr       = 3;
+    static constexpr uint32_t reg_mcr       = 4;
+    static constexpr uint32_t reg_lsr       = 5;
+    static constexpr uint32_t reg_msr       = 6;
+    static constexpr uint32_t reg_scr       = 7;
+
+    static constexpr uint8_t lcr_dlab       = 0x80;
+    static constexpr uint8_t lsr_dr         = 0x01;
+    static constexpr uint8_t lsr_thre       = 0x20;
+    static constexpr uint8_t lsr_temt       = 0x40;
+    static constexpr uint8_t ier_rdi        = 0x01;
+    static constexpr uint8_t ier_thri       = 0x02;
+    static constexpr uint8_t fcr_enable     = 0x01;
+    static constexpr uint8_t fcr_clear_rx   = 0x02;
+
+    static constexpr uint32_t out_capacity  = 0x10000;
+    static constexpr uint32_t poll_interval = 1024;
+
+    bool rx_ready();
+    void flush_locked();
+
+    std::vector<char> out;
+    std::deque<uint8_t> rx;
+    bool rx_eof = { false };
+    uint32_t polls_skipped = { 0 };
+    replay_log *log = { nullptr };
+
+    uint8_t ier = { 0 };
+    uint8_t lcr = { 0 };
+    uint8_t mcr = { 0 };
+    uint8_t fcr = { 0 };
+    uint8_t scr = { 0 };
+    uint8_t dll = { 0 };
+    uint8_t dlm = { 0 };
+    bool thre_pending = { true };   ///< Cleared by reading IIR, as on a 16550.
+
+    uint64_t tx_bytes = { 0 };
+    uint64_t rx_bytes = { 0 };
+    uint64_t host_writes = { 0 };
+    uint64_t host_polls = { 0 };
+
+    std::mutex lock;
+};
+
+#endif
@@ -0,0 +1,473 @@
+#include "vector_simd.h"
+
+#ifdef __x86_64__
+#include <emmintrin.h>
+#define VECTOR_SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define VECTOR_SIMD_CLONES
+#endif
+
+#define VECTOR_SIMD_INLINE __attribute__((always_inline)) inline
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+namespace
+{
+    constexpr size_t block_bytes = 32;
+
+    typedef uint8_t  u8x32  __attribute__((vector_size(block_bytes)));
+    typedef int8_t   s8x32  __attribute__((vector_size(block_bytes)));
+    typedef uint16_t u16x16 __attribute__((vector_size(block_bytes)));
+    typedef int16_t  s16x16 __attribute__((vector_size(block_bytes)));
+    typedef uint32_t u32x8  __attribute__((vector_size(block_bytes)));
+    typedef int32_t  s32x8  __attribute__((vector_size(block_bytes)));
+    typedef uint64_t u64x4  __attribute__((vector_size(block_bytes)));
+    typedef int64_t  s64x4  __attribute__((vector_size(block_bytes)));
+
+    /**
+     * @brief The block types for one element type.
+     * 
+     * vec holds a block of unsigned elements, svec the same block as
+     * signed elements, which is also the type of a compare result, and
+     * selem is one signed element.
+    */
+    template <typename T> struct lanes;
+    template <> struct lanes<uint8_t>  { typedef u8x32  vec; typedef s8x32  svec; typedef int8_t  selem; };
+    template <> struct lanes<uint16_t> { typedef u16x16 vec; typedef s16x16 svec; typedef int16_t selem; };
+    template <> struct lanes<uint32_t> { typedef u32x8  vec; typedef s32x8  svec; typedef int32_t selem; };
+    template <> struct lanes<uint64_t> { typedef u64x4  vec; typedef s64x4  svec; typedef int64_t selem; };
+}
+
+/**
+ * @brief Applies an arithmetic op to a block or to one element.
+ * 
+ * The helpers are always inlined, so each one is compiled for the
+ * instruction set of the entry point it ends up in.
+ * 
+ * @tparam V The unsigned block or element type.
+ * @tparam S The signed type of the same shape.
+ * @param op The op, one of op_add through op_max.
+ * @param a The first operand, which receives the result.
+ * @param b The second operand.
+*/
+template <typename V, typename S>
+VECTOR_SIMD_INLINE void vector_simd::apply(int op, V &a, const V &b)
+{
+    switch (op)
+    {
+    case op_add:    a = a + b; break;
+    case op_sub:    a = a - b; break;
+    case op_and:    a = a & b; break;
+    case op_or:     a = a | b; break;
+    case op_xor:    a = a ^ b; break;
+    case op_mul:    a = a * b; break;
+    case op_minu:   a = a < b ? a : b; break;
+    case op_min:    a = (S) a < (S) b ? a : b; break;
+    case op_maxu:   a = a < b ? b : a; break;
+    case op_max:    a = (S) a < (S) b ? b : a; break;
+    }
+}
+
+/**
+ * @brief Applies a compare to a block.
+ * 
+ * @param op The compare, one of cmp_eq through cmp_gt.
+ * @param c Set to all ones in the lanes where the compare holds. It
+ *  is left alone for an unknown compare.
+ * @param a The first operand.
+ * @param b The second operand.
+*/
+template <typename V, typename S, typename R>
+VECTOR_SIMD_INLINE void vector_simd::test(int op, R &c, const V &a, const V &b)
+{
+    switch (op)
+    {
+    case cmp_eq:    c = a == b; break;
+    case cmp_ne:    c = a != b; break;
+    case cmp_ltu:   c = a < b; break;
+    case cmp_lt:    c = (S) a < (S) b; break;
+    case cmp_leu:   c = a <= b; break;
+    case cmp_le:    c = (S) a <= (S) b; break;
+    case cmp_gtu:   c = a > b; break;
+    case cmp_gt:    c = (S) a > (S) b; break;
+    }
+}
+
+/**
+ * @brief Keeps one bit per element of a byte mask.
+ * 
+ * @param m One bit per byte of a block.
+ * @param width The element width in bytes.
+ * 
+ * @return The low bit of every element's bytes, packed together.
+*/
+uint32_t vector_simd::lane_bits(uint32_t m, uint32_t width)
+{
+    switch (width)
+    {
+    case 2:
+        m &= 0x55555555;
+        m = (m | (m >> 1)) & 0x33333333;
+        m = (m | (m >> 2)) & 0x0f0f0f0f;
+        m = (m | (m >> 4)) & 0x00ff00ff;
+        m = (m | (m >> 8)) & 0x0000ffff;
+        break;
+    case 4:
+        m &= 0x11111111;
+        m = (m | (m >> 3)) & 0x03030303;
+        m = (m | (m >> 6)) & 0x000f000f;
+        m = (m | (m >> 12)) & 0x000000ff;
+        break;
+    case 8:
+        m &= 0x01010101;
+        m = (m | (m >> 7)) & 0x00030003;
+        m = (m | (m >> 14)) & 0x0000000f;
+        break;
+    }
+    return m;
+}
+
+/**
+ * @brief The element loop of binary() for one element type.
+ * 
+ * The elements past the last full block are copied out to a padded
+ * block so they take the same path as the rest.
+*/
+template <typename T>
+VECTOR_SIMD_INLINE void vector_simd::binary_sew(int op, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n)
+{
+    typedef typename lanes<T>::vec V;
+    typedef typename lanes<T>::svec SV;
+
+    size_t bytes = (size_t) n * sizeof(T);
+    size_t i = 0;
+    for (; i + block_bytes <= bytes; i += block_bytes)
+    {
+        V x, y;
+        memcpy(&x, a + i, block_bytes);
+        memcpy(&y, b + i, block_bytes);
+        apply<V, SV>(op, x, y);
+        memcpy(d + i, &x, block_bytes);
+    }
+
+    if (i < bytes)
+    {
+        V x = { }, y = { };
+        memcpy(&x, a + i, bytes - i);
+        memcpy(&y, b + i, bytes - i);
+        apply<V, SV>(op, x, y);
+        memcpy(d + i, &x, bytes - i);
+    }
+}
+
+/**
+ * @brief The element loop of compare() for one element type.
+ * 
+ * Each block's compare result is squeezed to one bit per byte with
+ * the SSE2 byte mask instruction and then to one bit per element.
+*/
+template <typename T>
+VECTOR_SIMD_INLINE void vector_simd::compare_sew(int op, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n)
+{
+    typedef typename lanes<T>::vec V;
+    typedef typename lanes<T>::svec SV;
+    constexpr uint32_t per_block = block_bytes / sizeof(T);
+
+    memset(d, 0, (n + 7) / 8);
+
+    for (uint32_t i = 0; i < n; i += per_block)
+    {
+        // Pad a partial last block with zeros.
+        uint32_t count = std::min(per_block, n - i);
+        V x = { }, y = { };
+        memcpy(&x, a + (size_t) i * sizeof(T), count * sizeof(T));
+        memcpy(&y, b + (size_t) i * sizeof(T), count * sizeof(T));
+
+        SV c = { };
+        test<V, SV, SV>(op, c, x, y);
+
+        uint32_t m;
+#ifdef __x86_64__
+        __m128i lo, hi;
+        memcpy(&lo, &c, 16);
+        memcpy(&hi, (const uint8_t *) &c + 16, 16);
+        m = (uint32_t) _mm_movemask_epi8(lo) | ((uint32_t) _mm_movemask_epi8(hi) << 16);
+#else
+        uint8_t raw[block_bytes];
+        memcpy(raw, &c, block_bytes);
+        m = 0;
+        for (uint32_t j = 0; j < block_bytes; ++j)
+            m |= (uint32_t) (raw[j] >> 7) << j;
+#endif
+        m = lane_bits(m, sizeof(T));
+        if (count < 32)
+            m &= (1u << count) - 1;
+
+        // A block is at least 4 elements, so the bits land in whole
+        // bytes or in one half of a byte.
+        if (per_block >= 8)
+        {
+            for (uint32_t k = 0; k < (count + 7) / 8; ++k)
+                d[(i >> 3) + k] = (uint8_t) (m >> (8 * k));
+        }
+        else
+        {
+            d[i >> 3] |= (uint8_t) (m << (i & 7));
+        }
+    }
+}
+
+/**
+ * @brief The element loop of reduce() for one element type.
+ * 
+ * The full blocks are first folded together lane by lane, then the
+ * lanes of that block and any elements left over are folded one at
+ * a time.
+*/
+template <typename T>
+VECTOR_SIMD_INLINE uint64_t vector_simd::reduce_sew(int op, const uint8_t *a, uint32_t n, uint64_t init)
+{
+    typedef typename lanes<T>::vec V;
+    typedef typename lanes<T>::svec SV;
+    typedef typename lanes<T>::selem S;
+
+    T acc = (T) init;
+    size_t bytes = (size_t) n * sizeof(T);
+    size_t i = 0;
+    if (bytes >= block_bytes)
+    {
+        V v;
+        memcpy(&v, a, block_bytes);
+        for (i = block_bytes; i + block_bytes <= bytes; i += block_bytes)
+        {
+            V x;
+            memcpy(&x, a + i, block_bytes);
+            apply<V, SV>(op, v, x);
+        }
+
+        T lane[block_bytes / sizeof(T)];
+        memcpy(lane, &v, block_bytes);
+        for (T x : lane)
+            apply<T, S>(op, acc, x);
+    }
+
+    for (; i < bytes; i += sizeof(T))
+    {
+        T x;
+        memcpy(&x, a + i, sizeof(T));
+        apply<T, S>(op, acc, x);
+    }
+    return acc;
+}
+
+/**
+ * @brief The element loop of merge() for one element type.
+*/
+template <typename T>
+VECTOR_SIMD_INLINE void vector_simd::merge_sew(uint8_t *d, const uint8_t *s, const uint8_t *mask, uint32_t n)
+{
+    typedef typename lanes<T>::vec V;
+    constexpr uint32_t per_block = block_bytes / sizeof(T);
+
+    uint32_t i = 0;
+    for (; i + per_block <= n; i += per_block)
+    {
+        // Spread the mask bits out to whole lanes.
+        T sel[per_block];
+        for (uint32_t j = 0; j < per_block; ++j)
+            sel[j] = mask_bit(mask, i + j) ? (T) ~(T) 0 : 0;
+
+        V m, x, y;
+        memcpy(&m, sel, block_bytes);
+        memcpy(&x, d + (size_t) i * sizeof(T), block_bytes);
+        memcpy(&y, s + (size_t) i * sizeof(T), block_bytes);
+        x = (y & m) | (x & ~m);
+        memcpy(d + (size_t) i * sizeof(T), &x, block_bytes);
+    }
+
+    for (; i < n; ++i)
+    {
+        if (mask_bit(mask, i))
+            memcpy(d + (size_t) i * sizeof(T), s + (size_t) i * sizeof(T), sizeof(T));
+    }
+}
+
+/**
+ * @brief Applies an arithmetic op element by element.
+ * 
+ * @param op The op, one of op_add through op_max.
+ * @param sew The element width in bits, 8, 16, 32 or 64.
+ * @param d The destination elements. It may be the same as a or b.
+ * @param a The first operand elements.
+ * @param b The second operand elements.
+ * @param n The number of elements.
+*/
+VECTOR_SIMD_CLONES
+void vector_simd::binary(int op, uint32_t sew, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n)
+{
+    switch (sew)
+    {
+    case 8:     binary_sew<uint8_t>(op, d, a, b, n); break;
+    case 16:    binary_sew<uint16_t>(op, d, a, b, n); break;
+    case 32:    binary_sew<uint32_t>(op, d, a, b, n); break;
+    case 64:    binary_sew<uint64_t>(op, d, a, b, n); break;
+    }
+}
+
+/**
+ * @brief Compares elements into a mask.
+ * 
+ * @param op The compare, one of cmp_eq through cmp_gt.
+ * @param sew The element width in bits.
+ * @param d The mask. Bits 0 to n-1 are set, and the rest of the last
+ *  byte written is cleared.
+ * @param a The first operand elements.
+ * @param b The second operand elements.
+ * @param n The number of elements.
+*/
+VECTOR_SIMD_CLONES
+void vector_simd::compare(int op, uint32_t sew, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n)
+{
+    switch (sew)
+    {
+    case 8:     compare_sew<uint8_t>(op, d, a, b, n); break;
+    case 16:    compare_sew<uint16_t>(op, d, a, b, n); break;
+    case 32:    compare_sew<uint32_t>(op, d, a, b, n); break;
+    case 64:    compare_sew<uint64_t>(op, d, a, b, n); break;
+    }
+}
+
+/**
+ * @brief Folds elements into one value.
+ * 
+ * @param op The op, one of op_add through op_max.
+ * @param sew The element width in bits.
+ * @param a The elements.
+ * @param n The number of elements.
+ * @param init The value to start the fold with.
+ * 
+ * @return The result, zero-extended from sew bits.
+*/
+VECTOR_SIMD_CLONES
+uint64_t vector_simd::reduce(int op, uint32_t sew, const uint8_t *a, uint32_t n, uint64_t init)
+{
+    switch (sew)
+    {
+    case 8:     return reduce_sew<uint8_t>(op, a, n, init);
+    case 16:    return reduce_sew<uint16_t>(op, a, n, init);
+    case 32:    return reduce_sew<uint32_t>(op, a, n, init);
+    case 64:    return reduce_sew<uint64_t>(op, a, n, init);
+    }
+    return init;
+}
+
+/**
+ * @brief Copies the elements selected by a mask.
+ * 
+ * @param sew The element width in bits.
+ * @param d The destination elements.
+ * @param s The source elements.
+ * @param mask The mask. Element i is copied if bit i is set.
+ * @param n The number of elements.
+*/
+VECTOR_SIMD_CLONES
+void vector_simd::merge(uint32_t sew, uint8_t *d, const uint8_t *s, const uint8_t *mask, uint32_t n)
+{
+    switch (sew)
+    {
+    case 8:     merge_sew<uint8_t>(d, s, mask, n); break;
+    case 16:    merge_sew<uint16_t>(d, s, mask, n); break;
+    case 32:    merge_sew<uint32_t>(d, s, mask, n); break;
+    case 64:    merge_sew<uint64_t>(d, s, mask, n); break;
+    }
+}
+
+/**
+ * @brief Copies the mask bits selected by another mask.
+ * 
+ * @param d The destination mask.
+ * @param s The source mask.
+ * @param mask Bit i of s is copied if bit i of mask is set. If this is
+ *  nullptr every bit is copied.
+ * @param n The number of bits.
+*/
+void vector_simd::merge_bits(uint8_t *d, const uint8_t *s, const uint8_t *mask, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i += 8)
+    {
+        uint8_t keep = (n - i >= 8) ? 0xff : (uint8_t) ((1u << (n - i)) - 1);
+        if (mask)
+            keep &= mask[i >> 3];
+        d[i >> 3] = (d[i >> 3] & ~keep) | (s[i >> 3] & keep);
+    }
+}
+
+/**
+ * @brief Sets every element to the same value.
+ * 
+ * @param sew The element width in bits.
+ * @param d The destination elements.
+ * @param x The value, truncated to sew bits.
+ * @param n The number of elements.
+*/
+void vector_simd::splat(uint32_t sew, uint8_t *d, uint64_t x, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i)
+        set_elem(d, sew, i, x);
+}
+
+/**
+ * @brief Gets the identity element of a reduction.
+ * 
+ * @param op The op, one of op_add through op_max.
+ * @param sew The element width in bits.
+ * 
+ * @return The value that leaves any element unchanged under op.
+*/
+uint64_t vector_simd::identity(int op, uint32_t sew)
+{
+    uint64_t ones = (sew == 64) ? ~0ull : (1ull << sew) - 1;
+    switch (op)
+    {
+    case op_and:
+    case op_minu:
+        return ones;
+    case op_min:
+        return ones >> 1;
+    case op_max:
+        return (ones >> 1) + 1;
+    }
+    return 0;
+}
+
+/**
+ * @defgroup elem Element access
+ * Get or set one element of a register group. The elements are kept in
+ * the guest's little-endian byte order, as the kernels expect to find
+ * them on the host.
+ * 
+ * @param v The register group.
+ * @param sew The element width in bits.
+ * @param i The element number.
+ * @{
+*/
+uint64_t vector_simd::get_elem(const uint8_t *v, uint32_t sew, uint32_t i)       ///< Get element i, zero-extended.
+{
+    uint64_t x = 0;
+    memcpy(&x, v + (size_t) i * (sew / 8), sew / 8);
+    return x;
+}
+
+void vector_simd::set_elem(uint8_t *v, uint32_t sew, uint32_t i, uint64_t x)     ///< Set element i to the low sew bits of x.
+{
+    memcpy(v + (size_t) i * (sew / 8), &x, sew / 8);
+}
+/**@}*/
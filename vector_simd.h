@@ -0,0 +1,83 @@
+#ifndef VECTOR_SIMD_H
+#define VECTOR_SIMD_H
+
+#include "hex.h"
+#include <cstring>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief The element loops of the V extension, run on host SIMD.
+ * 
+ * Every kernel works on the bytes of a vector register group, n
+ * elements of sew bits each. The elements are handled 32 bytes at a
+ * time as GCC generic vectors, and every entry point is built twice,
+ * once for AVX2 and once for the baseline SSE2, with the best one for
+ * the host picked when the program is loaded. The elements past the
+ * last full block are run as a padded block or one at a time.
+*/
+class vector_simd
+{
+public:
+    static constexpr int op_add     = 0;
+    static constexpr int op_sub     = 1;
+    static constexpr int op_and     = 2;
+    static constexpr int op_or      = 3;
+    static constexpr int op_xor     = 4;
+    static constexpr int op_mul     = 5;
+    static constexpr int op_minu    = 6;
+    static constexpr int op_min     = 7;
+    static constexpr int op_maxu    = 8;
+    static constexpr int op_max     = 9;
+
+    static constexpr int cmp_eq     = 0;
+    static constexpr int cmp_ne     = 1;
+    static constexpr int cmp_ltu    = 2;
+    static constexpr int cmp_lt     = 3;
+    static constexpr int cmp_leu    = 4;
+    static constexpr int cmp_le     = 5;
+    static constexpr int cmp_gtu    = 6;
+    static constexpr int cmp_gt     = 7;
+
+    static void binary(int op, uint32_t sew, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n);
+    static void compare(int op, uint32_t sew, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n);
+    static uint64_t reduce(int op, uint32_t sew, const uint8_t *a, uint32_t n, uint64_t init);
+    static void merge(uint32_t sew, uint8_t *d, const uint8_t *s, const uint8_t *mask, uint32_t n);
+    static void merge_bits(uint8_t *d, const uint8_t *s, const uint8_t *mask, uint32_t n);
+    static void splat(uint32_t sew, uint8_t *d, uint64_t x, uint32_t n);
+
+    static uint64_t identity(int op, uint32_t sew);
+    static uint64_t get_elem(const uint8_t *v, uint32_t sew, uint32_t i);
+    static void set_elem(uint8_t *v, uint32_t sew, uint32_t i, uint64_t x);
+
+    /**
+     * @brief Gets one bit of a mask register.
+     * 
+     * @param m The mask register.
+     * @param i The element number.
+     * 
+     * @return True if element i is active.
+    */
+    static bool mask_bit(const uint8_t *m, uint32_t i) { return (m[i >> 3] >> (i & 7)) & 1; }
+
+private:
+    template <typename V, typename S> static void apply(int op, V &a, const V &b);
+    template <typename V, typename S, typename R> static void test(int op, R &c, const V &a, const V &b);
+
+    template <typename T> static void binary_sew(int op, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n);
+    template <typename T> static void compare_sew(int op, uint8_t *d, const uint8_t *a, const uint8_t *b, uint32_t n);
+    template <typename T> static uint64_t reduce_sew(int op, const uint8_t *a, uint32_t n, uint64_t init);
+    template <typename T> static void merge_sew(uint8_t *d, const uint8_t *s, const uint8_t *mask, uint32_t n);
+
+    static uint32_t lane_bits(uint32_t m, uint32_t width);
+};
+
+#endif
@@ -0,0 +1,609 @@
+#include "virtio_blk.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief Constructor for the disk.
+ * 
+ * @param m The simulated memory, which the queues and buffers are in.
+ * @param p The PLIC that completions are raised on.
+ * @param source The PLIC source of the disk.
+ * @param threads The number of host threads that do the I/O.
+*/
+virtio_blk::virtio_blk(memory &m, plic &p, uint32_t source, uint32_t threads)
+    : mem(m), irqc(p), source(source), pool(new thread_pool(threads))
+{
+}
+
+/**
+ * @brief Finishes the requests in flight and closes the image.
+*/
+virtio_blk::~virtio_blk()
+{
+    pool.reset();
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+/**
+ * @brief Opens the image file, for writing if the host allows it.
+ * 
+ * @param fname The name of the image file.
+ * 
+ * @return True if it was opened. The capacity is its size in whole
+ *  sectors.
+*/
+bool virtio_blk::open_image(const std::string &fname)
+{
+    fd = open(fname.c_str(), O_RDWR);
+    if (fd < 0)
+    {
+        fd = open(fname.c_str(), O_RDONLY);
+        read_only = true;
+    }
+
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        cerr << "Can't open disk image '" + fname + "'." << endl;
+        return false;
+    }
+
+    capacity = st.st_size / sector_size;
+    return true;
+}
+
+/**
+ * @brief Sets the event queue completions are delivered on.
+ * 
+ * @param q The queue. The hart that runs it must be the only one, as
+ *  delivery waits on that hart's thread.
+*/
+void virtio_blk::set_events(event_queue *q)
+{
+    events = q;
+}
+
+/**
+ * @brief Reads a byte of the device configuration. The transport
+ * registers only answer word reads.
+ * 
+ * @param offset The offset from the disk's base.
+ * 
+ * @return The byte, or 0 for an offset with nothing there.
+*/
+uint8_t virtio_blk::read8(uint32_t offset)
+{
+    return offset >= reg_config ? config8(offset - reg_config) : 0;
+}
+
+/**
+ * @brief The configuration cannot be written, so byte writes are
+ * ignored.
+*/
+void virtio_blk::write8(uint32_t, uint8_t)
+{
+}
+
+/**
+ * @brief Reads a transport register, or some of the configuration.
+ * 
+ * @param offset The offset from the disk's base.
+ * @param len The number of bytes, which must be 4 for a register.
+ * 
+ * @return The value, or 0 for an offset with nothing there.
+*/
+uint64_t virtio_blk::read(uint32_t offset, uint32_t len)
+{
+    if (offset >= reg_config || len != 4 || offset % 4)
+    {
+        return mmio_device::read(offset, len);
+    }
+
+    uint64_t features = feature_version_1 | feature_blk_size | feature_flush | (read_only ? feature_ro : 0);
+
+    switch (offset)
+    {
+        case reg_magic:
+            return 0x74726976;      // "virt"
+        case reg_version:
+            return 2;
+        case reg_device_id:
+            return 2;               // A block device.
+        case reg_vendor_id:
+            return 0x32337672;      // "rv32"
+        case reg_device_features:
+            return device_features_sel < 2 ? (uint32_t) (features >> (32 * device_features_sel)) : 0;
+        case reg_queue_num_max:
+            return queue_sel == 0 ? queue_num_max : 0;
+        case reg_queue_ready:
+            return queue_sel == 0 ? queue_ready : 0;
+        case reg_interrupt_status:
+        {
+            std::lock_guard<std::mutex> guard(used_lock);
+            return interrupt_status;
+        }
+        case reg_status:
+            return status;
+        case reg_config_generation:
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Writes a transport register.
+ * 
+ * @param offset The offset from the disk's base.
+ * @param len The number of bytes, which must be 4.
+ * @param val The value.
+*/
+void virtio_blk::write(uint32_t offset, uint32_t len, uint64_t val)
+{
+    if (offset >= reg_config || len != 4 || offset % 4)
+    {
+        return;
+    }
+
+    uint32_t v = val;
+    switch (offset)
+    {
+        case reg_device_features_sel:
+            device_features_sel = v;
+            break;
+        case reg_driver_features:
+            if (driver_features_sel < 2)
+            {
+                uint32_t shift = 32 * driver_features_sel;
+                driver_features = (driver_features & ~(0xffffffffull << shift)) | ((uint64_t) v << shift);
+            }
+            break;
+        case reg_driver_features_sel:
+            driver_features_sel = v;
+            break;
+        case reg_queue_sel:
+            queue_sel = v;
+            break;
+        case reg_queue_num:
+            // The ring indexes wrap at 65536, so the size must divide it.
+            if (queue_sel == 0 && v <= queue_num_max && (v & (v - 1)) == 0)
+            {
+                queue_num = v;
+            }
+            break;
+        case reg_queue_ready:
+            if (queue_sel == 0)
+            {
+                queue_ready = v & 1;
+            }
+            break;
+        case reg_queue_notify:
+            if (v == 0)
+            {
+                notify();
+            }
+            break;
+        case reg_interrupt_ack:
+        {
+            std::lock_guard<std::mutex> guard(used_lock);
+            interrupt_status &= ~v;
+            if (interrupt_status == 0)
+            {
+                irqc.set_level(source, false);
+            }
+            break;
+        }
+        case reg_status:
+            if (v == 0)
+            {
+                reset();
+            }
+            else
+            {
+                status = v;
+            }
+            break;
+        case reg_queue_desc:
+        case reg_queue_desc + 4:
+        case reg_queue_driver:
+        case reg_queue_driver + 4:
+        case reg_queue_device:
+        case reg_queue_device + 4:
+        {
+            if (queue_sel != 0)
+            {
+                break;
+            }
+            uint64_t &addr = (offset & ~4u) == reg_queue_desc ? desc_addr :
+                             (offset & ~4u) == reg_queue_driver ? driver_addr : device_addr;
+            uint32_t shift = (offset & 4) ? 32 : 0;
+            addr = (addr & ~(0xffffffffull << shift)) | ((uint64_t) v << shift);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Takes every new request from the available ring and hands it
+ * to the pool.
+*/
+void virtio_blk::notify()
+{
+    std::lock_guard<std::mutex> guard(queue_lock);
+    ++notifies;
+
+    if (!queue_ready || queue_num == 0)
+    {
+        return;
+    }
+
+    // The available ring is flags, idx, then the descriptor numbers.
+    uint16_t avail_idx = mem.get16(driver_addr + 2);
+    for (; last_avail != avail_idx; ++last_avail)
+    {
+        uint16_t head = mem.get16(driver_addr + 4 + 2 * (last_avail % queue_num));
+
+        request r;
+        if (!parse(head, r))
+        {
+            // There is no status byte to report through, so give the
+            // chain back with nothing written.
+            {
+                std::lock_guard<std::mutex> used(used_lock);
+                ++errors;
+            }
+            complete(head, 0);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> used(used_lock);
+            ++in_flight;
+            ++requests;
+        }
+        pool->submit([this, r] { process(r); });
+
+        if (events)
+        {
+            uint64_t id = events->schedule_in(completion_delay, [this, head] { deliver(head); });
+            std::lock_guard<std::mutex> used(used_lock);
+            timed[head] = id;
+        }
+    }
+}
+
+/**
+ * @brief Walks a descriptor chain: a header the device reads, the data
+ * buffers and a status byte the device writes.
+ * 
+ * @param head The first descriptor.
+ * @param r Set to the request.
+ * 
+ * @return True if the chain is well formed and lies in the simulated
+ *  memory.
+*/
+bool virtio_blk::parse(uint16_t head, request &r)
+{
+    r.head = head;
+    r.status = nullptr;
+
+    uint16_t i = head;
+    bool first = true;
+    for (uint32_t n = 0; n < queue_num; ++n)
+    {
+        // A descriptor is addr, len, flags and next.
+        uint32_t d = desc_addr + 16 * (i % queue_num);
+        uint64_t addr = mem.get64(d);
+        uint32_t len = mem.get32(d + 8);
+        uint16_t flags = mem.get16(d + 12);
+        uint16_t next = mem.get16(d + 14);
+
+        uint8_t *p = (addr >> 32) ? nullptr : mem.get_ptr(addr, len);
+        if (!p)
+        {
+            return false;
+        }
+
+        if (first)
+        {
+            if (len < 16 || (flags & desc_write))
+            {
+                return false;
+            }
+            r.type = mem.get32(addr);
+            r.sector = mem.get64(addr + 8);
+            first = false;
+        }
+        else if (!(flags & desc_next))
+        {
+            // The last one holds the status byte.
+            if (len < 1 || !(flags & desc_write))
+            {
+                return false;
+            }
+            r.status = p + len - 1;
+            if (len > 1)
+            {
+                r.data.push_back({ p, len - 1 });
+            }
+        }
+        else
+        {
+            r.data.push_back({ p, len });
+        }
+
+        if (!(flags & desc_next))
+        {
+            return r.status != nullptr;
+        }
+        i = next;
+    }
+
+    // The chain loops.
+    return false;
+}
+
+/**
+ * @brief Does the I/O of a request. Runs on a pool thread.
+ * 
+ * @param r The request.
+*/
+void virtio_blk::process(const request &r)
+{
+    uint64_t total = 0;
+    for (const iovec &v : r.data)
+    {
+        total += v.iov_len;
+    }
+
+    uint8_t st = status_ok;
+    uint32_t written = 0;
+    uint64_t pos = r.sector * sector_size;
+    bool in_range = r.sector <= capacity && total <= (capacity - r.sector) * sector_size;
+
+    switch (r.type)
+    {
+        case type_in:
+        case type_out:
+            if (!in_range || (r.type == type_out && read_only))
+            {
+                st = status_ioerr;
+                break;
+            }
+            for (const iovec &v : r.data)
+            {
+                uint8_t *p = (uint8_t *) v.iov_base;
+                size_t left = v.iov_len;
+                while (left > 0)
+                {
+                    ssize_t n = r.type == type_in ? pread(fd, p, left, pos) : pwrite(fd, p, left, pos);
+                    if (n <= 0)
+                    {
+                        st = status_ioerr;
+                        break;
+                    }
+                    p += n;
+                    pos += n;
+                    left -= n;
+                }
+                if (st != status_ok)
+                {
+                    break;
+                }
+            }
+            if (r.type == type_in)
+            {
+                written = total;
+            }
+            break;
+
+        case type_flush:
+            if (fdatasync(fd) != 0)
+            {
+                st = status_ioerr;
+            }
+            break;
+
+        case type_get_id:
+        {
+            static const char id[20] = "rv32i-virtio-blk";
+            if (!r.data.empty())
+            {
+                written = std::min<size_t>(sizeof(id), r.data[0].iov_len);
+                memcpy(r.data[0].iov_base, id, written);
+            }
+            break;
+        }
+
+        default:
+            st = status_unsupp;
+            break;
+    }
+
+    *r.status = st;
+    if (!events)
+    {
+        complete(r.head, written + 1);
+    }
+
+    std::lock_guard<std::mutex> guard(used_lock);
+    if (events)
+    {
+        finished[r.head] = written + 1;
+    }
+    if (st != status_ok)
+    {
+        ++errors;
+    }
+    else if (r.type == type_in)
+    {
+        bytes_read += total;
+    }
+    else if (r.type == type_out)
+    {
+        bytes_written += total;
+    }
+
+    --in_flight;
+    idle.notify_all();
+}
+
+/**
+ * @brief Completes a request when its event comes due, once its job is
+ * done.
+ * 
+ * @param head The first descriptor of the request.
+*/
+void virtio_blk::deliver(uint16_t head)
+{
+    uint32_t written;
+    {
+        std::unique_lock<std::mutex> guard(used_lock);
+        timed.erase(head);
+        if (!finished.count(head))
+        {
+            ++host_waits;
+            idle.wait(guard, [this, head] { return finished.count(head) != 0; });
+        }
+        written = finished[head];
+        finished.erase(head);
+    }
+    complete(head, written);
+}
+
+/**
+ * @brief Puts a finished request in the used ring and raises the
+ * interrupt.
+ * 
+ * @param head The first descriptor of the request.
+ * @param written The number of bytes written into the guest's buffers.
+*/
+void virtio_blk::complete(uint16_t head, uint32_t written)
+{
+    std::lock_guard<std::mutex> guard(used_lock);
+
+    // The used ring is flags, idx, then id and len pairs. The guest
+    // must see the pair, and the data before it, ahead of the new idx.
+    uint32_t elem = device_addr + 4 + 8 * (used_idx % queue_num);
+    mem.set32(elem, head);
+    mem.set32(elem + 4, written);
+    ++used_idx;
+    std::atomic_thread_fence(std::memory_order_release);
+    mem.set16(device_addr + 2, used_idx);
+
+    interrupt_status |= 1;
+    irqc.set_level(source, true);
+}
+
+/**
+ * @brief Puts the device back as it was at power on, once the requests
+ * in flight are done.
+*/
+void virtio_blk::reset()
+{
+    std::lock_guard<std::mutex> queue(queue_lock);
+    std::unique_lock<std::mutex> guard(used_lock);
+    idle.wait(guard, [this] { return in_flight == 0; });
+
+    // Requests done but not yet delivered are dropped.
+    for (auto &t : timed)
+    {
+        events->cancel(t.second);
+    }
+    timed.clear();
+    finished.clear();
+
+    status = 0;
+    driver_features = 0;
+    device_features_sel = 0;
+    driver_features_sel = 0;
+    queue_sel = 0;
+    queue_num = 0;
+    queue_ready = 0;
+    desc_addr = 0;
+    driver_addr = 0;
+    device_addr = 0;
+    last_avail = 0;
+    used_idx = 0;
+    interrupt_status = 0;
+    irqc.set_level(source, false);
+}
+
+/**
+ * @brief Gets a byte of the virtio-blk configuration.
+ * 
+ * @param offset The offset into the configuration.
+ * 
+ * @return The byte: the capacity in sectors at 0 and the block size at
+ *  20, 0 elsewhere.
+*/
+uint8_t virtio_blk::config8(uint32_t offset) const
+{
+    if (offset < 8)
+    {
+        return capacity >> (8 * offset);
+    }
+    if (offset >= 20 && offset < 24)
+    {
+        return sector_size >> (8 * (offset - 20));
+    }
+    return 0;
+}
+
+/**
+ * @brief Registers the transport registers and the queue's position
+ * for checkpoints. The image itself is a host file, and the same one
+ * has to be attached again to restore.
+ * 
+ * @param c The checkpoint registry.
+ * @param prefix The name the fields are grouped under.
+ * 
+ * @note A checkpoint is only taken with no request in flight.
+*/
+void virtio_blk::register_state(checkpoint &c, const std::string &prefix)
+{
+    c.add(prefix + ".device_features_sel", &device_features_sel);
+    c.add(prefix + ".driver_features_sel", &driver_features_sel);
+    c.add(prefix + ".driver_features", &driver_features);
+    c.add(prefix + ".status", &status);
+    c.add(prefix + ".queue_sel", &queue_sel);
+    c.add(prefix + ".queue_num", &queue_num);
+    c.add(prefix + ".queue_ready", &queue_ready);
+    c.add(prefix + ".desc_addr", &desc_addr);
+    c.add(prefix + ".driver_addr", &driver_addr);
+    c.add(prefix + ".device_addr", &device_addr);
+    c.add(prefix + ".last_avail", &last_avail);
+    c.add(prefix + ".used_idx", &used_idx);
+    c.add(prefix + ".interrupt_status", &interrupt_status);
+}
+
+/**
+ * @brief Registers the statistics of the disk.
+ * 
+ * @param s The statistics registry.
+ * @param prefix The name the statistics are grouped under.
+*/
+void virtio_blk::register_stats(stats &s, const std::string &prefix) const
+{
+    s.add_scalar(prefix + ".notifies", &notifies, "Writes to QueueNotify");
+    s.add_scalar(prefix + ".requests", &requests, "Requests handed to the I/O threads");
+    s.add_scalar(prefix + ".bytes_read", &bytes_read, "Bytes read from the image");
+    s.add_scalar(prefix + ".bytes_written", &bytes_written, "Bytes written to the image");
+    s.add_scalar(prefix + ".errors", &errors, "Requests that failed");
+    s.add_scalar(prefix + ".host_waits", &host_waits, "Completions that waited for the host I/O");
+}
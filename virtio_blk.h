@@ -0,0 +1,166 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "plic.h"
+#include "event_queue.h"
+#include "thread_pool.h"
+#include <map>
+#include <sys/uio.h>
+
+//***************************************************************************
+//
+//  Caleb Patsch
+//  11/04/2022
+//
+//  I certify that this is my own work and where appropriate an extension 
+//  of the starter code provided for the assignment.
+//
+//***************************************************************************
+
+/**
+ * @brief A virtio-blk disk over the virtio MMIO transport, version 2,
+ * backed by a host image file.
+ * 
+ * The guest sets up one split virtqueue and writes QueueNotify after
+ * putting requests in the available ring. The hart that wrote it only
+ * walks the descriptors and turns each request into a job for a pool
+ * of host threads, which do the preads and pwrites straight into and
+ * out of the simulated memory, so the hart keeps running during the
+ * I/O. Each job puts its request in the used ring when it is done and
+ * raises the device's PLIC source, so completions arrive as external
+ * interrupts and may arrive out of order, as virtio allows.
+ * 
+ * With an event queue, a request instead completes a fixed number of
+ * instructions after the QueueNotify that started it, waiting for the
+ * host if its I/O is not done by then, so a run does not depend on how
+ * fast the host disk is.
+ * 
+ * Reads, writes, flushes and GET_ID are done. The image is opened read
+ * only, and the disk offered as such, if it cannot be written.
+*/
+class virtio_blk : public mmio_device
+{
+public:
+    virtio_blk(memory &m, plic &p, uint32_t source, uint32_t threads);
+    ~virtio_blk();
+
+    bool open_image(const std::string &fname);
+    void set_events(event_queue *q);
+
+    uint8_t read8(uint32_t offset) override;
+    void write8(uint32_t offset, uint8_t val) override;
+    uint64_t read(uint32_t offset, uint32_t len) override;
+    void write(uint32_t offset, uint32_t len, uint64_t val) override;
+
+    void register_stats(stats &s, const std::string &prefix) const;
+    void register_state(checkpoint &c, const std::string &prefix);
+
+    static constexpr uint32_t base          = 0x10001000;
+    static constexpr uint32_t size          = 0x1000;
+    static constexpr uint32_t irq           = 1;
+
+private:
+    static constexpr uint32_t reg_magic             = 0x000;
+    static constexpr uint32_t reg_version           = 0x004;
+    static constexpr uint32_t reg_device_id         = 0x008;
+    static constexpr uint32_t reg_vendor_id         = 0x00c;
+    static constexpr uint32_t reg_device_features   = 0x010;
+    static constexpr uint32_t reg_device_features_sel = 0x014;
+    static constexpr uint32_t reg_driver_features   = 0x020;
+    static constexpr uint32_t reg_driver_features_sel = 0x024;
+    static constexpr uint32_t reg_queue_sel         = 0x030;
+    static constexpr uint32_t reg_queue_num_max     = 0x034;
+    static constexpr uint32_t reg_queue_num         = 0x038;
+    static constexpr uint32_t reg_queue_ready       = 0x044;
+    static constexpr uint32_t reg_queue_notify      = 0x050;
+    static constexpr uint32_t reg_interrupt_status  = 0x060;
+    static constexpr uint32_t reg_interrupt_ack     = 0x064;
+    static constexpr uint32_t reg_status            = 0x070;
+    static constexpr uint32_t reg_queue_desc        = 0x080;
+    static constexpr uint32_t reg_queue_driver      = 0x090;
+    static constexpr uint32_t reg_queue_device      = 0x0a0;
+    static constexpr uint32_t reg_config_generation = 0x0fc;
+    static constexpr uint32_t reg_config            = 0x100;
+
+    static constexpr uint64_t feature_ro            = 1ull << 5;
+    static constexpr uint64_t feature_blk_size      = 1ull << 6;
+    static constexpr uint64_t feature_flush         = 1ull << 9;
+    static constexpr uint64_t feature_version_1     = 1ull << 32;
+
+    static constexpr uint32_t type_in               = 0;
+    static constexpr uint32_t type_out              = 1;
+    static constexpr uint32_t type_flush            = 4;
+    static constexpr uint32_t type_get_id           = 8;
+
+    static constexpr uint8_t status_ok              = 0;
+    static constexpr uint8_t status_ioerr           = 1;
+    static constexpr uint8_t status_unsupp          = 2;
+
+    static constexpr uint16_t desc_next             = 1;
+    static constexpr uint16_t desc_write            = 2;
+
+    static constexpr uint32_t queue_num_max         = 256;
+    static constexpr uint32_t sector_size           = 512;
+    static constexpr uint64_t completion_delay      = 10000;   ///< Instructions, with an event queue.
+
+    /**
+     * @brief A request taken from the available ring.
+    */
+    struct request
+    {
+        uint16_t head;                  ///< The first descriptor, which goes in the used ring.
+        uint32_t type;
+        uint64_t sector;
+        std::vector<iovec> data;        ///< The data buffers, in the simulated memory.
+        uint8_t *status;                ///< The status byte, in the simulated memory.
+    };
+
+    void notify();
+    bool parse(uint16_t head, request &r);
+    void process(const request &r);
+    void complete(uint16_t head, uint32_t written);
+    void deliver(uint16_t head);
+    void reset();
+    uint8_t config8(uint32_t offset) const;
+
+    memory &mem;
+    plic &irqc;
+    uint32_t source;
+
+    int fd = { -1 };
+    bool read_only = { false };
+    uint64_t capacity = { 0 };          ///< In sectors.
+
+    uint32_t device_features_sel = { 0 };
+    uint32_t driver_features_sel = { 0 };
+    uint64_t driver_features = { 0 };
+    uint32_t status = { 0 };
+    uint32_t queue_sel = { 0 };
+    uint32_t queue_num = { 0 };
+    uint32_t queue_ready = { 0 };
+    uint64_t desc_addr = { 0 };
+    uint64_t driver_addr = { 0 };
+    uint64_t device_addr = { 0 };
+    uint16_t last_avail = { 0 };
+
+    std::mutex queue_lock;              ///< Held by a hart walking the available ring.
+    std::mutex used_lock;               ///< Held to complete a request or change the interrupt.
+    std::condition_variable idle;       ///< Signalled when a job is done.
+    uint16_t used_idx = { 0 };
+    uint32_t in_flight = { 0 };
+    uint32_t interrupt_status = { 0 };
+    event_queue *events = { nullptr };
+    std::map<uint16_t, uint64_t> timed;     ///< The completion event of each request, by head.
+    std::map<uint16_t, uint32_t> finished;  ///< Bytes written by each job done but not delivered.
+
+    uint64_t notifies = { 0 };
+    uint64_t requests = { 0 };
+    uint64_t bytes_read = { 0 };
+    uint64_t bytes_written = { 0 };
+    uint64_t errors = { 0 };
+    uint64_t host_waits = { 0 };
+
+    std::unique_ptr<thread_pool> pool;  ///< Last, so its jobs finish before the rest goes.
+};
+
+#endif